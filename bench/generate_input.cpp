@@ -0,0 +1,91 @@
+// Writes a large synthetic program in the C++ subset the optimizer
+// understands, for use with the benchmarks in this directory.
+//
+// Usage: generate_input <output_file> [statements_per_function] [functions]
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// Small deterministic generator so every run produces the same file
+struct Lcg {
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    uint32_t next(uint32_t bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>(state >> 33) % bound;
+    }
+};
+
+void writeFunction(std::ofstream& out, Lcg& rng, int statements) {
+    out << "int main() {\n";
+    int vars = 0;
+    auto var = [&]() { return "v" + std::to_string(rng.next(static_cast<uint32_t>(vars))); };
+
+    for (int s = 0; s < statements; ++s) {
+        if (vars < 4) {
+            out << "    int v" << vars++ << " = " << rng.next(100) << " + " << rng.next(100) << ";\n";
+            continue;
+        }
+        switch (rng.next(8)) {
+            case 0:
+                out << "    int v" << vars++ << " = " << var() << " * " << rng.next(16) << " + " << var() << ";\n";
+                break;
+            case 1:
+                out << "    " << var() << " = " << var() << " - " << rng.next(50) << ";\n";
+                break;
+            case 2:
+                out << "    if (" << var() << " < " << var() << ") {\n"
+                    << "        std::cout << \"branch " << s << "\" << " << var() << " << std::endl;\n"
+                    << "    }\n";
+                break;
+            case 3:
+                out << "    for (int i = 0; i < " << (rng.next(20) + 1) << "; i++) {\n"
+                    << "        " << var() << " += i;\n"
+                    << "    }\n";
+                break;
+            case 4:
+                out << "    while (" << var() << " < " << rng.next(1000) << ") {\n"
+                    << "        " << var() << "++;\n"
+                    << "    }\n";
+                break;
+            case 5:
+                out << "    // step " << s << ": keep the comment scanner busy as well\n";
+                break;
+            case 6:
+                out << "    std::cin >> " << var() << ";\n";
+                break;
+            default:
+                out << "    float f" << s << " = " << rng.next(100) << ".5 * 2;\n";
+                break;
+        }
+    }
+    out << "    return 0;\n}\n\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <output_file> [statements_per_function] [functions]" << std::endl;
+        return 1;
+    }
+
+    int statements = argc > 2 ? std::atoi(argv[2]) : 200000;
+    int functions = argc > 3 ? std::atoi(argv[3]) : 1;
+
+    std::ofstream out(argv[1]);
+    if (!out.is_open()) {
+        std::cerr << "Error opening file for writing: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    Lcg rng;
+    out << "#include <iostream>\n";
+    for (int f = 0; f < functions; ++f) {
+        writeFunction(out, rng, statements);
+    }
+    return 0;
+}
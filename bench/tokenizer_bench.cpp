@@ -0,0 +1,69 @@
+// Tokenizer throughput for each available scanning backend.
+//
+// Usage: tokenizer_bench <input_file> [iterations]
+#include "../include/Tokenizer.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+bool sameTokens(const std::vector<Token>& a, const std::vector<Token>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].type != b[i].type || a[i].value != b[i].value || a[i].offset != b[i].offset ||
+            a[i].loc.line != b[i].loc.line || a[i].loc.column != b[i].loc.column) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <input_file> [iterations]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file(argv[1]);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << argv[1] << std::endl;
+        return 1;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    SourceBuffer source(buffer.str());
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    const double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+    std::cout << "Input: " << megabytes << " MB, " << iterations << " iterations" << std::endl;
+
+    std::vector<Token> reference = Tokenizer(LexerBackend::Scalar).tokenize(source);
+
+    for (LexerBackend backend : {LexerBackend::Scalar, LexerBackend::SSE2, LexerBackend::AVX2}) {
+        if (!Tokenizer::isSupported(backend)) continue;
+        Tokenizer tokenizer(backend);
+
+        double best = 0;
+        size_t count = 0;
+        for (int it = 0; it < iterations; ++it) {
+            auto start = std::chrono::steady_clock::now();
+            auto tokens = tokenizer.tokenize(source);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = it == 0 ? elapsed.count() : std::min(best, elapsed.count());
+            count = tokens.size();
+            if (it == 0 && !sameTokens(tokens, reference)) {
+                std::cerr << "Error: " << tokenizer.backendName() << " tokens differ from scalar" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << tokenizer.backendName() << ": " << count << " tokens, "
+                  << megabytes / best << " MB/s" << std::endl;
+    }
+    return 0;
+}
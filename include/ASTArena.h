@@ -0,0 +1,84 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Bump-pointer arena that owns every AST node of one compilation unit.
+// Nodes are never freed one by one and their destructors never run:
+// destroying the arena releases the whole tree at once, in time
+// proportional to the number of blocks rather than the number of nodes.
+// Everything placed in the arena must therefore only own arena memory.
+class ASTArena {
+public:
+    ASTArena() = default;
+    ASTArena(const ASTArena&) = delete;
+    ASTArena& operator=(const ASTArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment);
+
+    // Gives back the most recent allocation if `p` is it (lets a growing
+    // vector reuse its old storage); anything else is simply kept
+    void release(void* p, size_t bytes);
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Takes ownership of another arena, e.g. one a parser worker filled.
+    // Its nodes live as long as this arena, and containers inside them
+    // keep allocating from it. Statistics include adopted arenas.
+    void adopt(std::unique_ptr<ASTArena> other);
+
+    size_t bytesUsed() const;
+    size_t bytesReserved() const;
+    size_t blockCount() const;
+    size_t allocationCount() const;
+
+private:
+    static constexpr size_t BlockSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<std::unique_ptr<ASTArena>> adopted;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t usedBytes = 0;
+    size_t reservedBytes = 0;
+    size_t allocations = 0;
+};
+
+// Standard allocator over an ASTArena, for containers stored inside nodes
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(ASTArena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        arena->release(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <typename U> friend class ArenaAllocator;
+    ASTArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // AST_ARENA_H
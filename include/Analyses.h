@@ -0,0 +1,114 @@
+#ifndef ANALYSES_H
+#define ANALYSES_H
+
+#include "ControlFlowGraph.h"
+#include "Parser.h"
+#include <cstdint>
+#include <vector>
+
+// Symbols stored contiguously in an analysis result
+class SymbolRange {
+public:
+    SymbolRange() = default;
+    SymbolRange(const Symbol* first, const Symbol* last) : first(first), last(last) {}
+
+    const Symbol* begin() const { return first; }
+    const Symbol* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+
+private:
+    const Symbol* first = nullptr;
+    const Symbol* last = nullptr;
+};
+
+// Variables each statement assigns, itself or anywhere below it:
+// declarations, assignments, compound assignments, increments and cin
+// targets; a store to an array element writes the array. A call may write
+// any variable declared at the top level of the program. Expression nodes
+// have no entry of their own.
+class WriteSets {
+public:
+    // Sorted by symbol id without duplicates; empty if the node writes nothing
+    SymbolRange of(const ASTNode* node) const;
+
+private:
+    friend struct WrittenVariables;
+
+    struct Entry {
+        const ASTNode* node;
+        uint32_t offset; // into `symbols`
+        uint32_t count;
+    };
+
+    // Sorted by node address once collected: a binary search is cheaper
+    // than hashing a few hundred thousand statements
+    std::vector<Entry> entries;
+    std::vector<Symbol> symbols;
+};
+
+struct WrittenVariables {
+    using Result = WriteSets;
+    static Result run(const ASTNode* root);
+
+private:
+    static void collect(const ASTNode* node, const std::vector<Symbol>& globals, WriteSets& sets,
+                        std::vector<Symbol>& pending);
+};
+
+// Whether evaluating `node` may write a variable or do I/O: it is or
+// holds an assignment, compound assignment, increment or call
+bool hasSideEffects(const ASTNode* node);
+
+// Whether two trees are the same code: the same node types and text,
+// in the same shape
+bool sameExpression(const ASTNode* a, const ASTNode* b);
+
+// Type of the value an expression computes, as far as passes track it
+enum class ValueType : uint8_t { Unknown, Bool, Int, Float, Double };
+
+// int and float; other declared types are not tracked
+ValueType declaredType(Symbol type);
+// true and false are bool; a number with a point or an exponent is a double
+ValueType literalType(Symbol text);
+// The type C++ gives `left op right`; Unknown for %, <<, >> and & on
+// anything but integers
+ValueType resultType(Symbol op, ValueType left, ValueType right);
+// The type of !x, which is a bool, or -x, which promotes a bool to an int
+ValueType unaryResultType(Symbol op, ValueType operand);
+// The type to declare a variable that holds such values exactly; empty if
+// there is none
+Symbol declarableType(ValueType type);
+// The type of an expression in the function `graph` belongs to, as the
+// optimizer sees it: its variables have their declared types, and other
+// names none
+ValueType expressionType(const ASTNode* node, const ControlFlowGraph& graph);
+
+// The value of a decimal int literal, possibly negative as folding spells
+// it; false for anything else, or a value int cannot hold
+bool intLiteralValue(Symbol text, int64_t& value);
+
+// Whether an array index is `variable` plus a literal: i, i + c, c + i
+// or i - c; `offset` is then the signed literal
+bool affineIndex(const ASTNode* index, Symbol variable, int64_t& offset);
+
+// A for loop that runs a known number of times: an int variable set to a
+// literal by the initializer, compared with a literal by the condition
+// (<, <=, >, >= or !=, with the literal on either side) and stepped by a
+// literal by the increment (++, --, += or -=), with no write to it in
+// the body. Loops that would only end by overflowing are not counted.
+struct CountedLoop {
+    Symbol variable;
+    bool declared; // by the initializer, so it ends with the loop
+    int64_t start;
+    int64_t step;
+    int64_t trips;
+
+    // The variable's value in the last iteration, and once the loop ends
+    int64_t last() const { return start + (trips - 1) * step; }
+    int64_t end() const { return start + trips * step; }
+};
+
+bool countedLoop(const ASTNode* loop, const ControlFlowGraph& graph, const WriteSets& writes, CountedLoop& count);
+
+#endif // ANALYSES_H
@@ -0,0 +1,228 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "Parser.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The instruction set of the virtual machine. Every instruction names
+// registers of the frame of the function it is in as a, b and c; some use
+// b and c together as a 32-bit operand instead (target, index), or c as a
+// signed 16-bit one (immediate, offset). Ints are kept sign-extended, and
+// wrap around as they do on the hardware; floats are kept as the doubles
+// they convert to exactly, rounded after every operation.
+#define BYTECODE_OPCODES(X)                                                                  \
+    X(Move)          /* a = b */                                                             \
+    X(Clear)         /* a, a + 1, ..., a + b - 1 = 0 */                                      \
+    X(IntToReal)     /* a = double(b) */                                                     \
+    X(RealToInt)     /* a = int(b), truncated */                                             \
+    X(RoundFloat)    /* a = float(b) */                                                      \
+    X(ToBool)        /* a = b != 0 */                                                        \
+    X(RealToBool)    /* a = b != 0.0 */                                                      \
+    X(AddInt)        /* a = b + c */                                                         \
+    X(AddIntImm)     /* a = b + immediate */                                                 \
+    X(SubInt)        /* a = b - c */                                                         \
+    X(MulInt)        /* a = b * c */                                                         \
+    X(DivInt)        /* a = b / c */                                                         \
+    X(ModInt)        /* a = b % c */                                                         \
+    X(ShlInt)        /* a = b << c */                                                        \
+    X(ShrInt)        /* a = b >> c */                                                        \
+    X(AndInt)        /* a = b & c */                                                         \
+    X(OrInt)         /* a = b | c */                                                         \
+    X(XorInt)        /* a = b ^ c */                                                         \
+    X(NegInt)        /* a = -b */                                                            \
+    X(Not)           /* a = !b */                                                            \
+    X(AddReal)       /* a = b + c */                                                         \
+    X(SubReal)       /* a = b - c */                                                         \
+    X(MulReal)       /* a = b * c */                                                         \
+    X(DivReal)       /* a = b / c */                                                         \
+    X(NegReal)       /* a = -b */                                                            \
+    X(EqInt)         /* a = b == c */                                                        \
+    X(NeInt)         /* a = b != c */                                                        \
+    X(LtInt)         /* a = b < c */                                                         \
+    X(LeInt)         /* a = b <= c */                                                        \
+    X(EqReal)        /* a = b == c */                                                        \
+    X(NeReal)        /* a = b != c */                                                        \
+    X(LtReal)        /* a = b < c */                                                         \
+    X(LeReal)        /* a = b <= c */                                                        \
+    X(LoadElement)   /* a = array b [c] */                                                   \
+    X(StoreElement)  /* array a [b] = c */                                                   \
+    X(SetElement)    /* array a [index b] = c */                                             \
+    X(ClearArray)    /* every element of array a = 0 */                                      \
+    X(LoadGlobal)    /* a = global b */                                                      \
+    X(StoreGlobal)   /* global a = b */                                                      \
+    X(Jump)          /* go to target */                                                      \
+    X(JumpIfZero)    /* if a == 0, go to target */                                           \
+    X(JumpIfNotZero) /* if a != 0, go to target */                                           \
+    X(BranchEqInt)   /* if a == b, go offset instructions on from the next */                \
+    X(BranchNeInt)   /* if a != b, ... */                                                    \
+    X(BranchLtInt)   /* if a < b, ... */                                                     \
+    X(BranchLeInt)   /* if a <= b, ... */                                                    \
+    X(Call)          /* a = function b, with its arguments in c, c + 1, ... */               \
+    X(Return)        /* return a */                                                          \
+    X(ReturnVoid)    /* return */                                                            \
+    X(PrintInt)      /* output int a */                                                      \
+    X(PrintReal)     /* output double a */                                                   \
+    X(PrintChar)     /* output the character b */                                            \
+    X(PrintString)   /* output string index */                                               \
+    X(PrintEndl)     /* output a newline and flush */                                        \
+    X(ReadInt)       /* input int a */                                                       \
+    X(ReadFloat)     /* input float a */
+
+enum class Opcode : uint8_t {
+#define BYTECODE_ENUMERATOR(name) name,
+    BYTECODE_OPCODES(BYTECODE_ENUMERATOR)
+#undef BYTECODE_ENUMERATOR
+};
+
+constexpr size_t OpcodeCount = 0
+#define BYTECODE_COUNT(name) +1
+    BYTECODE_OPCODES(BYTECODE_COUNT)
+#undef BYTECODE_COUNT
+    ;
+
+const char* opcodeName(Opcode op);
+
+struct Instruction {
+    Opcode op;
+    uint16_t a = 0;
+    uint16_t b = 0;
+    uint16_t c = 0;
+
+    uint32_t target() const { return uint32_t(b) | uint32_t(c) << 16; }
+    int16_t immediate() const { return static_cast<int16_t>(c); }
+};
+
+// A register, or an element of an array
+union Value {
+    int64_t i;
+    double r;
+};
+
+struct BytecodeFunction {
+    // An array of a frame, after the registers
+    struct Array {
+        uint32_t offset; // from the start of the frame
+        uint32_t size;
+    };
+
+    Symbol name;
+    uint16_t parameters = 0;  // in the first registers
+    uint16_t registers = 0;
+    uint32_t frameSize = 0;   // registers and arrays
+    std::vector<Value> constants; // in the registers after the parameters
+    std::vector<Array> arrays;
+    std::vector<Instruction> code;
+    std::vector<uint32_t> lines; // of each instruction, for errors
+    bool reals = false;          // has float values, not only ints
+};
+
+struct BytecodeProgram {
+    std::vector<BytecodeFunction> functions;
+    std::vector<std::string> strings;
+    uint32_t globals = 0; // variables outside functions, zero until main sets them
+    uint32_t entry = 0;   // main
+
+    // Instructions of every function
+    size_t size() const;
+};
+
+// Compiles a program to bytecode: functions with int and float
+// parameters and results, int and float variables and arrays, arithmetic,
+// comparisons and logic, if, for, while and do-while statements, calls,
+// and std::cin and std::cout. Variables take registers for as long as
+// they are in scope; temporaries only for the statement that computes
+// them. Literals are in registers of their own, set when the frame is.
+// Variables declared outside functions are globals, loaded and stored
+// where they are used, and main starts by initializing them; arrays must
+// be declared in functions.
+class BytecodeCompiler {
+public:
+    // Throws std::runtime_error, naming the line, for what the machine
+    // cannot run
+    BytecodeProgram compile(const ASTNode* root);
+
+private:
+    enum class Type : uint8_t { Int, Float, Double }; // comparisons and logic give an Int
+
+    struct Operand {
+        uint16_t reg;
+        Type type;
+    };
+
+    struct Variable {
+        uint16_t reg = 0;
+        Type type = Type::Int;
+        int32_t array = -1;  // of the function, if it is one
+        int32_t global = -1; // of the program, if it is one
+    };
+
+    // A name bound in the current scope, and what it meant before
+    struct Binding {
+        Symbol name;
+        bool shadows;
+        Variable previous;
+    };
+
+    struct Signature {
+        const ASTNode* definition = nullptr;
+        Type result = Type::Int;
+        bool returns = true; // not void
+        std::vector<Type> parameters;
+    };
+
+    void compileFunction(uint32_t index);
+    void collectConstants(const ASTNode* node);
+
+    void compileStatement(const ASTNode* node);
+    void compileScope(const ASTNode* node);
+    void compileNested(const ASTNode* node);
+    void endScope(size_t scope);
+    void compileDeclaration(const ASTNode* node);
+    void compileArrayDeclaration(const ASTNode* node);
+    void compilePrint(const ASTNode* node);
+    void compileInput(const ASTNode* node);
+    void compileReturn(const ASTNode* node);
+    void compileJumpIf(const ASTNode* condition, bool when, std::vector<size_t>& jumps);
+    void compileLoopBranch(const ASTNode* condition, size_t target);
+
+    Operand compileExpression(const ASTNode* node, int32_t dest = -1);
+    void compileInto(const ASTNode* node, uint16_t reg, Type type);
+    Operand compileBinary(const ASTNode* node, int32_t dest);
+    Operand compileLogic(const ASTNode* node);
+    Operand compileStore(const ASTNode* node, bool wantValue);
+    Operand compileCall(const ASTNode* node, int32_t dest);
+    Operand arithmetic(Symbol op, Operand left, Operand right, int32_t dest);
+    Operand compare(Symbol op, Operand left, Operand right, int32_t dest);
+    Operand convert(Operand operand, Type type, int32_t dest = -1);
+    Operand constant(const ASTNode* literal);
+
+    const Variable& lookup(const ASTNode* identifier);
+    const Variable& lookupArray(const ASTNode* identifier);
+    void bind(Symbol name, const Variable& variable);
+    uint16_t newRegister();
+    uint16_t target(int32_t dest) { return dest >= 0 ? static_cast<uint16_t>(dest) : newRegister(); }
+    size_t emit(Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+    void patch(size_t jump, size_t to);
+    Type typeOf(Symbol type) const;
+    static bool numericLiteral(Symbol spelling, Value& value, Type& type);
+    [[noreturn]] void fail(const std::string& message) const;
+
+    BytecodeProgram program;
+    std::vector<Signature> signatures;
+    SymbolMap<uint32_t> functionIndex;
+    std::vector<const ASTNode*> globals; // declarations
+
+    // State of the function being compiled
+    BytecodeFunction* function = nullptr;
+    const Signature* signature = nullptr;
+    SymbolMap<Variable> variables;
+    std::vector<Binding> bindings;
+    SymbolMap<Operand> constants; // by spelling
+    uint32_t top = 0;             // first free register
+    uint32_t memory = 0;          // taken by the arrays declared so far
+    uint32_t line = 0;            // of the statement being compiled
+};
+
+#endif // BYTECODE_H
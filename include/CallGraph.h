@@ -0,0 +1,43 @@
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#include "Parser.h"
+#include <cstdint>
+#include <vector>
+
+// Functions of a program and the calls between them. A function is known
+// by its name; its definition is the declaration with a body, and it may
+// be declared any number of times before that.
+class CallGraph {
+public:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Function {
+        Symbol name;
+        const ASTNode* definition = nullptr; // null if it is only declared
+        std::vector<uint32_t> callees;       // each once, in the order first called
+        size_t calls = 0;                    // calls to it anywhere in the program
+        bool recursive = false;              // calls itself, directly or through others
+    };
+
+    const std::vector<Function>& functions() const { return functionList; }
+
+    // The function with this name; None if there is none
+    uint32_t find(Symbol name) const;
+
+private:
+    friend struct Calls;
+
+    std::vector<Function> functionList;
+    SymbolMap<uint32_t> byName;
+};
+
+struct Calls {
+    using Result = CallGraph;
+    static Result run(const ASTNode* root);
+
+private:
+    static void collect(const ASTNode* node, uint32_t caller, CallGraph& graph);
+};
+
+#endif // CALL_GRAPH_H
@@ -1,15 +1,15 @@
-#ifndef CODE_ANALYZER_H
-#define CODE_ANALYZER_H
-
-#include "Parser.h"
-
-class CodeAnalyzer {
-public:
-    void analyze(const std::shared_ptr<ASTNode>& root);
-
-private:
-    void checkRedundantConditions(const std::shared_ptr<ASTNode>& node);
-    void report(const std::string& message);
-};
-
-#endif
+#ifndef CODE_ANALYZER_H
+#define CODE_ANALYZER_H
+
+#include "Parser.h"
+
+class CodeAnalyzer {
+public:
+    void analyze(const ASTNode* root);
+
+private:
+    void checkRedundantConditions(const ASTNode* node);
+    void report(const std::string& message);
+};
+
+#endif
@@ -1,35 +1,126 @@
-#ifndef CODE_OPTIMIZER_H
-#define CODE_OPTIMIZER_H
-
-#include "Parser.h"
-#include <string>
-#include <unordered_map>
-#include <sstream>
-#include <utility>
-
-class CodeOptimizer {
-public:
-    // Takes the AST and performs optimizations, returning a new optimized AST
-    std::shared_ptr<ASTNode> optimize(const std::shared_ptr<ASTNode>& root);
-    
-    // Convert the optimized AST back to code
-    std::string generateCode(const std::shared_ptr<ASTNode>& root);
-
-private:
-    // Various optimization methods
-    std::shared_ptr<ASTNode> optimizeRedundantConditions(const std::shared_ptr<ASTNode>& node);
-    std::shared_ptr<ASTNode> optimizeConstantFolding(const std::shared_ptr<ASTNode>& node);
-    std::shared_ptr<ASTNode> eliminateDeadCode(const std::shared_ptr<ASTNode>& node);
-    std::shared_ptr<ASTNode> optimizeLoops(const std::shared_ptr<ASTNode>& node);
-    
-    // Helper for evaluating constant expressions recursively
-    std::pair<bool, double> evaluateConstantExpression(const std::shared_ptr<ASTNode>& node);
-    
-    // Helpers for code generation
-    void generateCodeForNode(const std::shared_ptr<ASTNode>& node, std::ostringstream& code, int indent);
-    
-    // Symbol table for constant propagation
-    std::unordered_map<std::string, std::string> constantValues;
-};
-
-#endif // CODE_OPTIMIZER_H
\ No newline at end of file
+#ifndef CODE_OPTIMIZER_H
+#define CODE_OPTIMIZER_H
+
+#include "Parser.h"
+#include "ConstantPropagation.h"
+#include "CostModel.h"
+#include "DeadStoreElimination.h"
+#include "Inliner.h"
+#include "LoopFusion.h"
+#include "LoopInvariantCodeMotion.h"
+#include "LoopUnrolling.h"
+#include "PassManager.h"
+#include "PeepholeRewriter.h"
+#include "StrengthReduction.h"
+#include "ValueNumbering.h"
+#include "Vectorizer.h"
+#include <string>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+class CodeOptimizer {
+public:
+    // Nodes created while optimizing are allocated in `arena`
+    explicit CodeOptimizer(ASTArena& arena);
+    CodeOptimizer(const CodeOptimizer&) = delete;
+    CodeOptimizer& operator=(const CodeOptimizer&) = delete;
+
+    // Takes the AST and performs optimizations, returning a new optimized AST.
+    // The passes run again and again until none of them changes the tree,
+    // or until the iteration limit is reached. `root` is left intact; the
+    // result shares every subtree that no pass changed with it.
+    ASTNode* optimize(ASTNode* root);
+
+    // Convert the optimized AST back to code
+    std::string generateCode(ASTNode* root);
+
+    void setIterationLimit(unsigned limit) { passManager.setIterationLimit(limit); }
+
+    // Partial unrolling factor (below 2 turns it off) and the most AST
+    // nodes an unrolled loop may take
+    void setUnrollFactor(unsigned factor) { loopUnrolling.setFactor(factor); }
+    void setUnrollBudget(size_t nodes) { loopUnrolling.setBudget(nodes); }
+
+    // SIMD lanes per strip of a vectorized loop (below 2 turns it off)
+    void setVectorWidth(unsigned lanes) { vectorizer.setWidth(lanes); }
+
+    // The most AST nodes a function called more than once may have to be
+    // inlined
+    void setInlineBudget(size_t nodes) { inliner.setBudget(nodes); }
+
+    // The estimates passes weigh rewrites with
+    const CostModel& costModel() const { return costs; }
+    void setAssumedTrips(double trips) { costs.setAssumedTrips(trips); }
+
+    // Iterations, per-pass time and rewrites of the last optimize()
+    const PassManager& passes() const { return passManager; }
+
+private:
+    // Rewrites one node whose subtrees are already rewritten; returns its
+    // replacement, the node itself if nothing applies, or null to remove it.
+    // The node may belong to the caller's tree and must not be modified.
+    using Rule = ASTNode* (CodeOptimizer::*)(ASTNode* node);
+
+    // Applies `rule` to every node of the tree, children before parents.
+    // Returns the new root; ancestors of a rewrite are copied, every
+    // other node is shared with the input.
+    ASTNode* rewriteBottomUp(ASTNode* node, Rule rule, size_t& rewrites);
+
+    // Various optimization methods
+    ASTNode* eliminateDeadCode(ASTNode* node);
+    ASTNode* optimizeLoops(ASTNode* node);
+    ASTNode* optimizeConstantFolding(ASTNode* node);
+
+    // A value the folder knows exactly, with the type C++ gives it;
+    // Unknown if the expression is not a constant
+    struct Constant {
+        ValueType type = ValueType::Unknown;
+        int64_t integer = 0; // of a Bool or an Int
+        double real = 0;     // of a Double
+    };
+
+    // Helpers for evaluating constant expressions recursively
+    Constant evaluateConstantExpression(const ASTNode* node);
+    static Constant literalConstant(Symbol text);
+    static Constant applyOperator(Symbol op, const Constant& left, const Constant& right);
+    static Constant applyUnaryOperator(Symbol op, const Constant& operand);
+    static bool truthOf(const Constant& value);
+    static std::string spellingOf(const Constant& value);
+    static std::string convertedSpelling(Symbol type, const Constant& value);
+    static std::string shortestSpelling(double value, bool asFloat);
+
+    // Helpers for code generation
+    void generateCodeForNode(ASTNode* node, std::ostream& code, int indent);
+    void generateOperand(ASTNode* node, std::ostream& code, int minPrecedence);
+
+    template <typename Value>
+    ASTNode* makeNode(ASTNodeType type, Value&& value) {
+        return arena.create<ASTNode>(arena, type, std::forward<Value>(value));
+    }
+
+    ASTArena& arena;
+    CostModel costs;
+    PassManager passManager;
+    Inliner inliner;
+    ConstantPropagation constantPropagation;
+    ValueNumbering valueNumbering;
+    LoopFusion loopFusion;
+    LoopInvariantCodeMotion loopInvariantMotion;
+    PeepholeRewriter peephole;
+    StrengthReduction strengthReduction;
+    Vectorizer vectorizer;
+    LoopUnrolling loopUnrolling;
+    DeadStoreElimination deadStores;
+
+    // Values of recently evaluated operations, by node address. Nodes never
+    // change once built, so an entry stays valid; a collision only costs
+    // evaluating the node again.
+    struct CachedConstant {
+        const ASTNode* node = nullptr;
+        Constant value;
+    };
+    std::vector<CachedConstant> constants;
+};
+
+#endif // CODE_OPTIMIZER_H
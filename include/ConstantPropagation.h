@@ -0,0 +1,123 @@
+#ifndef CONSTANT_PROPAGATION_H
+#define CONSTANT_PROPAGATION_H
+
+#include "ControlFlowGraph.h"
+#include "PassManager.h"
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Sparse conditional constant propagation (Wegman and Zadeck) over the
+// control flow graph of each function.
+//
+// The variables of a function are put in SSA form: every write is a value
+// of its own, and a phi merges the values reaching a join point. Values
+// start out unknown and are lowered to a constant, then to "varying", as
+// blocks turn out to be reachable; a branch whose condition is a constant
+// makes only one of its edges reachable, so a write behind a branch that
+// never runs does not spoil a constant. Only int and bool values are
+// tracked, with the arithmetic of a 32-bit int.
+//
+// Uses of constant variables and constant operations are replaced by
+// literals, conditions that always go one way become true or false, and
+// statements no reachable edge leads to are removed.
+class ConstantPropagation {
+public:
+    // Nodes created by the pass are allocated in `arena`
+    explicit ConstantPropagation(ASTArena& arena) : arena(arena) {}
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    struct Lattice {
+        enum class State : uint8_t { Unknown, Constant, Varying };
+        State state = State::Unknown;
+        bool boolean = false; // a bool constant, rather than an int
+        int64_t number = 0;
+
+        static Lattice constant(int64_t number, bool boolean = false) {
+            return Lattice{State::Constant, boolean, number};
+        }
+        static Lattice varying() { return Lattice{State::Varying}; }
+        bool isConstant() const { return state == State::Constant; }
+        bool operator==(const Lattice& other) const {
+            return state == other.state && boolean == other.boolean && number == other.number;
+        }
+    };
+
+    // A write: a declaration, assignment, compound assignment, increment
+    // or cin target, producing SSA value `value`
+    struct Definition {
+        const ASTNode* writer;
+        const ASTNode* target; // the identifier written
+        uint32_t variable;
+        uint32_t value;
+    };
+
+    struct Phi {
+        uint32_t variable;
+        uint32_t value;
+        std::vector<uint32_t> operands; // one value per predecessor of the block
+    };
+
+    // What is known about one block during and after the propagation
+    struct BlockState {
+        std::vector<Phi> phis;
+        std::vector<Definition> definitions; // in execution order
+        std::array<bool, 2> edgeExecutable{false, false};
+        bool executable = false;
+        bool queued = false;
+    };
+
+    // Building SSA form
+    void computeDominators(const ControlFlowGraph& graph);
+    void placePhis(const ControlFlowGraph& graph);
+    void renameVariables(const ControlFlowGraph& graph);
+    uint32_t newValue();
+
+    // Propagation
+    void propagate(const ControlFlowGraph& graph);
+    void visitBlock(uint32_t block, const ControlFlowGraph& graph);
+    void markEdge(uint32_t from, size_t slot, const ControlFlowGraph& graph);
+    void lower(uint32_t value, Lattice lattice);
+    void enqueue(uint32_t block);
+    Lattice evaluate(const ASTNode* node) const;
+    Lattice evaluateDefinition(const Definition& definition, const ControlFlowGraph& graph) const;
+    uint32_t valueOf(const ASTNode* identifier) const;
+
+    static Lattice meet(Lattice a, Lattice b);
+    static Lattice apply(Symbol op, Lattice left, Lattice right);
+    static Lattice applyUnary(Symbol op, Lattice operand);
+    static Lattice literalValue(Symbol text);
+
+    // Rewriting the tree
+    ASTNode* rewriteStatement(ASTNode* node, const ControlFlowGraph& graph);
+    ASTNode* rewriteExpression(ASTNode* node);
+    ASTNode* rewriteCondition(ASTNode* node, const ASTNode* statement);
+    ASTNode* literal(const Lattice& lattice);
+    bool reachable(const ASTNode* statement, const ControlFlowGraph& graph) const;
+
+    ASTArena& arena;
+
+    // State of one function. Value 0 is what a variable holds before any
+    // write: unknown to the analysis, so always varying.
+    std::vector<BlockState> blockStates;
+    std::vector<uint32_t> order;       // reachable blocks in reverse postorder
+    std::vector<uint32_t> orderIndex;  // block -> position in `order`, or None
+    std::vector<uint32_t> idom;        // immediate dominators
+    std::vector<std::vector<uint32_t>> frontiers;
+    std::vector<Lattice> values;
+    std::vector<uint32_t> current; // variable -> value it holds, while renaming
+    std::vector<std::pair<uint32_t, uint32_t>> renamed; // (variable, value it held before), innermost last
+    std::vector<std::pair<const ASTNode*, uint32_t>> uses; // identifier -> value it reads, sorted
+    std::vector<std::pair<uint32_t, uint32_t>> userPairs; // (value, block reading it)
+    std::vector<uint32_t> userOffsets; // value -> its range of `userBlocks`
+    std::vector<uint32_t> userBlocks;
+    std::vector<uint32_t> worklist;
+
+    size_t replaced = 0;
+    size_t removed = 0;
+};
+
+#endif // CONSTANT_PROPAGATION_H
@@ -0,0 +1,130 @@
+#ifndef CONTROL_FLOW_GRAPH_H
+#define CONTROL_FLOW_GRAPH_H
+
+#include "Parser.h"
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Basic blocks of one function body. Blocks hold the tree's own statement
+// nodes, in execution order; a for loop's increment is held as the
+// expression node it is. Every declaration is a variable of its own, so a
+// name declared again in an inner scope is a different variable.
+class ControlFlowGraph {
+public:
+    static constexpr uint32_t None = UINT32_MAX;
+    static constexpr uint32_t Entry = 0;
+    static constexpr uint32_t Exit = 1;
+
+    struct Block {
+        std::vector<const ASTNode*> statements;
+        // Evaluated after the statements; control goes to successors[0]
+        // if it is true and to successors[1] if it is false. Without a
+        // condition, control goes to successors[0], if there is one.
+        const ASTNode* condition = nullptr;
+        const ASTNode* branch = nullptr; // the if statement or loop the condition belongs to
+        std::array<uint32_t, 2> successors{None, None};
+        std::vector<uint32_t> predecessors;
+    };
+
+    struct Variable {
+        Symbol name;
+        Symbol type; // as declared: "int" or "float", or "int[]" for an array of int
+    };
+
+    const ASTNode* function() const { return functionNode; }
+    const std::vector<Block>& blocks() const { return blockList; }
+    const std::vector<Variable>& variables() const { return variableList; }
+
+    // The variable an identifier in this function refers to; None for
+    // names declared outside it
+    uint32_t variableOf(const ASTNode* identifier) const;
+
+    // The block control is in when it reaches a statement of this
+    // function; a statement in a block no edge leads to is unreachable
+    uint32_t blockOf(const ASTNode* statement) const;
+
+private:
+    friend struct ControlFlow;
+    class Builder;
+
+    const ASTNode* functionNode = nullptr;
+    std::vector<Block> blockList;
+    std::vector<Variable> variableList;
+
+    // Sorted by node address once built, like WriteSets
+    std::vector<std::pair<const ASTNode*, uint32_t>> identifierVariables;
+    std::vector<std::pair<const ASTNode*, uint32_t>> statementBlocks;
+};
+
+// Calls read(identifier) for every variable a block statement, condition
+// or for loop increment reads, and write(writer, identifier) for every one
+// it writes, in the order they happen. A compound assignment or increment
+// reads its target before writing it; a declaration's target is written
+// after its initializer is read. Storing to an element of an array reads
+// the index and the array, then writes the array: the other elements keep
+// their values.
+template <typename Read, typename Write>
+void forEachAccess(const ASTNode* node, Read&& read, Write&& write) {
+    if (!node) return;
+    auto writeElement = [&](const ASTNode* writer, const ASTNode* subscript) {
+        forEachAccess(subscript->right, read, write);
+        if (subscript->left && subscript->left->type == ASTNodeType::Identifier) {
+            read(subscript->left);
+            write(writer, subscript->left);
+        }
+    };
+    switch (node->type) {
+        case ASTNodeType::Identifier:
+            read(node);
+            return;
+        case ASTNodeType::Declaration:
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement:
+            forEachAccess(node->right, read, write);
+            if (node->left && node->left->type == ASTNodeType::Identifier) {
+                if (node->type != ASTNodeType::Declaration && node->type != ASTNodeType::Assignment) {
+                    read(node->left);
+                }
+                write(node, node->left);
+            } else if (node->left && node->left->type == ASTNodeType::ArraySubscript) {
+                writeElement(node, node->left);
+            }
+            return;
+        case ASTNodeType::ArrayDeclaration:
+            forEachAccess(node->right, read, write);
+            for (const ASTNode* child : node->children) {
+                forEachAccess(child, read, write);
+            }
+            if (node->left && node->left->type == ASTNodeType::Identifier) write(node, node->left);
+            return;
+        case ASTNodeType::InputStatement:
+            for (const ASTNode* child : node->children) {
+                if (!child) continue;
+                if (child->type == ASTNodeType::Identifier) {
+                    write(node, child);
+                } else if (child->type == ASTNodeType::ArraySubscript) {
+                    writeElement(node, child);
+                }
+            }
+            return;
+        default:
+            forEachAccess(node->left, read, write);
+            forEachAccess(node->right, read, write);
+            for (const ASTNode* child : node->children) {
+                forEachAccess(child, read, write);
+            }
+            return;
+    }
+}
+
+// One graph per function, in source order
+struct ControlFlow {
+    using Result = std::vector<ControlFlowGraph>;
+    static Result run(const ASTNode* root);
+};
+
+#endif // CONTROL_FLOW_GRAPH_H
@@ -0,0 +1,87 @@
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include "CallGraph.h"
+#include "Parser.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A static estimate of how many cycles code takes to run on a current
+// out-of-order x86-64 core. Every operator and statement has a cost: one
+// cycle for simple arithmetic, logic and comparisons, more for
+// multiplication and far more for division and remainder; a memory
+// access for an array element, a store for every write, and a taken or
+// not taken branch for every condition. Output costs a hundred cycles per
+// value and a thousand more for std::endl, which flushes; input costs
+// two hundred per value.
+//
+// A loop costs its body, condition and increment once per trip. A for
+// loop stepping a variable from a literal to a literal by a literal runs
+// the number of trips that gives; every other loop is assumed to run
+// over AssumedTrips values, in fewer trips if it steps by more than one.
+// The lanes loop of a vectorized strip runs in parallel, for the cost of
+// one trip, and the scalar epilogue after the strips is assumed to run
+// half of one. An if statement is assumed to run its body half of the
+// time. A call costs its overhead and its arguments, and, where the
+// program defines the callee, what its body costs; a recursive call costs
+// the overhead only.
+//
+// The numbers are rough: they are meant to compare two versions of the
+// same code, not to predict the time it takes.
+class CostModel {
+public:
+    static constexpr double DefaultAssumedTrips = 100;
+
+    // A function or a loop, and what running it once is estimated to cost
+    struct Region {
+        std::string kind;  // "function", "for loop", "while loop" or "do-while loop"
+        Symbol function;   // the one it is in, or is
+        uint32_t line = 0;
+        unsigned depth = 0;      // loops around it in its function
+        double trips = 1;        // of a loop
+        bool assumed = false;    // trip count not known
+        double cycles = 0;       // to run it once
+        double executions = 1;   // times it runs in one call of its function
+    };
+
+    void setAssumedTrips(double trips) { assumedTrips = trips; }
+
+    // Cycles one evaluation of an expression, or one execution of a
+    // statement, takes; calls count their overhead only
+    double cost(const ASTNode* node) const;
+
+    // Whether `replacement` is estimated to run faster than `original`
+    bool cheaper(const ASTNode* replacement, const ASTNode* original) const {
+        return cost(replacement) < cost(original);
+    }
+
+    // Times the body of a loop is estimated to run; `assumed` if the
+    // trip count is not known
+    double trips(const ASTNode* loop, bool& assumed) const;
+
+    // Every function the program defines, followed by the loops in it, in
+    // the order of the source; the whole program as one function named
+    // "program" if it defines none
+    std::vector<Region> regions(const ASTNode* root) const;
+
+private:
+    // What an estimate of a whole program needs besides the node
+    struct Walk {
+        const CallGraph* calls = nullptr;
+        std::vector<double> functionCycles; // by function, once computed
+        std::vector<char> state;            // 0 not started, 1 in progress, 2 done
+        std::vector<Region>* regions = nullptr; // to record loops into, if any
+        Symbol function;
+    };
+
+    double estimate(const ASTNode* node, Walk& walk, unsigned depth, double executions) const;
+    double estimateLoop(const ASTNode* loop, Walk& walk, unsigned depth, double executions) const;
+    double functionCost(uint32_t function, Walk& walk) const;
+
+    static double operatorCost(Symbol op, bool unary);
+
+    double assumedTrips = DefaultAssumedTrips;
+};
+
+#endif // COST_MODEL_H
@@ -0,0 +1,82 @@
+#ifndef DEAD_STORE_ELIMINATION_H
+#define DEAD_STORE_ELIMINATION_H
+
+#include "Analyses.h"
+#include "ControlFlowGraph.h"
+#include "PassManager.h"
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Removes stores no later read can see. A dead assignment or compound
+// assignment goes; a dead declaration loses its initializer, or goes
+// altogether once nothing else refers to its variable. A store whose
+// value is only read by dead stores is dead as well. Stores whose value
+// has side effects (an increment or assignment inside it) are kept.
+//
+// Liveness is a backward dataflow problem over each function's control
+// flow graph, solved with a bitvector per block indexed by variable. A
+// variable referenced in one block only, and written there before it is
+// read, is never live across blocks and gets no bit, so the vectors stay
+// narrow in long functions.
+class DeadStoreElimination {
+public:
+    // Bytes of code generateCode() emits for a node, not counting its
+    // indentation; 0 for null
+    using EmittedSize = std::function<size_t(ASTNode* node)>;
+
+    // Nodes created by the pass are allocated in `arena`
+    DeadStoreElimination(ASTArena& arena, EmittedSize emittedSize)
+        : arena(arena), emittedSize(std::move(emittedSize)) {}
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    enum class Fate : uint8_t { Keep, Remove, DropInitializer };
+
+    // A variable read or written by a block statement or condition
+    struct Access {
+        uint32_t variable;
+        bool write;
+    };
+
+    // One statement of a block, or its condition
+    struct Step {
+        const ASTNode* store; // the store the statement is, if it may be removed
+        uint32_t first;       // its accesses, in execution order: [first, last)
+        uint32_t last;
+    };
+
+    void collectAccesses(const ControlFlowGraph& graph);
+    void solveLiveness(const ControlFlowGraph& graph);
+    void transfer(uint32_t block, std::vector<uint64_t>& live, bool record);
+    void findDeadStores(const ControlFlowGraph& graph);
+    Fate fateOf(const ASTNode* statement) const;
+    ASTNode* rewriteStatement(ASTNode* node);
+
+    static const ASTNode* storeOf(const ASTNode* statement);
+
+    ASTArena& arena;
+    EmittedSize emittedSize;
+
+    // State of one function
+    std::vector<uint32_t> postorder;  // blocks reachable from the entry
+    std::vector<bool> reachable;
+    std::vector<Step> steps;          // of every block, in block order
+    std::vector<uint32_t> stepOffsets; // block -> its range of `steps`
+    std::vector<Access> accesses;
+    std::vector<uint32_t> bitIndex;   // variable -> its bit, or None if it is local to a block
+    std::vector<bool> localLive;      // live flags of the variables without a bit, while scanning
+    size_t words = 0;                 // per bitvector
+    std::vector<uint64_t> liveIn;     // blocks * words
+    std::vector<uint32_t> references; // variable -> identifiers naming it, besides its declaration
+    std::vector<const ASTNode*> deadStores;
+    std::vector<std::pair<const ASTNode*, Fate>> fates; // dead writers, sorted
+
+    size_t removedStores = 0;
+    size_t removedDeclarations = 0;
+    size_t savedBytes = 0;
+};
+
+#endif // DEAD_STORE_ELIMINATION_H
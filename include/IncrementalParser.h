@@ -0,0 +1,55 @@
+#ifndef INCREMENTAL_PARSER_H
+#define INCREMENTAL_PARSER_H
+
+#include "Parser.h"
+#include <cstddef>
+#include <vector>
+
+// Bytes [offset, offset + removed) of the old source were replaced by
+// `inserted` bytes, which are [offset, offset + inserted) of the new source
+struct TextEdit {
+    size_t offset = 0;
+    size_t removed = 0;
+    size_t inserted = 0;
+};
+
+struct ReparseStats {
+    size_t bytesRelexed = 0;
+    size_t statementsReparsed = 0;
+    size_t statementsReplaced = 0;
+    size_t levelsEscalated = 0; // times the edit did not stay inside its innermost block
+};
+
+// Brings a tree up to date after an edit without parsing the whole file
+// again. The statements around the edit in the innermost block that
+// contains it are relexed and reparsed. Every other subtree of the old tree
+// is kept as it is; nodes after the edit only have their positions moved.
+// The result is the tree a full parse of the new source would build.
+class IncrementalParser {
+public:
+    // New nodes are allocated in `arena`, which must outlive the tree
+    explicit IncrementalParser(ASTArena& arena, LexerBackend backend = LexerBackend::Auto)
+        : arena(arena), backend(backend) {}
+
+    // `program` is the tree of oldSource, as built by Parser::parse or an
+    // earlier reparse. It is updated in place and returned.
+    ASTNode* reparse(ASTNode* program, const SourceBuffer& oldSource,
+                     const SourceBuffer& newSource, const TextEdit& edit);
+
+    const ReparseStats& stats() const { return lastStats; }
+
+private:
+    struct Shift;
+
+    bool reparseList(ASTNode* list, const SourceBuffer& oldSource,
+                     const SourceBuffer& newSource, const TextEdit& edit, Shift& shift);
+    size_t countTokensBefore(const SourceBuffer& source, size_t from, size_t limit, size_t enough);
+    static void shiftAfter(const std::vector<ASTNode*>& path, size_t depth, const Shift& shift);
+    static void shiftSubtree(ASTNode* node, const Shift& shift);
+
+    ASTArena& arena;
+    LexerBackend backend;
+    ReparseStats lastStats;
+};
+
+#endif // INCREMENTAL_PARSER_H
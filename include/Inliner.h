@@ -0,0 +1,73 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "Analyses.h"
+#include "CallGraph.h"
+#include "ControlFlowGraph.h"
+#include "PassManager.h"
+#include <vector>
+
+// Replaces calls to small functions with the functions' code, so that the
+// passes after it see through the call.
+//
+// A function is inlined if it is not main, not recursive and has a body
+// that ends in its only return statement, uses no variable declared
+// outside it and fits in the size budget (in AST nodes); a function
+// called just once is inlined whatever its size. A call is inlined where
+// a declaration or assignment stores it, an expression statement or
+// return statement computes it or an if statement tests it, in a block,
+// unless && or || may skip it or an argument has side effects.
+//
+// The arguments are put in variables of the parameters' types ahead of
+// the statement, followed by the body, with every variable renamed;
+// the returned value takes the place of the call. An argument is used in
+// place of a parameter the body never writes if it has the parameter's
+// type, reads only the caller's own variables and either is a literal or
+// a variable, or the body is just the return using it once; the returned
+// expression is used in place of the call if it has the return type. A
+// function every call of which has been inlined is removed.
+class Inliner {
+public:
+    static constexpr size_t DefaultBudget = 40;
+
+    // Nodes created by the pass are allocated in `arena`
+    explicit Inliner(ASTArena& arena) : arena(arena) {}
+
+    void setBudget(size_t nodes) { budget = nodes; }
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    // A function calls to which may be inlined
+    struct Callee {
+        const ASTNode* definition = nullptr; // null if calls to it are kept
+        const ControlFlowGraph* graph = nullptr;
+        std::vector<Symbol> locals; // every name it declares, parameters first
+    };
+
+    ASTNode* rewriteStatement(ASTNode* node);
+    void rewriteInto(ASTNode* statement, std::vector<ASTNode*>& out);
+    const ASTNode* findCall(const ASTNode* node) const;
+    ASTNode* expand(const ASTNode* call, std::vector<ASTNode*>& out);
+    ASTNode* copyRenamed(const ASTNode* node);
+    ASTNode* replace(ASTNode* node, const ASTNode* target, ASTNode* replacement);
+    Symbol freshName(Symbol function, Symbol name, size_t number);
+
+    void examine(uint32_t function);
+
+    ASTArena& arena;
+    size_t budget = DefaultBudget;
+    size_t expansions = 0; // never reset, so that names stay fresh
+
+    // State of one run
+    const CallGraph* calls = nullptr;
+    const WriteSets* writeSets = nullptr;
+    const ControlFlowGraph* graph = nullptr; // of the function being rewritten
+    std::vector<Callee> callees;             // by call graph index
+    std::vector<size_t> inlinedCalls;        // calls to each function inlined
+    std::vector<size_t> copiedCalls;         // calls to each function copied with a body
+    SymbolMap<const ASTNode*> renamed;       // what the names of the body being expanded become
+    size_t inlined = 0;
+};
+
+#endif // INLINER_H
@@ -0,0 +1,76 @@
+#ifndef LOOP_FUSION_H
+#define LOOP_FUSION_H
+
+#include "Analyses.h"
+#include "ControlFlowGraph.h"
+#include "PassManager.h"
+#include <cstdint>
+#include <vector>
+
+// Fuses for loops that follow each other in a statement list and run over
+// the same values: the same initializer, condition and increment, with the
+// initializer declaring the int loop variable. The bodies run one after
+// the other in a single loop, so the data they share is streamed once.
+//
+// Fusing runs the second body for an iteration before the first body has
+// run its later iterations, so it is only done when that cannot be seen:
+// - no body writes the loop variable or anything the header reads;
+// - no body calls a function or returns, and at most one does I/O;
+// - no variable declared outside the bodies, in the function or outside
+//   every function, is written by one of them and used by another;
+// - an array written by one body and used by another is indexed as the
+//   loop variable plus a literal everywhere in both, and the earlier
+//   body's offset is never below the later body's: element i + c is
+//   written and used in the same order as before.
+class LoopFusion {
+public:
+    // Nodes created by the pass are allocated in `arena`
+    explicit LoopFusion(ASTArena& arena) : arena(arena) {}
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    // An element of an array a body uses
+    struct Element {
+        uint32_t array;
+        bool write;
+        bool affine; // indexed as the loop variable plus `offset`
+        int64_t offset;
+    };
+
+    // A variable declared outside every function
+    struct Global {
+        Symbol name;
+        bool array;
+    };
+
+    // What one loop's body does, as far as fusing it matters; variables
+    // are those of the function and the globals, declared outside the body
+    struct Summary {
+        const ASTNode* original; // as the analyses saw it
+        ASTNode* loop;           // with the loops in its body fused
+        bool io = false;
+        std::vector<uint32_t> reads;  // sorted, without duplicates
+        std::vector<uint32_t> writes; // sorted, without duplicates
+        std::vector<Element> elements;
+    };
+
+    ASTNode* rewriteStatement(ASTNode* node);
+    ASTNode* rewriteList(ASTNode* list);
+    bool summarize(const ASTNode* loop, Summary& summary);
+    void collectElements(const ASTNode* node, Symbol variable, bool written, Summary& summary);
+    bool fusible(const Summary& first, const Summary& earlier, const Summary& later);
+    ASTNode* fuse(const std::vector<Summary>& group);
+
+    uint32_t variableOf(const ASTNode* identifier) const;
+    bool isArray(uint32_t variable) const;
+
+    ASTArena& arena;
+
+    // State of one run
+    std::vector<Global> globals;             // numbered after the variables of the function
+    const ControlFlowGraph* graph = nullptr; // of the function being rewritten
+    size_t fused = 0;
+};
+
+#endif // LOOP_FUSION_H
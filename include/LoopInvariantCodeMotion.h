@@ -0,0 +1,69 @@
+#ifndef LOOP_INVARIANT_CODE_MOTION_H
+#define LOOP_INVARIANT_CODE_MOTION_H
+
+#include "Analyses.h"
+#include "ControlFlowGraph.h"
+#include "PassManager.h"
+#include <vector>
+
+// Moves computations whose operands no part of a loop writes out of for,
+// while and do-while loops. Each largest invariant operation, in the
+// condition, the body or a for loop's increment, is computed once into a
+// temporary declared right before the loop, and declarations inside the
+// loop are initialized from that temporary.
+//
+// What the condition computes is computed before the loop unconditionally,
+// since the condition runs at least once. What the body computes is only
+// computed if the condition holds on entry, so a loop that never runs
+// computes nothing it did not before. Division and remainder are only
+// moved with a divisor that is a literal other than 0 and -1, since
+// anything else may trap where the loop would not have evaluated it.
+// Inner loops are handled first, so a value invariant in several nested
+// loops moves out of all of them.
+class LoopInvariantCodeMotion {
+public:
+    // Nodes created by the pass are allocated in `arena`
+    explicit LoopInvariantCodeMotion(ASTArena& arena) : arena(arena) {}
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    // A node with its largest invariant operations not yet replaced
+    struct Scanned {
+        ASTNode* node;
+        bool invariant;
+        ValueType type;
+    };
+
+    struct Temporary {
+        Symbol name;
+        Symbol type;
+        ASTNode* value;
+        bool guarded; // computed only if the loop runs at least once
+    };
+
+    ASTNode* rewriteStatement(ASTNode* node);
+    ASTNode* rewriteNested(ASTNode* node);
+    void rewriteInto(ASTNode* node, std::vector<ASTNode*>& out);
+    void moveOutOfLoop(ASTNode* original, ASTNode* loop, std::vector<ASTNode*>& out);
+
+    Scanned scan(ASTNode* node);
+    ASTNode* settle(const Scanned& scanned);
+    ASTNode* guardOf(ASTNode* loop, ASTNode* condition, bool& canGuard);
+    Symbol newTemporaryName();
+
+    static bool mayTrap(const ASTNode* operation);
+
+    ASTArena& arena;
+
+    // State of one run
+    const WriteSets* writeSets = nullptr;
+    const ControlFlowGraph* graph = nullptr; // of the function being rewritten
+    SymbolRange loopWrites;                  // of the loop being moved out of
+    bool guarded = false;                    // whether scanned code runs only after the condition held
+    std::vector<Temporary> temporaries;      // of the loop being moved out of
+    unsigned temporaryCount = 0;
+    size_t hoisted = 0;
+};
+
+#endif // LOOP_INVARIANT_CODE_MOTION_H
@@ -0,0 +1,57 @@
+#ifndef LOOP_UNROLLING_H
+#define LOOP_UNROLLING_H
+
+#include "Analyses.h"
+#include "ControlFlowGraph.h"
+#include "PassManager.h"
+#include <cstdint>
+#include <vector>
+
+// Unrolls for loops whose trip count is known at compile time (see
+// CountedLoop).
+//
+// A loop whose unrolled form fits in the size budget is replaced by one
+// copy of the body per iteration, with the variable's value in place of
+// the variable. Otherwise a loop stepping by one is unrolled by the
+// factor: the body is repeated for i, i + 1, ... and the loop steps by
+// the factor, followed by a loop for the iterations left over. The
+// unrolled body must fit in the budget as well. Sizes are counted in AST
+// nodes.
+class LoopUnrolling {
+public:
+    static constexpr unsigned DefaultFactor = 4;
+    static constexpr size_t DefaultBudget = 256;
+
+    // Nodes created by the pass are allocated in `arena`
+    explicit LoopUnrolling(ASTArena& arena) : arena(arena) {}
+
+    // A factor below 2 turns partial unrolling off
+    void setFactor(unsigned factor) { unrollFactor = factor; }
+    void setBudget(size_t nodes) { budget = nodes; }
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    ASTNode* rewriteStatement(ASTNode* node);
+    ASTNode* rewriteNested(ASTNode* node);
+    void rewriteInto(ASTNode* node, std::vector<ASTNode*>& out);
+    bool unroll(ASTNode* original, ASTNode* loop, std::vector<ASTNode*>& out);
+
+    void appendBody(const ASTNode* body, bool scoped, const CountedLoop& count, const ASTNode* value,
+                    std::vector<ASTNode*>& out);
+    ASTNode* initializer(const ASTNode* loop, const CountedLoop& count, int64_t value);
+    ASTNode* literal(int64_t value);
+
+    static size_t sizeOf(const ASTNode* node);
+
+    ASTArena& arena;
+    unsigned unrollFactor = DefaultFactor;
+    size_t budget = DefaultBudget;
+
+    // State of one run
+    const WriteSets* writeSets = nullptr;
+    const ControlFlowGraph* graph = nullptr; // of the function being rewritten
+    size_t unrolled = 0;
+};
+
+#endif // LOOP_UNROLLING_H
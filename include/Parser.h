@@ -1,80 +1,145 @@
-#ifndef PARSER_H
-#define PARSER_H
-
-#include "Tokenizer.h"
-#include <memory>
-#include <vector>
-
-enum class ASTNodeType {
-    Program,
-    Declaration,
-    Assignment,
-    BinaryOperation,
-    Literal,
-    Identifier,
-    IfStatement,
-    Block,
-    ExpressionStatement,
-    PrintStatement,
-    InputStatement,        // Added this for cin handling
-    FunctionDeclaration,
-    ReturnStatement,
-    Preprocessor,
-    ForStatement,
-    WhileStatement,
-    DoWhileStatement,
-    PreIncrement,
-    PostIncrement,
-    CompoundAssignment
-};
-
-struct ASTNode {
-    ASTNodeType type;
-    std::string value;
-    std::shared_ptr<ASTNode> left;
-    std::shared_ptr<ASTNode> right;
-    std::vector<std::shared_ptr<ASTNode>> children; // For statements that need multiple children
-
-    ASTNode(ASTNodeType t, const std::string& val) : type(t), value(val), left(nullptr), right(nullptr) {}
-};
-
-class Parser {
-public:
-    Parser(const std::vector<Token>& tokens);
-    std::shared_ptr<ASTNode> parse();
-
-private:
-    std::vector<Token> tokens;
-    size_t pos;
-
-    std::shared_ptr<ASTNode> parseStatement();
-    std::shared_ptr<ASTNode> parseExpression();
-    std::shared_ptr<ASTNode> parseAssignment();
-    std::shared_ptr<ASTNode> parseDeclaration();
-    std::shared_ptr<ASTNode> parseIfStatement();
-    std::shared_ptr<ASTNode> parseForStatement();
-    std::shared_ptr<ASTNode> parseWhileStatement();
-    std::shared_ptr<ASTNode> parseDoWhileStatement();
-    std::shared_ptr<ASTNode> parseIncrementExpression();
-    std::shared_ptr<ASTNode> parseBlock();
-    std::shared_ptr<ASTNode> parsePrintStatement();
-    std::shared_ptr<ASTNode> parseInputStatement();
-    std::shared_ptr<ASTNode> parseFunctionDeclaration();
-    std::shared_ptr<ASTNode> parseReturnStatement();
-    std::shared_ptr<ASTNode> parsePreprocessor();
-    std::shared_ptr<ASTNode> parseLogicalExpression();
-    std::shared_ptr<ASTNode> parseComparisonExpression();
-    std::shared_ptr<ASTNode> parseArithmeticExpression();
-    std::shared_ptr<ASTNode> parseMultiplicativeExpression();
-    std::shared_ptr<ASTNode> parsePrimary();
-
-    Token peek();
-    Token advance();
-    bool match(TokenType type, const std::string& val = "");
-    bool check(TokenType type, const std::string& val = "");
-    void skipTo(const std::string& target);
-};
-
-void printAST(const std::shared_ptr<ASTNode>& node, int indent = 0);
-
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "ASTArena.h"
+#include "TokenStream.h"
+#include <array>
+#include <string_view>
+#include <vector>
+
+enum class ASTNodeType {
+    Program,
+    Declaration,
+    Assignment,
+    BinaryOperation,
+    Literal,
+    Identifier,
+    IfStatement,
+    Block,
+    ExpressionStatement,
+    PrintStatement,
+    InputStatement,        // Added this for cin handling
+    FunctionDeclaration,   // name; parameters in children, body in left (null for a prototype), result type in right
+    ReturnStatement,
+    Preprocessor,
+    ForStatement,
+    WhileStatement,
+    DoWhileStatement,
+    PreIncrement,
+    PostIncrement,
+    CompoundAssignment,
+    UnaryOperation,        // ! or -, operand in left
+    CallExpression,        // callee name, arguments in children
+    ArrayDeclaration,      // element type; name in left, size in right, initializers in children
+    ArraySubscript         // array in left, index in right
+};
+
+// Byte range [begin, end) of a statement or block in the source it was
+// parsed from; empty for expression nodes and nodes built by passes
+struct SourceSpan {
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// Nodes live in an ASTArena and refer to each other with plain pointers;
+// the arena that created a tree owns all of it
+struct ASTNode {
+    ASTNodeType type;
+    Symbol value; // Interned text: identifiers and literals compare by id
+    SourceLocation loc;
+    SourceSpan span;
+    ASTNode* left = nullptr;
+    ASTNode* right = nullptr;
+    ArenaVector<ASTNode*> children; // For statements that need multiple children
+
+    // Reuses the symbol interned by the lexer
+    ASTNode(ASTArena& arena, ASTNodeType t, const Token& tok)
+        : type(t), value(tok.symbol), loc(tok.loc), children(ArenaAllocator<ASTNode*>(arena)) {}
+    ASTNode(ASTArena& arena, ASTNodeType t, Symbol val)
+        : type(t), value(val), children(ArenaAllocator<ASTNode*>(arena)) {}
+    ASTNode(ASTArena& arena, ASTNodeType t, std::string_view val)
+        : type(t), value(val), children(ArenaAllocator<ASTNode*>(arena)) {}
+    ASTNode(ASTArena& arena, ASTNodeType t, const char* val)
+        : ASTNode(arena, t, std::string_view(val)) {}
+
+    // Copy sharing this node's subtrees, for a pass to change in place of
+    // the original
+    ASTNode* shallowCopy(ASTArena& arena) const;
+    // Copy of the whole subtree, with every identifier named `name`
+    // replaced by a copy of `value`. For code that appears twice: analyses
+    // tell variable reads apart by their nodes.
+    ASTNode* deepCopy(ASTArena& arena, Symbol name = Symbol(), const ASTNode* value = nullptr) const;
+};
+
+class Parser {
+    friend class IncrementalParser;
+
+public:
+    // Lexes the source on demand while parsing. Nodes are allocated in
+    // `arena`, which must outlive the returned tree.
+    Parser(const SourceBuffer& source, ASTArena& arena, LexerBackend backend = LexerBackend::Auto);
+    // Parses an already tokenized sequence; the vector must outlive the parser
+    Parser(const std::vector<Token>& tokens, ASTArena& arena);
+
+    // With threads > 1, top-level items of a source buffer are parsed on
+    // that many worker threads; the tree is identical to a sequential parse
+    ASTNode* parse(unsigned threads = 1);
+
+    size_t tokensConsumed() const;
+
+private:
+    Parser(const SourceBuffer& source, const SourceRange& range, ASTArena& arena, LexerBackend backend);
+
+    TokenStream tokens;
+    ASTArena& arena;
+    const SourceBuffer* source = nullptr; // null when parsing a token vector
+    LexerBackend backend = LexerBackend::Auto;
+    size_t workerTokens = 0;
+
+    template <typename Value>
+    ASTNode* makeNode(ASTNodeType type, Value&& value) {
+        return arena.create<ASTNode>(arena, type, std::forward<Value>(value));
+    }
+
+    using StatementRule = ASTNode* (Parser::*)();
+    static const std::array<StatementRule, kTokenKindCount> statementRules;
+
+    bool parseTopLevel(ASTNode* programNode);
+    bool parseInParallel(ASTNode* programNode, unsigned threads);
+
+    ASTNode* parseStatement();
+    ASTNode* parseDeclarationOrFunction();
+    ASTNode* parseStreamStatement();
+    ASTNode* parseIdentifierStatement();
+    ASTNode* parsePrefixIncrementStatement();
+    ASTNode* parseExpression();
+    ASTNode* parseAssignment();
+    ASTNode* parseDeclaration();
+    ASTNode* parseIfStatement();
+    ASTNode* parseForStatement();
+    ASTNode* parseWhileStatement();
+    ASTNode* parseDoWhileStatement();
+    ASTNode* parseIncrementExpression();
+    ASTNode* parseBlock();
+    ASTNode* parsePrintStatement();
+    ASTNode* parseInputStatement();
+    ASTNode* parseFunctionDeclaration();
+    ASTNode* parseReturnStatement();
+    ASTNode* parsePreprocessor();
+    ASTNode* parseBinaryExpression(int minPrecedence);
+    ASTNode* parsePrimary();
+    ASTNode* parseCall();
+    ASTNode* parseTarget();
+    ASTNode* parseSubscript();
+
+    const Token& peek(size_t ahead = 0);
+    const Token& advance();
+    bool match(TokenKind kind);
+    bool check(TokenKind kind);
+    bool check(TokenType type);
+    void skipTo(std::string_view target);
+};
+
+void printAST(const ASTNode* node, int indent = 0);
+
 #endif // PARSER_H
\ No newline at end of file
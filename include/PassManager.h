@@ -0,0 +1,99 @@
+#ifndef PASS_MANAGER_H
+#define PASS_MANAGER_H
+
+#include "Parser.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Results of analyses over the tree being optimized. An analysis is a type
+// with a `Result` type and a static `Result run(const ASTNode* root)`; it is
+// computed the first time a pass asks for it and kept until a pass changes
+// the tree.
+class AnalysisCache {
+public:
+    template <typename Analysis>
+    const typename Analysis::Result& get(const ASTNode* root) {
+        auto& slot = results[std::type_index(typeid(Analysis))];
+        if (slot && slot->root == root) {
+            ++reusedCount;
+        } else {
+            slot = std::make_unique<Entry<typename Analysis::Result>>(root, Analysis::run(root));
+            ++computedCount;
+        }
+        return static_cast<Entry<typename Analysis::Result>&>(*slot).result;
+    }
+
+    void invalidate() { results.clear(); }
+
+    size_t computed() const { return computedCount; }
+    size_t reused() const { return reusedCount; }
+
+private:
+    struct EntryBase {
+        explicit EntryBase(const ASTNode* root) : root(root) {}
+        virtual ~EntryBase() = default;
+        const ASTNode* root;
+    };
+
+    template <typename Result>
+    struct Entry : EntryBase {
+        Entry(const ASTNode* root, Result result) : EntryBase(root), result(std::move(result)) {}
+        Result result;
+    };
+
+    std::unordered_map<std::type_index, std::unique_ptr<EntryBase>> results;
+    size_t computedCount = 0;
+    size_t reusedCount = 0;
+};
+
+struct PassStatistics {
+    std::string name;
+    size_t runs = 0;
+    size_t rewrites = 0;
+    std::chrono::nanoseconds time{0};
+};
+
+// Runs registered passes in order, over and over, until a whole round
+// leaves the tree unchanged or the iteration limit is reached
+class PassManager {
+public:
+    static constexpr unsigned DefaultIterationLimit = 8;
+
+    // Rewrites the tree under `root` and returns its new root. Every change
+    // must be counted in `rewrites`: a pass that reports none is taken to
+    // have left the tree exactly as it was, and cached analyses are kept.
+    using Pass = std::function<ASTNode*(ASTNode* root, AnalysisCache& analyses, size_t& rewrites)>;
+
+    explicit PassManager(unsigned iterationLimit = DefaultIterationLimit) : iterationLimit(iterationLimit) {}
+
+    void addPass(std::string name, Pass pass);
+    void setIterationLimit(unsigned limit) { iterationLimit = limit; }
+
+    ASTNode* run(ASTNode* root);
+
+    // About the last run
+    unsigned iterations() const { return iterationsRun; }
+    bool reachedFixedPoint() const { return fixedPoint; }
+    const std::vector<PassStatistics>& statistics() const { return passStatistics; }
+    const AnalysisCache& analyses() const { return cache; }
+
+    // One line per pass, then one for the analysis cache
+    void report(std::ostream& out, const char* prefix) const;
+
+private:
+    std::vector<Pass> passes;
+    std::vector<PassStatistics> passStatistics;
+    AnalysisCache cache;
+    unsigned iterationLimit;
+    unsigned iterationsRun = 0;
+    bool fixedPoint = false;
+};
+
+#endif // PASS_MANAGER_H
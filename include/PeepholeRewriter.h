@@ -0,0 +1,40 @@
+#ifndef PEEPHOLE_REWRITER_H
+#define PEEPHOLE_REWRITER_H
+
+#include "Analyses.h"
+#include "ControlFlowGraph.h"
+#include "PassManager.h"
+
+// Rewrites expressions by algebraic identities: x * 1 to x, x - x to 0,
+// true || x to true, !!x to x and the like.
+//
+// Rules are written as patterns, such as "x * 1" -> "x", in the table in
+// PeepholeRewriter.cpp. The table is compiled with the optimizer: each
+// pattern is parsed into a tree at compile time, and rules are grouped
+// by the operator at the root of their pattern, so a node is only ever
+// tried against the few rules for its own operator, found with one table
+// lookup. A malformed rule does not compile.
+//
+// A rule applies only when the expressions its variables match have the
+// types it allows, so that no rewrite changes a value or its type; an
+// expression the rewrite drops, or matches twice, must not have side
+// effects.
+class PeepholeRewriter {
+public:
+    // Nodes created by the pass are allocated in `arena`
+    explicit PeepholeRewriter(ASTArena& arena) : arena(arena) {}
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    ASTNode* rewrite(ASTNode* node);
+    ASTNode* simplify(ASTNode* node);
+
+    ASTArena& arena;
+
+    // State of one run
+    const ControlFlowGraph* graph = nullptr; // of the function being rewritten
+    size_t simplified = 0;
+};
+
+#endif // PEEPHOLE_REWRITER_H
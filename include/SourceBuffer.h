@@ -0,0 +1,37 @@
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Owns the text of one translation unit. Tokens and AST nodes refer into
+// this buffer instead of copying, so it must outlive the whole pipeline.
+// The text is either held in memory or mapped read-only from a file.
+class SourceBuffer {
+public:
+    explicit SourceBuffer(std::string text);
+    ~SourceBuffer();
+
+    // Maps `path` read-only when it is a regular file; pipes, character
+    // devices and "-" (stdin) are read into memory instead.
+    // Throws std::runtime_error if the file cannot be opened or read.
+    static SourceBuffer fromFile(const std::string& path);
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    std::string_view view() const { return std::string_view(data, length); }
+    size_t size() const { return length; }
+    bool isMapped() const { return mapping != nullptr; }
+
+private:
+    SourceBuffer(void* mapping, size_t length);
+
+    std::string text;
+    const char* data;
+    size_t length;
+    void* mapping = nullptr;
+};
+
+#endif // SOURCE_BUFFER_H
@@ -0,0 +1,97 @@
+#ifndef STRENGTH_REDUCTION_H
+#define STRENGTH_REDUCTION_H
+
+#include "Analyses.h"
+#include "ControlFlowGraph.h"
+#include "CostModel.h"
+#include "PassManager.h"
+#include <cstdint>
+#include <vector>
+
+// Replaces int multiplication, division and remainder by literals with
+// cheaper operations that compute the same values:
+//
+// - In the body of a counted for loop (see CountedLoop), i * c becomes a
+//   variable set to start * c before the loop and stepped by step * c at
+//   the end of every iteration, if none of the values it takes overflows.
+// - x * 2^k becomes x << k, and x / 2^k and x % 2^k a shift and a mask,
+//   when x is known not to be negative. For any other x, a division or
+//   remainder adds the mask of x's sign first, so that the quotient still
+//   rounds toward zero; a multiplication stays as it is.
+// - x / d and x % d for any other d > 1 become a multiplication by a
+//   scaled reciprocal of d and a shift, when x is known to lie in a range
+//   where the product fits in an int: the language has no wider integer
+//   for the high half of a full multiplication.
+//
+// Where x is computed more than once, the replacement is only made if the
+// cost model estimates it cheaper than the operation, which for an
+// expensive x it is not.
+//
+// Only operations on ints are changed. Ranges are known for literals and
+// counted loop variables, and carried through arithmetic on them. Right
+// shifts and masks of negative numbers are as C++20 defines them, which is
+// what every supported compiler does.
+class StrengthReduction {
+public:
+    // Nodes created by the pass are allocated in `arena`; `costs` decides
+    // whether a replacement is worth it
+    StrengthReduction(ASTArena& arena, const CostModel& costs) : arena(arena), costs(costs) {}
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    // Values an int expression may take
+    struct Range {
+        bool known = false;
+        int64_t low = 0;
+        int64_t high = 0;
+    };
+
+    // An expression with its reductions applied
+    struct Reduced {
+        ASTNode* node;
+        ValueType type;
+        Range range;
+    };
+
+    // A variable holding the loop variable times `factor`
+    struct Induction {
+        int64_t factor;
+        Symbol name;
+    };
+
+    // A counted loop whose body is being rewritten
+    struct ActiveLoop {
+        uint32_t variable;
+        CountedLoop count;
+        std::vector<Induction> inductions;
+    };
+
+    ASTNode* rewrite(ASTNode* node);
+    void rewriteInto(ASTNode* node, std::vector<ASTNode*>& out);
+    void rewriteLoop(ASTNode* loop, std::vector<ASTNode*>& out);
+
+    Reduced reduce(ASTNode* node);
+    ASTNode* reduceOperation(const ASTNode* original, ASTNode* node, const Reduced& left, const Reduced& right);
+    ASTNode* inductionFor(const ASTNode* identifier, int64_t factor);
+    Range rangeOf(const ASTNode* identifier) const;
+
+    ASTNode* operation(Symbol op, ASTNode* left, ASTNode* right);
+    ASTNode* literal(int64_t value);
+    Symbol newInductionName();
+
+    static Range combine(Symbol op, const Range& left, const Range& right);
+    static bool reciprocal(int64_t divisor, int64_t high, int64_t& multiplier, int& shift);
+
+    ASTArena& arena;
+    const CostModel& costs;
+
+    // State of one run
+    const WriteSets* writeSets = nullptr;
+    const ControlFlowGraph* graph = nullptr; // of the function being rewritten
+    std::vector<ActiveLoop> loops;           // innermost last
+    unsigned inductionCount = 0;
+    size_t reduced = 0;
+};
+
+#endif // STRENGTH_REDUCTION_H
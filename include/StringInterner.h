@@ -0,0 +1,129 @@
+#ifndef STRING_INTERNER_H
+#define STRING_INTERNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Assigns dense integer ids to strings. Every distinct text is stored
+// once and never moves, so the views handed out stay valid for the
+// lifetime of the program. Id 0 is always the empty string.
+//
+// intern() may be called from several threads at once (the parallel
+// parser lexes on every worker). text() takes no lock: the id -> text
+// table grows in buckets of doubling size, so existing entries never move.
+class StringInterner {
+public:
+    static StringInterner& global();
+
+    uint32_t intern(std::string_view text);
+    // Whether `text` was ever interned, without interning it
+    bool contains(std::string_view text);
+    std::string_view text(uint32_t id) const {
+        const uint64_t index = uint64_t(id) + FirstBucketSize;
+        const unsigned bucket = floorLog2(index) - FirstBucketBits;
+        return buckets[bucket][index - (uint64_t(FirstBucketSize) << bucket)];
+    }
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+private:
+    static constexpr unsigned FirstBucketBits = 10;
+    static constexpr uint32_t FirstBucketSize = 1u << FirstBucketBits;
+    static constexpr unsigned BucketCount = 33 - FirstBucketBits;
+
+    static unsigned floorLog2(uint64_t value) {
+#if defined(__GNUC__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+        unsigned bit = 0;
+        while (value >>= 1) ++bit;
+        return bit;
+#endif
+    }
+
+    StringInterner();
+    const char* store(std::string_view text);
+    uint32_t append(std::string_view stored);
+
+    std::shared_mutex mutex;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::unique_ptr<std::string_view[]> buckets[BucketCount];
+    std::atomic<uint32_t> count{0};
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunkUsed = 0;
+    size_t chunkSize = 0;
+};
+
+// Interned string: comparing two symbols compares their ids
+class Symbol {
+public:
+    Symbol() : symbolId(0) {}
+    explicit Symbol(std::string_view text) : symbolId(StringInterner::global().intern(text)) {}
+
+    static Symbol fromId(uint32_t id) {
+        Symbol symbol;
+        symbol.symbolId = id;
+        return symbol;
+    }
+
+    uint32_t id() const { return symbolId; }
+    std::string_view str() const { return StringInterner::global().text(symbolId); }
+    bool empty() const { return symbolId == 0; }
+
+    bool operator==(Symbol other) const { return symbolId == other.symbolId; }
+    bool operator!=(Symbol other) const { return symbolId != other.symbolId; }
+
+private:
+    uint32_t symbolId;
+};
+
+// Text comparisons, for matching against fixed spellings such as "+"
+inline bool operator==(Symbol symbol, std::string_view text) { return symbol.str() == text; }
+inline bool operator!=(Symbol symbol, std::string_view text) { return symbol.str() != text; }
+
+inline std::ostream& operator<<(std::ostream& out, Symbol symbol) {
+    return out << symbol.str();
+}
+
+// Map keyed directly by symbol id. clear() is O(1): entries written before
+// the last clear are recognised by a stale generation stamp.
+template <typename T>
+class SymbolMap {
+public:
+    bool contains(Symbol key) const {
+        return key.id() < stamps.size() && stamps[key.id()] == generation;
+    }
+
+    // Precondition: contains(key)
+    const T& at(Symbol key) const { return values[key.id()]; }
+
+    T& operator[](Symbol key) {
+        if (key.id() >= stamps.size()) {
+            stamps.resize(key.id() + 1, 0);
+            values.resize(key.id() + 1);
+        }
+        if (stamps[key.id()] != generation) {
+            stamps[key.id()] = generation;
+            values[key.id()] = T();
+        }
+        return values[key.id()];
+    }
+
+    void erase(Symbol key) {
+        if (contains(key)) stamps[key.id()] = 0;
+    }
+
+    void clear() { ++generation; }
+
+private:
+    std::vector<T> values;
+    std::vector<uint32_t> stamps;
+    uint32_t generation = 1;
+};
+
+#endif // STRING_INTERNER_H
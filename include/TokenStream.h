@@ -0,0 +1,56 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include "Tokenizer.h"
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Pull-based token source for the parser. Tokens are lexed on demand and
+// only a small lookahead window is kept, so tokenizing and parsing run in
+// one pass with bounded token memory. A pre-tokenized vector can be
+// streamed as well (it is referenced, not copied).
+class TokenStream {
+public:
+    // The parser never looks further ahead than peek(2); the spare slot
+    // holds the token most recently returned by advance()
+    static constexpr size_t Lookahead = 4;
+
+    explicit TokenStream(const SourceBuffer& source, LexerBackend backend = LexerBackend::Auto);
+    TokenStream(const SourceBuffer& source, const SourceRange& range, LexerBackend backend = LexerBackend::Auto);
+    explicit TokenStream(const std::vector<Token>& tokens);
+
+    // Token `ahead` positions past the current one; an Unknown token with
+    // empty text once the input is exhausted
+    const Token& peek(size_t ahead = 0);
+    // Consumes the current token. The reference stays valid until the
+    // stream is advanced again; copy the token to keep it longer.
+    const Token& advance();
+    bool atEnd();
+
+    // Number of tokens consumed so far
+    size_t consumed() const { return consumedCount; }
+    // Offset just past the last consumed token
+    size_t consumedEnd() const { return lastEnd; }
+
+    // True once any peek or advance has looked past the last token
+    bool reachedEnd() const { return exhausted; }
+
+private:
+    bool fill(size_t ahead);
+    bool pull(Token& token);
+
+    std::optional<Lexer> lexer; // empty when streaming a token vector
+    const Token* vectorCursor = nullptr;
+    const Token* vectorEnd = nullptr;
+
+    Token window[Lookahead];
+    size_t head = 0;
+    size_t buffered = 0;
+    size_t consumedCount = 0;
+    size_t lastEnd = 0;
+    bool exhausted = false;
+    Token endToken;
+};
+
+#endif // TOKEN_STREAM_H
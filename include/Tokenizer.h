@@ -1,27 +1,134 @@
-#ifndef TOKENIZER_H
-#define TOKENIZER_H
-
-#include <string>
-#include <vector>
-
-enum class TokenType {
-    Identifier,
-    Keyword,
-    Operator,
-    Number,
-    Separator,
-    Literal,
-    Unknown
-};
-
-struct Token {
-    TokenType type;
-    std::string value;
-};
-
-class Tokenizer {
-public:
-    std::vector<Token> tokenize(const std::string& code);
-};
-
-#endif
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include "SourceBuffer.h"
+#include "StringInterner.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+enum class TokenType : uint8_t {
+    Identifier,
+    Keyword,
+    Operator,
+    Number,
+    Separator,
+    Literal,
+    Unknown
+};
+
+// Exact spelling of a fixed token, so the parser can dispatch on a small
+// integer instead of comparing text. Identifiers, numbers, string literals
+// and unknown characters are None; preprocessor lines are Preprocessor.
+enum class TokenKind : uint8_t {
+    None,
+    Preprocessor,
+
+    // Keywords, in the lexer's keyword table order
+    KwInt, KwFloat, KwIf, KwElse, KwWhile, KwFor, KwDo, KwReturn,
+    KwInclude, KwIostream, KwStd, KwCout, KwCin, KwEndl, KwMain, KwTrue, KwFalse,
+
+    // Two-character operators
+    Equal, NotEqual, LessEqual, GreaterEqual, OrOr, AndAnd, ColonColon,
+    ShiftLeft, ShiftRight, PlusPlus, MinusMinus,
+    PlusAssign, MinusAssign, StarAssign, SlashAssign,
+
+    // Single-character operators
+    Plus, Minus, Star, Slash, Percent, Ampersand, Assign, Less, Greater, Not,
+
+    // Separators
+    Semicolon, Comma, LParen, RParen, LBrace, RBrace, LBracket, RBracket,
+
+    Count
+};
+
+constexpr size_t kTokenKindCount = static_cast<size_t>(TokenKind::Count);
+
+// 1-based position of a token in the source
+struct SourceLocation {
+    uint32_t line = 0;
+    uint32_t column = 0;
+};
+
+// value is a view into the SourceBuffer the token was read from;
+// symbol is the same text interned when the token was lexed
+struct Token {
+    TokenType type = TokenType::Unknown;
+    TokenKind kind = TokenKind::None;
+    Symbol symbol;
+    std::string_view value;
+    size_t offset = 0;
+    SourceLocation loc;
+};
+
+// Byte range [begin, end) of a SourceBuffer that starts on a token, with
+// the location of that token, so lexing can resume in the middle of a file
+struct SourceRange {
+    size_t begin = 0;
+    size_t end = 0;
+    SourceLocation loc{1, 1};
+};
+
+// Scanning kernels used for whitespace, identifier and comment runs.
+// Auto picks the widest instruction set the CPU supports at runtime.
+enum class LexerBackend {
+    Auto,
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+struct ScanKernels;
+struct FixedSymbols;
+
+// Produces the tokens of a SourceBuffer one at a time, on demand
+class Lexer {
+public:
+    // Current line and where it starts; kept up to date by the whitespace
+    // scanner so every token gets its column without a second pass
+    struct LineState {
+        uint32_t line;
+        const char* lineStart;
+    };
+
+    explicit Lexer(const SourceBuffer& source, LexerBackend backend = LexerBackend::Auto);
+    // Lexes only `range`; token offsets stay relative to the whole buffer
+    Lexer(const SourceBuffer& source, const SourceRange& range, LexerBackend backend = LexerBackend::Auto);
+
+    // Reads the next token; returns false once the input is exhausted
+    bool next(Token& token);
+    // Like next(), but leaves the symbol of identifiers, numbers and
+    // literals empty instead of interning them (for quick pre-passes)
+    bool scan(Token& token);
+
+    const char* backendName() const;
+    static bool isSupported(LexerBackend backend);
+
+private:
+    template <bool Intern>
+    bool lex(Token& token);
+
+    const ScanKernels* kernels;
+    const FixedSymbols* symbols;
+    const char* begin;
+    const char* cursor;
+    const char* end;
+    LineState lines;
+};
+
+// Materialises the whole token sequence at once (used for token dumps;
+// the parser pulls tokens from a Lexer instead)
+class Tokenizer {
+public:
+    explicit Tokenizer(LexerBackend backend = LexerBackend::Auto) : backend(backend) {}
+    std::vector<Token> tokenize(const SourceBuffer& source);
+
+    const char* backendName() const;
+    static bool isSupported(LexerBackend backend);
+
+private:
+    LexerBackend backend;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef VALUE_NUMBERING_H
+#define VALUE_NUMBERING_H
+
+#include "Analyses.h"
+#include "PassManager.h"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Common subexpression elimination by global value numbering.
+//
+// Every pure expression gets a value number; equal numbers mean equal
+// values. The number of an operation is hash-consed from its operator and
+// its operands' numbers, with the operands of commutative operators put in
+// order so that a * b and b * a match; one with a literal that changes
+// nothing, such as x * 1, has its operand's number. Writing a variable
+// gives it a new number, or the number of the value stored into it.
+//
+// A computation whose value some variable still holds is replaced by that
+// variable. A value computed more than once in one statement list and not
+// held anywhere is computed once, into a temporary declared right before
+// the statement that first needs it.
+class ValueNumbering {
+public:
+    // Nodes created by the pass are allocated in `arena`
+    explicit ValueNumbering(ASTArena& arena) : arena(arena) {}
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    struct Numbered {
+        ASTNode* node;   // the expression, rewritten
+        uint32_t number; // 0 if the expression is not pure
+        ValueType type;
+        int occurrence;  // index into the statement list's occurrences, or -1
+    };
+
+    // An operation computed in a statement of the list being numbered
+    struct Occurrence {
+        ASTNode* node;
+        uint32_t number;
+        ValueType type;
+        size_t statement;
+        int parent; // the occurrence it is an operand of, or -1
+        bool replaced = false;
+    };
+    using Occurrences = std::vector<Occurrence>;
+
+    struct ExpressionKey {
+        uint32_t op;
+        uint32_t left;
+        uint32_t right;
+        bool operator==(const ExpressionKey& other) const {
+            return op == other.op && left == other.left && right == other.right;
+        }
+    };
+    struct ExpressionKeyHash {
+        size_t operator()(const ExpressionKey& key) const {
+            uint64_t h = (uint64_t(key.left) << 32 | key.right) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>(h ^ (h >> 29) ^ key.op);
+        }
+    };
+
+    ASTNode* numberList(ASTNode* list);
+    ASTNode* numberNested(ASTNode* node);
+    ASTNode* numberStatement(ASTNode* node, size_t index, Occurrences* occurrences);
+    Numbered numberExpression(ASTNode* node, Symbol target, Occurrences* occurrences, size_t statement);
+    ASTNode* introduceTemporaries(ASTNode* list, Occurrences& occurrences);
+    ASTNode* substitute(ASTNode* node, const std::unordered_map<const ASTNode*, ASTNode*>& replacements);
+
+    uint32_t freshNumber();
+    uint32_t variableNumber(Symbol name);
+    uint32_t literalNumber(Symbol text);
+    void assign(Symbol name, const Numbered& value);
+    void declare(Symbol name, Symbol type);
+    void leaveScope(size_t scope);
+    void forgetWrites(const ASTNode* node);
+    Symbol holderOf(uint32_t number, ValueType type, Symbol target);
+    Symbol newTemporaryName();
+
+    static bool canHold(ValueType variable, ValueType value);
+
+    ASTArena& arena;
+
+    // State of one run
+    const WriteSets* writeSets = nullptr;
+    uint32_t numberCount = 0;
+    std::unordered_map<ExpressionKey, uint32_t, ExpressionKeyHash> expressionNumbers;
+    SymbolMap<uint32_t> literalNumbers;
+    SymbolMap<uint32_t> variableNumbers; // current value of each variable
+    SymbolMap<ValueType> variableTypes;
+    std::vector<std::pair<Symbol, ValueType>> declaredTypes; // (variable, type it had before), innermost last
+    std::vector<Symbol> holders; // value number -> variable last assigned it
+    size_t eliminated = 0;
+    unsigned temporaryCount = 0;
+};
+
+#endif // VALUE_NUMBERING_H
@@ -0,0 +1,99 @@
+#ifndef VECTORIZER_H
+#define VECTORIZER_H
+
+#include "Analyses.h"
+#include "ControlFlowGraph.h"
+#include "PassManager.h"
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Strip-mines for loops over arrays whose iterations are independent, so
+// that the compiler of the output can run each strip in SIMD lanes.
+//
+// A loop is vectorized if it declares an int variable i, starts it at a
+// literal or a variable, runs while i < a bound the loop does not change
+// and steps by one; if its body stores only to elements of arrays and to
+// variables the body declares, and holds nothing but declarations, stores
+// and if statements, none of them calling a function; and if it accesses
+// at least one array. The dependence test then requires every element of
+// a written array to be indexed as i plus or minus a literal, and any two
+// such indices of one array to be equal or at least the vector width
+// apart: an iteration never uses an element another iteration of its
+// strip stores.
+//
+//     int vec_end = start + (bound - start) / W * W;
+//     for (int i = start; i < vec_end; i += W) {
+//         #pragma omp simd
+//         for (int vec_lane = 0; vec_lane < W; vec_lane++) { body with i + vec_lane for i }
+//     }
+//     for (int i = vec_end; i < bound; i++) { body }
+//
+// With literal bounds the end of the strips is a literal, and the scalar
+// epilogue is left out when there is nothing for it to do. Arrays are
+// named objects, which never alias each other, so no restrict hints are
+// needed. Every loop over arrays that is not vectorized is reported once,
+// with the reason.
+class Vectorizer {
+public:
+    static constexpr unsigned DefaultWidth = 8;
+
+    // Nodes created by the pass are allocated in `arena`
+    explicit Vectorizer(ASTArena& arena) : arena(arena) {}
+
+    // A width below 2 turns vectorization off
+    void setWidth(unsigned lanes) { width = lanes; }
+
+    ASTNode* run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites);
+
+private:
+    // An element of an array the loop body uses
+    struct Access {
+        Symbol array;
+        bool write;
+        bool affine;    // indexed as the loop variable plus `offset`
+        int64_t offset;
+    };
+
+    // What the dependence test needs to know about the loop being examined
+    struct Candidate {
+        Symbol variable;
+        const ASTNode* start = nullptr;
+        const ASTNode* bound = nullptr;
+        std::vector<uint32_t> locals; // variables the body declares
+        std::vector<Access> accesses;
+    };
+
+    ASTNode* rewriteStatement(ASTNode* node);
+    ASTNode* rewriteNested(ASTNode* node);
+    void rewriteInto(ASTNode* node, std::vector<ASTNode*>& out);
+    bool vectorize(ASTNode* original, ASTNode* loop, std::vector<ASTNode*>& out);
+
+    bool examine(const ASTNode* loop, Candidate& candidate, std::string& reason);
+    bool examineStatement(const ASTNode* node, Candidate& candidate, std::string& reason);
+    bool examineStore(const ASTNode* target, Candidate& candidate, std::string& reason);
+    void collectAccesses(const ASTNode* node, Candidate& candidate);
+    Access accessOf(const ASTNode* subscript, bool write, Symbol variable);
+    bool independent(const Candidate& candidate, std::string& reason);
+    bool invariant(const ASTNode* node, const ASTNode* loop);
+
+    ASTNode* literal(int64_t value);
+    ASTNode* identifier(Symbol name);
+    Symbol freshName(const char* prefix);
+
+    ASTArena& arena;
+    unsigned width = DefaultWidth;
+    size_t names = 0; // never reset, so that names stay fresh
+
+    // Loops already reported as not vectorized, by line and column: the
+    // pass sees them again on every iteration
+    std::unordered_set<uint64_t> reported;
+
+    // State of one run
+    const WriteSets* writeSets = nullptr;
+    const ControlFlowGraph* graph = nullptr; // of the function being rewritten
+    size_t vectorized = 0;
+};
+
+#endif // VECTORIZER_H
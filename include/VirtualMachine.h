@@ -0,0 +1,43 @@
+#ifndef VIRTUAL_MACHINE_H
+#define VIRTUAL_MACHINE_H
+
+#include "Bytecode.h"
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+// Runs bytecode. Each call gets a frame on one stack of values: its
+// registers, with the arguments and literals copied in, then its arrays.
+// Instructions are dispatched by jumping from the end of each straight to
+// the code of the next, through a table of label addresses, where the
+// compiler supports that (GCC and Clang), and through a switch elsewhere.
+//
+// Ints wrap around as they do on the hardware; division by zero, an index
+// outside its array and too many nested calls stop the program with an
+// error where the compiled program would have undefined behaviour.
+class VirtualMachine {
+public:
+    static constexpr uint64_t DefaultInstructionLimit = 10000000000ull;
+    static constexpr size_t MaxCallDepth = 100000;
+
+    struct Statistics {
+        uint64_t instructions = 0;
+        std::array<uint64_t, OpcodeCount> executed{}; // by opcode
+        double seconds = 0;                           // wall time, output included
+        int exitCode = 0;                             // what main returned
+    };
+
+    // A program that runs more instructions than this is stopped
+    void setInstructionLimit(uint64_t limit) { instructionLimit = limit; }
+
+    // Runs main, reading std::cin from `in` and writing std::cout to `out`.
+    // Throws std::runtime_error, naming the line, when the program has to
+    // be stopped.
+    Statistics run(const BytecodeProgram& program, std::istream& in, std::ostream& out) const;
+
+private:
+    uint64_t instructionLimit = DefaultInstructionLimit;
+};
+
+#endif // VIRTUAL_MACHINE_H
@@ -0,0 +1,118 @@
+#ifndef X86_BACKEND_H
+#define X86_BACKEND_H
+
+#include "Bytecode.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Lowers bytecode of int-only programs to x86-64 assembly for the System V
+// ABI, in the AT&T syntax of the GNU assembler, to be assembled and linked
+// with the C library: gcc program.s -o program.
+//
+// Registers of the bytecode are split into live ranges, one for each
+// value a reused register holds, and the ranges get machine registers by
+// linear scan over the interval from the first instruction of each to the
+// last. A range live across a call, printf and scanf included, only gets
+// a register the callee saves; when none is free, the range that ends
+// last is spilled to the frame. rax, rcx and rdx are kept for the code of
+// single instructions, and the argument registers for calls. Literals
+// become immediates.
+//
+// A comparison feeding only the branch after it becomes a cmp and a
+// conditional jump, and one that skips only a move becomes a cmp and a
+// cmov; other comparisons are set to 0 or 1 with setcc. std::cout becomes
+// printf, one call for each run of outputs, with a flush where std::endl
+// flushes, and std::cin scanf, through a helper that stops reading after a
+// read fails, as std::cin does.
+class X86Backend {
+public:
+    struct Statistics {
+        size_t functions = 0;
+        size_t ranges = 0;      // live ranges of registers
+        size_t spilled = 0;     // of those, in the frame
+        size_t conditionalMoves = 0;
+        size_t fusedBranches = 0; // comparisons and jumps as cmp and jcc
+    };
+
+    // Throws std::runtime_error, naming the function, for a program with
+    // float values or a function with more than six parameters
+    std::string compile(const BytecodeProgram& program);
+
+    const Statistics& statistics() const { return stats; }
+
+private:
+    enum : int8_t { Immediate = -2, Spilled = -1 };
+
+    // Where a register of the bytecode lives
+    struct Location {
+        int8_t reg = Spilled; // a machine register, Spilled or Immediate
+        int32_t value = 0;    // offset from rbp if Spilled, else the value of an Immediate
+    };
+
+    // Instructions a register is live over in a row, in a live range
+    struct Run {
+        uint32_t start;
+        uint32_t end;
+        uint32_t range;
+    };
+
+    struct Interval {
+        uint32_t start;
+        uint32_t end;
+        bool crossesCall;
+    };
+
+    void analyze();
+    void allocate();
+    void emitFunction(uint32_t index);
+    size_t emitInstruction(size_t pc);
+    size_t emitOutput(size_t pc);
+    bool emitConditionalMove(size_t pc);
+
+    Location place(uint16_t reg) const;
+    bool isConstant(uint16_t reg) const;
+    size_t runAt(uint16_t reg, size_t pc) const;
+    bool liveAfter(uint16_t reg, size_t pc) const;
+    std::string operand(uint16_t reg) const;
+    bool inRegister(uint16_t reg) const { return place(reg).reg >= 0; }
+    bool immediate(uint16_t reg) const { return place(reg).reg == Immediate; }
+    bool sameLocation(uint16_t a, uint16_t b) const;
+    void copy(uint16_t to, uint16_t from);
+    void moveFrom(uint16_t to, const std::string& memory);
+    void load(const std::string& scratch, uint16_t reg);
+    void assign(uint16_t reg, const std::string& scratch);
+    std::string source(uint16_t reg, const std::string& scratch);
+    void binary(const char* mnemonic, uint16_t a, uint16_t b, uint16_t c, bool commutative);
+    const char* compare(Opcode op, uint16_t left, uint16_t right, bool negate);
+    void test(uint16_t reg);
+    void setFromFlags(uint16_t a);
+    void index(uint16_t reg);
+    std::string element(uint16_t array, int64_t offset, bool indexed) const;
+    std::string label(size_t pc) const;
+    std::string stringLabel(const std::string& text);
+    void line(const std::string& instruction);
+    [[noreturn]] void fail(const std::string& message) const;
+
+    const BytecodeProgram* program = nullptr;
+    std::string out;
+    std::vector<std::string> strings; // of the data section, by label number
+    bool reads = false;                // whether the helper for scanf is needed
+    Statistics stats;
+
+    // State of the function being lowered
+    const BytecodeFunction* function = nullptr;
+    uint32_t functionIndex = 0;
+    std::vector<char> targets;             // instructions jumps go to
+    size_t words = 0;                      // of a set of registers
+    std::vector<uint64_t> live;            // registers live after each instruction
+    std::vector<std::vector<Run>> runs;    // of each register, in order
+    std::vector<Interval> ranges;          // live ranges
+    std::vector<Location> locations;       // of each range
+    size_t at = 0;                         // the instruction being lowered
+    std::vector<int8_t> saved;         // callee-saved registers used
+    int32_t frameBytes = 0;            // below the saved registers
+    int32_t arrayBase = 0;             // offset of the arrays from rbp
+};
+
+#endif // X86_BACKEND_H
@@ -0,0 +1,71 @@
+#include "../include/ASTArena.h"
+#include <cstdint>
+
+namespace {
+
+char* alignUp(char* p, size_t alignment) {
+    uintptr_t value = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<char*>((value + alignment - 1) & ~(uintptr_t(alignment) - 1));
+}
+
+} // namespace
+
+void* ASTArena::allocate(size_t bytes, size_t alignment) {
+    ++allocations;
+
+    // Large requests (big child lists) get a block of their own so the
+    // current block keeps serving small nodes
+    if (bytes + alignment > BlockSize / 4) {
+        blocks.emplace_back(new char[bytes + alignment]);
+        reservedBytes += bytes + alignment;
+        usedBytes += bytes;
+        return alignUp(blocks.back().get(), alignment);
+    }
+
+    char* result = cursor ? alignUp(cursor, alignment) : nullptr;
+    if (!result || result + bytes > limit) {
+        blocks.emplace_back(new char[BlockSize]); // not zeroed: pages are touched on first use
+        cursor = blocks.back().get();
+        limit = cursor + BlockSize;
+        reservedBytes += BlockSize;
+        result = alignUp(cursor, alignment);
+    }
+    usedBytes += static_cast<size_t>(result + bytes - cursor);
+    cursor = result + bytes;
+    return result;
+}
+
+void ASTArena::release(void* p, size_t bytes) {
+    if (static_cast<char*>(p) + bytes == cursor) {
+        cursor = static_cast<char*>(p);
+        usedBytes -= bytes;
+    }
+}
+
+void ASTArena::adopt(std::unique_ptr<ASTArena> other) {
+    adopted.push_back(std::move(other));
+}
+
+size_t ASTArena::bytesUsed() const {
+    size_t total = usedBytes;
+    for (const auto& other : adopted) total += other->bytesUsed();
+    return total;
+}
+
+size_t ASTArena::bytesReserved() const {
+    size_t total = reservedBytes;
+    for (const auto& other : adopted) total += other->bytesReserved();
+    return total;
+}
+
+size_t ASTArena::blockCount() const {
+    size_t total = blocks.size();
+    for (const auto& other : adopted) total += other->blockCount();
+    return total;
+}
+
+size_t ASTArena::allocationCount() const {
+    size_t total = allocations;
+    for (const auto& other : adopted) total += other->allocationCount();
+    return total;
+}
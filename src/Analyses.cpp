@@ -0,0 +1,373 @@
+#include "../include/Analyses.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+namespace {
+
+const Symbol kInt("int");
+const Symbol kFloat("float");
+const Symbol kIntArray("int[]");
+const Symbol kFloatArray("float[]");
+const Symbol kTrue("true");
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kFalse("false");
+const Symbol kEqual("==");
+const Symbol kNotEqual("!=");
+const Symbol kLess("<");
+const Symbol kGreater(">");
+const Symbol kLessEqual("<=");
+const Symbol kGreaterEqual(">=");
+const Symbol kAnd("&&");
+const Symbol kOr("||");
+const Symbol kNot("!");
+const Symbol kModulo("%");
+const Symbol kShiftLeft("<<");
+const Symbol kShiftRight(">>");
+const Symbol kBitAnd("&");
+const Symbol kIncrement("++");
+const Symbol kDecrement("--");
+const Symbol kPlusAssign("+=");
+const Symbol kMinusAssign("-=");
+
+constexpr uint32_t None = ControlFlowGraph::None;
+
+bool isComparison(Symbol op) {
+    return op == kEqual || op == kNotEqual || op == kLess || op == kGreater ||
+           op == kLessEqual || op == kGreaterEqual || op == kAnd || op == kOr;
+}
+
+// The variable or array element a store targets, as the variable it writes
+const ASTNode* targetIdentifier(const ASTNode* target) {
+    if (target && target->type == ASTNodeType::ArraySubscript) target = target->left;
+    return target && target->type == ASTNodeType::Identifier ? target : nullptr;
+}
+
+// The variable a writing node assigns, if it is one; an array for a store
+// to one of its elements
+const ASTNode* writtenIdentifier(const ASTNode* node) {
+    switch (node->type) {
+        case ASTNodeType::Declaration:
+        case ASTNodeType::ArrayDeclaration:
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement:
+            return targetIdentifier(node->left);
+        default:
+            return nullptr;
+    }
+}
+
+bool isExpression(const ASTNode* node) {
+    switch (node->type) {
+        case ASTNodeType::BinaryOperation:
+        case ASTNodeType::UnaryOperation:
+        case ASTNodeType::CallExpression:
+        case ASTNodeType::ArraySubscript:
+        case ASTNodeType::Literal:
+        case ASTNodeType::Identifier:
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement:
+        case ASTNodeType::CompoundAssignment:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+SymbolRange WriteSets::of(const ASTNode* node) const {
+    auto it = std::lower_bound(entries.begin(), entries.end(), node,
+                               [](const Entry& entry, const ASTNode* key) { return entry.node < key; });
+    if (it == entries.end() || it->node != node) return SymbolRange();
+    const Symbol* first = symbols.data() + it->offset;
+    return SymbolRange(first, first + it->count);
+}
+
+WriteSets WrittenVariables::run(const ASTNode* root) {
+    WriteSets result;
+    std::vector<Symbol> globals;
+    if (root && root->type == ASTNodeType::Program) {
+        for (const ASTNode* child : root->children) {
+            const bool declaration = child && (child->type == ASTNodeType::Declaration ||
+                                               child->type == ASTNodeType::ArrayDeclaration);
+            if (declaration && child->left) globals.push_back(child->left->value);
+        }
+    }
+    std::vector<Symbol> pending;
+    collect(root, globals, result, pending);
+    std::sort(result.entries.begin(), result.entries.end(),
+              [](const WriteSets::Entry& a, const WriteSets::Entry& b) { return a.node < b.node; });
+    return result;
+}
+
+// Adds the writes of `node` to `pending`, the writes of the nodes being
+// visited, and records them for statements
+void WrittenVariables::collect(const ASTNode* node, const std::vector<Symbol>& globals, WriteSets& sets,
+                                std::vector<Symbol>& pending) {
+    if (!node) return;
+    const size_t begin = pending.size();
+
+    if (const ASTNode* target = writtenIdentifier(node)) {
+        pending.push_back(target->value);
+    }
+    if (node->type == ASTNodeType::CallExpression) {
+        pending.insert(pending.end(), globals.begin(), globals.end());
+    }
+    if (node->type == ASTNodeType::InputStatement) {
+        for (const ASTNode* child : node->children) {
+            if (const ASTNode* target = targetIdentifier(child)) pending.push_back(target->value);
+        }
+    } else {
+        collect(node->left, globals, sets, pending);
+        collect(node->right, globals, sets, pending);
+        for (const ASTNode* child : node->children) {
+            collect(child, globals, sets, pending);
+        }
+    }
+
+    if (pending.size() == begin || isExpression(node)) return;
+    auto byId = [](Symbol a, Symbol b) { return a.id() < b.id(); };
+    std::sort(pending.begin() + begin, pending.end(), byId);
+    pending.erase(std::unique(pending.begin() + begin, pending.end()), pending.end());
+    sets.entries.push_back(WriteSets::Entry{node, static_cast<uint32_t>(sets.symbols.size()),
+                                            static_cast<uint32_t>(pending.size() - begin)});
+    sets.symbols.insert(sets.symbols.end(), pending.begin() + begin, pending.end());
+}
+
+bool hasSideEffects(const ASTNode* node) {
+    if (!node) return false;
+    switch (node->type) {
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement:
+        case ASTNodeType::CallExpression:
+            return true;
+        default:
+            break;
+    }
+    if (hasSideEffects(node->left) || hasSideEffects(node->right)) return true;
+    for (const ASTNode* child : node->children) {
+        if (hasSideEffects(child)) return true;
+    }
+    return false;
+}
+
+bool sameExpression(const ASTNode* a, const ASTNode* b) {
+    if (!a || !b) return a == b;
+    if (a == b) return true;
+    if (a->type != b->type || a->value != b->value || a->children.size() != b->children.size()) return false;
+    if (!sameExpression(a->left, b->left) || !sameExpression(a->right, b->right)) return false;
+    for (size_t i = 0; i < a->children.size(); ++i) {
+        if (!sameExpression(a->children[i], b->children[i])) return false;
+    }
+    return true;
+}
+
+ValueType declaredType(Symbol type) {
+    return type == kInt ? ValueType::Int : type == kFloat ? ValueType::Float : ValueType::Unknown;
+}
+
+ValueType literalType(Symbol text) {
+    if (text == kTrue || text == kFalse) return ValueType::Bool;
+    std::string_view spelling = text.str();
+    if (!spelling.empty() && spelling[0] == '-') spelling.remove_prefix(1);
+    if (spelling.empty() || !(std::isdigit(static_cast<unsigned char>(spelling[0])) || spelling[0] == '.')) {
+        return ValueType::Unknown; // strings and characters
+    }
+    return spelling.find_first_of(".eE") == std::string_view::npos ? ValueType::Int : ValueType::Double;
+}
+
+ValueType resultType(Symbol op, ValueType left, ValueType right) {
+    if (isComparison(op)) return ValueType::Bool;
+    if (left == ValueType::Unknown || right == ValueType::Unknown) return ValueType::Unknown;
+    if (op == kModulo || op == kShiftLeft || op == kShiftRight || op == kBitAnd) {
+        const bool integers = (left == ValueType::Int || left == ValueType::Bool) &&
+                              (right == ValueType::Int || right == ValueType::Bool);
+        return integers ? ValueType::Int : ValueType::Unknown;
+    }
+    if (left == ValueType::Double || right == ValueType::Double) return ValueType::Double;
+    if (left == ValueType::Float || right == ValueType::Float) return ValueType::Float;
+    return ValueType::Int;
+}
+
+ValueType unaryResultType(Symbol op, ValueType operand) {
+    if (op == kNot) return ValueType::Bool;
+    if (operand == ValueType::Bool) return ValueType::Int;
+    return operand;
+}
+
+Symbol declarableType(ValueType type) {
+    switch (type) {
+        case ValueType::Bool:
+        case ValueType::Int:
+            return kInt;
+        case ValueType::Float:
+            return kFloat;
+        default:
+            return Symbol();
+    }
+}
+
+ValueType expressionType(const ASTNode* node, const ControlFlowGraph& graph) {
+    switch (node->type) {
+        case ASTNodeType::Literal:
+            return literalType(node->value);
+        case ASTNodeType::Identifier: {
+            const uint32_t variable = graph.variableOf(node);
+            return variable == None ? ValueType::Unknown : declaredType(graph.variables()[variable].type);
+        }
+        case ASTNodeType::BinaryOperation:
+            if (!node->left || !node->right) return ValueType::Unknown;
+            return resultType(node->value, expressionType(node->left, graph), expressionType(node->right, graph));
+        case ASTNodeType::UnaryOperation:
+            return node->left ? unaryResultType(node->value, expressionType(node->left, graph)) : ValueType::Unknown;
+        case ASTNodeType::ArraySubscript: {
+            const uint32_t variable = node->left ? graph.variableOf(node->left) : None;
+            if (variable == None) return ValueType::Unknown;
+            const Symbol type = graph.variables()[variable].type;
+            return type == kIntArray ? ValueType::Int : type == kFloatArray ? ValueType::Float : ValueType::Unknown;
+        }
+        default:
+            return ValueType::Unknown;
+    }
+}
+
+bool intLiteralValue(Symbol text, int64_t& value) {
+    std::string_view spelling = text.str();
+    const bool negative = !spelling.empty() && spelling[0] == '-';
+    if (negative) spelling.remove_prefix(1);
+    // A leading zero would make it octal
+    if (spelling.empty() || spelling.size() > 10 || (spelling[0] == '0' && spelling.size() > 1)) return false;
+    int64_t number = 0;
+    for (char c : spelling) {
+        if (c < '0' || c > '9') return false;
+        number = number * 10 + (c - '0');
+    }
+    value = negative ? -number : number;
+    return value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max();
+}
+
+namespace {
+
+bool intLiteral(const ASTNode* node, int64_t& value) {
+    return node && node->type == ASTNodeType::Literal && intLiteralValue(node->value, value);
+}
+
+bool isIdentifier(const ASTNode* node, Symbol name) {
+    return node && node->type == ASTNodeType::Identifier && node->value == name;
+}
+
+} // namespace
+
+bool affineIndex(const ASTNode* index, Symbol variable, int64_t& offset) {
+    if (isIdentifier(index, variable)) {
+        offset = 0;
+        return true;
+    }
+    if (!index || index->type != ASTNodeType::BinaryOperation) return false;
+    int64_t value;
+    if (isIdentifier(index->left, variable) && intLiteral(index->right, value) &&
+        (index->value == kPlus || index->value == kMinus)) {
+        offset = index->value == kPlus ? value : -value;
+        return true;
+    }
+    if (index->value == kPlus && intLiteral(index->left, value) && isIdentifier(index->right, variable)) {
+        offset = value;
+        return true;
+    }
+    return false;
+}
+
+bool countedLoop(const ASTNode* loop, const ControlFlowGraph& graph, const WriteSets& writes, CountedLoop& count) {
+    if (loop->type != ASTNodeType::ForStatement || loop->children.size() < 4 || !loop->children[3]) return false;
+    const ASTNode* init = loop->children[0];
+    const ASTNode* condition = loop->children[1];
+    const ASTNode* increment = loop->children[2];
+    if (!init || !condition || !increment) return false;
+
+    // for (int i = a; ...) or for (i = a; ...), with i an int
+    if (init->type != ASTNodeType::Declaration && init->type != ASTNodeType::Assignment) return false;
+    if (!init->left || init->left->type != ASTNodeType::Identifier) return false;
+    if (!intLiteral(init->right, count.start)) return false;
+    count.variable = init->left->value;
+    count.declared = init->type == ASTNodeType::Declaration;
+    if (count.declared) {
+        if (init->value != kInt) return false;
+    } else {
+        const uint32_t variable = graph.variableOf(init->left);
+        if (variable == None || graph.variables()[variable].type != kInt) return false;
+    }
+
+    // i += s, i -= s, i++, ++i, i--, --i
+    if (!isIdentifier(increment->left, count.variable)) return false;
+    if (increment->type == ASTNodeType::PostIncrement || increment->type == ASTNodeType::PreIncrement) {
+        if (increment->value == kIncrement) {
+            count.step = 1;
+        } else if (increment->value == kDecrement) {
+            count.step = -1;
+        } else {
+            return false;
+        }
+    } else if (increment->type == ASTNodeType::CompoundAssignment &&
+               (increment->value == kPlusAssign || increment->value == kMinusAssign)) {
+        if (!intLiteral(increment->right, count.step)) return false;
+        if (increment->value == kMinusAssign) count.step = -count.step;
+    } else {
+        return false;
+    }
+    if (count.step == 0) return false;
+
+    // i op bound, or bound op i
+    if (condition->type != ASTNodeType::BinaryOperation) return false;
+    Symbol op = condition->value;
+    int64_t bound;
+    if (isIdentifier(condition->left, count.variable) && intLiteral(condition->right, bound)) {
+        // as written
+    } else if (isIdentifier(condition->right, count.variable) && intLiteral(condition->left, bound)) {
+        op = op == kLess ? kGreater : op == kGreater ? kLess : op == kLessEqual ? kGreaterEqual
+           : op == kGreaterEqual ? kLessEqual : op;
+    } else {
+        return false;
+    }
+
+    // Nothing else may change i, or the count would be off
+    const SymbolRange written = writes.of(loop->children[3]);
+    if (std::binary_search(written.begin(), written.end(), count.variable,
+                           [](Symbol a, Symbol b) { return a.id() < b.id(); })) {
+        return false;
+    }
+
+    const int64_t distance = bound - count.start;
+    const int64_t step = count.step;
+    if (op == kLess || op == kLessEqual) {
+        const int64_t span = op == kLess ? distance : distance + 1; // values of i that pass
+        if (span <= 0) {
+            count.trips = 0;
+        } else if (step > 0) {
+            count.trips = (span + step - 1) / step;
+        } else {
+            return false;
+        }
+    } else if (op == kGreater || op == kGreaterEqual) {
+        const int64_t span = op == kGreater ? -distance : -distance + 1;
+        if (span <= 0) {
+            count.trips = 0;
+        } else if (step < 0) {
+            count.trips = (span - step - 1) / -step;
+        } else {
+            return false;
+        }
+    } else if (op == kNotEqual) {
+        if (distance % step != 0 || distance / step < 0) return false;
+        count.trips = distance / step;
+    } else {
+        return false;
+    }
+    const int64_t end = count.end();
+    return end >= std::numeric_limits<int32_t>::min() && end <= std::numeric_limits<int32_t>::max();
+}
@@ -0,0 +1,912 @@
+#include "../include/Bytecode.h"
+#include "../include/Analyses.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+const Symbol kInt("int");
+const Symbol kFloat("float");
+const Symbol kVoid("void");
+const Symbol kMain("main");
+const Symbol kEndl("std::endl");
+const Symbol kTrue("true");
+const Symbol kFalse("false");
+const Symbol kOne("1.0");
+
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kTimes("*");
+const Symbol kDivide("/");
+const Symbol kModulo("%");
+const Symbol kShiftLeft("<<");
+const Symbol kShiftRight(">>");
+const Symbol kBitAnd("&");
+const Symbol kBitOr("|");
+const Symbol kBitXor("^");
+const Symbol kNot("!");
+const Symbol kAnd("&&");
+const Symbol kOr("||");
+const Symbol kEqual("==");
+const Symbol kNotEqual("!=");
+const Symbol kLess("<");
+const Symbol kGreater(">");
+const Symbol kLessEqual("<=");
+const Symbol kGreaterEqual(">=");
+const Symbol kIncrement("++");
+const Symbol kPlusAssign("+=");
+const Symbol kMinusAssign("-=");
+const Symbol kTimesAssign("*=");
+const Symbol kDivideAssign("/=");
+
+constexpr uint32_t kMaxRegisters = 0xffff;
+constexpr uint32_t kMaxArrayElements = 1u << 24; // of a frame
+
+bool isComparison(Symbol op) {
+    return op == kEqual || op == kNotEqual || op == kLess || op == kGreater || op == kLessEqual ||
+           op == kGreaterEqual;
+}
+
+// The instruction for a binary arithmetic operator; false if there is none
+bool arithmeticOpcode(Symbol op, bool real, Opcode& opcode) {
+    static const std::pair<Symbol, Opcode> ints[] = {
+        {kPlus, Opcode::AddInt},       {kMinus, Opcode::SubInt},      {kTimes, Opcode::MulInt},
+        {kDivide, Opcode::DivInt},     {kModulo, Opcode::ModInt},     {kShiftLeft, Opcode::ShlInt},
+        {kShiftRight, Opcode::ShrInt}, {kBitAnd, Opcode::AndInt},     {kBitOr, Opcode::OrInt},
+        {kBitXor, Opcode::XorInt},
+    };
+    static const std::pair<Symbol, Opcode> reals[] = {
+        {kPlus, Opcode::AddReal},   {kMinus, Opcode::SubReal},
+        {kTimes, Opcode::MulReal},  {kDivide, Opcode::DivReal},
+    };
+    auto find = [&](const auto& table) {
+        for (const auto& entry : table) {
+            if (entry.first == op) {
+                opcode = entry.second;
+                return true;
+            }
+        }
+        return false;
+    };
+    return real ? find(reals) : find(ints);
+}
+
+bool isNumber(std::string_view spelling) {
+    if (!spelling.empty() && spelling[0] == '-') spelling.remove_prefix(1);
+    return !spelling.empty() && ((spelling[0] >= '0' && spelling[0] <= '9') || spelling[0] == '.');
+}
+
+bool mentions(const ASTNode* node, Symbol name) {
+    if (!node) return false;
+    if (node->type == ASTNodeType::Identifier && node->value == name) return true;
+    if (mentions(node->left, name) || mentions(node->right, name)) return true;
+    return std::any_of(node->children.begin(), node->children.end(),
+                       [&](const ASTNode* child) { return mentions(child, name); });
+}
+
+// The text of a string literal, its escapes replaced; false if `spelling`
+// is not one
+bool stringLiteral(std::string_view spelling, char quote, std::string& text) {
+    while (!spelling.empty() && spelling.back() == ' ') spelling.remove_suffix(1);
+    if (spelling.size() < 2 || spelling.front() != quote || spelling.back() != quote) return false;
+    spelling = spelling.substr(1, spelling.size() - 2);
+    text.clear();
+    for (size_t i = 0; i < spelling.size(); ++i) {
+        if (spelling[i] != '\\' || i + 1 == spelling.size()) {
+            text += spelling[i];
+            continue;
+        }
+        switch (spelling[++i]) {
+            case 'n': text += '\n'; break;
+            case 't': text += '\t'; break;
+            case 'r': text += '\r'; break;
+            case '0': text += '\0'; break;
+            default: text += spelling[i]; break;
+        }
+    }
+    return true;
+}
+} // namespace
+
+const char* opcodeName(Opcode op) {
+    static const char* const names[] = {
+#define BYTECODE_NAME(name) #name,
+        BYTECODE_OPCODES(BYTECODE_NAME)
+#undef BYTECODE_NAME
+    };
+    return names[static_cast<size_t>(op)];
+}
+
+size_t BytecodeProgram::size() const {
+    size_t instructions = 0;
+    for (const auto& function : functions) instructions += function.code.size();
+    return instructions;
+}
+
+BytecodeProgram BytecodeCompiler::compile(const ASTNode* root) {
+    program = BytecodeProgram();
+    function = nullptr;
+    signatures.clear();
+    functionIndex.clear();
+    globals.clear();
+    line = root ? root->loc.line : 0;
+    if (!root) fail("there is no program");
+
+    // Every function is known before any is compiled, so calls may come
+    // before definitions
+    std::vector<const ASTNode*> statements; // outside functions
+    for (const ASTNode* child : root->children) {
+        if (!child || child->type == ASTNodeType::Preprocessor) continue;
+        if (child->type != ASTNodeType::FunctionDeclaration) {
+            statements.push_back(child);
+            continue;
+        }
+        if (!child->left) continue; // a prototype
+        line = child->loc.line;
+        if (functionIndex.contains(child->value)) fail("function " + std::string(child->value.str()) + " is defined more than once");
+        Signature signature;
+        signature.definition = child;
+        const Symbol result = child->right ? child->right->value : kInt;
+        signature.returns = result != kVoid;
+        if (signature.returns) signature.result = typeOf(result);
+        for (const ASTNode* parameter : child->children) signature.parameters.push_back(typeOf(parameter->value));
+        functionIndex[child->value] = static_cast<uint32_t>(signatures.size());
+        signatures.push_back(std::move(signature));
+    }
+
+    if (signatures.empty()) {
+        // Statements with no function around them run as main
+        Signature signature;
+        signature.definition = root;
+        signatures.push_back(signature);
+        functionIndex[kMain] = 0;
+    } else {
+        // Variables outside functions are globals, set before main starts
+        for (const ASTNode* statement : statements) {
+            line = statement->loc.line;
+            if (statement->type == ASTNodeType::ArrayDeclaration) {
+                fail("arrays declared outside functions are not supported; declare " +
+                     std::string(statement->left->value.str()) + " in the functions that use it");
+            }
+            if (statement->type != ASTNodeType::Declaration) {
+                fail("only variables can be declared outside functions");
+            }
+            globals.push_back(statement);
+        }
+        program.globals = static_cast<uint32_t>(globals.size());
+    }
+    if (!functionIndex.contains(kMain)) fail("the program has no main function");
+    program.entry = functionIndex.at(kMain);
+
+    program.functions.resize(signatures.size());
+    for (uint32_t index = 0; index < signatures.size(); ++index) compileFunction(index);
+    return std::move(program);
+}
+
+void BytecodeCompiler::compileFunction(uint32_t index) {
+    function = &program.functions[index];
+    signature = &signatures[index];
+    const ASTNode* definition = signature->definition;
+    const bool wholeProgram = definition->type == ASTNodeType::Program;
+    function->name = wholeProgram ? kMain : definition->value;
+    line = definition->loc.line;
+    variables.clear();
+    bindings.clear();
+    constants.clear();
+    memory = 0;
+    top = 0;
+    for (uint32_t global = 0; global < globals.size(); ++global) {
+        const ASTNode* declaration = globals[global];
+        variables[declaration->left->value] =
+            Variable{0, typeOf(declaration->value), -1, static_cast<int32_t>(global)};
+    }
+
+    // Parameters first, then the literals
+    if (!wholeProgram) {
+        for (const ASTNode* parameter : definition->children) {
+            bind(parameter->left->value, Variable{newRegister(), typeOf(parameter->value), -1});
+        }
+    }
+    function->parameters = static_cast<uint16_t>(top);
+    Value one;
+    one.r = 1.0;
+    constants[kOne] = Operand{newRegister(), Type::Double};
+    function->constants.push_back(one);
+    collectConstants(wholeProgram ? definition : definition->left);
+
+    // main sets the globals first
+    if (index == program.entry) {
+        for (const ASTNode* global : globals) collectConstants(global->right);
+        const uint32_t mark = top;
+        for (const ASTNode* global : globals) {
+            if (!global->right) continue;
+            line = global->loc.line;
+            const Variable variable = variables.at(global->left->value);
+            const Operand value = convert(compileExpression(global->right), variable.type);
+            emit(Opcode::StoreGlobal, static_cast<uint32_t>(variable.global), value.reg);
+            top = mark;
+        }
+    }
+    if (wholeProgram) {
+        for (const ASTNode* statement : definition->children) compileStatement(statement);
+    } else {
+        compileStatement(definition->left);
+    }
+    emit(Opcode::ReturnVoid);
+
+    for (auto& array : function->arrays) array.offset += function->registers;
+    function->frameSize = function->registers + memory;
+    function = nullptr;
+    signature = nullptr;
+}
+
+// Gives every numeric literal of the function a register
+void BytecodeCompiler::collectConstants(const ASTNode* node) {
+    if (!node) return;
+    if (node->type == ASTNodeType::Literal && !constants.contains(node->value)) {
+        Value value;
+        Type type;
+        if (numericLiteral(node->value, value, type)) {
+            constants[node->value] = Operand{newRegister(), type};
+            function->constants.push_back(value);
+        }
+    }
+    collectConstants(node->left);
+    collectConstants(node->right);
+    for (const ASTNode* child : node->children) collectConstants(child);
+}
+
+// The value and type of an int, float, double or bool literal; false for
+// anything else
+bool BytecodeCompiler::numericLiteral(Symbol spelling, Value& value, Type& type) {
+    int64_t integer;
+    if (spelling == kTrue || spelling == kFalse) {
+        value.i = spelling == kTrue;
+        type = Type::Int;
+        return true;
+    }
+    if (intLiteralValue(spelling, integer)) {
+        value.i = integer;
+        type = Type::Int;
+        return true;
+    }
+    const std::string text(spelling.str());
+    if (!isNumber(text) || text.find_first_of(".eE") == std::string::npos) return false;
+    char* end = nullptr;
+    value.r = std::strtod(text.c_str(), &end);
+    type = Type::Double;
+    if (*end == 'f' || *end == 'F') {
+        value.r = static_cast<float>(value.r);
+        type = Type::Float;
+        ++end;
+    }
+    return *end == '\0';
+}
+
+void BytecodeCompiler::compileStatement(const ASTNode* node) {
+    if (!node) return;
+    if (node->loc.line) line = node->loc.line;
+    const uint32_t mark = top; // temporaries end with the statement
+
+    switch (node->type) {
+        case ASTNodeType::Block:
+            compileScope(node);
+            return;
+
+        case ASTNodeType::Declaration:
+            compileDeclaration(node);
+            return;
+
+        case ASTNodeType::ArrayDeclaration:
+            compileArrayDeclaration(node);
+            return;
+
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement:
+            compileStore(node, false);
+            break;
+
+        case ASTNodeType::ExpressionStatement:
+            compileStatement(node->left);
+            break;
+
+        case ASTNodeType::PrintStatement:
+            compilePrint(node);
+            break;
+
+        case ASTNodeType::InputStatement:
+            compileInput(node);
+            break;
+
+        case ASTNodeType::ReturnStatement:
+            compileReturn(node);
+            break;
+
+        case ASTNodeType::IfStatement: {
+            std::vector<size_t> skip;
+            compileJumpIf(node->left, false, skip);
+            top = mark;
+            compileNested(node->right);
+            for (size_t jump : skip) patch(jump, function->code.size());
+            break;
+        }
+
+        // Loops test their condition at the bottom, with a jump to it
+        // before the first trip
+        case ASTNodeType::WhileStatement: {
+            const size_t entry = emit(Opcode::Jump);
+            const size_t body = function->code.size();
+            compileNested(node->right);
+            patch(entry, function->code.size());
+            compileLoopBranch(node->left, body);
+            break;
+        }
+
+        case ASTNodeType::DoWhileStatement: {
+            const size_t body = function->code.size();
+            compileNested(node->left);
+            compileLoopBranch(node->right, body);
+            break;
+        }
+
+        case ASTNodeType::ForStatement: {
+            const size_t scope = bindings.size();
+            compileStatement(node->children.size() > 0 ? node->children[0] : nullptr);
+            const ASTNode* condition = node->children.size() > 1 ? node->children[1] : nullptr;
+            const size_t entry = condition ? emit(Opcode::Jump) : 0;
+            const size_t body = function->code.size();
+            compileNested(node->children.size() > 3 ? node->children[3] : nullptr);
+            compileStatement(node->children.size() > 2 ? node->children[2] : nullptr);
+            if (condition) {
+                patch(entry, function->code.size());
+                compileLoopBranch(condition, body);
+            } else {
+                patch(emit(Opcode::Jump), body);
+            }
+            endScope(scope);
+            break;
+        }
+
+        case ASTNodeType::Preprocessor:
+            break;
+
+        case ASTNodeType::FunctionDeclaration:
+            fail("functions declared inside functions are not supported");
+
+        default:
+            compileExpression(node);
+            break;
+    }
+    top = mark;
+}
+
+// A block: what it declares ends with it
+void BytecodeCompiler::compileScope(const ASTNode* node) {
+    const uint32_t mark = top;
+    const size_t scope = bindings.size();
+    for (const ASTNode* statement : node->children) compileStatement(statement);
+    endScope(scope);
+    top = mark;
+}
+
+// The body of an if statement or a loop, which is a scope of its own
+// even when it is not a block
+void BytecodeCompiler::compileNested(const ASTNode* node) {
+    if (!node) return;
+    if (node->type == ASTNodeType::Block) {
+        compileScope(node);
+        return;
+    }
+    const uint32_t mark = top;
+    const size_t scope = bindings.size();
+    compileStatement(node);
+    endScope(scope);
+    top = mark;
+}
+
+// Unbinds the names bound since `scope`, uncovering what they shadowed
+void BytecodeCompiler::endScope(size_t scope) {
+    while (bindings.size() > scope) {
+        const Binding& binding = bindings.back();
+        if (binding.shadows) {
+            variables[binding.name] = binding.previous;
+        } else {
+            variables.erase(binding.name);
+        }
+        bindings.pop_back();
+    }
+}
+
+void BytecodeCompiler::compileDeclaration(const ASTNode* node) {
+    const Type type = typeOf(node->value);
+    const Symbol name = node->left->value;
+    const uint16_t reg = newRegister();
+    bind(name, Variable{reg, type, -1});
+    // A variable is zero until it is set, also where C++ leaves it
+    // indeterminate, so that a run does not depend on what the register
+    // held before
+    if (!node->right || mentions(node->right, name)) emit(Opcode::Clear, reg, 1);
+    if (node->right) compileInto(node->right, reg, type);
+    top = reg + 1u;
+}
+
+void BytecodeCompiler::compileArrayDeclaration(const ASTNode* node) {
+    const Type type = typeOf(node->value);
+    const Symbol name = node->left->value;
+    int64_t size = 0;
+    if (!node->right || node->right->type != ASTNodeType::Literal || !intLiteralValue(node->right->value, size) ||
+        size <= 0) {
+        fail("the size of array " + std::string(name.str()) + " must be a positive int literal");
+    }
+    if (size > static_cast<int64_t>(kMaxArrayElements - memory)) fail("the arrays of the function are too large");
+    if (function->arrays.size() >= kMaxRegisters) fail("the function declares too many arrays");
+    if (node->children.size() > static_cast<size_t>(size)) {
+        fail("array " + std::string(name.str()) + " has more initializers than elements");
+    }
+    if (node->children.size() > kMaxRegisters) fail("array " + std::string(name.str()) + " has too many initializers");
+
+    const auto array = static_cast<uint32_t>(function->arrays.size());
+    function->arrays.push_back(BytecodeFunction::Array{memory, static_cast<uint32_t>(size)});
+    memory += static_cast<uint32_t>(size);
+    bind(name, Variable{0, type, static_cast<int32_t>(array)});
+
+    emit(Opcode::ClearArray, array);
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        const Operand value = convert(compileExpression(node->children[i]), type);
+        emit(Opcode::SetElement, array, static_cast<uint32_t>(i), value.reg);
+    }
+}
+
+void BytecodeCompiler::compilePrint(const ASTNode* node) {
+    std::string text;
+    for (const ASTNode* child : node->children) {
+        if (!child) continue;
+        if (child->type == ASTNodeType::Literal) {
+            const std::string_view spelling = child->value.str();
+            if (child->value == kEndl) {
+                emit(Opcode::PrintEndl);
+                continue;
+            }
+            if (stringLiteral(spelling, '"', text)) {
+                const auto index = static_cast<uint32_t>(program.strings.size());
+                program.strings.push_back(text);
+                emit(Opcode::PrintString, 0, index & 0xffff, index >> 16);
+                continue;
+            }
+            if (stringLiteral(spelling, '\'', text) && text.size() == 1) {
+                emit(Opcode::PrintChar, 0, static_cast<unsigned char>(text[0]));
+                continue;
+            }
+        }
+        const Operand value = compileExpression(child);
+        emit(value.type == Type::Int ? Opcode::PrintInt : Opcode::PrintReal, value.reg);
+    }
+}
+
+// Reads into variables and elements. A read that fails leaves zero, and a
+// read from a stream that has failed before leaves the value as it was,
+// as for std::cin; so an element is loaded before it is read into
+void BytecodeCompiler::compileInput(const ASTNode* node) {
+    for (const ASTNode* child : node->children) {
+        if (!child) continue;
+        if (child->type == ASTNodeType::Identifier) {
+            const Variable variable = lookup(child);
+            const Opcode read = variable.type == Type::Int ? Opcode::ReadInt : Opcode::ReadFloat;
+            if (variable.global < 0) {
+                emit(read, variable.reg);
+                continue;
+            }
+            const uint16_t value = newRegister();
+            emit(Opcode::LoadGlobal, value, static_cast<uint32_t>(variable.global));
+            emit(read, value);
+            emit(Opcode::StoreGlobal, static_cast<uint32_t>(variable.global), value);
+            continue;
+        }
+        if (child->type != ASTNodeType::ArraySubscript) fail("std::cin can only read into variables and elements");
+        const Variable array = lookupArray(child->left);
+        const Operand index = convert(compileExpression(child->right), Type::Int);
+        const uint16_t element = newRegister();
+        emit(Opcode::LoadElement, element, array.array, index.reg);
+        emit(array.type == Type::Int ? Opcode::ReadInt : Opcode::ReadFloat, element);
+        emit(Opcode::StoreElement, array.array, index.reg, element);
+    }
+}
+
+void BytecodeCompiler::compileReturn(const ASTNode* node) {
+    if (!node->left) {
+        emit(Opcode::ReturnVoid);
+        return;
+    }
+    if (!signature->returns) fail("a void function cannot return a value");
+    const Operand value = convert(compileExpression(node->left), signature->result);
+    emit(Opcode::Return, value.reg);
+}
+
+// Emits jumps, to be patched, that are taken when `condition` is `when`;
+// && and || jump as soon as one side decides
+void BytecodeCompiler::compileJumpIf(const ASTNode* condition, bool when, std::vector<size_t>& jumps) {
+    if (!condition) fail("an expression is missing");
+    if (condition->type == ASTNodeType::UnaryOperation && condition->value == kNot) {
+        compileJumpIf(condition->left, !when, jumps);
+        return;
+    }
+    if (condition->type == ASTNodeType::BinaryOperation && (condition->value == kAnd || condition->value == kOr)) {
+        const bool decides = condition->value == kOr; // the value of the left side that decides
+        if (when == decides) {
+            compileJumpIf(condition->left, when, jumps);
+            compileJumpIf(condition->right, when, jumps);
+            return;
+        }
+        std::vector<size_t> decided;
+        compileJumpIf(condition->left, !when, decided);
+        compileJumpIf(condition->right, when, jumps);
+        for (size_t jump : decided) patch(jump, function->code.size());
+        return;
+    }
+    Value value;
+    Type type;
+    if (condition->type == ASTNodeType::Literal && numericLiteral(condition->value, value, type)) {
+        const bool truth = type == Type::Int ? value.i != 0 : value.r != 0;
+        if (truth == when) jumps.push_back(emit(Opcode::Jump));
+        return;
+    }
+
+    Operand operand = compileExpression(condition);
+    if (operand.type != Type::Int) {
+        const uint16_t reg = newRegister();
+        emit(Opcode::RealToBool, reg, operand.reg);
+        operand = Operand{reg, Type::Int};
+    }
+    jumps.push_back(emit(when ? Opcode::JumpIfNotZero : Opcode::JumpIfZero, operand.reg));
+}
+
+// Goes back to `target` while `condition` holds, comparing and branching
+// in one instruction where the operands are ints
+void BytecodeCompiler::compileLoopBranch(const ASTNode* condition, size_t target) {
+    if (!condition) fail("an expression is missing");
+    if (condition->type == ASTNodeType::BinaryOperation && isComparison(condition->value)) {
+        const Symbol op = condition->value;
+        Operand left = compileExpression(condition->left);
+        Operand right = compileExpression(condition->right);
+        const auto offset = static_cast<int64_t>(target) - static_cast<int64_t>(function->code.size() + 1);
+        if (left.type == Type::Int && right.type == Type::Int && offset >= INT16_MIN) {
+            if (op == kGreater || op == kGreaterEqual) std::swap(left, right);
+            const Opcode branch = op == kEqual                     ? Opcode::BranchEqInt
+                                  : op == kNotEqual                ? Opcode::BranchNeInt
+                                  : op == kLess || op == kGreater ? Opcode::BranchLtInt
+                                                                   : Opcode::BranchLeInt;
+            emit(branch, left.reg, right.reg, static_cast<uint16_t>(static_cast<int16_t>(offset)));
+            return;
+        }
+        const Operand holds = compare(op, left, right, -1);
+        patch(emit(Opcode::JumpIfNotZero, holds.reg), target);
+        return;
+    }
+    std::vector<size_t> jumps;
+    compileJumpIf(condition, true, jumps);
+    for (size_t jump : jumps) patch(jump, target);
+}
+
+// The operand holding the value of an expression; `dest`, if given, is
+// the register to compute it into where that takes an instruction, but
+// variables and literals are used where they are
+BytecodeCompiler::Operand BytecodeCompiler::compileExpression(const ASTNode* node, int32_t dest) {
+    if (!node) fail("an expression is missing");
+    switch (node->type) {
+        case ASTNodeType::Literal:
+            return constant(node);
+
+        case ASTNodeType::Identifier: {
+            const Variable variable = lookup(node);
+            if (variable.global < 0) return Operand{variable.reg, variable.type};
+            const uint16_t reg = target(dest);
+            emit(Opcode::LoadGlobal, reg, static_cast<uint32_t>(variable.global));
+            return Operand{reg, variable.type};
+        }
+
+        case ASTNodeType::ArraySubscript: {
+            const Variable array = lookupArray(node->left);
+            const Operand index = convert(compileExpression(node->right), Type::Int);
+            const uint16_t reg = target(dest);
+            emit(Opcode::LoadElement, reg, array.array, index.reg);
+            return Operand{reg, array.type};
+        }
+
+        case ASTNodeType::UnaryOperation: {
+            const Operand operand = compileExpression(node->left);
+            if (node->value == kNot) {
+                const uint16_t reg = target(dest);
+                if (operand.type == Type::Int) {
+                    emit(Opcode::Not, reg, operand.reg);
+                } else {
+                    emit(Opcode::RealToBool, reg, operand.reg);
+                    emit(Opcode::Not, reg, reg);
+                }
+                return Operand{reg, Type::Int};
+            }
+            if (node->value != kMinus) fail("operator " + std::string(node->value.str()) + " is not supported");
+            const uint16_t reg = target(dest);
+            emit(operand.type == Type::Int ? Opcode::NegInt : Opcode::NegReal, reg, operand.reg);
+            return Operand{reg, operand.type};
+        }
+
+        case ASTNodeType::BinaryOperation:
+            return compileBinary(node, dest);
+
+        case ASTNodeType::CallExpression:
+            return compileCall(node, dest);
+
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement:
+            return compileStore(node, true);
+
+        default:
+            fail("this statement cannot be used as a value");
+    }
+}
+
+// Computes an expression into a register, converted to its type
+void BytecodeCompiler::compileInto(const ASTNode* node, uint16_t reg, Type type) {
+    convert(compileExpression(node, reg), type, reg);
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::compileBinary(const ASTNode* node, int32_t dest) {
+    const Symbol op = node->value;
+    if (op == kAnd || op == kOr) return compileLogic(node);
+
+    const Operand left = compileExpression(node->left);
+    int64_t amount = 0;
+    if ((op == kPlus || op == kMinus) && left.type == Type::Int && node->right &&
+        node->right->type == ASTNodeType::Literal && intLiteralValue(node->right->value, amount)) {
+        if (op == kMinus) amount = -amount;
+        if (amount >= INT16_MIN && amount <= INT16_MAX) {
+            const uint16_t reg = target(dest);
+            emit(Opcode::AddIntImm, reg, left.reg, static_cast<uint16_t>(static_cast<int16_t>(amount)));
+            return Operand{reg, Type::Int};
+        }
+    }
+    const Operand right = compileExpression(node->right);
+    if (isComparison(op)) return compare(op, left, right, dest);
+    return arithmetic(op, left, right, dest);
+}
+
+// && and ||, as 0 or 1
+BytecodeCompiler::Operand BytecodeCompiler::compileLogic(const ASTNode* node) {
+    const uint16_t reg = newRegister();
+    std::vector<size_t> jumps;
+    emit(Opcode::Clear, reg, 1);
+    compileJumpIf(node, false, jumps);
+    emit(Opcode::AddIntImm, reg, reg, 1);
+    for (size_t jump : jumps) patch(jump, function->code.size());
+    return Operand{reg, Type::Int};
+}
+
+// Assignments, compound assignments and increments; the value is the one
+// the expression has in C++, if `wantValue`
+BytecodeCompiler::Operand BytecodeCompiler::compileStore(const ASTNode* node, bool wantValue) {
+    const ASTNode* destination = node->left;
+    if (!destination) fail("an assignment has no target");
+    const bool element = destination->type == ASTNodeType::ArraySubscript;
+    if (!element && destination->type != ASTNodeType::Identifier) fail("only variables and elements can be assigned");
+    const Variable variable = element ? lookupArray(destination->left) : lookup(destination);
+    const bool inRegister = !element && variable.global < 0;
+
+    // The right side of an assignment comes before its target (C++17)
+    Operand index{0, Type::Int};
+    auto store = [&](Operand value) {
+        if (element) {
+            emit(Opcode::StoreElement, variable.array, index.reg, value.reg);
+        } else if (!inRegister) {
+            emit(Opcode::StoreGlobal, static_cast<uint32_t>(variable.global), value.reg);
+        }
+    };
+    if (node->type == ASTNodeType::Assignment) {
+        if (inRegister) {
+            compileInto(node->right, variable.reg, variable.type);
+            return Operand{variable.reg, variable.type};
+        }
+        const Operand value = convert(compileExpression(node->right), variable.type);
+        if (element) index = convert(compileExpression(destination->right), Type::Int);
+        store(value);
+        return value;
+    }
+
+    const bool increment = node->type != ASTNodeType::CompoundAssignment;
+    Operand amount{0, Type::Int};
+    if (!increment) amount = compileExpression(node->right);
+    Operand old{variable.reg, variable.type};
+    if (element) {
+        index = convert(compileExpression(destination->right), Type::Int);
+        old.reg = newRegister();
+        emit(Opcode::LoadElement, old.reg, variable.array, index.reg);
+    } else if (!inRegister) {
+        old.reg = newRegister();
+        emit(Opcode::LoadGlobal, old.reg, static_cast<uint32_t>(variable.global));
+    }
+    const Operand current = old;
+    if (wantValue && node->type == ASTNodeType::PostIncrement && inRegister) {
+        const uint16_t saved = newRegister();
+        emit(Opcode::Move, saved, old.reg);
+        old.reg = saved;
+    }
+
+    const Symbol value = node->value;
+    const Symbol op = increment ? (value == kIncrement ? kPlus : kMinus)
+                      : value == kPlusAssign   ? kPlus
+                      : value == kMinusAssign  ? kMinus
+                      : value == kTimesAssign  ? kTimes
+                      : value == kDivideAssign ? kDivide
+                                               : Symbol();
+    if (op == Symbol()) fail("operator " + std::string(value.str()) + " is not supported");
+
+    // Ints step by a literal in one instruction
+    int64_t step = 1;
+    const bool literalStep = increment || (node->right->type == ASTNodeType::Literal &&
+                                           intLiteralValue(node->right->value, step) && step <= INT16_MAX);
+    const int32_t dest = inRegister ? variable.reg : -1;
+    Operand result;
+    if (variable.type == Type::Int && literalStep && (op == kPlus || op == kMinus)) {
+        result = Operand{target(dest), Type::Int};
+        emit(Opcode::AddIntImm, result.reg, current.reg,
+             static_cast<uint16_t>(static_cast<int16_t>(op == kMinus ? -step : step)));
+    } else {
+        result = arithmetic(op, current, increment ? constants.at(kOne) : amount, dest);
+        result = convert(result, variable.type, dest);
+    }
+    store(result);
+    return node->type == ASTNodeType::PostIncrement ? old : result;
+}
+
+// Arguments go to consecutive registers, converted to the types of the
+// parameters
+BytecodeCompiler::Operand BytecodeCompiler::compileCall(const ASTNode* node, int32_t dest) {
+    const std::string name(node->value.str());
+    if (!functionIndex.contains(node->value)) fail("function " + name + " is not defined");
+    const uint32_t callee = functionIndex.at(node->value);
+    const Signature& called = signatures[callee];
+    if (node->children.size() != called.parameters.size()) {
+        fail("function " + name + " takes " + std::to_string(called.parameters.size()) + " arguments");
+    }
+
+    const uint16_t reg = target(dest);
+    const uint32_t first = top;
+    for (size_t i = 0; i < called.parameters.size(); ++i) newRegister();
+    for (size_t i = 0; i < called.parameters.size(); ++i) {
+        compileInto(node->children[i], static_cast<uint16_t>(first + i), called.parameters[i]);
+    }
+    emit(Opcode::Call, reg, callee, first);
+    if (called.returns && called.result != Type::Int) function->reals = true;
+    return Operand{reg, called.returns ? called.result : Type::Int};
+}
+
+// Binary arithmetic in the type of the wider operand
+BytecodeCompiler::Operand BytecodeCompiler::arithmetic(Symbol op, Operand left, Operand right, int32_t dest) {
+    const bool bitwise = op == kModulo || op == kShiftLeft || op == kShiftRight || op == kBitAnd || op == kBitOr ||
+                         op == kBitXor;
+    if (bitwise && (left.type != Type::Int || right.type != Type::Int)) {
+        fail("operator " + std::string(op.str()) + " needs int operands");
+    }
+    const Type type = std::max(left.type, right.type);
+    left = convert(left, type);
+    right = convert(right, type);
+
+    Opcode opcode;
+    if (!arithmeticOpcode(op, type != Type::Int, opcode)) {
+        fail("operator " + std::string(op.str()) + " is not supported");
+    }
+    const uint16_t reg = target(dest);
+    emit(opcode, reg, left.reg, right.reg);
+    if (type == Type::Float) emit(Opcode::RoundFloat, reg, reg);
+    return Operand{reg, type};
+}
+
+// A comparison, as 0 or 1; > and >= are < and <= with the operands
+// swapped
+BytecodeCompiler::Operand BytecodeCompiler::compare(Symbol op, Operand left, Operand right, int32_t dest) {
+    const Type type = std::max(left.type, right.type);
+    left = convert(left, type);
+    right = convert(right, type);
+    if (op == kGreater || op == kGreaterEqual) std::swap(left, right);
+    const bool real = type != Type::Int;
+    const Opcode opcode = op == kEqual      ? (real ? Opcode::EqReal : Opcode::EqInt)
+                          : op == kNotEqual ? (real ? Opcode::NeReal : Opcode::NeInt)
+                          : op == kLess || op == kGreater ? (real ? Opcode::LtReal : Opcode::LtInt)
+                                                          : (real ? Opcode::LeReal : Opcode::LeInt);
+    const uint16_t reg = target(dest);
+    emit(opcode, reg, left.reg, right.reg);
+    return Operand{reg, Type::Int};
+}
+
+// The operand as `type`; into `dest` if given, else in place where the
+// conversion changes nothing
+BytecodeCompiler::Operand BytecodeCompiler::convert(Operand operand, Type type, int32_t dest) {
+    if (type != Type::Int) function->reals = true;
+    const bool widens = operand.type == Type::Float && type == Type::Double; // floats are doubles already
+    if (operand.type == type || widens) {
+        if (dest >= 0 && dest != operand.reg) emit(Opcode::Move, dest, operand.reg);
+        return Operand{dest >= 0 ? static_cast<uint16_t>(dest) : operand.reg, type};
+    }
+    const uint16_t reg = target(dest);
+    if (type == Type::Int) {
+        emit(Opcode::RealToInt, reg, operand.reg);
+    } else if (operand.type == Type::Int) {
+        emit(Opcode::IntToReal, reg, operand.reg);
+        if (type == Type::Float) emit(Opcode::RoundFloat, reg, reg);
+    } else {
+        emit(Opcode::RoundFloat, reg, operand.reg);
+    }
+    return Operand{reg, type};
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::constant(const ASTNode* literal) {
+    if (!constants.contains(literal->value)) {
+        fail("literal " + std::string(literal->value.str()) + " cannot be used as a value");
+    }
+    const Operand operand = constants.at(literal->value);
+    if (operand.type != Type::Int) function->reals = true;
+    return operand;
+}
+
+const BytecodeCompiler::Variable& BytecodeCompiler::lookup(const ASTNode* identifier) {
+    const std::string name(identifier->value.str());
+    if (identifier->type != ASTNodeType::Identifier || !variables.contains(identifier->value)) {
+        fail(name + " is not a declared variable");
+    }
+    const Variable& variable = variables.at(identifier->value);
+    if (variable.array >= 0) fail("array " + name + " is used as a value");
+    return variable;
+}
+
+const BytecodeCompiler::Variable& BytecodeCompiler::lookupArray(const ASTNode* identifier) {
+    const std::string name(identifier ? identifier->value.str() : "");
+    if (!identifier || identifier->type != ASTNodeType::Identifier || !variables.contains(identifier->value) ||
+        variables.at(identifier->value).array < 0) {
+        fail(name + " is not a declared array");
+    }
+    return variables.at(identifier->value);
+}
+
+void BytecodeCompiler::bind(Symbol name, const Variable& variable) {
+    Binding binding{name, variables.contains(name), Variable()};
+    if (binding.shadows) binding.previous = variables.at(name);
+    bindings.push_back(binding);
+    variables[name] = variable;
+}
+
+uint16_t BytecodeCompiler::newRegister() {
+    if (top >= kMaxRegisters) fail("the function needs more registers than the machine has");
+    const auto reg = static_cast<uint16_t>(top++);
+    function->registers = std::max(function->registers, static_cast<uint16_t>(top));
+    return reg;
+}
+
+size_t BytecodeCompiler::emit(Opcode op, uint32_t a, uint32_t b, uint32_t c) {
+    function->code.push_back(
+        Instruction{op, static_cast<uint16_t>(a), static_cast<uint16_t>(b), static_cast<uint16_t>(c)});
+    function->lines.push_back(line);
+    return function->code.size() - 1;
+}
+
+// Points a jump at an instruction
+void BytecodeCompiler::patch(size_t jump, size_t to) {
+    Instruction& instruction = function->code[jump];
+    instruction.b = static_cast<uint16_t>(to & 0xffff);
+    instruction.c = static_cast<uint16_t>(to >> 16);
+}
+
+BytecodeCompiler::Type BytecodeCompiler::typeOf(Symbol type) const {
+    if (type == kInt) return Type::Int;
+    if (type == kFloat) {
+        if (function) function->reals = true;
+        return Type::Float;
+    }
+    fail("type " + std::string(type.str()) + " is not supported");
+}
+
+void BytecodeCompiler::fail(const std::string& message) const {
+    throw std::runtime_error("line " + std::to_string(line) + ": " + message);
+}
@@ -0,0 +1,84 @@
+#include "../include/CallGraph.h"
+#include <algorithm>
+
+uint32_t CallGraph::find(Symbol name) const {
+    return byName.contains(name) ? byName.at(name) : None;
+}
+
+CallGraph Calls::run(const ASTNode* root) {
+    CallGraph graph;
+    if (!root) return graph;
+
+    std::vector<const ASTNode*> declarations;
+    if (root->type == ASTNodeType::FunctionDeclaration) {
+        declarations.push_back(root);
+    } else {
+        for (const ASTNode* child : root->children) {
+            if (child && child->type == ASTNodeType::FunctionDeclaration) declarations.push_back(child);
+        }
+    }
+    for (const ASTNode* declaration : declarations) {
+        if (!graph.byName.contains(declaration->value)) {
+            graph.byName[declaration->value] = static_cast<uint32_t>(graph.functionList.size());
+            graph.functionList.emplace_back();
+            graph.functionList.back().name = declaration->value;
+        }
+        if (declaration->left) graph.functionList[graph.find(declaration->value)].definition = declaration;
+    }
+    for (uint32_t f = 0; f < graph.functionList.size(); ++f) {
+        if (const ASTNode* definition = graph.functionList[f].definition) collect(definition->left, f, graph);
+    }
+
+    // A function is recursive if it is on a cycle: in a strongly connected
+    // component of more than one function, or calling itself (Tarjan)
+    const uint32_t count = static_cast<uint32_t>(graph.functionList.size());
+    std::vector<uint32_t> order(count, CallGraph::None), low(count, 0), stack;
+    std::vector<bool> onStack(count, false);
+    uint32_t visited = 0;
+    auto connect = [&](auto&& self, uint32_t f) -> void {
+        order[f] = low[f] = visited++;
+        stack.push_back(f);
+        onStack[f] = true;
+        for (uint32_t callee : graph.functionList[f].callees) {
+            if (order[callee] == CallGraph::None) {
+                self(self, callee);
+                low[f] = std::min(low[f], low[callee]);
+            } else if (onStack[callee]) {
+                low[f] = std::min(low[f], order[callee]);
+            }
+        }
+        if (low[f] != order[f]) return;
+
+        const size_t first = std::find(stack.begin(), stack.end(), f) - stack.begin();
+        const bool cycle = stack.size() - first > 1;
+        for (size_t i = first; i < stack.size(); ++i) {
+            CallGraph::Function& function = graph.functionList[stack[i]];
+            function.recursive = cycle || std::count(function.callees.begin(), function.callees.end(), stack[i]);
+            onStack[stack[i]] = false;
+        }
+        stack.resize(first);
+    };
+    for (uint32_t f = 0; f < count; ++f) {
+        if (order[f] == CallGraph::None) connect(connect, f);
+    }
+    return graph;
+}
+
+// Records the calls under `node`, made by function `caller`. Calls to
+// names the program does not declare are left out.
+void Calls::collect(const ASTNode* node, uint32_t caller, CallGraph& graph) {
+    if (!node) return;
+    if (node->type == ASTNodeType::CallExpression) {
+        const uint32_t callee = graph.find(node->value);
+        if (callee != CallGraph::None) {
+            ++graph.functionList[callee].calls;
+            auto& callees = graph.functionList[caller].callees;
+            if (std::find(callees.begin(), callees.end(), callee) == callees.end()) callees.push_back(callee);
+        }
+    }
+    collect(node->left, caller, graph);
+    collect(node->right, caller, graph);
+    for (const ASTNode* child : node->children) {
+        collect(child, caller, graph);
+    }
+}
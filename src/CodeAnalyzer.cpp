@@ -1,51 +1,66 @@
-#include "../include/CodeAnalyzer.h"
-#include <iostream>
-
-void CodeAnalyzer::analyze(const std::shared_ptr<ASTNode>& root) {
-    if (!root) return;
-    
-    checkRedundantConditions(root);
-    
-    // Analyze children
-    if (root->left) analyze(root->left);
-    if (root->right) analyze(root->right);
-    
-    // Analyze children vector
-    for (const auto& child : root->children) {
-        analyze(child);
-    }
-}
-
-void CodeAnalyzer::checkRedundantConditions(const std::shared_ptr<ASTNode>& node) {
-    if (!node || node->type != ASTNodeType::BinaryOperation) return;
-
-    // Check for x == x
-    if (node->left && node->right && node->left->value == node->right->value &&
-        (node->value == "==" || node->value == "||" || node->value == "&&")) {
-        report("Redundant condition: " + node->left->value + " " + node->value + " " + node->right->value);
-    }
-
-    // Check for true || something
-    if ((node->left && node->left->value == "true" && node->value == "||") ||
-        (node->right && node->right->value == "true" && node->value == "||")) {
-        report("Always true condition due to 'true' || something");
-    }
-
-    // Check for false && something
-    if ((node->left && node->left->value == "false" && node->value == "&&") ||
-        (node->right && node->right->value == "false" && node->value == "&&")) {
-        report("Always false condition due to 'false' && something");
-    }
-    
-    // Check for constant folding opportunities
-    if (node->left && node->right && 
-        node->left->type == ASTNodeType::Literal && 
-        node->right->type == ASTNodeType::Literal &&
-        (node->value == "+" || node->value == "-" || node->value == "*" || node->value == "/")) {
-        report("Constant folding opportunity: " + node->left->value + " " + node->value + " " + node->right->value);
-    }
-}
-
-void CodeAnalyzer::report(const std::string& message) {
-    std::cout << "[Analyzer] " << message << std::endl;
+#include "../include/CodeAnalyzer.h"
+#include <iostream>
+
+namespace {
+// Interned once so every check below is an integer compare
+const Symbol kTrue("true");
+const Symbol kFalse("false");
+const Symbol kEqual("==");
+const Symbol kOr("||");
+const Symbol kAnd("&&");
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kTimes("*");
+const Symbol kDivide("/");
+}
+
+void CodeAnalyzer::analyze(const ASTNode* root) {
+    if (!root) return;
+    
+    checkRedundantConditions(root);
+    
+    // Analyze children
+    if (root->left) analyze(root->left);
+    if (root->right) analyze(root->right);
+    
+    // Analyze children vector
+    for (const auto& child : root->children) {
+        analyze(child);
+    }
+}
+
+void CodeAnalyzer::checkRedundantConditions(const ASTNode* node) {
+    if (!node || node->type != ASTNodeType::BinaryOperation) return;
+
+    // Check for x == x
+    if (node->left && node->right && node->left->value == node->right->value &&
+        (node->value == kEqual || node->value == kOr || node->value == kAnd)) {
+        report("Redundant condition: " + std::string(node->left->value.str()) + " " +
+               std::string(node->value.str()) + " " + std::string(node->right->value.str()));
+    }
+
+    // Check for true || something
+    if ((node->left && node->left->value == kTrue && node->value == kOr) ||
+        (node->right && node->right->value == kTrue && node->value == kOr)) {
+        report("Always true condition due to 'true' || something");
+    }
+
+    // Check for false && something
+    if ((node->left && node->left->value == kFalse && node->value == kAnd) ||
+        (node->right && node->right->value == kFalse && node->value == kAnd)) {
+        report("Always false condition due to 'false' && something");
+    }
+    
+    // Check for constant folding opportunities
+    if (node->left && node->right && 
+        node->left->type == ASTNodeType::Literal && 
+        node->right->type == ASTNodeType::Literal &&
+        (node->value == kPlus || node->value == kMinus || node->value == kTimes || node->value == kDivide)) {
+        report("Constant folding opportunity: " + std::string(node->left->value.str()) + " " +
+               std::string(node->value.str()) + " " + std::string(node->right->value.str()));
+    }
+}
+
+void CodeAnalyzer::report(const std::string& message) {
+    std::cout << "[Analyzer] " << message << std::endl;
 }
\ No newline at end of file
@@ -1,616 +1,827 @@
-#include "../include/CodeOptimizer.h"
-#include <iostream>
-#include <sstream>
-#include <cctype>
-#include <algorithm>
-#include <cmath>
-
-std::shared_ptr<ASTNode> CodeOptimizer::optimize(const std::shared_ptr<ASTNode>& root) {
-    if (!root) return nullptr;
-    
-    // Clear constant values for each optimization run
-    constantValues.clear();
-    
-    // Create a new node to avoid modifying the original
-    auto newNode = std::make_shared<ASTNode>(root->type, root->value);
-    
-    // First optimize children recursively
-    if (root->left) {
-        newNode->left = optimize(root->left);
-    }
-    if (root->right) {
-        newNode->right = optimize(root->right);
-    }
-    
-    // Optimize children vector
-    for (const auto& child : root->children) {
-        if (child) {
-            auto optimizedChild = optimize(child);
-            if (optimizedChild) {
-                newNode->children.push_back(optimizedChild);
-            }
-        }
-    }
-    
-    // Apply different optimizations in the correct order
-    auto optimizedNode = optimizeConstantFolding(newNode);
-    optimizedNode = optimizeRedundantConditions(optimizedNode);
-    optimizedNode = eliminateDeadCode(optimizedNode);
-    optimizedNode = optimizeLoops(optimizedNode);
-    
-    return optimizedNode;
-}
-
-std::shared_ptr<ASTNode> CodeOptimizer::optimizeLoops(const std::shared_ptr<ASTNode>& node) {
-    if (!node) return nullptr;
-    
-    // Optimize for loops with constant conditions
-    if (node->type == ASTNodeType::ForStatement && node->children.size() >= 2) {
-        auto condition = node->children[1]; // condition is at index 1
-        
-        // Check if condition is always false
-        if (condition && condition->type == ASTNodeType::Literal && condition->value == "false") {
-            std::cout << "[Optimizer] Eliminated for loop with false condition" << std::endl;
-            return nullptr; // Remove the entire loop
-        }
-        
-        // Check if condition is always true (infinite loop warning)
-        if (condition && condition->type == ASTNodeType::Literal && condition->value == "true") {
-            std::cout << "[Optimizer] Warning: For loop with always true condition (infinite loop)" << std::endl;
-        }
-    }
-    
-    // Optimize while loops with constant conditions
-    if (node->type == ASTNodeType::WhileStatement && node->left) {
-        auto condition = node->left;
-        
-        // Check if condition is always false
-        if (condition->type == ASTNodeType::Literal && condition->value == "false") {
-            std::cout << "[Optimizer] Eliminated while loop with false condition" << std::endl;
-            return nullptr; // Remove the entire loop
-        }
-        
-        // Check if condition is always true (infinite loop warning)
-        if (condition->type == ASTNodeType::Literal && condition->value == "true") {
-            std::cout << "[Optimizer] Warning: While loop with always true condition (infinite loop)" << std::endl;
-        }
-    }
-    
-    // Optimize do-while loops with constant conditions
-    if (node->type == ASTNodeType::DoWhileStatement && node->right) {
-        auto condition = node->right;
-        
-        // For do-while, the body executes at least once, but we can optimize the loop part
-        if (condition->type == ASTNodeType::Literal && condition->value == "false") {
-            std::cout << "[Optimizer] Simplified do-while loop with false condition to execute body once" << std::endl;
-            // Return just the body since it executes once and then exits
-            return node->left;
-        }
-        
-        // Check for infinite loop
-        if (condition->type == ASTNodeType::Literal && condition->value == "true") {
-            std::cout << "[Optimizer] Warning: Do-while loop with always true condition (infinite loop)" << std::endl;
-        }
-    }
-    
-    return node;
-}
-
-std::shared_ptr<ASTNode> CodeOptimizer::optimizeRedundantConditions(const std::shared_ptr<ASTNode>& node) {
-    if (!node) return nullptr;
-    
-    // Optimize x == x to true
-    if (node->type == ASTNodeType::BinaryOperation && node->value == "==" && 
-        node->left && node->right && 
-        node->left->type == ASTNodeType::Identifier && 
-        node->right->type == ASTNodeType::Identifier &&
-        node->left->value == node->right->value) {
-        std::cout << "[Optimizer] Optimized redundant equality check: " << node->left->value << " == " << node->right->value << " to true" << std::endl;
-        return std::make_shared<ASTNode>(ASTNodeType::Literal, "true");
-    }
-    
-    // Optimize constant == constant
-    if (node->type == ASTNodeType::BinaryOperation && node->value == "==" && 
-        node->left && node->right && 
-        node->left->type == ASTNodeType::Literal && 
-        node->right->type == ASTNodeType::Literal &&
-        node->left->value == node->right->value) {
-        std::cout << "[Optimizer] Optimized constant equality: " << node->left->value << " == " << node->right->value << " to true" << std::endl;
-        return std::make_shared<ASTNode>(ASTNodeType::Literal, "true");
-    }
-    
-    // Optimize true || x to true
-    if (node->type == ASTNodeType::BinaryOperation && node->value == "||" &&
-        ((node->left && node->left->value == "true") || 
-         (node->right && node->right->value == "true"))) {
-        std::cout << "[Optimizer] Optimized OR with true to always true" << std::endl;
-        return std::make_shared<ASTNode>(ASTNodeType::Literal, "true");
-    }
-    
-    // Optimize false && x to false
-    if (node->type == ASTNodeType::BinaryOperation && node->value == "&&" &&
-        ((node->left && node->left->value == "false") || 
-         (node->right && node->right->value == "false"))) {
-        std::cout << "[Optimizer] Optimized AND with false to always false" << std::endl;
-        return std::make_shared<ASTNode>(ASTNodeType::Literal, "false");
-    }
-    
-    // Optimize x || false to x
-    if (node->type == ASTNodeType::BinaryOperation && node->value == "||") {
-        if (node->left && node->left->value == "false" && node->right) {
-            std::cout << "[Optimizer] Optimized false || x to x" << std::endl;
-            return node->right;
-        }
-        if (node->right && node->right->value == "false" && node->left) {
-            std::cout << "[Optimizer] Optimized x || false to x" << std::endl;
-            return node->left;
-        }
-    }
-    
-    // Optimize x && true to x
-    if (node->type == ASTNodeType::BinaryOperation && node->value == "&&") {
-        if (node->left && node->left->value == "true" && node->right) {
-            std::cout << "[Optimizer] Optimized true && x to x" << std::endl;
-            return node->right;
-        }
-        if (node->right && node->right->value == "true" && node->left) {
-            std::cout << "[Optimizer] Optimized x && true to x" << std::endl;
-            return node->left;
-        }
-    }
-    
-    return node;
-}
-
-std::shared_ptr<ASTNode> CodeOptimizer::optimizeConstantFolding(const std::shared_ptr<ASTNode>& node) {
-    if (!node) return nullptr;
-    
-    // Handle function declarations - need to process their bodies for constant tracking
-    if (node->type == ASTNodeType::FunctionDeclaration && node->left && node->left->type == ASTNodeType::Block) {
-        // Process the function body to track constants
-        optimizeConstantFolding(node->left);
-        return node;
-    }
-    
-    // Handle blocks - process children and maintain constants across statements
-    if (node->type == ASTNodeType::Block) {
-        for (auto& child : node->children) {
-            if (child) {
-                child = optimizeConstantFolding(child);
-            }
-        }
-        return node;
-    }
-    
-    // Handle declarations with constant values
-    if (node->type == ASTNodeType::Declaration && 
-        node->left && node->left->type == ASTNodeType::Identifier &&
-        node->right && node->right->type == ASTNodeType::Literal) {
-        constantValues[node->left->value] = node->right->value;
-        std::cout << "[Optimizer] Saved constant value: " << node->left->value << " = " << node->right->value << std::endl;
-        return node;
-    }
-    
-    // Handle declarations with binary operations that can be folded
-    if (node->type == ASTNodeType::Declaration && 
-        node->left && node->left->type == ASTNodeType::Identifier &&
-        node->right && node->right->type == ASTNodeType::BinaryOperation) {
-        
-        // First replace variables in the binary operation with their known values
-        if (node->right->left && node->right->left->type == ASTNodeType::Identifier && 
-            constantValues.count(node->right->left->value)) {
-            std::cout << "[Optimizer] Replaced variable " << node->right->left->value << " with constant " << constantValues[node->right->left->value] << std::endl;
-            node->right->left = std::make_shared<ASTNode>(ASTNodeType::Literal, constantValues[node->right->left->value]);
-        }
-        
-        if (node->right->right && node->right->right->type == ASTNodeType::Identifier && 
-            constantValues.count(node->right->right->value)) {
-            std::cout << "[Optimizer] Replaced variable " << node->right->right->value << " with constant " << constantValues[node->right->right->value] << std::endl;
-            node->right->right = std::make_shared<ASTNode>(ASTNodeType::Literal, constantValues[node->right->right->value]);
-        }
-        
-        // Now try to fold the constants
-        auto optimizedRight = optimizeConstantFolding(node->right);
-        
-        // If the result is now a literal, save it as a constant
-        if (optimizedRight && optimizedRight->type == ASTNodeType::Literal) {
-            constantValues[node->left->value] = optimizedRight->value;
-            std::cout << "[Optimizer] Saved folded constant: " << node->left->value << " = " << optimizedRight->value << std::endl;
-            node->right = optimizedRight;
-        }
-        
-        return node;
-    }
-    
-    // Handle assignments with constant propagation
-    if (node->type == ASTNodeType::Assignment && 
-        node->left && node->left->type == ASTNodeType::Identifier &&
-        node->right) {
-        
-        // Replace variables in the right side with their known values
-        if (node->right->type == ASTNodeType::Identifier && 
-            constantValues.count(node->right->value)) {
-            std::cout << "[Optimizer] Replaced variable " << node->right->value << " with constant " << constantValues[node->right->value] << std::endl;
-            node->right = std::make_shared<ASTNode>(ASTNodeType::Literal, constantValues[node->right->value]);
-        }
-        
-        // If right side is a binary operation, try to optimize it
-        if (node->right->type == ASTNodeType::BinaryOperation) {
-            node->right = optimizeConstantFolding(node->right);
-        }
-        
-        // If the result is a literal, save it as a constant
-        if (node->right && node->right->type == ASTNodeType::Literal) {
-            constantValues[node->left->value] = node->right->value;
-            std::cout << "[Optimizer] Updated constant value: " << node->left->value << " = " << node->right->value << std::endl;
-        }
-        
-        return node;
-    }
-    
-    // Replace variables with known constants in binary operations
-    if (node->type == ASTNodeType::BinaryOperation) {
-        // Replace left operand if it's a known constant
-        if (node->left && node->left->type == ASTNodeType::Identifier && 
-            constantValues.count(node->left->value)) {
-            std::cout << "[Optimizer] Replaced variable " << node->left->value << " with constant " << constantValues[node->left->value] << std::endl;
-            node->left = std::make_shared<ASTNode>(ASTNodeType::Literal, constantValues[node->left->value]);
-        }
-        
-        // Replace right operand if it's a known constant
-        if (node->right && node->right->type == ASTNodeType::Identifier && 
-            constantValues.count(node->right->value)) {
-            std::cout << "[Optimizer] Replaced variable " << node->right->value << " with constant " << constantValues[node->right->value] << std::endl;
-            node->right = std::make_shared<ASTNode>(ASTNodeType::Literal, constantValues[node->right->value]);
-        }
-    }
-    
-    // Enhanced constant folding for complex expressions
-    if (node->type == ASTNodeType::BinaryOperation && 
-        node->left && node->right) {
-        
-        // Handle nested binary operations (like 5 * 10 + 20 / 4)
-        auto leftResult = evaluateConstantExpression(node->left);
-        auto rightResult = evaluateConstantExpression(node->right);
-        
-        if (leftResult.first && rightResult.first) {
-            double result = 0;
-            bool canOptimize = true;
-            
-            if (node->value == "+") {
-                result = leftResult.second + rightResult.second;
-            } else if (node->value == "-") {
-                result = leftResult.second - rightResult.second;
-            } else if (node->value == "*") {
-                result = leftResult.second * rightResult.second;
-            } else if (node->value == "/" && rightResult.second != 0) {
-                result = leftResult.second / rightResult.second;
-            } else {
-                canOptimize = false;
-            }
-            
-            if (canOptimize) {
-                std::cout << "[Optimizer] Folded constant expression: " 
-                         << leftResult.second << " " << node->value << " " 
-                         << rightResult.second << " = " << result << std::endl;
-                
-                // Convert back to integer if result is a whole number
-                int intResult = static_cast<int>(result);
-                if (std::abs(result - intResult) < 1e-9) {
-                    return std::make_shared<ASTNode>(ASTNodeType::Literal, std::to_string(intResult));
-                } else {
-                    return std::make_shared<ASTNode>(ASTNodeType::Literal, std::to_string(result));
-                }
-            }
-        }
-    }
-    
-    return node;
-}
-
-// Helper function to evaluate constant expressions recursively
-std::pair<bool, double> CodeOptimizer::evaluateConstantExpression(const std::shared_ptr<ASTNode>& node) {
-    if (!node) return {false, 0.0};
-    
-    if (node->type == ASTNodeType::Literal) {
-        try {
-            double val = std::stod(node->value);
-            return {true, val};
-        } catch (...) {
-            return {false, 0.0};
-        }
-    }
-    
-    // Handle identifiers that are known constants
-    if (node->type == ASTNodeType::Identifier && constantValues.count(node->value)) {
-        try {
-            double val = std::stod(constantValues[node->value]);
-            return {true, val};
-        } catch (...) {
-            return {false, 0.0};
-        }
-    }
-    
-    if (node->type == ASTNodeType::BinaryOperation && node->left && node->right) {
-        auto leftResult = evaluateConstantExpression(node->left);
-        auto rightResult = evaluateConstantExpression(node->right);
-        
-        if (leftResult.first && rightResult.first) {
-            if (node->value == "+") {
-                return {true, leftResult.second + rightResult.second};
-            } else if (node->value == "-") {
-                return {true, leftResult.second - rightResult.second};
-            } else if (node->value == "*") {
-                return {true, leftResult.second * rightResult.second};
-            } else if (node->value == "/" && rightResult.second != 0) {
-                return {true, leftResult.second / rightResult.second};
-            }
-        }
-    }
-    
-    return {false, 0.0};
-}
-
-std::shared_ptr<ASTNode> CodeOptimizer::eliminateDeadCode(const std::shared_ptr<ASTNode>& node) {
-    if (!node) return nullptr;
-    
-    // Eliminate if statements with false conditions
-    if (node->type == ASTNodeType::IfStatement && 
-        node->left && node->left->type == ASTNodeType::Literal && 
-        node->left->value == "false") {
-        std::cout << "[Optimizer] Eliminated dead code: if (false) block" << std::endl;
-        return nullptr; // Remove the entire if statement
-    }
-    
-    // Convert if (true) statements to just execute the body directly
-    if (node->type == ASTNodeType::IfStatement && 
-        node->left && node->left->type == ASTNodeType::Literal && 
-        node->left->value == "true") {
-        std::cout << "[Optimizer] Simplified if (true) to just the body" << std::endl;
-        
-        // Return the body content directly
-        return node->right;
-    }
-    
-    return node;
-}
-
-std::string CodeOptimizer::generateCode(const std::shared_ptr<ASTNode>& root) {
-    std::ostringstream code;
-    code << "// Optimized C++ code\n";
-    generateCodeForNode(root, code, 0);
-    return code.str();
-}
-
-void CodeOptimizer::generateCodeForNode(const std::shared_ptr<ASTNode>& node, std::ostringstream& code, int indent) {
-    if (!node) return;
-    
-    std::string indentStr(indent, ' ');
-    
-    switch (node->type) {
-        case ASTNodeType::Program:
-            for (const auto& child : node->children) {
-                generateCodeForNode(child, code, indent);
-            }
-            break;
-            
-        case ASTNodeType::Preprocessor:
-            code << node->value << "\n\n";
-            break;
-            
-        case ASTNodeType::FunctionDeclaration:
-            code << indentStr << "int " << node->value << "() ";
-            if (node->left) {
-                generateCodeForNode(node->left, code, indent);
-            }
-            code << "\n";
-            break;
-            
-        case ASTNodeType::Block:
-            code << "{\n";
-            for (const auto& child : node->children) {
-                generateCodeForNode(child, code, indent + 4);
-            }
-            code << indentStr << "}\n";
-            break;
-            
-        case ASTNodeType::Declaration:
-            code << indentStr << node->value << " ";
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            if (node->right) {
-                code << " = ";
-                generateCodeForNode(node->right, code, 0);
-            }
-            code << ";\n";
-            break;
-            
-        case ASTNodeType::Assignment:
-            code << indentStr;
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            code << " = ";
-            if (node->right) {
-                generateCodeForNode(node->right, code, 0);
-            }
-            code << ";\n";
-            break;
-            
-        case ASTNodeType::IfStatement:
-            code << indentStr << "if (";
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            code << ") ";
-            if (node->right) {
-                generateCodeForNode(node->right, code, indent);
-            }
-            break;
-            
-        case ASTNodeType::ForStatement:
-            code << indentStr << "for (";
-            // Generate initialization (index 0)
-            if (node->children.size() > 0 && node->children[0]) {
-                // For init statements, don't include indentation or newlines
-                std::ostringstream initCode;
-                generateCodeForNode(node->children[0], initCode, 0);
-                std::string initStr = initCode.str();
-                // Remove trailing newline and semicolon for inline generation
-                if (!initStr.empty() && initStr.back() == '\n') {
-                    initStr.pop_back();
-                }
-                if (!initStr.empty() && initStr.back() == ';') {
-                    initStr.pop_back();
-                }
-                // Remove leading whitespace for inline generation
-                size_t firstNonSpace = initStr.find_first_not_of(" \t");
-                if (firstNonSpace != std::string::npos) {
-                    initStr = initStr.substr(firstNonSpace);
-                }
-                code << initStr;
-            }
-            code << "; ";
-            
-            // Generate condition (index 1)
-            if (node->children.size() > 1 && node->children[1]) {
-                generateCodeForNode(node->children[1], code, 0);
-            }
-            code << "; ";
-            
-            // Generate increment (index 2)
-            if (node->children.size() > 2 && node->children[2]) {
-                generateCodeForNode(node->children[2], code, 0);
-            }
-            code << ") ";
-            
-            // Generate body (index 3)
-            if (node->children.size() > 3 && node->children[3]) {
-                generateCodeForNode(node->children[3], code, indent);
-            }
-            break;
-            
-        case ASTNodeType::WhileStatement:
-            code << indentStr << "while (";
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            code << ") ";
-            if (node->right) {
-                generateCodeForNode(node->right, code, indent);
-            }
-            break;
-            
-        case ASTNodeType::DoWhileStatement:
-            code << indentStr << "do ";
-            if (node->left) {
-                generateCodeForNode(node->left, code, indent);
-            }
-            code << indentStr << "while (";
-            if (node->right) {
-                generateCodeForNode(node->right, code, 0);
-            }
-            code << ");\n";
-            break;
-            
-        case ASTNodeType::PreIncrement:
-            code << node->value;
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            break;
-            
-        case ASTNodeType::PostIncrement:
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            code << node->value;
-            break;
-            
-        case ASTNodeType::CompoundAssignment:
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            code << " " << node->value << " ";
-            if (node->right) {
-                generateCodeForNode(node->right, code, 0);
-            }
-            break;
-            
-        case ASTNodeType::PrintStatement:
-            // Handle cout statements
-            code << indentStr << "std::cout";
-            for (size_t i = 0; i < node->children.size(); ++i) {
-                code << " << ";
-                const auto& child = node->children[i];
-                if (child->type == ASTNodeType::Literal) {
-                    // Check if it's std::endl
-                    if (child->value == "std::endl") {
-                        code << "std::endl";
-                    } else {
-                        // Regular string literal - preserve quotes if they exist
-                        std::string cleanValue = child->value;
-                        // Remove trailing spaces
-                        while (!cleanValue.empty() && cleanValue.back() == ' ') {
-                            cleanValue.pop_back();
-                        }
-                        code << cleanValue;
-                    }
-                } else {
-                    generateCodeForNode(child, code, 0);
-                }
-            }
-            code << ";\n";
-            break;
-
-        case ASTNodeType::InputStatement:
-            // Handle cin statements
-            code << indentStr << "std::cin";
-            for (size_t i = 0; i < node->children.size(); ++i) {
-                code << " >> ";
-                const auto& child = node->children[i];
-                generateCodeForNode(child, code, 0);
-            }
-            code << ";\n";
-            break;
-            
-        case ASTNodeType::ReturnStatement:
-            code << indentStr << "return";
-            if (node->left) {
-                code << " ";
-                generateCodeForNode(node->left, code, 0);
-            }
-            code << ";\n";
-            break;
-            
-        case ASTNodeType::ExpressionStatement:
-            code << indentStr;
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            code << ";\n";
-            break;
-            
-        case ASTNodeType::BinaryOperation:
-            if (node->left) {
-                generateCodeForNode(node->left, code, 0);
-            }
-            code << " " << node->value << " ";
-            if (node->right) {
-                generateCodeForNode(node->right, code, 0);
-            }
-            break;
-            
-        case ASTNodeType::Literal:
-            code << node->value;
-            break;
-            
-        case ASTNodeType::Identifier:
-            code << node->value;
-            break;
-            
-        default:
-            break;
-    }
-}
\ No newline at end of file
+#include "../include/CodeOptimizer.h"
+#include <iostream>
+#include <sstream>
+#include <cctype>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+namespace {
+
+const Symbol kInt("int");
+const Symbol kFloat("float");
+const Symbol kTrue("true");
+const Symbol kFalse("false");
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kTimes("*");
+const Symbol kDivide("/");
+const Symbol kModulo("%");
+const Symbol kShiftLeft("<<");
+const Symbol kShiftRight(">>");
+const Symbol kBitAnd("&");
+const Symbol kEqual("==");
+const Symbol kNotEqual("!=");
+const Symbol kLess("<");
+const Symbol kGreater(">");
+const Symbol kLessEqual("<=");
+const Symbol kGreaterEqual(">=");
+const Symbol kAnd("&&");
+const Symbol kOr("||");
+const Symbol kNot("!");
+const Symbol kSimdFor("simd for");
+
+// How tightly C++ binds each binary operator, loosest first. The parser
+// puts && with || and relational with equality operators, so a tree
+// from it can need parentheses C++ would not.
+int precedenceInCpp(Symbol op) {
+    static const std::pair<Symbol, int> levels[] = {
+        {Symbol("||"), 1}, {Symbol("&&"), 2}, {Symbol("&"), 3},
+        {Symbol("=="), 4}, {Symbol("!="), 4},
+        {Symbol("<"), 5}, {Symbol(">"), 5}, {Symbol("<="), 5}, {Symbol(">="), 5},
+        {Symbol("<<"), 6}, {Symbol(">>"), 6},
+        {Symbol("+"), 7}, {Symbol("-"), 7},
+        {Symbol("*"), 8}, {Symbol("/"), 8}, {Symbol("%"), 8},
+    };
+    for (const auto& level : levels) {
+        if (level.first == op) return level.second;
+    }
+    return 0;
+}
+
+// The operand of << in a cout chain binds like a shift's right operand
+constexpr int kStreamOperand = 7;
+// A prefix operator binds tighter than any binary one
+constexpr int kUnaryOperand = 9;
+
+} // namespace
+
+CodeOptimizer::CodeOptimizer(ASTArena& arena)
+    : arena(arena), inliner(arena), constantPropagation(arena), valueNumbering(arena), loopFusion(arena),
+      loopInvariantMotion(arena), peephole(arena), strengthReduction(arena, costs), vectorizer(arena), loopUnrolling(arena),
+      deadStores(arena, [this](ASTNode* node) {
+          if (!node) return size_t(0);
+          std::ostringstream code;
+          generateCodeForNode(node, code, 0);
+          return static_cast<size_t>(code.tellp());
+      }),
+      constants(4096) {
+    // Inlining first, so that every pass after it sees through the calls
+    passManager.addPass("inlining", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return inliner.run(root, analyses, rewrites);
+    });
+    // Propagation and folding first expose literal conditions to the passes after them
+    passManager.addPass("constant-propagation", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return constantPropagation.run(root, analyses, rewrites);
+    });
+    passManager.addPass("constant-folding", [this](ASTNode* root, AnalysisCache&, size_t& rewrites) {
+        return rewriteBottomUp(root, &CodeOptimizer::optimizeConstantFolding, rewrites);
+    });
+    passManager.addPass("value-numbering", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return valueNumbering.run(root, analyses, rewrites);
+    });
+    passManager.addPass("peephole", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return peephole.run(root, analyses, rewrites);
+    });
+    passManager.addPass("dead-code", [this](ASTNode* root, AnalysisCache&, size_t& rewrites) {
+        return rewriteBottomUp(root, &CodeOptimizer::eliminateDeadCode, rewrites);
+    });
+    passManager.addPass("loops", [this](ASTNode* root, AnalysisCache&, size_t& rewrites) {
+        return rewriteBottomUp(root, &CodeOptimizer::optimizeLoops, rewrites);
+    });
+    // Before motion, which puts the temporaries it hoists between loops
+    passManager.addPass("loop-fusion", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return loopFusion.run(root, analyses, rewrites);
+    });
+    passManager.addPass("loop-invariant-motion", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return loopInvariantMotion.run(root, analyses, rewrites);
+    });
+    // Before strength reduction, whose induction variables carry values from
+    // one iteration to the next, and unrolling, which takes loops apart
+    passManager.addPass("vectorization", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return vectorizer.run(root, analyses, rewrites);
+    });
+    passManager.addPass("strength-reduction", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return strengthReduction.run(root, analyses, rewrites);
+    });
+    // After motion, so that invariant code is not copied into every unrolled body
+    passManager.addPass("loop-unrolling", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return loopUnrolling.run(root, analyses, rewrites);
+    });
+    // Last, so that stores only removed code read are found dead
+    passManager.addPass("dead-stores", [this](ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+        return deadStores.run(root, analyses, rewrites);
+    });
+}
+
+ASTNode* CodeOptimizer::optimize(ASTNode* root) {
+    if (!root) return nullptr;
+    
+    // Passes never modify the original tree: a node is copied only on the
+    // path to a rewrite, and everything else is shared with the original
+    auto optimizedNode = passManager.run(root);
+    passManager.report(std::cout, "[Optimizer] ");
+    
+    return optimizedNode;
+}
+
+ASTNode* CodeOptimizer::rewriteBottomUp(ASTNode* node, Rule rule, size_t& rewrites) {
+    if (!node) return nullptr;
+    
+    // Copied on the first change below this node
+    ASTNode* copy = nullptr;
+    auto own = [&]() {
+        if (!copy) copy = node->shallowCopy(arena);
+        return copy;
+    };
+    
+    auto left = rewriteBottomUp(node->left, rule, rewrites);
+    if (left != node->left) own()->left = left;
+    auto right = rewriteBottomUp(node->right, rule, rewrites);
+    if (right != node->right) own()->right = right;
+    
+    // Statement lists drop removed statements; other nodes keep every
+    // child in its slot (a for loop's children are init, condition,
+    // increment and body)
+    const bool isList = node->type == ASTNodeType::Program || node->type == ASTNodeType::Block;
+    size_t kept = 0;
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        auto child = rewriteBottomUp(node->children[i], rule, rewrites);
+        if (child != node->children[i]) own();
+        if (!copy) {
+            ++kept;
+        } else if (child || !isList) {
+            copy->children[kept++] = child;
+        }
+    }
+    if (copy) copy->children.resize(kept);
+    
+    auto current = copy ? copy : node;
+    auto rewritten = (this->*rule)(current);
+    if (rewritten != current) {
+        ++rewrites;
+    }
+    return rewritten;
+}
+
+ASTNode* CodeOptimizer::optimizeLoops(ASTNode* node) {
+    if (!node) return nullptr;
+    
+    // Optimize for loops with constant conditions
+    if (node->type == ASTNodeType::ForStatement && node->children.size() >= 2) {
+        auto condition = node->children[1]; // condition is at index 1
+        
+        // Check if condition is always false
+        if (condition && condition->type == ASTNodeType::Literal && condition->value == "false") {
+            std::cout << "[Optimizer] Eliminated for loop with false condition" << std::endl;
+            // The initializer still runs once; only a declaration dies with the loop
+            auto init = node->children[0];
+            if (init && init->type != ASTNodeType::Declaration) return init;
+            return nullptr; // Remove the entire loop
+        }
+        
+        // Check if condition is always true (infinite loop warning)
+        if (condition && condition->type == ASTNodeType::Literal && condition->value == "true") {
+            std::cout << "[Optimizer] Warning: For loop with always true condition (infinite loop)" << std::endl;
+        }
+    }
+    
+    // Optimize while loops with constant conditions
+    if (node->type == ASTNodeType::WhileStatement && node->left) {
+        auto condition = node->left;
+        
+        // Check if condition is always false
+        if (condition->type == ASTNodeType::Literal && condition->value == "false") {
+            std::cout << "[Optimizer] Eliminated while loop with false condition" << std::endl;
+            return nullptr; // Remove the entire loop
+        }
+        
+        // Check if condition is always true (infinite loop warning)
+        if (condition->type == ASTNodeType::Literal && condition->value == "true") {
+            std::cout << "[Optimizer] Warning: While loop with always true condition (infinite loop)" << std::endl;
+        }
+    }
+    
+    // Optimize do-while loops with constant conditions
+    if (node->type == ASTNodeType::DoWhileStatement && node->right) {
+        auto condition = node->right;
+        
+        // For do-while, the body executes at least once, but we can optimize the loop part
+        if (condition->type == ASTNodeType::Literal && condition->value == "false") {
+            std::cout << "[Optimizer] Simplified do-while loop with false condition to execute body once" << std::endl;
+            // Return just the body since it executes once and then exits
+            return node->left;
+        }
+        
+        // Check for infinite loop
+        if (condition->type == ASTNodeType::Literal && condition->value == "true") {
+            std::cout << "[Optimizer] Warning: Do-while loop with always true condition (infinite loop)" << std::endl;
+        }
+    }
+    
+    return node;
+}
+
+// Folds operations on literals, and converts a literal initializer to
+// the type it is declared with. Constants in variables are propagated
+// by the constant-propagation pass.
+ASTNode* CodeOptimizer::optimizeConstantFolding(ASTNode* node) {
+    if (node->type == ASTNodeType::Declaration) {
+        if (!node->right || node->right->type != ASTNodeType::Literal) return node;
+        const std::string converted = convertedSpelling(node->value, evaluateConstantExpression(node->right));
+        if (converted.empty() || converted == node->right->value.str()) return node;
+        std::cout << "[Optimizer] Converted the initializer of " << (node->left ? node->left->value : Symbol())
+                  << " to " << node->value << ": " << node->right->value << " is " << converted << std::endl;
+        auto copy = node->shallowCopy(arena);
+        copy->right = makeNode(ASTNodeType::Literal, converted);
+        return copy;
+    }
+    const bool unary = node->type == ASTNodeType::UnaryOperation;
+    if (!(unary || node->type == ASTNodeType::BinaryOperation) || !node->left || (!unary && !node->right)) {
+        return node;
+    }
+    
+    // Operands are folded already, so nested expressions such as
+    // 5 * 10 + 20 / 4 fold from the bottom up
+    const Constant value = evaluateConstantExpression(node);
+    if (value.type == ValueType::Unknown) return node;
+    const std::string spelling = spellingOf(value);
+    if (spelling.empty()) return node;
+    // Merging the sign of -5 into the literal is not worth a line of its own
+    if (unary && node->left->type == ASTNodeType::Literal && node->value == kMinus &&
+        spelling == "-" + std::string(node->left->value.str())) {
+        return makeNode(ASTNodeType::Literal, spelling);
+    }
+    
+    auto operand = [](const ASTNode* side) {
+        return side->type == ASTNodeType::Literal ? std::string(side->value.str()) : std::string("(...)");
+    };
+    if (unary) {
+        std::cout << "[Optimizer] Folded constant expression: " << node->value << operand(node->left) << " = "
+                  << spelling << std::endl;
+    } else {
+        std::cout << "[Optimizer] Folded constant expression: " << operand(node->left) << " " << node->value << " "
+                  << operand(node->right) << " = " << spelling << std::endl;
+    }
+    return makeNode(ASTNodeType::Literal, spelling);
+}
+
+// Evaluates an expression of literals as C++ would: int arithmetic is
+// exact, double arithmetic is done in double, and comparisons and logical
+// operators give a bool. Variables never count as constant here;
+// propagation has replaced the known ones. Operations are folded children
+// first, so a parent finds its operands' values in the cache.
+CodeOptimizer::Constant CodeOptimizer::evaluateConstantExpression(const ASTNode* node) {
+    if (!node) return Constant();
+    if (node->type == ASTNodeType::Literal) return literalConstant(node->value);
+    if (node->type == ASTNodeType::UnaryOperation) {
+        return applyUnaryOperator(node->value, evaluateConstantExpression(node->left));
+    }
+    if (node->type != ASTNodeType::BinaryOperation) return Constant();
+    CachedConstant& cached = constants[(reinterpret_cast<uintptr_t>(node) / alignof(ASTNode)) % constants.size()];
+    if (cached.node == node) return cached.value;
+    
+    Constant value;
+    if (node->left && node->right) {
+        const Constant left = evaluateConstantExpression(node->left);
+        const bool logical = node->value == kAnd || node->value == kOr;
+        // && and || stop at a left operand that decides them, like C++
+        if (logical && left.type != ValueType::Unknown && truthOf(left) == (node->value == kOr)) {
+            value = Constant{ValueType::Bool, node->value == kOr, 0};
+        } else {
+            value = applyOperator(node->value, left, evaluateConstantExpression(node->right));
+        }
+    }
+    cached = CachedConstant{node, value};
+    return value;
+}
+
+CodeOptimizer::Constant CodeOptimizer::literalConstant(Symbol text) {
+    if (text == kTrue) return Constant{ValueType::Bool, 1, 0};
+    if (text == kFalse) return Constant{ValueType::Bool, 0, 0};
+    
+    int64_t integer;
+    switch (literalType(text)) {
+        case ValueType::Int:
+            // Too large for an int, it would be a long
+            return intLiteralValue(text, integer) ? Constant{ValueType::Int, integer, 0} : Constant();
+        case ValueType::Double: {
+            const std::string spelling(text.str());
+            char* end = nullptr;
+            const double real = std::strtod(spelling.c_str(), &end);
+            if (*end != '\0' || !std::isfinite(real)) return Constant();
+            return Constant{ValueType::Double, 0, real};
+        }
+        default:
+            return Constant(); // strings and characters
+    }
+}
+
+bool CodeOptimizer::truthOf(const Constant& value) {
+    return value.type == ValueType::Double ? value.real != 0 : value.integer != 0;
+}
+
+// `left op right` with C++'s conversions: a bool operand counts as an int,
+// and an int as a double next to a double. Operations that overflow an
+// int, divide by zero or leave the finite doubles are not folded.
+CodeOptimizer::Constant CodeOptimizer::applyOperator(Symbol op, const Constant& left, const Constant& right) {
+    if (left.type == ValueType::Unknown || right.type == ValueType::Unknown) return Constant();
+    auto boolean = [](bool value) { return Constant{ValueType::Bool, value, 0}; };
+    
+    if (op == kAnd) return boolean(truthOf(left) && truthOf(right));
+    if (op == kOr) return boolean(truthOf(left) || truthOf(right));
+    
+    if (left.type == ValueType::Double || right.type == ValueType::Double) {
+        const double a = left.type == ValueType::Double ? left.real : static_cast<double>(left.integer);
+        const double b = right.type == ValueType::Double ? right.real : static_cast<double>(right.integer);
+        if (op == kLess) return boolean(a < b);
+        if (op == kGreater) return boolean(a > b);
+        if (op == kLessEqual) return boolean(a <= b);
+        if (op == kGreaterEqual) return boolean(a >= b);
+        if (op == kEqual) return boolean(a == b);
+        if (op == kNotEqual) return boolean(a != b);
+        
+        double result;
+        if (op == kPlus) {
+            result = a + b;
+        } else if (op == kMinus) {
+            result = a - b;
+        } else if (op == kTimes) {
+            result = a * b;
+        } else if (op == kDivide && b != 0) {
+            result = a / b;
+        } else {
+            return Constant(); // %, shifts and & do not apply to doubles
+        }
+        return std::isfinite(result) ? Constant{ValueType::Double, 0, result} : Constant();
+    }
+    
+    const int64_t a = left.integer;
+    const int64_t b = right.integer;
+    if (op == kLess) return boolean(a < b);
+    if (op == kGreater) return boolean(a > b);
+    if (op == kLessEqual) return boolean(a <= b);
+    if (op == kGreaterEqual) return boolean(a >= b);
+    if (op == kEqual) return boolean(a == b);
+    if (op == kNotEqual) return boolean(a != b);
+    
+    int64_t result;
+    if (op == kPlus) {
+        result = a + b;
+    } else if (op == kMinus) {
+        result = a - b;
+    } else if (op == kTimes) {
+        result = a * b;
+    } else if ((op == kDivide || op == kModulo) && b != 0) {
+        // INT_MIN / -1 overflows, and so does INT_MIN % -1
+        if (a / b > std::numeric_limits<int32_t>::max()) return Constant();
+        result = op == kDivide ? a / b : a % b;
+    } else if ((op == kShiftLeft || op == kShiftRight) && b >= 0 && b < 32) {
+        result = op == kShiftLeft ? a * (int64_t(1) << b) : a >> b;
+    } else if (op == kBitAnd) {
+        result = a & b;
+    } else {
+        return Constant();
+    }
+    if (result < std::numeric_limits<int32_t>::min() || result > std::numeric_limits<int32_t>::max()) {
+        return Constant();
+    }
+    return Constant{ValueType::Int, result, 0};
+}
+
+// !operand is a bool; -operand promotes a bool to an int, and is not
+// folded for INT_MIN, which it overflows
+CodeOptimizer::Constant CodeOptimizer::applyUnaryOperator(Symbol op, const Constant& operand) {
+    if (operand.type == ValueType::Unknown) return Constant();
+    if (op == kNot) return Constant{ValueType::Bool, !truthOf(operand), 0};
+    if (op != kMinus) return Constant();
+    if (operand.type == ValueType::Double) return Constant{ValueType::Double, 0, -operand.real};
+    if (operand.integer == std::numeric_limits<int32_t>::min()) return Constant();
+    return Constant{ValueType::Int, -operand.integer, 0};
+}
+
+// Literal text for a value; empty if it has none the lexer reads back
+std::string CodeOptimizer::spellingOf(const Constant& value) {
+    switch (value.type) {
+        case ValueType::Bool:
+            return value.integer ? "true" : "false";
+        case ValueType::Int:
+            return std::to_string(value.integer);
+        case ValueType::Double:
+            return shortestSpelling(value.real, false);
+        default:
+            return std::string();
+    }
+}
+
+// The initializer a literal of `value` becomes in a variable declared
+// `type`, spelled as that type holds it; empty if it stays as written
+std::string CodeOptimizer::convertedSpelling(Symbol type, const Constant& value) {
+    if (type == kInt) {
+        if (value.type == ValueType::Bool) return std::to_string(value.integer);
+        // Doubles convert toward zero; out of range, the conversion is undefined
+        if (value.type == ValueType::Double && value.real > std::numeric_limits<int32_t>::min() - 1.0 &&
+            value.real < std::numeric_limits<int32_t>::max() + 1.0) {
+            return std::to_string(static_cast<int64_t>(value.real));
+        }
+    } else if (type == kFloat && value.type == ValueType::Double &&
+               std::fabs(value.real) <= std::numeric_limits<float>::max()) {
+        return shortestSpelling(static_cast<float>(value.real), true);
+    }
+    return std::string();
+}
+
+// The shortest decimal that reads back as `value`, or as the same float
+// with `asFloat`, with a point so it stays a floating literal. Values
+// that need an exponent are left alone: the lexer reads digits and points.
+std::string CodeOptimizer::shortestSpelling(double value, bool asFloat) {
+    char text[32];
+    for (int digits = 1; digits <= 17; ++digits) {
+        std::snprintf(text, sizeof(text), "%.*g", digits, value);
+        const double back = std::strtod(text, nullptr);
+        if (asFloat ? static_cast<float>(back) == static_cast<float>(value) : back == value) break;
+    }
+    std::string spelling(text);
+    if (spelling.find_first_of("eEni") != std::string::npos) return std::string();
+    if (spelling.find('.') == std::string::npos) spelling += ".0";
+    return spelling;
+}
+
+ASTNode* CodeOptimizer::eliminateDeadCode(ASTNode* node) {
+    if (!node) return nullptr;
+    
+    // Eliminate if statements with false conditions
+    if (node->type == ASTNodeType::IfStatement && 
+        node->left && node->left->type == ASTNodeType::Literal && 
+        node->left->value == "false") {
+        std::cout << "[Optimizer] Eliminated dead code: if (false) block" << std::endl;
+        return nullptr; // Remove the entire if statement
+    }
+    
+    // Convert if (true) statements to just execute the body directly
+    if (node->type == ASTNodeType::IfStatement && 
+        node->left && node->left->type == ASTNodeType::Literal && 
+        node->left->value == "true") {
+        std::cout << "[Optimizer] Simplified if (true) to just the body" << std::endl;
+        
+        // Return the body content directly
+        return node->right;
+    }
+    
+    return node;
+}
+
+namespace {
+
+// Stream buffer that appends straight into a std::string, so the generated
+// code is not copied out of an ostringstream once emission is done
+class StringAppendBuffer : public std::streambuf {
+public:
+    explicit StringAppendBuffer(std::string& out) : out(out) {}
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            out.push_back(traits_type::to_char_type(ch));
+        }
+        return ch;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        out.append(s, static_cast<size_t>(n));
+        return n;
+    }
+
+private:
+    std::string& out;
+};
+
+} // namespace
+
+std::string CodeOptimizer::generateCode(ASTNode* root) {
+    std::string result;
+    StringAppendBuffer buffer(result);
+    std::ostream code(&buffer);
+    code << "// Optimized C++ code\n";
+    generateCodeForNode(root, code, 0);
+    return result;
+}
+
+void CodeOptimizer::generateCodeForNode(ASTNode* node, std::ostream& code, int indent) {
+    if (!node) return;
+    
+    std::string indentStr(indent, ' ');
+    
+    switch (node->type) {
+        case ASTNodeType::Program:
+            for (const auto& child : node->children) {
+                generateCodeForNode(child, code, indent);
+            }
+            break;
+            
+        case ASTNodeType::Preprocessor:
+            code << node->value << "\n\n";
+            break;
+            
+        case ASTNodeType::FunctionDeclaration:
+            code << indentStr << (node->right ? node->right->value : kInt) << " " << node->value << "(";
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                const ASTNode* parameter = node->children[i];
+                code << (i ? ", " : "") << parameter->value << " " << parameter->left->value;
+            }
+            code << ")";
+            if (node->left) {
+                code << " ";
+                generateCodeForNode(node->left, code, indent);
+            } else {
+                code << ";\n";
+            }
+            code << "\n";
+            break;
+            
+        case ASTNodeType::Block:
+            code << "{\n";
+            for (const auto& child : node->children) {
+                // A nested scope opens on a line of its own
+                if (child && child->type == ASTNodeType::Block) code << indentStr << "    ";
+                generateCodeForNode(child, code, indent + 4);
+            }
+            code << indentStr << "}\n";
+            break;
+            
+        case ASTNodeType::ArrayDeclaration:
+            code << indentStr << node->value << " ";
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << "[";
+            if (node->right) {
+                generateCodeForNode(node->right, code, 0);
+            }
+            code << "]";
+            if (!node->children.empty()) {
+                code << " = {";
+                for (size_t i = 0; i < node->children.size(); ++i) {
+                    if (i) code << ", ";
+                    generateCodeForNode(node->children[i], code, 0);
+                }
+                code << "}";
+            }
+            code << ";\n";
+            break;
+            
+        case ASTNodeType::Declaration:
+            code << indentStr << node->value << " ";
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            if (node->right) {
+                code << " = ";
+                generateCodeForNode(node->right, code, 0);
+            }
+            code << ";\n";
+            break;
+            
+        case ASTNodeType::Assignment:
+            code << indentStr;
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << " = ";
+            if (node->right) {
+                generateCodeForNode(node->right, code, 0);
+            }
+            code << ";\n";
+            break;
+            
+        case ASTNodeType::IfStatement:
+            code << indentStr << "if (";
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << ") ";
+            if (node->right) {
+                generateCodeForNode(node->right, code, indent);
+            }
+            break;
+            
+        case ASTNodeType::ForStatement:
+            if (node->value == kSimdFor) {
+                code << indentStr << "#pragma omp simd\n";
+            }
+            code << indentStr << "for (";
+            // Generate initialization (index 0)
+            if (node->children.size() > 0 && node->children[0]) {
+                // For init statements, don't include indentation or newlines
+                std::ostringstream initCode;
+                generateCodeForNode(node->children[0], initCode, 0);
+                std::string initStr = initCode.str();
+                // Remove trailing newline and semicolon for inline generation
+                if (!initStr.empty() && initStr.back() == '\n') {
+                    initStr.pop_back();
+                }
+                if (!initStr.empty() && initStr.back() == ';') {
+                    initStr.pop_back();
+                }
+                // Remove leading whitespace for inline generation
+                size_t firstNonSpace = initStr.find_first_not_of(" \t");
+                if (firstNonSpace != std::string::npos) {
+                    initStr = initStr.substr(firstNonSpace);
+                }
+                code << initStr;
+            }
+            code << "; ";
+            
+            // Generate condition (index 1)
+            if (node->children.size() > 1 && node->children[1]) {
+                generateCodeForNode(node->children[1], code, 0);
+            }
+            code << "; ";
+            
+            // Generate increment (index 2)
+            if (node->children.size() > 2 && node->children[2]) {
+                generateCodeForNode(node->children[2], code, 0);
+            }
+            code << ") ";
+            
+            // Generate body (index 3)
+            if (node->children.size() > 3 && node->children[3]) {
+                generateCodeForNode(node->children[3], code, indent);
+            }
+            break;
+            
+        case ASTNodeType::WhileStatement:
+            code << indentStr << "while (";
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << ") ";
+            if (node->right) {
+                generateCodeForNode(node->right, code, indent);
+            }
+            break;
+            
+        case ASTNodeType::DoWhileStatement:
+            code << indentStr << "do ";
+            if (node->left) {
+                generateCodeForNode(node->left, code, indent);
+            }
+            code << indentStr << "while (";
+            if (node->right) {
+                generateCodeForNode(node->right, code, 0);
+            }
+            code << ");\n";
+            break;
+            
+        case ASTNodeType::PreIncrement:
+            code << node->value;
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            break;
+            
+        case ASTNodeType::PostIncrement:
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << node->value;
+            break;
+            
+        case ASTNodeType::CompoundAssignment:
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << " " << node->value << " ";
+            if (node->right) {
+                generateCodeForNode(node->right, code, 0);
+            }
+            break;
+            
+        case ASTNodeType::PrintStatement:
+            // Handle cout statements
+            code << indentStr << "std::cout";
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                code << " << ";
+                const auto& child = node->children[i];
+                if (child->type == ASTNodeType::Literal) {
+                    // Check if it's std::endl
+                    if (child->value == "std::endl") {
+                        code << "std::endl";
+                    } else {
+                        // Regular string literal - preserve quotes if they exist
+                        std::string_view cleanValue = child->value.str();
+                        // Remove trailing spaces
+                        while (!cleanValue.empty() && cleanValue.back() == ' ') {
+                            cleanValue.remove_suffix(1);
+                        }
+                        code << cleanValue;
+                    }
+                } else {
+                    generateOperand(child, code, kStreamOperand);
+                }
+            }
+            code << ";\n";
+            break;
+
+        case ASTNodeType::InputStatement:
+            // Handle cin statements
+            code << indentStr << "std::cin";
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                code << " >> ";
+                const auto& child = node->children[i];
+                generateCodeForNode(child, code, 0);
+            }
+            code << ";\n";
+            break;
+            
+        case ASTNodeType::ReturnStatement:
+            code << indentStr << "return";
+            if (node->left) {
+                code << " ";
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << ";\n";
+            break;
+            
+        case ASTNodeType::ExpressionStatement:
+            code << indentStr;
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << ";\n";
+            break;
+            
+        case ASTNodeType::BinaryOperation: {
+            // Operators associate to the left, so an operand on the right
+            // as loose as the operator itself needs parentheses too
+            const int precedence = precedenceInCpp(node->value);
+            if (node->left) {
+                generateOperand(node->left, code, precedence);
+            }
+            code << " " << node->value << " ";
+            if (node->right) {
+                generateOperand(node->right, code, precedence + 1);
+            }
+            break;
+        }
+            
+        case ASTNodeType::UnaryOperation: {
+            code << node->value;
+            if (!node->left) break;
+            // - -x, or - -1, must not read as a decrement
+            const ASTNode* operand = node->left;
+            const bool negated = (operand->type == ASTNodeType::UnaryOperation && operand->value == kMinus) ||
+                                 (operand->type == ASTNodeType::Literal && operand->value.str().substr(0, 1) == "-");
+            if (node->value == kMinus && negated) {
+                code << "(";
+                generateCodeForNode(node->left, code, 0);
+                code << ")";
+            } else {
+                generateOperand(node->left, code, kUnaryOperand);
+            }
+            break;
+        }
+            
+        case ASTNodeType::CallExpression:
+            code << node->value << "(";
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                if (i) code << ", ";
+                generateCodeForNode(node->children[i], code, 0);
+            }
+            code << ")";
+            break;
+            
+        case ASTNodeType::ArraySubscript:
+            if (node->left) {
+                generateCodeForNode(node->left, code, 0);
+            }
+            code << "[";
+            if (node->right) {
+                generateCodeForNode(node->right, code, 0);
+            }
+            code << "]";
+            break;
+            
+        case ASTNodeType::Literal:
+            code << node->value;
+            break;
+            
+        case ASTNodeType::Identifier:
+            code << node->value;
+            break;
+            
+        default:
+            break;
+    }
+}
+
+// Writes an expression, in parentheses if it binds less tightly than
+// `minPrecedence`
+void CodeOptimizer::generateOperand(ASTNode* node, std::ostream& code, int minPrecedence) {
+    const bool parenthesize = node->type == ASTNodeType::BinaryOperation && precedenceInCpp(node->value) < minPrecedence;
+    if (parenthesize) code << "(";
+    generateCodeForNode(node, code, 0);
+    if (parenthesize) code << ")";
+}
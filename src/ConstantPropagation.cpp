@@ -0,0 +1,699 @@
+#include "../include/ConstantPropagation.h"
+#include "../include/Analyses.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace {
+const Symbol kInt("int");
+const Symbol kTrue("true");
+const Symbol kFalse("false");
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kTimes("*");
+const Symbol kDivide("/");
+const Symbol kModulo("%");
+const Symbol kShiftLeft("<<");
+const Symbol kShiftRight(">>");
+const Symbol kBitAnd("&");
+const Symbol kEqual("==");
+const Symbol kNotEqual("!=");
+const Symbol kLess("<");
+const Symbol kGreater(">");
+const Symbol kLessEqual("<=");
+const Symbol kGreaterEqual(">=");
+const Symbol kAnd("&&");
+const Symbol kOr("||");
+const Symbol kNot("!");
+const Symbol kPlusAssign("+=");
+const Symbol kMinusAssign("-=");
+const Symbol kTimesAssign("*=");
+const Symbol kDivideAssign("/=");
+const Symbol kIncrement("++");
+
+constexpr uint32_t None = ControlFlowGraph::None;
+
+bool fitsInt(int64_t number) {
+    return number >= std::numeric_limits<int32_t>::min() && number <= std::numeric_limits<int32_t>::max();
+}
+
+const char* branchName(const ASTNode* statement) {
+    switch (statement->type) {
+        case ASTNodeType::IfStatement: return "if statement";
+        case ASTNodeType::WhileStatement: return "while loop";
+        case ASTNodeType::DoWhileStatement: return "do-while loop";
+        case ASTNodeType::ForStatement: return "for loop";
+        default: return "statement";
+    }
+}
+} // namespace
+
+ASTNode* ConstantPropagation::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    replaced = 0;
+    removed = 0;
+
+    ASTNode* result = root;
+    size_t next = 0; // graphs are in the order of the program's functions
+    for (const ControlFlowGraph& graph : graphs) {
+        computeDominators(graph);
+        placePhis(graph);
+        renameVariables(graph);
+        propagate(graph);
+
+        auto function = const_cast<ASTNode*>(graph.function());
+        auto rewritten = rewriteStatement(function, graph);
+        if (rewritten == function) continue;
+        if (function == root) {
+            result = rewritten;
+            continue;
+        }
+        while (root->children[next] != function) ++next;
+        if (result == root) result = root->shallowCopy(arena);
+        result->children[next] = rewritten;
+    }
+
+    if (removed > 0) {
+        std::cout << "[Optimizer] Removed " << removed << " unreachable statement"
+                  << (removed == 1 ? "" : "s") << std::endl;
+    }
+    rewrites += replaced + removed;
+    return result;
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm over the blocks
+// reachable from the entry, in reverse postorder
+void ConstantPropagation::computeDominators(const ControlFlowGraph& graph) {
+    const auto& blocks = graph.blocks();
+    order.clear();
+    orderIndex.assign(blocks.size(), None);
+
+    std::vector<uint32_t> postorder;
+    std::vector<std::pair<uint32_t, size_t>> stack; // (block, next successor slot)
+    std::vector<bool> visited(blocks.size(), false);
+    stack.emplace_back(ControlFlowGraph::Entry, 0);
+    visited[ControlFlowGraph::Entry] = true;
+    while (!stack.empty()) {
+        auto& [block, slot] = stack.back();
+        if (slot < 2) {
+            const uint32_t successor = blocks[block].successors[slot++];
+            if (successor != None && !visited[successor]) {
+                visited[successor] = true;
+                stack.emplace_back(successor, 0);
+            }
+            continue;
+        }
+        postorder.push_back(block);
+        stack.pop_back();
+    }
+    order.assign(postorder.rbegin(), postorder.rend());
+    for (size_t i = 0; i < order.size(); ++i) {
+        orderIndex[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    idom.assign(blocks.size(), None);
+    idom[ControlFlowGraph::Entry] = ControlFlowGraph::Entry;
+    auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (orderIndex[a] > orderIndex[b]) a = idom[a];
+            while (orderIndex[b] > orderIndex[a]) b = idom[b];
+        }
+        return a;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 1; i < order.size(); ++i) {
+            const uint32_t block = order[i];
+            uint32_t dominator = None;
+            for (uint32_t predecessor : blocks[block].predecessors) {
+                if (idom[predecessor] == None) continue;
+                dominator = dominator == None ? predecessor : intersect(predecessor, dominator);
+            }
+            if (dominator != idom[block]) {
+                idom[block] = dominator;
+                changed = true;
+            }
+        }
+    }
+
+    frontiers.assign(blocks.size(), {});
+    for (uint32_t block : order) {
+        if (blocks[block].predecessors.size() < 2) continue;
+        for (uint32_t predecessor : blocks[block].predecessors) {
+            if (orderIndex[predecessor] == None) continue;
+            for (uint32_t runner = predecessor; runner != idom[block]; runner = idom[runner]) {
+                auto& frontier = frontiers[runner];
+                if (frontier.empty() || frontier.back() != block) frontier.push_back(block);
+            }
+        }
+    }
+}
+
+// Minimal SSA: a phi for each variable in the iterated dominance frontier
+// of the blocks that write it
+void ConstantPropagation::placePhis(const ControlFlowGraph& graph) {
+    const auto& blocks = graph.blocks();
+    const size_t variableCount = graph.variables().size();
+    blockStates.assign(blocks.size(), BlockState());
+    values.assign(1, Lattice::varying());
+
+    std::vector<std::vector<uint32_t>> writers(variableCount);
+    for (uint32_t block : order) {
+        for (const ASTNode* statement : blocks[block].statements) {
+            forEachAccess(statement, [](const ASTNode*) {}, [&](const ASTNode*, const ASTNode* target) {
+                const uint32_t variable = graph.variableOf(target);
+                if (variable == None) return;
+                auto& list = writers[variable];
+                if (list.empty() || list.back() != block) list.push_back(block);
+            });
+        }
+    }
+
+    std::vector<uint32_t> hasPhi(blocks.size(), 0);
+    std::vector<uint32_t> queued(blocks.size(), 0);
+    std::vector<uint32_t> work;
+    for (uint32_t variable = 0; variable < variableCount; ++variable) {
+        const uint32_t stamp = variable + 1;
+        work = writers[variable];
+        for (uint32_t block : work) queued[block] = stamp;
+        while (!work.empty()) {
+            const uint32_t block = work.back();
+            work.pop_back();
+            for (uint32_t frontier : frontiers[block]) {
+                if (hasPhi[frontier] == stamp) continue;
+                hasPhi[frontier] = stamp;
+                blockStates[frontier].phis.push_back(
+                    Phi{variable, newValue(), std::vector<uint32_t>(blocks[frontier].predecessors.size(), 0)});
+                if (queued[frontier] != stamp) {
+                    queued[frontier] = stamp;
+                    work.push_back(frontier);
+                }
+            }
+        }
+    }
+}
+
+// Walks the dominator tree, giving every write a value and recording the
+// value every read sees
+void ConstantPropagation::renameVariables(const ControlFlowGraph& graph) {
+    const auto& blocks = graph.blocks();
+    current.assign(graph.variables().size(), 0);
+    renamed.clear();
+    uses.clear();
+    userPairs.clear();
+
+    std::vector<std::vector<uint32_t>> children(blocks.size());
+    for (size_t i = 1; i < order.size(); ++i) {
+        children[idom[order[i]]].push_back(order[i]);
+    }
+
+    auto rename = [&](uint32_t variable, uint32_t value) {
+        renamed.emplace_back(variable, current[variable]);
+        current[variable] = value;
+    };
+
+    struct Frame {
+        uint32_t block;
+        size_t scope; // size of `renamed` on entry
+        size_t child;
+    };
+    std::vector<Frame> stack;
+    stack.push_back(Frame{ControlFlowGraph::Entry, 0, 0});
+    bool entering = true;
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        const uint32_t block = frame.block;
+        auto& state = blockStates[block];
+
+        if (entering) {
+            entering = false;
+            // Records the value each read sees
+            auto readVariable = [&](const ASTNode* identifier) {
+                const uint32_t variable = graph.variableOf(identifier);
+                if (variable == None) return;
+                uses.emplace_back(identifier, current[variable]);
+                userPairs.emplace_back(current[variable], block);
+            };
+            for (Phi& phi : state.phis) {
+                rename(phi.variable, phi.value);
+            }
+            for (const ASTNode* statement : blocks[block].statements) {
+                // A declaration's own name in its initializer is a new,
+                // uninitialized variable, not the one the last iteration left
+                if (statement->type == ASTNodeType::Declaration && statement->left) {
+                    const uint32_t variable = graph.variableOf(statement->left);
+                    if (variable != None) rename(variable, 0);
+                }
+                forEachAccess(statement, readVariable, [&](const ASTNode* writer, const ASTNode* target) {
+                    const uint32_t variable = graph.variableOf(target);
+                    if (variable == None) return;
+                    const uint32_t value = newValue();
+                    state.definitions.push_back(Definition{writer, target, variable, value});
+                    rename(variable, value);
+                });
+            }
+            forEachAccess(blocks[block].condition, readVariable, [](const ASTNode*, const ASTNode*) {});
+
+            for (uint32_t successor : blocks[block].successors) {
+                if (successor == None) continue;
+                const auto& predecessors = blocks[successor].predecessors;
+                const size_t edge = std::find(predecessors.begin(), predecessors.end(), block) - predecessors.begin();
+                for (Phi& phi : blockStates[successor].phis) {
+                    phi.operands[edge] = current[phi.variable];
+                    userPairs.emplace_back(current[phi.variable], successor);
+                }
+            }
+        }
+
+        if (frame.child < children[block].size()) {
+            const uint32_t child = children[block][frame.child++];
+            stack.push_back(Frame{child, renamed.size(), 0});
+            entering = true;
+            continue;
+        }
+
+        while (renamed.size() > frame.scope) {
+            current[renamed.back().first] = renamed.back().second;
+            renamed.pop_back();
+        }
+        stack.pop_back();
+    }
+
+    auto byNode = [](const std::pair<const ASTNode*, uint32_t>& a, const std::pair<const ASTNode*, uint32_t>& b) {
+        return a.first < b.first;
+    };
+    std::sort(uses.begin(), uses.end(), byNode);
+
+    // The blocks reading each value, bucketed by value
+    userOffsets.assign(values.size() + 1, 0);
+    for (const auto& pair : userPairs) ++userOffsets[pair.first + 1];
+    for (size_t i = 1; i < userOffsets.size(); ++i) userOffsets[i] += userOffsets[i - 1];
+    userBlocks.resize(userPairs.size());
+    std::vector<uint32_t> fill(userOffsets.begin(), userOffsets.end() - 1);
+    for (const auto& pair : userPairs) userBlocks[fill[pair.first]++] = pair.second;
+}
+
+uint32_t ConstantPropagation::newValue() {
+    values.push_back(Lattice());
+    return static_cast<uint32_t>(values.size() - 1);
+}
+
+void ConstantPropagation::propagate(const ControlFlowGraph& graph) {
+    worklist.clear();
+    blockStates[ControlFlowGraph::Entry].executable = true;
+    enqueue(ControlFlowGraph::Entry);
+    while (!worklist.empty()) {
+        const uint32_t block = worklist.back();
+        worklist.pop_back();
+        blockStates[block].queued = false;
+        visitBlock(block, graph);
+    }
+}
+
+void ConstantPropagation::visitBlock(uint32_t block, const ControlFlowGraph& graph) {
+    const auto& info = graph.blocks()[block];
+    auto& state = blockStates[block];
+
+    // A phi merges what arrives over the edges known to be taken
+    for (const Phi& phi : state.phis) {
+        Lattice merged;
+        for (size_t i = 0; i < info.predecessors.size(); ++i) {
+            const uint32_t predecessor = info.predecessors[i];
+            const auto& from = graph.blocks()[predecessor];
+            const auto& taken = blockStates[predecessor].edgeExecutable;
+            if ((taken[0] && from.successors[0] == block) || (taken[1] && from.successors[1] == block)) {
+                merged = meet(merged, values[phi.operands[i]]);
+            }
+        }
+        lower(phi.value, merged);
+    }
+
+    for (const Definition& definition : state.definitions) {
+        lower(definition.value, evaluateDefinition(definition, graph));
+    }
+
+    if (!info.condition) {
+        if (info.successors[0] != None) markEdge(block, 0, graph);
+        return;
+    }
+    const Lattice condition = evaluate(info.condition);
+    if (condition.isConstant()) {
+        markEdge(block, condition.number != 0 ? 0 : 1, graph);
+    } else if (condition.state == Lattice::State::Varying) {
+        markEdge(block, 0, graph);
+        markEdge(block, 1, graph);
+    }
+}
+
+void ConstantPropagation::markEdge(uint32_t from, size_t slot, const ControlFlowGraph& graph) {
+    auto& taken = blockStates[from].edgeExecutable[slot];
+    if (taken) return;
+    taken = true;
+    const uint32_t to = graph.blocks()[from].successors[slot];
+    blockStates[to].executable = true;
+    enqueue(to);
+}
+
+// Values only ever move down the lattice, so each is lowered at most twice
+void ConstantPropagation::lower(uint32_t value, Lattice lattice) {
+    const Lattice merged = meet(values[value], lattice);
+    if (merged == values[value]) return;
+    values[value] = merged;
+    for (uint32_t i = userOffsets[value]; i < userOffsets[value + 1]; ++i) {
+        if (blockStates[userBlocks[i]].executable) enqueue(userBlocks[i]);
+    }
+}
+
+void ConstantPropagation::enqueue(uint32_t block) {
+    if (blockStates[block].queued) return;
+    blockStates[block].queued = true;
+    worklist.push_back(block);
+}
+
+ConstantPropagation::Lattice ConstantPropagation::meet(Lattice a, Lattice b) {
+    if (a.state == Lattice::State::Unknown) return b;
+    if (b.state == Lattice::State::Unknown) return a;
+    if (a == b) return a;
+    return Lattice::varying();
+}
+
+ConstantPropagation::Lattice ConstantPropagation::evaluate(const ASTNode* node) const {
+    if (!node) return Lattice::varying();
+    switch (node->type) {
+        case ASTNodeType::Literal:
+            return literalValue(node->value);
+        case ASTNodeType::Identifier: {
+            const uint32_t value = valueOf(node);
+            return value == None ? Lattice::varying() : values[value];
+        }
+        case ASTNodeType::BinaryOperation:
+            return apply(node->value, evaluate(node->left), evaluate(node->right));
+        case ASTNodeType::UnaryOperation:
+            return applyUnary(node->value, evaluate(node->left));
+        default:
+            return Lattice::varying();
+    }
+}
+
+// The value a write stores, converted to the variable's type
+ConstantPropagation::Lattice ConstantPropagation::evaluateDefinition(const Definition& definition,
+                                                                     const ControlFlowGraph& graph) const {
+    const ASTNode* writer = definition.writer;
+    Lattice stored;
+    switch (writer->type) {
+        case ASTNodeType::Declaration:
+        case ASTNodeType::Assignment:
+            stored = writer->right ? evaluate(writer->right) : Lattice::varying();
+            break;
+        case ASTNodeType::CompoundAssignment: {
+            const Symbol op = writer->value == kPlusAssign    ? kPlus
+                              : writer->value == kMinusAssign ? kMinus
+                              : writer->value == kTimesAssign ? kTimes
+                              : writer->value == kDivideAssign ? kDivide
+                                                               : Symbol();
+            stored = apply(op, evaluate(definition.target), evaluate(writer->right));
+            break;
+        }
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement:
+            stored = apply(writer->value == kIncrement ? kPlus : kMinus, evaluate(definition.target),
+                           Lattice::constant(1));
+            break;
+        default:
+            return Lattice::varying(); // read with cin
+    }
+
+    if (graph.variables()[definition.variable].type != kInt) return Lattice::varying();
+    if (stored.isConstant()) stored.boolean = false;
+    return stored;
+}
+
+uint32_t ConstantPropagation::valueOf(const ASTNode* identifier) const {
+    auto it = std::lower_bound(uses.begin(), uses.end(), identifier,
+                               [](const std::pair<const ASTNode*, uint32_t>& entry, const ASTNode* key) {
+                                   return entry.first < key;
+                               });
+    return it != uses.end() && it->first == identifier ? it->second : None;
+}
+
+// Decimal int literals and true/false; anything else is not tracked
+ConstantPropagation::Lattice ConstantPropagation::literalValue(Symbol text) {
+    if (text == kTrue) return Lattice::constant(1, true);
+    if (text == kFalse) return Lattice::constant(0, true);
+
+    int64_t number;
+    return intLiteralValue(text, number) ? Lattice::constant(number) : Lattice::varying();
+}
+
+// Operators as C++ applies them to int and bool operands. && and || are
+// decided by one constant operand, whatever the other one is.
+ConstantPropagation::Lattice ConstantPropagation::apply(Symbol op, Lattice left, Lattice right) {
+    if (op == kAnd || op == kOr) {
+        const bool decisive = op == kOr;
+        if ((left.isConstant() && (left.number != 0) == decisive) ||
+            (right.isConstant() && (right.number != 0) == decisive)) {
+            return Lattice::constant(decisive, true);
+        }
+    }
+    if (left.state == Lattice::State::Unknown || right.state == Lattice::State::Unknown) return Lattice();
+    if (!left.isConstant() || !right.isConstant()) return Lattice::varying();
+
+    const int64_t a = left.number;
+    const int64_t b = right.number;
+    int64_t result;
+    if (op == kPlus) {
+        result = a + b;
+    } else if (op == kMinus) {
+        result = a - b;
+    } else if (op == kTimes) {
+        result = a * b;
+    } else if (op == kDivide) {
+        if (b == 0) return Lattice::varying();
+        result = a / b;
+    } else if (op == kModulo) {
+        // INT_MIN % -1 overflows like the division does
+        if (b == 0 || !fitsInt(a / b)) return Lattice::varying();
+        result = a % b;
+    } else if (op == kShiftLeft) {
+        // Multiplies by a power of two, as C++20 defines it for negative
+        // numbers as well; shifting by the width or more is undefined
+        if (b < 0 || b >= 32) return Lattice::varying();
+        result = a * (int64_t(1) << b);
+    } else if (op == kShiftRight) {
+        // Arithmetic, as every supported compiler shifts a negative int
+        if (b < 0 || b >= 32) return Lattice::varying();
+        result = a >> b;
+    } else if (op == kBitAnd) {
+        result = a & b;
+    } else if (op == kLess) {
+        return Lattice::constant(a < b, true);
+    } else if (op == kGreater) {
+        return Lattice::constant(a > b, true);
+    } else if (op == kLessEqual) {
+        return Lattice::constant(a <= b, true);
+    } else if (op == kGreaterEqual) {
+        return Lattice::constant(a >= b, true);
+    } else if (op == kEqual) {
+        return Lattice::constant(a == b, true);
+    } else if (op == kNotEqual) {
+        return Lattice::constant(a != b, true);
+    } else if (op == kAnd || op == kOr) {
+        return Lattice::constant(op == kAnd ? (a && b) : (a || b), true);
+    } else {
+        return Lattice::varying();
+    }
+    // Signed overflow is undefined; leave such code as it is
+    return fitsInt(result) ? Lattice::constant(result) : Lattice::varying();
+}
+
+ConstantPropagation::Lattice ConstantPropagation::applyUnary(Symbol op, Lattice operand) {
+    if (!operand.isConstant()) return operand;
+    if (op == kNot) return Lattice::constant(operand.number == 0, true);
+    // -INT_MIN overflows
+    if (op == kMinus && fitsInt(-operand.number)) return Lattice::constant(-operand.number);
+    return Lattice::varying();
+}
+
+bool ConstantPropagation::reachable(const ASTNode* statement, const ControlFlowGraph& graph) const {
+    const uint32_t block = graph.blockOf(statement);
+    return block == None || blockStates[block].executable;
+}
+
+ASTNode* ConstantPropagation::rewriteStatement(ASTNode* node, const ControlFlowGraph& graph) {
+    if (!node) return nullptr;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+    auto setLeft = [&](ASTNode* left) {
+        if (left != node->left) own()->left = left;
+    };
+    auto setRight = [&](ASTNode* right) {
+        if (right != node->right) own()->right = right;
+    };
+    auto setChild = [&](size_t i, ASTNode* child) {
+        if (child != node->children[i]) own()->children[i] = child;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Program:
+        case ASTNodeType::Block: {
+            size_t kept = 0;
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                ASTNode* child = node->children[i];
+                if (child && !reachable(child, graph)) {
+                    ++removed;
+                    own();
+                    continue;
+                }
+                auto rewritten = rewriteStatement(child, graph);
+                if (rewritten != child) own();
+                if (result != node) result->children[kept] = rewritten;
+                ++kept;
+            }
+            if (result != node) result->children.resize(kept);
+            break;
+        }
+
+        case ASTNodeType::FunctionDeclaration:
+            setLeft(rewriteStatement(node->left, graph));
+            break;
+
+        case ASTNodeType::Declaration:
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+            setRight(rewriteExpression(node->right));
+            if (node->left && node->left->type == ASTNodeType::ArraySubscript) {
+                setLeft(rewriteExpression(node->left));
+            }
+            break;
+
+        case ASTNodeType::ArrayDeclaration:
+            setRight(rewriteExpression(node->right));
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                setChild(i, rewriteExpression(node->children[i]));
+            }
+            break;
+
+        // Only an element's index is read
+        case ASTNodeType::InputStatement:
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                ASTNode* child = node->children[i];
+                if (child && child->type == ASTNodeType::ArraySubscript) setChild(i, rewriteExpression(child));
+            }
+            break;
+
+        case ASTNodeType::ExpressionStatement:
+        case ASTNodeType::ReturnStatement:
+            setLeft(node->left && node->left->type == ASTNodeType::CompoundAssignment
+                        ? rewriteStatement(node->left, graph)
+                        : rewriteExpression(node->left));
+            break;
+
+        case ASTNodeType::PrintStatement:
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                setChild(i, rewriteExpression(node->children[i]));
+            }
+            break;
+
+        case ASTNodeType::IfStatement:
+        case ASTNodeType::WhileStatement:
+            setLeft(rewriteCondition(node->left, node));
+            setRight(rewriteStatement(node->right, graph));
+            break;
+
+        case ASTNodeType::DoWhileStatement:
+            setLeft(rewriteStatement(node->left, graph));
+            setRight(rewriteCondition(node->right, node));
+            break;
+
+        case ASTNodeType::ForStatement:
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                ASTNode* child = node->children[i];
+                setChild(i, i == 1 ? rewriteCondition(child, node) : rewriteStatement(child, graph));
+            }
+            break;
+
+        default:
+            break;
+    }
+    return result;
+}
+
+ASTNode* ConstantPropagation::rewriteExpression(ASTNode* node) {
+    if (!node) return nullptr;
+    if (node->type == ASTNodeType::CallExpression) {
+        ASTNode* result = node;
+        for (size_t i = 0; i < node->children.size(); ++i) {
+            auto argument = rewriteExpression(node->children[i]);
+            if (argument == node->children[i]) continue;
+            if (result == node) result = node->shallowCopy(arena);
+            result->children[i] = argument;
+        }
+        return result;
+    }
+    // An element's value is not tracked, only its index
+    if (node->type == ASTNodeType::ArraySubscript) {
+        auto index = rewriteExpression(node->right);
+        if (index == node->right) return node;
+        auto result = node->shallowCopy(arena);
+        result->right = index;
+        return result;
+    }
+    if (node->type != ASTNodeType::Identifier && node->type != ASTNodeType::BinaryOperation &&
+        node->type != ASTNodeType::UnaryOperation) {
+        return node;
+    }
+    // -5 is a literal already; folding merges the sign into it
+    if (node->type == ASTNodeType::UnaryOperation && node->left && node->left->type == ASTNodeType::Literal) {
+        return node;
+    }
+
+    // An operand that decides && or || does not spare the call in the other one
+    const Lattice value = evaluate(node);
+    if (value.isConstant() && !hasSideEffects(node)) {
+        ++replaced;
+        auto replacement = literal(value);
+        if (node->type == ASTNodeType::Identifier) {
+            std::cout << "[Optimizer] Replaced variable " << node->value << " with constant "
+                      << replacement->value << std::endl;
+        } else {
+            std::cout << "[Optimizer] Folded an expression to constant " << replacement->value << std::endl;
+        }
+        return replacement;
+    }
+    if (node->type == ASTNodeType::Identifier) return node;
+
+    auto left = rewriteExpression(node->left);
+    auto right = rewriteExpression(node->right);
+    if (left == node->left && right == node->right) return node;
+    auto result = node->shallowCopy(arena);
+    result->left = left;
+    result->right = right;
+    return result;
+}
+
+// A condition that always goes one way becomes true or false, which the
+// dead code and loop passes know how to remove
+ASTNode* ConstantPropagation::rewriteCondition(ASTNode* node, const ASTNode* statement) {
+    if (!node || node->type == ASTNodeType::Literal) return node;
+
+    const Lattice value = evaluate(node);
+    if (!value.isConstant() || hasSideEffects(node)) return rewriteExpression(node);
+
+    ++replaced;
+    const bool taken = value.number != 0;
+    std::cout << "[Optimizer] Condition of the " << branchName(statement) << " on line " << statement->loc.line
+              << " is always " << (taken ? "true" : "false") << std::endl;
+    return arena.create<ASTNode>(arena, ASTNodeType::Literal, taken ? kTrue : kFalse);
+}
+
+ASTNode* ConstantPropagation::literal(const Lattice& lattice) {
+    if (lattice.boolean) {
+        return arena.create<ASTNode>(arena, ASTNodeType::Literal, lattice.number ? kTrue : kFalse);
+    }
+    return arena.create<ASTNode>(arena, ASTNodeType::Literal, std::to_string(lattice.number));
+}
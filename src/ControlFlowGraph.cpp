@@ -0,0 +1,264 @@
+#include "../include/ControlFlowGraph.h"
+#include <algorithm>
+#include <string>
+
+namespace {
+
+uint32_t lookup(const std::vector<std::pair<const ASTNode*, uint32_t>>& sorted, const ASTNode* node) {
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), node,
+                               [](const std::pair<const ASTNode*, uint32_t>& entry, const ASTNode* key) {
+                                   return entry.first < key;
+                               });
+    return it != sorted.end() && it->first == node ? it->second : ControlFlowGraph::None;
+}
+
+} // namespace
+
+uint32_t ControlFlowGraph::variableOf(const ASTNode* identifier) const {
+    return lookup(identifierVariables, identifier);
+}
+
+uint32_t ControlFlowGraph::blockOf(const ASTNode* statement) const {
+    return lookup(statementBlocks, statement);
+}
+
+// Walks a function body in source order, appending statements to the
+// current block and starting new blocks at branches and join points
+class ControlFlowGraph::Builder {
+public:
+    explicit Builder(ControlFlowGraph& graph) : graph(graph) {}
+
+    void build(const ASTNode* function) {
+        graph.functionNode = function;
+        newBlock(); // Entry
+        newBlock(); // Exit
+        current = Entry;
+        // Parameters are declarations at the top of the entry block
+        for (const ASTNode* parameter : function->children) {
+            visit(parameter);
+        }
+        visit(function->left);
+        connect(current, Exit);
+
+        auto byNode = [](const std::pair<const ASTNode*, uint32_t>& a,
+                         const std::pair<const ASTNode*, uint32_t>& b) { return a.first < b.first; };
+        std::sort(graph.identifierVariables.begin(), graph.identifierVariables.end(), byNode);
+        std::sort(graph.statementBlocks.begin(), graph.statementBlocks.end(), byNode);
+    }
+
+private:
+    uint32_t newBlock() {
+        graph.blockList.emplace_back();
+        return static_cast<uint32_t>(graph.blockList.size() - 1);
+    }
+
+    void connect(uint32_t from, uint32_t to, size_t slot = 0) {
+        graph.blockList[from].successors[slot] = to;
+        graph.blockList[to].predecessors.push_back(from);
+    }
+
+    // Ends the current block with a branch on `condition`; returns the
+    // blocks taken when it is true and when it is false
+    std::pair<uint32_t, uint32_t> branch(const ASTNode* statement, const ASTNode* condition) {
+        resolve(condition);
+        const uint32_t from = current;
+        const uint32_t taken = newBlock();
+        if (!condition) {
+            // for (;;) and friends never leave through the condition
+            connect(from, taken);
+            return {taken, newBlock()};
+        }
+        const uint32_t notTaken = newBlock();
+        graph.blockList[from].condition = condition;
+        graph.blockList[from].branch = statement;
+        connect(from, taken, 0);
+        connect(from, notTaken, 1);
+        return {taken, notTaken};
+    }
+
+    void append(const ASTNode* statement) {
+        graph.blockList[current].statements.push_back(statement);
+    }
+
+    void visit(const ASTNode* node) {
+        if (!node) return;
+        graph.statementBlocks.emplace_back(node, current);
+
+        switch (node->type) {
+            case ASTNodeType::Program:
+            case ASTNodeType::Block: {
+                const size_t scope = shadowed.size();
+                for (const ASTNode* child : node->children) {
+                    visit(child);
+                }
+                leaveScope(scope);
+                break;
+            }
+
+            // The name is in scope in its own initializer
+            case ASTNodeType::Declaration:
+                if (node->left && node->left->type == ASTNodeType::Identifier) {
+                    declare(node->left, node->value);
+                }
+                resolve(node->right);
+                append(node);
+                break;
+
+            // An array is a variable of a type no pass tracks the value of
+            case ASTNodeType::ArrayDeclaration:
+                resolve(node->right);
+                for (const ASTNode* child : node->children) {
+                    resolve(child);
+                }
+                if (node->left && node->left->type == ASTNodeType::Identifier) {
+                    declare(node->left, Symbol(std::string(node->value.str()) + "[]"));
+                }
+                append(node);
+                break;
+
+            case ASTNodeType::Assignment:
+            case ASTNodeType::ExpressionStatement:
+            case ASTNodeType::PrintStatement:
+            case ASTNodeType::InputStatement:
+                resolve(node);
+                append(node);
+                break;
+
+            // Nothing after a return runs; whatever follows it goes into a
+            // block no edge leads to
+            case ASTNodeType::ReturnStatement:
+                resolve(node->left);
+                append(node);
+                connect(current, Exit);
+                current = newBlock();
+                break;
+
+            case ASTNodeType::IfStatement: {
+                auto [then, after] = branch(node, node->left);
+                current = then;
+                visit(node->right);
+                connect(current, after);
+                current = after;
+                break;
+            }
+
+            case ASTNodeType::WhileStatement: {
+                const uint32_t header = newBlock();
+                connect(current, header);
+                current = header;
+                auto [body, after] = branch(node, node->left);
+                current = body;
+                visit(node->right);
+                connect(current, header);
+                current = after;
+                break;
+            }
+
+            case ASTNodeType::DoWhileStatement: {
+                const uint32_t body = newBlock();
+                connect(current, body);
+                current = body;
+                visit(node->left);
+                // The condition's false edge is the way out; its true edge
+                // goes back to the top of the body
+                resolve(node->right);
+                const uint32_t from = current;
+                const uint32_t after = newBlock();
+                if (node->right) {
+                    graph.blockList[from].condition = node->right;
+                    graph.blockList[from].branch = node;
+                    connect(from, body, 0);
+                    connect(from, after, 1);
+                } else {
+                    connect(from, body);
+                }
+                current = after;
+                break;
+            }
+
+            // init; header: condition; body; increment; back to header
+            case ASTNodeType::ForStatement: {
+                const size_t scope = shadowed.size();
+                auto child = [&](size_t i) { return i < node->children.size() ? node->children[i] : nullptr; };
+                visit(child(0));
+                const uint32_t header = newBlock();
+                connect(current, header);
+                current = header;
+                auto [body, after] = branch(node, child(1));
+                current = body;
+                visit(child(3));
+                if (const ASTNode* increment = child(2)) {
+                    resolve(increment);
+                    append(increment);
+                }
+                connect(current, header);
+                leaveScope(scope);
+                current = after;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    // Records the variable of every identifier under `node`
+    void resolve(const ASTNode* node) {
+        if (!node) return;
+        if (node->type == ASTNodeType::Identifier) {
+            if (visible.contains(node->value)) {
+                graph.identifierVariables.emplace_back(node, visible.at(node->value));
+            }
+            return;
+        }
+        resolve(node->left);
+        resolve(node->right);
+        for (const ASTNode* child : node->children) {
+            resolve(child);
+        }
+    }
+
+    void declare(const ASTNode* identifier, Symbol type) {
+        const Symbol name = identifier->value;
+        shadowed.emplace_back(name, visible.contains(name) ? visible.at(name) : None);
+        const uint32_t variable = static_cast<uint32_t>(graph.variableList.size());
+        graph.variableList.push_back(Variable{name, type});
+        visible[name] = variable;
+        graph.identifierVariables.emplace_back(identifier, variable);
+    }
+
+    void leaveScope(size_t scope) {
+        while (shadowed.size() > scope) {
+            auto [name, previous] = shadowed.back();
+            if (previous == None) {
+                visible.erase(name);
+            } else {
+                visible[name] = previous;
+            }
+            shadowed.pop_back();
+        }
+    }
+
+    ControlFlowGraph& graph;
+    uint32_t current = Entry;
+    SymbolMap<uint32_t> visible; // name -> innermost variable declared with it
+    std::vector<std::pair<Symbol, uint32_t>> shadowed; // (name, variable it hid or None), innermost last
+};
+
+ControlFlow::Result ControlFlow::run(const ASTNode* root) {
+    Result graphs;
+    if (!root) return graphs;
+
+    auto add = [&](const ASTNode* function) {
+        graphs.emplace_back();
+        ControlFlowGraph::Builder(graphs.back()).build(function);
+    };
+    if (root->type == ASTNodeType::FunctionDeclaration) {
+        add(root);
+    } else {
+        for (const ASTNode* child : root->children) {
+            if (child && child->type == ASTNodeType::FunctionDeclaration) add(child);
+        }
+    }
+    return graphs;
+}
@@ -0,0 +1,320 @@
+#include "../include/CostModel.h"
+#include "../include/Analyses.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+const Symbol kSimdFor("simd for");
+const Symbol kEpilogueFor("epilogue for");
+const Symbol kEndl("std::endl");
+const Symbol kProgram("program");
+
+const Symbol kTimes("*");
+const Symbol kDivide("/");
+const Symbol kModulo("%");
+const Symbol kAnd("&&");
+const Symbol kOr("||");
+const Symbol kLess("<");
+const Symbol kGreater(">");
+const Symbol kLessEqual("<=");
+const Symbol kGreaterEqual(">=");
+const Symbol kNotEqual("!=");
+const Symbol kIncrement("++");
+const Symbol kDecrement("--");
+const Symbol kPlusAssign("+=");
+const Symbol kMinusAssign("-=");
+
+// Cycles, for what has no operator to look up
+constexpr double kStore = 1;
+constexpr double kElement = 2; // address and load of an array element
+constexpr double kBranch = 1;
+constexpr double kCall = 5;    // call, return and frame
+constexpr double kOutput = 100;
+constexpr double kFlush = 1000;
+constexpr double kInput = 200;
+constexpr double kTaken = 0.5; // how often an if statement runs its body
+constexpr double kEpilogueTrips = 3.5; // of the scalar epilogue of a vectorized loop, half a strip
+
+const char* loopKind(const ASTNode* loop) {
+    switch (loop->type) {
+        case ASTNodeType::WhileStatement: return "while loop";
+        case ASTNodeType::DoWhileStatement: return "do-while loop";
+        default: return "for loop";
+    }
+}
+
+bool literalValue(const ASTNode* node, int64_t& value) {
+    return node && node->type == ASTNodeType::Literal && intLiteralValue(node->value, value);
+}
+
+// The start, bound and step of `for (i = a; i op b; step)` with literals
+// a, b and the step; false for any other loop
+bool literalLoop(const ASTNode* loop, int64_t& start, Symbol& op, int64_t& bound, int64_t& step) {
+    if (loop->type != ASTNodeType::ForStatement || loop->children.size() < 3) return false;
+    const ASTNode* init = loop->children[0];
+    const ASTNode* condition = loop->children[1];
+    const ASTNode* increment = loop->children[2];
+    if (!init || !condition || !increment || !init->left || init->left->type != ASTNodeType::Identifier) return false;
+    if (init->type != ASTNodeType::Declaration && init->type != ASTNodeType::Assignment) return false;
+    const Symbol variable = init->left->value;
+    if (!literalValue(init->right, start)) return false;
+
+    if (condition->type != ASTNodeType::BinaryOperation || !condition->left ||
+        condition->left->type != ASTNodeType::Identifier || condition->left->value != variable ||
+        !literalValue(condition->right, bound)) {
+        return false;
+    }
+    op = condition->value;
+
+    if (!increment->left || increment->left->type != ASTNodeType::Identifier ||
+        increment->left->value != variable) {
+        return false;
+    }
+    if (increment->type == ASTNodeType::PreIncrement || increment->type == ASTNodeType::PostIncrement) {
+        step = increment->value == kDecrement ? -1 : 1;
+        return increment->value == kIncrement || increment->value == kDecrement;
+    }
+    if (increment->type != ASTNodeType::CompoundAssignment || !literalValue(increment->right, step)) return false;
+    if (increment->value == kMinusAssign) {
+        step = -step;
+    } else if (increment->value != kPlusAssign) {
+        return false;
+    }
+    return step != 0;
+}
+} // namespace
+
+double CostModel::cost(const ASTNode* node) const {
+    Walk walk;
+    return estimate(node, walk, 0, 1);
+}
+
+double CostModel::trips(const ASTNode* loop, bool& assumed) const {
+    int64_t start, bound, step;
+    Symbol op;
+    if (literalLoop(loop, start, op, bound, step)) {
+        // Distance to the first value that fails the condition, in steps;
+        // a variable moving away from its bound is not counted
+        const int64_t stride = step < 0 ? -step : step;
+        int64_t span = -1;
+        if (step > 0 && (op == kLess || op == kNotEqual)) span = bound - start;
+        if (step > 0 && op == kLessEqual) span = bound - start + 1;
+        if (step < 0 && (op == kGreater || op == kNotEqual)) span = start - bound;
+        if (step < 0 && op == kGreaterEqual) span = start - bound + 1;
+        if (span >= 0 && (op != kNotEqual || span % stride == 0)) {
+            assumed = false;
+            return static_cast<double>((span + stride - 1) / stride);
+        }
+    }
+    assumed = true;
+    if (loop->type == ASTNodeType::DoWhileStatement) return std::max(1.0, assumedTrips);
+    if (loop->value == kEpilogueFor) return kEpilogueTrips;
+    // Stepping by more than one, it covers the same values in fewer trips
+    if (loop->type == ASTNodeType::ForStatement && loop->children.size() > 2 && loop->children[2] &&
+        loop->children[2]->type == ASTNodeType::CompoundAssignment && literalValue(loop->children[2]->right, step) &&
+        step != 0) {
+        return assumedTrips / static_cast<double>(step < 0 ? -step : step);
+    }
+    return assumedTrips;
+}
+
+std::vector<CostModel::Region> CostModel::regions(const ASTNode* root) const {
+    std::vector<Region> result;
+    if (!root) return result;
+
+    const CallGraph calls = Calls::run(root);
+    Walk walk;
+    walk.calls = &calls;
+    walk.functionCycles.assign(calls.functions().size(), 0);
+    walk.state.assign(calls.functions().size(), 0);
+    walk.regions = &result;
+
+    auto add = [&](const ASTNode* function, const ASTNode* body, Symbol name) {
+        Region region;
+        region.kind = "function";
+        region.function = name;
+        region.line = function->loc.line;
+        const size_t index = result.size();
+        result.push_back(region);
+        walk.function = name;
+        result[index].cycles = estimate(body, walk, 0, 1);
+    };
+
+    bool defined = false;
+    for (const ASTNode* child : root->children) {
+        if (!child || child->type != ASTNodeType::FunctionDeclaration || !child->left) continue;
+        add(child, child->left, child->value);
+        defined = true;
+    }
+    if (!defined) add(root, root, kProgram);
+    return result;
+}
+
+double CostModel::functionCost(uint32_t function, Walk& walk) const {
+    if (walk.state[function] == 2) return walk.functionCycles[function];
+    if (walk.state[function] == 1) return 0; // recursion: the caller counts the overhead
+
+    // Its loops are recorded when the function itself is estimated
+    walk.state[function] = 1;
+    auto regions = std::exchange(walk.regions, nullptr);
+    const double cycles = estimate(walk.calls->functions()[function].definition->left, walk, 0, 1);
+    walk.regions = regions;
+    walk.functionCycles[function] = cycles;
+    walk.state[function] = 2;
+    return cycles;
+}
+
+double CostModel::estimate(const ASTNode* node, Walk& walk, unsigned depth, double executions) const {
+    if (!node) return 0;
+    auto of = [&](const ASTNode* child) { return estimate(child, walk, depth, executions); };
+    auto ofTarget = [&](const ASTNode* target) {
+        // Storing to an element computes its address first
+        return target && target->type == ASTNodeType::ArraySubscript ? of(target->right) + kElement : 0.0;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Literal:
+        case ASTNodeType::Identifier:
+        case ASTNodeType::Preprocessor:
+            return 0;
+
+        case ASTNodeType::ArraySubscript:
+            return of(node->right) + kElement;
+
+        case ASTNodeType::BinaryOperation:
+            return of(node->left) + of(node->right) + operatorCost(node->value, false);
+
+        case ASTNodeType::UnaryOperation:
+            return of(node->left) + operatorCost(node->value, true);
+
+        case ASTNodeType::Declaration:
+            return node->right ? of(node->right) + kStore : 0;
+
+        case ASTNodeType::ArrayDeclaration: {
+            double cycles = 0;
+            for (const ASTNode* value : node->children) cycles += of(value) + kStore;
+            return cycles;
+        }
+
+        case ASTNodeType::Assignment:
+            return ofTarget(node->left) + of(node->right) + kStore;
+
+        case ASTNodeType::CompoundAssignment: {
+            // x op= y reads x, applies op and stores
+            const std::string_view op = node->value.str();
+            const Symbol binary(op.substr(0, op.size() - 1));
+            const double read = node->left && node->left->type == ASTNodeType::ArraySubscript ? kElement : 0;
+            return ofTarget(node->left) + read + of(node->right) + operatorCost(binary, false) + kStore;
+        }
+
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement: {
+            const double read = node->left && node->left->type == ASTNodeType::ArraySubscript ? kElement : 0;
+            return ofTarget(node->left) + read + 1 + kStore;
+        }
+
+        case ASTNodeType::ExpressionStatement:
+            return of(node->left);
+
+        case ASTNodeType::ReturnStatement:
+            return of(node->left) + kBranch;
+
+        case ASTNodeType::PrintStatement: {
+            double cycles = 0;
+            for (const ASTNode* value : node->children) {
+                cycles += value->type == ASTNodeType::Literal && value->value == kEndl ? kOutput + kFlush
+                                                                                    : of(value) + kOutput;
+            }
+            return cycles;
+        }
+
+        case ASTNodeType::InputStatement: {
+            double cycles = 0;
+            for (const ASTNode* target : node->children) cycles += ofTarget(target) + kInput;
+            return cycles;
+        }
+
+        case ASTNodeType::CallExpression: {
+            double cycles = kCall;
+            for (const ASTNode* argument : node->children) cycles += of(argument) + kStore;
+            if (walk.calls) {
+                const uint32_t callee = walk.calls->find(node->value);
+                if (callee != CallGraph::None && walk.calls->functions()[callee].definition) {
+                    cycles += functionCost(callee, walk);
+                }
+            }
+            return cycles;
+        }
+
+        case ASTNodeType::IfStatement:
+            return of(node->left) + kBranch + kTaken * estimate(node->right, walk, depth, executions * kTaken);
+
+        case ASTNodeType::ForStatement:
+        case ASTNodeType::WhileStatement:
+        case ASTNodeType::DoWhileStatement:
+            return estimateLoop(node, walk, depth, executions);
+
+        case ASTNodeType::FunctionDeclaration:
+            return 0; // costs where it is called
+
+        case ASTNodeType::Program:
+        case ASTNodeType::Block:
+        default: {
+            double cycles = 0;
+            for (const ASTNode* child : node->children) cycles += of(child);
+            return cycles;
+        }
+    }
+}
+
+// A loop costs its setup once, and its condition, body and increment once
+// per trip, with the condition evaluated once more to leave
+double CostModel::estimateLoop(const ASTNode* loop, Walk& walk, unsigned depth, double executions) const {
+    bool assumed;
+    const double count = trips(loop, assumed);
+    const bool lanes = loop->type == ASTNodeType::ForStatement && loop->value == kSimdFor;
+    const double runs = lanes ? 1 : count; // the lanes run together
+    const double inside = executions * runs;
+
+    const size_t index = walk.regions ? walk.regions->size() : 0;
+    if (walk.regions) {
+        Region region;
+        region.kind = loopKind(loop);
+        region.function = walk.function;
+        region.line = loop->loc.line;
+        region.depth = depth;
+        region.trips = count;
+        region.assumed = assumed;
+        region.executions = executions;
+        walk.regions->push_back(region);
+    }
+    auto of = [&](const ASTNode* node, double times) { return estimate(node, walk, depth + 1, times); };
+
+    double cycles = 0;
+    if (lanes) {
+        cycles = of(loop->children.size() > 3 ? loop->children[3] : nullptr, inside); // one trip, no loop around it
+    } else if (loop->type == ASTNodeType::ForStatement) {
+        const ASTNode* init = loop->children.size() > 0 ? loop->children[0] : nullptr;
+        const ASTNode* condition = loop->children.size() > 1 ? loop->children[1] : nullptr;
+        const ASTNode* increment = loop->children.size() > 2 ? loop->children[2] : nullptr;
+        const ASTNode* body = loop->children.size() > 3 ? loop->children[3] : nullptr;
+        const double test = of(condition, inside) + kBranch;
+        cycles = of(init, executions) + test + runs * (of(body, inside) + of(increment, inside) + test);
+    } else if (loop->type == ASTNodeType::WhileStatement) {
+        const double test = of(loop->left, inside) + kBranch;
+        cycles = test + runs * (of(loop->right, inside) + test);
+    } else {
+        const double test = of(loop->right, inside) + kBranch;
+        cycles = runs * (of(loop->left, inside) + test);
+    }
+    if (walk.regions) (*walk.regions)[index].cycles = cycles;
+    return cycles;
+}
+
+double CostModel::operatorCost(Symbol op, bool unary) {
+    if (unary) return 1;
+    if (op == kTimes) return 3;
+    if (op == kDivide || op == kModulo) return 25;
+    if (op == kAnd || op == kOr) return 1 + kBranch; // they short-circuit
+    return 1;
+}
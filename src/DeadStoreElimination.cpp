@@ -0,0 +1,364 @@
+#include "../include/DeadStoreElimination.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+const Symbol kBlock("Block");
+
+constexpr uint32_t None = ControlFlowGraph::None;
+} // namespace
+
+ASTNode* DeadStoreElimination::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    removedStores = 0;
+    removedDeclarations = 0;
+    savedBytes = 0;
+
+    ASTNode* result = root;
+    size_t next = 0; // graphs are in the order of the program's functions
+    for (const ControlFlowGraph& graph : graphs) {
+        collectAccesses(graph);
+        solveLiveness(graph);
+        findDeadStores(graph);
+        if (fates.empty()) continue;
+
+        auto function = const_cast<ASTNode*>(graph.function());
+        auto rewritten = rewriteStatement(function);
+        if (rewritten == function) continue;
+        if (function == root) {
+            result = rewritten;
+            continue;
+        }
+        while (root->children[next] != function) ++next;
+        if (result == root) result = root->shallowCopy(arena);
+        result->children[next] = rewritten;
+    }
+
+    if (removedStores + removedDeclarations > 0) {
+        std::cout << "[Optimizer] Removed " << removedStores << " dead store" << (removedStores == 1 ? "" : "s")
+                  << " and " << removedDeclarations << " dead declaration" << (removedDeclarations == 1 ? "" : "s")
+                  << ", saving " << savedBytes << " bytes of code" << std::endl;
+    }
+    rewrites += removedStores + removedDeclarations;
+    return result;
+}
+
+// Lists the accesses of every block once, so that solving the dataflow
+// problem only walks flat arrays, and decides which variables need a bit
+void DeadStoreElimination::collectAccesses(const ControlFlowGraph& graph) {
+    const auto& blocks = graph.blocks();
+    const size_t variableCount = graph.variables().size();
+
+    postorder.clear();
+    reachable.assign(blocks.size(), false);
+    std::vector<std::pair<uint32_t, size_t>> stack; // (block, next successor slot)
+    stack.emplace_back(ControlFlowGraph::Entry, 0);
+    reachable[ControlFlowGraph::Entry] = true;
+    while (!stack.empty()) {
+        auto& [block, slot] = stack.back();
+        if (slot < 2) {
+            const uint32_t successor = blocks[block].successors[slot++];
+            if (successor != None && !reachable[successor]) {
+                reachable[successor] = true;
+                stack.emplace_back(successor, 0);
+            }
+            continue;
+        }
+        postorder.push_back(block);
+        stack.pop_back();
+    }
+
+    steps.clear();
+    accesses.clear();
+    stepOffsets.assign(blocks.size() + 1, 0);
+    references.assign(variableCount, 0);
+
+    auto read = [&](const ASTNode* identifier) {
+        const uint32_t variable = graph.variableOf(identifier);
+        if (variable == None) return;
+        accesses.push_back(Access{variable, false});
+        ++references[variable];
+    };
+    // The target of a compound assignment or increment was counted as read
+    auto write = [&](const ASTNode* writer, const ASTNode* identifier) {
+        const uint32_t variable = graph.variableOf(identifier);
+        if (variable == None) return;
+        accesses.push_back(Access{variable, true});
+        if (writer->type == ASTNodeType::Assignment || writer->type == ASTNodeType::InputStatement) {
+            ++references[variable];
+        }
+    };
+    auto add = [&](const ASTNode* node, const ASTNode* store) {
+        const auto first = static_cast<uint32_t>(accesses.size());
+        forEachAccess(node, read, write);
+        steps.push_back(Step{store, first, static_cast<uint32_t>(accesses.size())});
+    };
+
+    for (uint32_t block = 0; block < blocks.size(); ++block) {
+        stepOffsets[block] = static_cast<uint32_t>(steps.size());
+        for (const ASTNode* statement : blocks[block].statements) {
+            const ASTNode* store = storeOf(statement);
+            if (store && (graph.variableOf(store->left) == None || hasSideEffects(store->right))) {
+                store = nullptr;
+            }
+            add(statement, store);
+        }
+        if (blocks[block].condition) add(blocks[block].condition, nullptr);
+    }
+    stepOffsets[blocks.size()] = static_cast<uint32_t>(steps.size());
+
+    // A variable is local to the one reachable block referring to it if it
+    // is written there before it is read
+    std::vector<uint32_t> home(variableCount, None);
+    std::vector<bool> shared(variableCount, false);
+    for (uint32_t block : postorder) {
+        for (uint32_t i = stepOffsets[block]; i < stepOffsets[block + 1]; ++i) {
+            for (uint32_t j = steps[i].first; j < steps[i].last; ++j) {
+                const Access& access = accesses[j];
+                if (home[access.variable] == None) {
+                    home[access.variable] = block;
+                    if (!access.write) shared[access.variable] = true;
+                } else if (home[access.variable] != block) {
+                    shared[access.variable] = true;
+                }
+            }
+        }
+    }
+    bitIndex.assign(variableCount, None);
+    uint32_t bits = 0;
+    for (uint32_t variable = 0; variable < variableCount; ++variable) {
+        if (shared[variable]) bitIndex[variable] = bits++;
+    }
+    words = (bits + 63) / 64;
+    localLive.assign(variableCount, false);
+}
+
+// Iterates from nothing live until no block's live-in set grows: the
+// least solution, in which a variable only dead stores read is not live
+void DeadStoreElimination::solveLiveness(const ControlFlowGraph& graph) {
+    const auto& blocks = graph.blocks();
+    liveIn.assign(blocks.size() * words, 0);
+
+    // Popped from the back: successors come before their predecessors
+    std::vector<uint32_t> worklist(postorder.rbegin(), postorder.rend());
+    std::vector<bool> queued(blocks.size(), false);
+    for (uint32_t block : postorder) queued[block] = true;
+
+    std::vector<uint64_t> live(words);
+    while (!worklist.empty()) {
+        const uint32_t block = worklist.back();
+        worklist.pop_back();
+        queued[block] = false;
+
+        std::fill(live.begin(), live.end(), 0);
+        for (uint32_t successor : blocks[block].successors) {
+            if (successor == None) continue;
+            for (size_t w = 0; w < words; ++w) live[w] |= liveIn[successor * words + w];
+        }
+        transfer(block, live, false);
+
+        auto in = liveIn.begin() + block * words;
+        if (std::equal(live.begin(), live.end(), in)) continue;
+        std::copy(live.begin(), live.end(), in);
+        for (uint32_t predecessor : blocks[block].predecessors) {
+            if (reachable[predecessor] && !queued[predecessor]) {
+                queued[predecessor] = true;
+                worklist.push_back(predecessor);
+            }
+        }
+    }
+}
+
+// Turns what is live after `block` into what is live before it. A store
+// of a variable that is not live is dead, and what it reads is not
+// needed for it; with `record`, dead stores are collected.
+//
+// Variables without a bit are never live after their block, and the
+// first access to one in its block is a write: their flags are clear
+// again once the scan is done.
+void DeadStoreElimination::transfer(uint32_t block, std::vector<uint64_t>& live, bool record) {
+    auto isLive = [&](uint32_t variable) -> bool {
+        const uint32_t bit = bitIndex[variable];
+        if (bit == None) return localLive[variable];
+        return (live[bit / 64] >> (bit % 64)) & 1;
+    };
+    auto setLive = [&](uint32_t variable, bool value) {
+        const uint32_t bit = bitIndex[variable];
+        if (bit == None) {
+            localLive[variable] = value;
+        } else if (value) {
+            live[bit / 64] |= uint64_t(1) << (bit % 64);
+        } else {
+            live[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+        }
+    };
+
+    for (uint32_t i = stepOffsets[block + 1]; i-- > stepOffsets[block];) {
+        const Step& step = steps[i];
+        // The store's own write is its last access
+        if (step.store && !isLive(accesses[step.last - 1].variable)) {
+            if (record) deadStores.push_back(step.store);
+            continue;
+        }
+        for (uint32_t j = step.last; j-- > step.first;) {
+            setLive(accesses[j].variable, !accesses[j].write);
+        }
+    }
+}
+
+void DeadStoreElimination::findDeadStores(const ControlFlowGraph& graph) {
+    const auto& blocks = graph.blocks();
+    deadStores.clear();
+    fates.clear();
+
+    std::vector<uint64_t> live(words);
+    for (uint32_t block : postorder) {
+        std::fill(live.begin(), live.end(), 0);
+        for (uint32_t successor : blocks[block].successors) {
+            if (successor == None) continue;
+            for (size_t w = 0; w < words; ++w) live[w] |= liveIn[successor * words + w];
+        }
+        transfer(block, live, true);
+    }
+
+    // Identifiers inside removed code no longer refer to their variables
+    for (const ASTNode* store : deadStores) {
+        forEachAccess(
+            store->right,
+            [&](const ASTNode* identifier) {
+                const uint32_t variable = graph.variableOf(identifier);
+                if (variable != None) --references[variable];
+            },
+            [](const ASTNode*, const ASTNode*) {});
+        if (store->type != ASTNodeType::Declaration) --references[graph.variableOf(store->left)];
+    }
+
+    for (const ASTNode* store : deadStores) {
+        if (store->type != ASTNodeType::Declaration) {
+            fates.emplace_back(store, Fate::Remove);
+        } else if (references[graph.variableOf(store->left)] == 0) {
+            fates.emplace_back(store, Fate::Remove);
+        } else if (store->right) {
+            fates.emplace_back(store, Fate::DropInitializer);
+        }
+    }
+    std::sort(fates.begin(), fates.end(),
+              [](const std::pair<const ASTNode*, Fate>& a, const std::pair<const ASTNode*, Fate>& b) {
+                  return a.first < b.first;
+              });
+}
+
+// A compound assignment statement is judged by the assignment it holds
+DeadStoreElimination::Fate DeadStoreElimination::fateOf(const ASTNode* statement) const {
+    if (statement->type == ASTNodeType::ExpressionStatement && statement->left) statement = statement->left;
+    auto it = std::lower_bound(fates.begin(), fates.end(), statement,
+                               [](const std::pair<const ASTNode*, Fate>& entry, const ASTNode* key) {
+                                   return entry.first < key;
+                               });
+    return it != fates.end() && it->first == statement ? it->second : Fate::Keep;
+}
+
+// Returns the rewritten statement, or null if it is removed
+ASTNode* DeadStoreElimination::rewriteStatement(ASTNode* node) {
+    if (!node) return nullptr;
+
+    switch (fateOf(node)) {
+        case Fate::Remove:
+            ++(node->type == ASTNodeType::Declaration ? removedDeclarations : removedStores);
+            savedBytes += emittedSize(node);
+            return nullptr;
+        case Fate::DropInitializer: {
+            auto declaration = node->shallowCopy(arena);
+            declaration->right = nullptr;
+            ++removedStores;
+            savedBytes += emittedSize(node) - emittedSize(declaration);
+            return declaration;
+        }
+        case Fate::Keep:
+            break;
+    }
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+    // A loop or if body that is removed leaves an empty block behind
+    auto body = [&](ASTNode* statement) {
+        auto rewritten = rewriteStatement(statement);
+        if (statement && !rewritten) {
+            rewritten = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+            savedBytes -= emittedSize(rewritten);
+        }
+        return rewritten;
+    };
+    auto setLeft = [&](ASTNode* left) {
+        if (left != node->left) own()->left = left;
+    };
+    auto setRight = [&](ASTNode* right) {
+        if (right != node->right) own()->right = right;
+    };
+    auto setChild = [&](size_t i, ASTNode* child) {
+        if (child != node->children[i]) own()->children[i] = child;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Program:
+        case ASTNodeType::Block: {
+            size_t kept = 0;
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                ASTNode* child = node->children[i];
+                auto rewritten = rewriteStatement(child);
+                if (rewritten != child) own();
+                if (child && !rewritten) continue;
+                if (result != node) result->children[kept] = rewritten;
+                ++kept;
+            }
+            if (result != node) result->children.resize(kept);
+            break;
+        }
+
+        case ASTNodeType::FunctionDeclaration:
+            setLeft(body(node->left));
+            break;
+
+        case ASTNodeType::IfStatement:
+        case ASTNodeType::WhileStatement:
+            setRight(body(node->right));
+            break;
+
+        case ASTNodeType::DoWhileStatement:
+            setLeft(body(node->left));
+            break;
+
+        // A removed initializer or increment leaves its slot empty
+        case ASTNodeType::ForStatement:
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                ASTNode* child = node->children[i];
+                setChild(i, i == 1 ? child : i == 3 ? body(child) : rewriteStatement(child));
+            }
+            break;
+
+        default:
+            break;
+    }
+    return result;
+}
+
+// The store a statement makes, if removing the statement removes just it
+const ASTNode* DeadStoreElimination::storeOf(const ASTNode* statement) {
+    switch (statement->type) {
+        case ASTNodeType::Declaration:
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+            return statement;
+        case ASTNodeType::ExpressionStatement:
+            if (statement->left && (statement->left->type == ASTNodeType::CompoundAssignment ||
+                                    statement->left->type == ASTNodeType::Assignment)) {
+                return statement->left;
+            }
+            return nullptr;
+        default:
+            return nullptr;
+    }
+}
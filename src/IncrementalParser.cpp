@@ -0,0 +1,286 @@
+#include "../include/IncrementalParser.h"
+#include <algorithm>
+#include <stdexcept>
+
+// How the positions of everything after the edit move. Lines after the one
+// the edit ended on keep their columns; nodes on that line also move sideways.
+struct IncrementalParser::Shift {
+    size_t removed = 0;
+    size_t inserted = 0;
+    uint32_t editLine = 0; // line the edit ended on, in old numbering
+    size_t editLineEnd = 0; // old offset of the end of that line
+    int64_t lines = 0;
+    int64_t columns = 0;
+
+    bool movesAnything() const { return removed != inserted || lines != 0 || columns != 0; }
+};
+
+namespace {
+
+// A statement decides nothing based on tokens further past its end than
+// the parser's lookahead window reaches
+constexpr size_t kLookaheadTokens = TokenStream::Lookahead - 1;
+
+// Statement lists are the only places a reparse can start and stop
+bool isList(const ASTNode* node) {
+    return node->type == ASTNodeType::Program || node->type == ASTNodeType::Block;
+}
+
+// A block in `stmt` (or `stmt` itself) whose braces strictly enclose [begin, end)
+ASTNode* enclosingBlock(ASTNode* stmt, size_t begin, size_t end) {
+    auto encloses = [&](ASTNode* node) {
+        return node && node->type == ASTNodeType::Block && node->span.begin < begin && end < node->span.end;
+    };
+    if (encloses(stmt)) return stmt;
+    if (encloses(stmt->left)) return stmt->left;
+    if (encloses(stmt->right)) return stmt->right;
+    for (ASTNode* child : stmt->children) {
+        if (encloses(child)) return child;
+    }
+    return nullptr;
+}
+
+// Line and column reached by walking text[from, to) from `start`
+SourceLocation advanceLocation(std::string_view text, size_t from, size_t to, SourceLocation start) {
+    SourceLocation loc = start;
+    size_t lineStart = std::string_view::npos;
+    for (size_t i = from; i < to; ++i) {
+        if (text[i] == '\n') {
+            ++loc.line;
+            lineStart = i + 1;
+        }
+    }
+    loc.column = lineStart == std::string_view::npos
+        ? start.column + static_cast<uint32_t>(to - from)
+        : static_cast<uint32_t>(to - lineStart + 1);
+    return loc;
+}
+
+} // namespace
+
+ASTNode* IncrementalParser::reparse(ASTNode* program, const SourceBuffer& oldSource,
+                                    const SourceBuffer& newSource, const TextEdit& edit) {
+    if (edit.offset + edit.removed > oldSource.size() ||
+        edit.offset + edit.inserted > newSource.size() ||
+        oldSource.size() - edit.removed + edit.inserted != newSource.size()) {
+        throw std::invalid_argument("Edit does not match the old and new sources");
+    }
+    lastStats = ReparseStats();
+
+    const size_t editBegin = edit.offset;
+    const size_t editEnd = edit.offset + edit.removed;
+
+    // Walk down to the innermost block whose braces enclose the edit. The
+    // path keeps every node on the way, each a direct child of the one before.
+    std::vector<ASTNode*> path{program};
+    for (ASTNode* list = program;;) {
+        auto& children = list->children;
+        auto it = std::lower_bound(children.begin(), children.end(), editBegin,
+                                   [](const ASTNode* child, size_t pos) { return child->span.end < pos; });
+        if (it == children.end() || (*it)->span.begin >= editBegin || (*it)->span.end < editEnd) break;
+
+        ASTNode* block = enclosingBlock(*it, editBegin, editEnd);
+        if (!block) break;
+        path.push_back(*it);
+        if (block != *it) path.push_back(block);
+        list = block;
+    }
+
+    // Reparse in the innermost list; if the edit changes where that list
+    // ends, move out one level and reparse the statement holding it instead
+    Shift shift;
+    for (size_t depth = path.size(); depth-- > 0;) {
+        if (!isList(path[depth])) continue;
+        if (reparseList(path[depth], oldSource, newSource, edit, shift)) {
+            shiftAfter(path, depth, shift);
+            return program;
+        }
+        ++lastStats.levelsEscalated;
+    }
+    return program; // not reached: the program level always succeeds
+}
+
+// Reparses the statements of `list` that the edit touches. Returns false,
+// leaving the list untouched, if the list would no longer end where it did.
+bool IncrementalParser::reparseList(ASTNode* list, const SourceBuffer& oldSource,
+                                    const SourceBuffer& newSource, const TextEdit& edit, Shift& shift) {
+    auto& children = list->children;
+    const size_t count = children.size();
+    const bool isBlock = list->type == ASTNodeType::Block;
+    const size_t editBegin = edit.offset;
+    const size_t editEnd = edit.offset + edit.removed;
+    const size_t newEditEnd = edit.offset + edit.inserted;
+
+    // Where the list's statements start, and whether it had its closing brace
+    const size_t contentBegin = isBlock ? list->span.begin + 1 : 0;
+    const SourceLocation contentLoc = isBlock ? SourceLocation{list->loc.line, list->loc.column + 1}
+                                              : SourceLocation{1, 1};
+    const bool closed = isBlock && list->span.end > (count ? children.back()->span.end : contentBegin);
+
+    // Start at the first statement reaching the edit, or the one before it
+    // if the edit falls in the gap between two statements
+    size_t first = static_cast<size_t>(
+        std::lower_bound(children.begin(), children.end(), editBegin,
+                         [](const ASTNode* child, size_t pos) { return child->span.end < pos; }) -
+        children.begin());
+    if (first > 0 && (first == count || children[first]->span.begin > editBegin)) --first;
+
+    // Whatever the old parse did before the restart point (statements and
+    // skipped tokens alike) must not have looked ahead into the edit;
+    // otherwise restart one statement earlier
+    bool fromListStart = first == count || children[first]->span.begin > editBegin;
+    while (!fromListStart &&
+           countTokensBefore(newSource, children[first]->span.begin, editBegin, kLookaheadTokens) < kLookaheadTokens) {
+        if (first == 0) {
+            fromListStart = true;
+        } else {
+            --first;
+        }
+    }
+    if (fromListStart && isBlock &&
+        countTokensBefore(newSource, contentBegin, editBegin, kLookaheadTokens) < kLookaheadTokens) {
+        return false; // the statement holding the block may have looked into the edit
+    }
+
+    const size_t start = fromListStart ? contentBegin : children[first]->span.begin;
+    const SourceLocation startLoc = fromListStart ? contentLoc : children[first]->loc;
+
+    // Parse statements the way Parser::parseBlock / parseTopLevel would,
+    // until the parser is back at the start of an old statement after the edit
+    Parser parser(newSource, SourceRange{start, newSource.size(), startLoc}, arena, backend);
+    std::vector<ASTNode*> fresh;
+    size_t resume = first; // first old statement that may still be reused
+    for (;;) {
+        if (parser.tokens.atEnd()) {
+            // A block that runs to the end of the input ends wherever its
+            // last statement does now; let the enclosing level redo it
+            if (isBlock) return false;
+            resume = count;
+            break;
+        }
+
+        const Token& current = parser.peek();
+        const bool closingBrace = isBlock && current.kind == TokenKind::RBrace;
+        if (current.offset >= newEditEnd) {
+            const size_t oldOffset = current.offset - edit.inserted + edit.removed;
+            while (resume < count && children[resume]->span.begin < oldOffset) ++resume;
+            if (closingBrace) {
+                if (!closed || resume != count || oldOffset != list->span.end - 1) return false;
+                break; // the same closing brace as before
+            }
+            if (resume < count && children[resume]->span.begin == oldOffset) break;
+        } else if (closingBrace) {
+            return false; // the edit closes the block early
+        }
+
+        ASTNode* stmt = parser.parseStatement();
+        if (stmt) {
+            fresh.push_back(stmt);
+        } else {
+            parser.tokens.advance();
+        }
+    }
+
+    lastStats.bytesRelexed += std::max(parser.tokens.consumedEnd(), start) - start;
+    lastStats.statementsReparsed += fresh.size();
+    lastStats.statementsReplaced += resume - first;
+
+    // Work out how positions after the edit move
+    const SourceLocation editLoc = advanceLocation(newSource.view(), start, editBegin, startLoc);
+    const SourceLocation oldEnd = advanceLocation(oldSource.view(), editBegin, editEnd, editLoc);
+    const SourceLocation newEnd = advanceLocation(newSource.view(), editBegin, newEditEnd, editLoc);
+    shift.removed = edit.removed;
+    shift.inserted = edit.inserted;
+    shift.editLine = oldEnd.line;
+    shift.editLineEnd = std::min(oldSource.view().find('\n', editEnd), oldSource.size());
+    shift.lines = int64_t(newEnd.line) - int64_t(oldEnd.line);
+    shift.columns = int64_t(newEnd.column) - int64_t(oldEnd.column);
+
+    // Splice the new statements in place of the old ones
+    if (fresh.size() == resume - first) {
+        std::copy(fresh.begin(), fresh.end(), children.begin() + first);
+    } else {
+        children.erase(children.begin() + first, children.begin() + resume);
+        children.insert(children.begin() + first, fresh.begin(), fresh.end());
+    }
+    if (shift.movesAnything()) {
+        for (size_t k = first + fresh.size(); k < children.size(); ++k) {
+            shiftSubtree(children[k], shift);
+        }
+    }
+    if (isBlock) {
+        list->span.end = list->span.end - edit.removed + edit.inserted;
+    }
+    return true;
+}
+
+// Number of tokens, up to `enough`, from `from` on that end before `limit`
+// (a token ending right at the edit could absorb the inserted text)
+size_t IncrementalParser::countTokensBefore(const SourceBuffer& source, size_t from, size_t limit, size_t enough) {
+    Lexer lexer(source, SourceRange{from, source.size(), SourceLocation{1, 1}}, backend);
+    Token token;
+    size_t tokens = 0;
+    size_t end = from;
+    while (tokens < enough && lexer.scan(token) && token.offset + token.value.size() < limit) {
+        end = token.offset + token.value.size();
+        ++tokens;
+    }
+    lastStats.bytesRelexed += end - from;
+    return tokens;
+}
+
+// Ancestors of the reparsed list: their spans grow or shrink by the edit
+// and whatever follows the path inside them moves with it
+void IncrementalParser::shiftAfter(const std::vector<ASTNode*>& path, size_t depth, const Shift& shift) {
+    for (size_t d = depth; d-- > 0;) {
+        ASTNode* node = path[d];
+        ASTNode* onPath = path[d + 1];
+        if (node->span.end != 0) {
+            node->span.end = node->span.end - shift.removed + shift.inserted;
+        }
+        if (!shift.movesAnything()) continue;
+
+        // left, right, then children is source order for every statement
+        // but a function, whose result type and parameters precede its body
+        bool after = false;
+        auto visit = [&](ASTNode* child) {
+            if (after) shiftSubtree(child, shift);
+            if (child == onPath) after = true;
+        };
+        if (node->type == ASTNodeType::FunctionDeclaration) {
+            visit(node->right);
+            for (ASTNode* child : node->children) visit(child);
+            visit(node->left);
+            continue;
+        }
+        visit(node->left);
+        visit(node->right);
+        for (ASTNode* child : node->children) visit(child);
+    }
+}
+
+void IncrementalParser::shiftSubtree(ASTNode* node, const Shift& shift) {
+    if (!node) return;
+    // If no line moved, nothing in a statement that starts past the edit
+    // line changes position; only the spans of statements in it still move.
+    // An expression's own line says nothing: its left operand may come
+    // before a string spanning lines.
+    const bool spansOnly = shift.lines == 0 && node->span.end != 0 && node->span.begin > shift.editLineEnd;
+    if (node->span.end != 0) {
+        node->span.begin = node->span.begin - shift.removed + shift.inserted;
+        node->span.end = node->span.end - shift.removed + shift.inserted;
+    }
+    if (node->loc.line != 0) {
+        if (node->loc.line == shift.editLine) {
+            node->loc.column = static_cast<uint32_t>(int64_t(node->loc.column) + shift.columns);
+        }
+        node->loc.line = static_cast<uint32_t>(int64_t(node->loc.line) + shift.lines);
+    }
+
+    auto visit = [&](ASTNode* child) {
+        if (child && (!spansOnly || child->span.end != 0)) shiftSubtree(child, shift);
+    };
+    visit(node->left);
+    visit(node->right);
+    for (ASTNode* child : node->children) visit(child);
+}
@@ -0,0 +1,414 @@
+#include "../include/Inliner.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+const Symbol kMain("main");
+const Symbol kAnd("&&");
+const Symbol kOr("||");
+const Symbol kResult("result");
+
+constexpr uint32_t None = ControlFlowGraph::None;
+
+size_t sizeOf(const ASTNode* node) {
+    if (!node) return 0;
+    size_t size = 1 + sizeOf(node->left) + sizeOf(node->right);
+    for (const ASTNode* child : node->children) {
+        size += sizeOf(child);
+    }
+    return size;
+}
+
+size_t countOf(const ASTNode* node, ASTNodeType type) {
+    if (!node) return 0;
+    size_t count = (node->type == type) + countOf(node->left, type) + countOf(node->right, type);
+    for (const ASTNode* child : node->children) {
+        count += countOf(child, type);
+    }
+    return count;
+}
+
+size_t usesOf(const ASTNode* node, Symbol name) {
+    if (!node) return 0;
+    if (node->type == ASTNodeType::Identifier) return node->value == name;
+    size_t uses = usesOf(node->left, name) + usesOf(node->right, name);
+    for (const ASTNode* child : node->children) {
+        uses += usesOf(child, name);
+    }
+    return uses;
+}
+
+// Whether every name under `node` is a variable of the function `graph`
+// belongs to, which only the function itself can write
+bool onlyLocals(const ASTNode* node, const ControlFlowGraph& graph) {
+    if (!node) return true;
+    if (node->type == ASTNodeType::Identifier) return graph.variableOf(node) != None;
+    if (!onlyLocals(node->left, graph) || !onlyLocals(node->right, graph)) return false;
+    return std::all_of(node->children.begin(), node->children.end(),
+                       [&](const ASTNode* child) { return onlyLocals(child, graph); });
+}
+
+void collectDeclared(const ASTNode* node, std::vector<Symbol>& names) {
+    if (!node) return;
+    const bool declaration = node->type == ASTNodeType::Declaration || node->type == ASTNodeType::ArrayDeclaration;
+    if (declaration && node->left && node->left->type == ASTNodeType::Identifier &&
+        std::find(names.begin(), names.end(), node->left->value) == names.end()) {
+        names.push_back(node->left->value);
+    }
+    collectDeclared(node->left, names);
+    collectDeclared(node->right, names);
+    for (const ASTNode* child : node->children) {
+        collectDeclared(child, names);
+    }
+}
+
+// The expression of a statement calls are inlined from: what a
+// declaration or assignment stores, what an expression statement or
+// return statement computes, or what an if statement tests
+ASTNode* expressionOf(const ASTNode* statement) {
+    switch (statement->type) {
+        case ASTNodeType::Declaration:
+        case ASTNodeType::Assignment:
+            return statement->right;
+        case ASTNodeType::ExpressionStatement:
+            if (statement->left && statement->left->type == ASTNodeType::CompoundAssignment) {
+                return statement->left->right;
+            }
+            return statement->left;
+        case ASTNodeType::ReturnStatement:
+        case ASTNodeType::IfStatement:
+            return statement->left;
+        default:
+            return nullptr;
+    }
+}
+
+ASTNode* withExpression(ASTArena& arena, const ASTNode* statement, ASTNode* expression) {
+    auto copy = statement->shallowCopy(arena);
+    switch (statement->type) {
+        case ASTNodeType::Declaration:
+        case ASTNodeType::Assignment:
+            copy->right = expression;
+            break;
+        case ASTNodeType::ExpressionStatement:
+            if (statement->left && statement->left->type == ASTNodeType::CompoundAssignment) {
+                copy->left = statement->left->shallowCopy(arena);
+                copy->left->right = expression;
+            } else {
+                copy->left = expression;
+            }
+            break;
+        default:
+            copy->left = expression;
+            break;
+    }
+    return copy;
+}
+} // namespace
+
+ASTNode* Inliner::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    if (!root || root->type != ASTNodeType::Program) return root;
+    calls = &analyses.get<Calls>(root);
+    const auto& functions = calls->functions();
+    if (std::none_of(functions.begin(), functions.end(), [](const CallGraph::Function& function) {
+            return function.definition && function.calls > 0 && !function.recursive;
+        })) {
+        calls = nullptr;
+        return root;
+    }
+    writeSets = &analyses.get<WrittenVariables>(root);
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    const size_t count = functions.size();
+    callees.assign(count, Callee());
+    inlinedCalls.assign(count, 0);
+    copiedCalls.assign(count, 0);
+    inlined = 0;
+
+    for (const ControlFlowGraph& functionGraph : graphs) {
+        const uint32_t function = calls->find(functionGraph.function()->value);
+        if (functions[function].definition == functionGraph.function()) {
+            callees[function].graph = &functionGraph;
+        }
+    }
+    for (uint32_t function = 0; function < count; ++function) {
+        examine(function);
+    }
+
+    ASTNode* result = root;
+    if (std::any_of(callees.begin(), callees.end(), [](const Callee& callee) { return callee.definition; })) {
+        size_t next = 0; // graphs are in the order of the program's functions
+        for (const ControlFlowGraph& functionGraph : graphs) {
+            graph = &functionGraph;
+            auto function = const_cast<ASTNode*>(graph->function());
+            auto rewritten = rewriteStatement(function);
+            if (rewritten == function) continue;
+            while (root->children[next] != function) ++next;
+            if (result == root) result = root->shallowCopy(arena);
+            result->children[next] = rewritten;
+        }
+    }
+
+    // Functions no call to is left, nor copied with another body
+    if (result != root) {
+        size_t kept = 0;
+        for (ASTNode* child : result->children) {
+            if (child && child->type == ASTNodeType::FunctionDeclaration) {
+                const uint32_t function = calls->find(child->value);
+                const size_t total = functions[function].calls;
+                if (total > 0 && inlinedCalls[function] == total && copiedCalls[function] == 0) {
+                    if (child->left) {
+                        std::cout << "[Optimizer] Removed function " << child->value
+                                  << ": every call to it was inlined" << std::endl;
+                    }
+                    continue;
+                }
+            }
+            result->children[kept++] = child;
+        }
+        result->children.resize(kept);
+    }
+
+    rewrites += inlined;
+    graph = nullptr;
+    writeSets = nullptr;
+    calls = nullptr;
+    return result;
+}
+
+// Decides whether calls to a function are inlined, and what its body
+// declares if they are
+void Inliner::examine(uint32_t function) {
+    const CallGraph::Function& info = calls->functions()[function];
+    Callee& callee = callees[function];
+    const ASTNode* definition = info.definition;
+    if (!definition || !callee.graph || !definition->right || info.name == kMain || info.recursive ||
+        info.calls == 0) {
+        return;
+    }
+
+    const ASTNode* body = definition->left;
+    if (body->type != ASTNodeType::Block || body->children.empty()) return;
+    const ASTNode* last = body->children.back();
+    if (!last || last->type != ASTNodeType::ReturnStatement || !last->left) return;
+    if (countOf(body, ASTNodeType::ReturnStatement) != 1) return;
+    if (info.calls > 1 && sizeOf(body) > budget) return;
+    if (!onlyLocals(body, *callee.graph)) return;
+
+    // A parameter declared again in an inner scope would be renamed
+    // along with it
+    std::vector<Symbol> locals;
+    for (const ASTNode* parameter : definition->children) {
+        if (!parameter->left || parameter->left->type != ASTNodeType::Identifier) return;
+        locals.push_back(parameter->left->value);
+    }
+    const size_t parameters = locals.size();
+    collectDeclared(body, locals);
+    for (size_t i = parameters; i < locals.size(); ++i) {
+        if (std::find(locals.begin(), locals.begin() + parameters, locals[i]) != locals.begin() + parameters) return;
+    }
+
+    callee.definition = definition;
+    callee.locals = std::move(locals);
+}
+
+// Rewrites the blocks under a statement; a statement in a place that
+// holds just one has nowhere to put the code of a call
+ASTNode* Inliner::rewriteStatement(ASTNode* node) {
+    if (!node) return nullptr;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Block: {
+            std::vector<ASTNode*> statements;
+            statements.reserve(node->children.size());
+            for (ASTNode* child : node->children) {
+                if (child) rewriteInto(child, statements);
+            }
+            if (!std::equal(statements.begin(), statements.end(), node->children.begin(), node->children.end())) {
+                own()->children.assign(statements.begin(), statements.end());
+            }
+            break;
+        }
+
+        case ASTNodeType::FunctionDeclaration:
+        case ASTNodeType::DoWhileStatement:
+            if (auto body = rewriteStatement(node->left); body != node->left) own()->left = body;
+            break;
+
+        case ASTNodeType::IfStatement:
+        case ASTNodeType::WhileStatement:
+            if (auto body = rewriteStatement(node->right); body != node->right) own()->right = body;
+            break;
+
+        case ASTNodeType::ForStatement:
+            if (node->children.size() > 3) {
+                if (auto body = rewriteStatement(node->children[3]); body != node->children[3]) own()->children[3] = body;
+            }
+            break;
+
+        default:
+            break;
+    }
+    return result;
+}
+
+// Appends the rewritten statement to `out`, preceded by the code of the
+// calls inlined from it
+void Inliner::rewriteInto(ASTNode* statement, std::vector<ASTNode*>& out) {
+    ASTNode* current = rewriteStatement(statement);
+    const ASTNode* expression = expressionOf(current);
+    if (!expression) {
+        out.push_back(current);
+        return;
+    }
+
+    // Calls that come with an inlined body wait for the next run
+    for (size_t left = countOf(expression, ASTNodeType::CallExpression); left > 0; --left) {
+        const ASTNode* call = findCall(expressionOf(current));
+        if (!call) break;
+        ASTNode* value = expand(call, out);
+        if (current->type == ASTNodeType::ExpressionStatement && current->left == call && !hasSideEffects(value)) {
+            return; // the value goes unused
+        }
+        current = withExpression(arena, current, replace(expressionOf(current), call, value));
+    }
+    out.push_back(current);
+}
+
+// The first call, in the order they are made, that can be inlined; none
+// that && or || may skip
+const ASTNode* Inliner::findCall(const ASTNode* node) const {
+    if (!node) return nullptr;
+    if (node->type == ASTNodeType::BinaryOperation && (node->value == kAnd || node->value == kOr)) {
+        return findCall(node->left);
+    }
+    if (node->type == ASTNodeType::CallExpression &&
+        std::none_of(node->children.begin(), node->children.end(), hasSideEffects)) {
+        const uint32_t function = calls->find(node->value);
+        if (function == None || !callees[function].definition) return nullptr;
+        return callees[function].definition->children.size() == node->children.size() ? node : nullptr;
+    }
+
+    if (auto call = findCall(node->left)) return call;
+    if (auto call = findCall(node->right)) return call;
+    for (const ASTNode* child : node->children) {
+        if (auto call = findCall(child)) return call;
+    }
+    return nullptr;
+}
+
+// Appends the code of a call to `out`; returns the expression that takes
+// the call's place
+ASTNode* Inliner::expand(const ASTNode* call, std::vector<ASTNode*>& out) {
+    const uint32_t function = calls->find(call->value);
+    const Callee& callee = callees[function];
+    const ASTNode* definition = callee.definition;
+    const ASTNode* body = definition->left;
+    const ASTNode* returned = body->children.back()->left;
+    const bool onlyReturn = body->children.size() == 1;
+    const SymbolRange written = writeSets->of(body);
+    const size_t number = ++expansions;
+    renamed.clear();
+
+    for (size_t i = 0; i < definition->children.size(); ++i) {
+        const ASTNode* parameter = definition->children[i];
+        const Symbol name = parameter->left->value;
+        ASTNode* argument = call->children[i];
+        const ValueType type = declaredType(parameter->value);
+        const bool simple = argument->type == ASTNodeType::Literal || argument->type == ASTNodeType::Identifier;
+        if (type != ValueType::Unknown && expressionType(argument, *graph) == type && onlyLocals(argument, *graph) &&
+            std::find(written.begin(), written.end(), name) == written.end() &&
+            (simple || (onlyReturn && usesOf(returned, name) <= 1))) {
+            renamed[name] = argument;
+            continue;
+        }
+        auto variable = arena.create<ASTNode>(arena, ASTNodeType::Identifier, freshName(call->value, name, number));
+        auto declaration = arena.create<ASTNode>(arena, ASTNodeType::Declaration, parameter->value);
+        declaration->loc = call->loc;
+        declaration->left = variable;
+        declaration->right = argument;
+        out.push_back(declaration);
+        renamed[name] = variable;
+    }
+    for (size_t i = definition->children.size(); i < callee.locals.size(); ++i) {
+        const Symbol name = callee.locals[i];
+        renamed[name] = arena.create<ASTNode>(arena, ASTNodeType::Identifier, freshName(call->value, name, number));
+    }
+
+    for (size_t i = 0; i + 1 < body->children.size(); ++i) {
+        if (body->children[i]) out.push_back(copyRenamed(body->children[i]));
+    }
+    for (uint32_t called : calls->functions()[function].callees) {
+        ++copiedCalls[called];
+    }
+
+    // The returned value, converted to the return type where it is not
+    // of that type already
+    ASTNode* value = copyRenamed(returned);
+    const Symbol returnType = definition->right->value;
+    const ValueType type = declaredType(returnType);
+    if (type == ValueType::Unknown || expressionType(returned, *callee.graph) != type) {
+        const Symbol name = freshName(call->value, kResult, number);
+        auto declaration = arena.create<ASTNode>(arena, ASTNodeType::Declaration, returnType);
+        declaration->loc = call->loc;
+        declaration->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, name);
+        declaration->right = value;
+        out.push_back(declaration);
+        value = arena.create<ASTNode>(arena, ASTNodeType::Identifier, name);
+    }
+
+    std::cout << "[Optimizer] Inlined the call to " << call->value << " on line " << call->loc.line << std::endl;
+    ++inlinedCalls[function];
+    ++inlined;
+    return value;
+}
+
+// A copy of code of the function being expanded, with its names replaced
+ASTNode* Inliner::copyRenamed(const ASTNode* node) {
+    if (!node) return nullptr;
+    if (node->type == ASTNodeType::Identifier && renamed.contains(node->value)) {
+        return renamed.at(node->value)->deepCopy(arena);
+    }
+    auto copy = node->shallowCopy(arena);
+    copy->left = copyRenamed(node->left);
+    copy->right = copyRenamed(node->right);
+    for (auto& child : copy->children) {
+        child = copyRenamed(child);
+    }
+    return copy;
+}
+
+// `node` with `target` somewhere under it replaced, copying the nodes on
+// the way
+ASTNode* Inliner::replace(ASTNode* node, const ASTNode* target, ASTNode* replacement) {
+    if (!node) return nullptr;
+    if (node == target) return replacement;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+    if (auto left = replace(node->left, target, replacement); left != node->left) own()->left = left;
+    if (auto right = replace(node->right, target, replacement); right != node->right) own()->right = right;
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        auto child = replace(node->children[i], target, replacement);
+        if (child != node->children[i]) own()->children[i] = child;
+    }
+    return result;
+}
+
+// function_name_number, or the first free name after it
+Symbol Inliner::freshName(Symbol function, Symbol name, size_t number) {
+    std::string text;
+    do {
+        text = std::string(function.str()) + "_" + std::string(name.str()) + "_" + std::to_string(number++);
+    } while (StringInterner::global().contains(text));
+    return Symbol(text);
+}
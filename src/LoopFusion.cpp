@@ -0,0 +1,346 @@
+#include "../include/LoopFusion.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+const Symbol kInt("int");
+const Symbol kFor("for");
+const Symbol kBlock("Block");
+
+constexpr uint32_t None = ControlFlowGraph::None;
+
+bool contains(const ASTNode* node, ASTNodeType type) {
+    if (!node) return false;
+    if (node->type == type || contains(node->left, type) || contains(node->right, type)) return true;
+    return std::any_of(node->children.begin(), node->children.end(),
+                       [&](const ASTNode* child) { return contains(child, type); });
+}
+
+bool declares(const ASTNode* node, Symbol name) {
+    if (!node) return false;
+    if ((node->type == ASTNodeType::Declaration || node->type == ASTNodeType::ArrayDeclaration) && node->left &&
+        node->left->value == name) {
+        return true;
+    }
+    if (declares(node->left, name) || declares(node->right, name)) return true;
+    return std::any_of(node->children.begin(), node->children.end(),
+                       [&](const ASTNode* child) { return declares(child, name); });
+}
+
+// Whether a loop body declares variables at its top level
+bool declaresVariables(const ASTNode* body) {
+    if (body->type != ASTNodeType::Block) {
+        return body->type == ASTNodeType::Declaration || body->type == ASTNodeType::ArrayDeclaration;
+    }
+    return std::any_of(body->children.begin(), body->children.end(), [](const ASTNode* statement) {
+        return statement && (statement->type == ASTNodeType::Declaration ||
+                             statement->type == ASTNodeType::ArrayDeclaration);
+    });
+}
+
+bool intersects(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    auto i = a.begin();
+    auto j = b.begin();
+    while (i != a.end() && j != b.end()) {
+        if (*i == *j) return true;
+        if (*i < *j) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return false;
+}
+
+void sortUnique(std::vector<uint32_t>& variables) {
+    std::sort(variables.begin(), variables.end());
+    variables.erase(std::unique(variables.begin(), variables.end()), variables.end());
+}
+} // namespace
+
+ASTNode* LoopFusion::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    fused = 0;
+    globals.clear();
+    for (const ASTNode* child : root->children) {
+        if (child && (child->type == ASTNodeType::Declaration || child->type == ASTNodeType::ArrayDeclaration) &&
+            child->left) {
+            globals.push_back(Global{child->left->value, child->type == ASTNodeType::ArrayDeclaration});
+        }
+    }
+
+    ASTNode* result = root;
+    size_t next = 0; // graphs are in the order of the program's functions
+    for (const ControlFlowGraph& functionGraph : graphs) {
+        graph = &functionGraph;
+        auto function = const_cast<ASTNode*>(graph->function());
+        auto rewritten = rewriteStatement(function);
+        if (rewritten == function) continue;
+        if (function == root) {
+            result = rewritten;
+            continue;
+        }
+        while (root->children[next] != function) ++next;
+        if (result == root) result = root->shallowCopy(arena);
+        result->children[next] = rewritten;
+    }
+
+    rewrites += fused;
+    graph = nullptr;
+    globals.clear();
+    return result;
+}
+
+// Rewrites the statement lists under a statement
+ASTNode* LoopFusion::rewriteStatement(ASTNode* node) {
+    if (!node) return nullptr;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Program:
+        case ASTNodeType::Block:
+            return rewriteList(node);
+
+        case ASTNodeType::FunctionDeclaration:
+        case ASTNodeType::DoWhileStatement:
+            if (auto body = rewriteStatement(node->left); body != node->left) own()->left = body;
+            break;
+
+        case ASTNodeType::IfStatement:
+        case ASTNodeType::WhileStatement:
+            if (auto body = rewriteStatement(node->right); body != node->right) own()->right = body;
+            break;
+
+        case ASTNodeType::ForStatement:
+            if (node->children.size() > 3) {
+                if (auto body = rewriteStatement(node->children[3]); body != node->children[3]) {
+                    own()->children[3] = body;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+    return result;
+}
+
+// Fuses each run of adjacent loops that can be
+ASTNode* LoopFusion::rewriteList(ASTNode* list) {
+    std::vector<ASTNode*> statements;
+    statements.reserve(list->children.size());
+    std::vector<Summary> group;
+    auto flush = [&]() {
+        if (group.size() > 1) {
+            statements.push_back(fuse(group));
+        } else if (!group.empty()) {
+            statements.push_back(group.front().loop);
+        }
+        group.clear();
+    };
+
+    for (ASTNode* child : list->children) {
+        if (!child) {
+            flush();
+            statements.push_back(nullptr);
+            continue;
+        }
+        ASTNode* rewritten = rewriteStatement(child);
+        Summary summary;
+        if (child->type != ASTNodeType::ForStatement || !summarize(child, summary)) {
+            flush();
+            statements.push_back(rewritten);
+            continue;
+        }
+        summary.loop = rewritten;
+        const bool joins = !group.empty() && std::all_of(group.begin(), group.end(), [&](const Summary& earlier) {
+            return fusible(group.front(), earlier, summary);
+        });
+        if (!joins) flush();
+        group.push_back(std::move(summary));
+    }
+    flush();
+
+    if (std::equal(statements.begin(), statements.end(), list->children.begin(), list->children.end())) return list;
+    auto result = list->shallowCopy(arena);
+    result->children.assign(statements.begin(), statements.end());
+    return result;
+}
+
+// Whether the loop has a header fusion can share and a body it can
+// reorder; fills in what the body reads and writes
+bool LoopFusion::summarize(const ASTNode* loop, Summary& summary) {
+    if (loop->value != kFor || loop->children.size() < 4 || !loop->children[3]) return false;
+    const ASTNode* init = loop->children[0];
+    const ASTNode* condition = loop->children[1];
+    const ASTNode* increment = loop->children[2];
+    const ASTNode* body = loop->children[3];
+
+    // for (int i = start; condition; step i), with nothing else written
+    if (!init || init->type != ASTNodeType::Declaration || init->value != kInt || !init->left ||
+        init->left->type != ASTNodeType::Identifier || !init->right || hasSideEffects(init->right)) {
+        return false;
+    }
+    if (!condition || hasSideEffects(condition) || !increment) return false;
+    const Symbol name = init->left->value;
+    const bool steps = (increment->type == ASTNodeType::PreIncrement || increment->type == ASTNodeType::PostIncrement ||
+                        increment->type == ASTNodeType::CompoundAssignment) &&
+                       increment->left && increment->left->type == ASTNodeType::Identifier &&
+                       increment->left->value == name && !hasSideEffects(increment->right);
+    if (!steps) return false;
+
+    if (contains(body, ASTNodeType::CallExpression) || contains(body, ASTNodeType::ReturnStatement) ||
+        declares(body, name)) {
+        return false;
+    }
+    summary.original = loop;
+    summary.io = contains(body, ASTNodeType::PrintStatement) || contains(body, ASTNodeType::InputStatement);
+
+    // Variables the body declares are its own; so are their values
+    std::vector<uint32_t> locals;
+    bool undeclared = false;
+    forEachAccess(
+        body, [](const ASTNode*) {},
+        [&](const ASTNode* writer, const ASTNode* target) {
+            if (writer->type == ASTNodeType::Declaration || writer->type == ASTNodeType::ArrayDeclaration) {
+                locals.push_back(graph->variableOf(target));
+            }
+        });
+    sortUnique(locals);
+    auto record = [&](const ASTNode* identifier, std::vector<uint32_t>& into) {
+        const uint32_t variable = variableOf(identifier);
+        if (variable == None) {
+            undeclared = true;
+        } else if (!isArray(variable) && !std::binary_search(locals.begin(), locals.end(), variable)) {
+            into.push_back(variable);
+        }
+    };
+    forEachAccess(
+        body, [&](const ASTNode* identifier) { record(identifier, summary.reads); },
+        [&](const ASTNode*, const ASTNode* target) { record(target, summary.writes); });
+    sortUnique(summary.reads);
+    sortUnique(summary.writes);
+
+    // The body may change neither the loop variable nor the bounds
+    std::vector<uint32_t> header;
+    auto headerRead = [&](const ASTNode* identifier) { record(identifier, header); };
+    auto headerWrite = [](const ASTNode*, const ASTNode*) {};
+    forEachAccess(init, headerRead, headerWrite);
+    forEachAccess(condition, headerRead, headerWrite);
+    forEachAccess(increment, headerRead, headerWrite);
+    header.push_back(graph->variableOf(init->left));
+    sortUnique(header);
+    if (undeclared || intersects(header, summary.writes)) return false;
+
+    collectElements(body, name, false, summary);
+    return true;
+}
+
+// Records every array element under `node`; `written` if `node` is the
+// target of a store
+void LoopFusion::collectElements(const ASTNode* node, Symbol variable, bool written, Summary& summary) {
+    if (!node) return;
+    switch (node->type) {
+        case ASTNodeType::ArraySubscript: {
+            Element element{variableOf(node->left), written, false, 0};
+            element.affine = affineIndex(node->right, variable, element.offset);
+            summary.elements.push_back(element);
+            collectElements(node->right, variable, false, summary);
+            return;
+        }
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+        case ASTNodeType::PreIncrement:
+        case ASTNodeType::PostIncrement:
+            collectElements(node->left, variable, true, summary);
+            collectElements(node->right, variable, false, summary);
+            return;
+        case ASTNodeType::InputStatement:
+            for (const ASTNode* child : node->children) {
+                collectElements(child, variable, true, summary);
+            }
+            return;
+        default:
+            collectElements(node->left, variable, false, summary);
+            collectElements(node->right, variable, false, summary);
+            for (const ASTNode* child : node->children) {
+                collectElements(child, variable, false, summary);
+            }
+            return;
+    }
+}
+
+// Whether `later` can run in the same iteration right after `earlier`,
+// both loops having the header of `first`
+bool LoopFusion::fusible(const Summary& first, const Summary& earlier, const Summary& later) {
+    for (size_t i = 0; i < 3; ++i) {
+        if (!sameExpression(first.original->children[i], later.original->children[i])) return false;
+    }
+    if (earlier.io && later.io) return false;
+    if (intersects(earlier.writes, later.reads) || intersects(earlier.writes, later.writes) ||
+        intersects(later.writes, earlier.reads)) {
+        return false;
+    }
+
+    // Element i + c of the earlier body is written or used by the later
+    // one in iteration i + c - d; that must not come before iteration i
+    for (const Element& a : earlier.elements) {
+        for (const Element& b : later.elements) {
+            if (a.array != b.array || (!a.write && !b.write)) continue;
+            if (!a.affine || !b.affine || a.offset < b.offset) return false;
+        }
+    }
+    return true;
+}
+
+ASTNode* LoopFusion::fuse(const std::vector<Summary>& group) {
+    auto body = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+    for (size_t i = 0; i < group.size(); ++i) {
+        ASTNode* part = group[i].loop->children[3];
+        // Variables a body declares stay in a scope of their own, where the
+        // bodies after it cannot see them
+        const bool scoped = i + 1 < group.size() && declaresVariables(part);
+        if (part->type == ASTNodeType::Block && !scoped) {
+            for (ASTNode* statement : part->children) {
+                if (statement) body->children.push_back(statement);
+            }
+        } else {
+            body->children.push_back(part);
+        }
+    }
+    auto loop = group.front().loop->shallowCopy(arena);
+    loop->children[3] = body;
+
+    std::cout << "[Optimizer] Fused the for loops on lines ";
+    for (size_t i = 0; i < group.size(); ++i) {
+        if (i > 0) std::cout << (i + 1 == group.size() ? " and " : ", ");
+        std::cout << group[i].original->loc.line;
+    }
+    std::cout << " into one" << std::endl;
+    fused += group.size() - 1;
+    return loop;
+}
+
+// The function's variable an identifier refers to, or else the global;
+// None for a name declared nowhere
+uint32_t LoopFusion::variableOf(const ASTNode* identifier) const {
+    const uint32_t variable = graph->variableOf(identifier);
+    if (variable != None) return variable;
+    for (size_t i = 0; i < globals.size(); ++i) {
+        if (globals[i].name == identifier->value) return static_cast<uint32_t>(graph->variables().size() + i);
+    }
+    return None;
+}
+
+bool LoopFusion::isArray(uint32_t variable) const {
+    const auto& variables = graph->variables();
+    if (variable >= variables.size()) return globals[variable - variables.size()].array;
+    const std::string_view type = variables[variable].type.str();
+    return type.size() > 2 && type.substr(type.size() - 2) == "[]";
+}
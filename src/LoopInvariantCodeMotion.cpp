@@ -0,0 +1,356 @@
+#include "../include/LoopInvariantCodeMotion.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+const Symbol kTrue("true");
+const Symbol kAssign("=");
+const Symbol kIf("if");
+const Symbol kBlock("Block");
+const Symbol kDivide("/");
+const Symbol kModulo("%");
+
+constexpr uint32_t None = ControlFlowGraph::None;
+
+bool isLoop(const ASTNode* node) {
+    return node->type == ASTNodeType::ForStatement || node->type == ASTNodeType::WhileStatement ||
+           node->type == ASTNodeType::DoWhileStatement;
+}
+
+const char* loopName(const ASTNode* loop) {
+    switch (loop->type) {
+        case ASTNodeType::WhileStatement: return "while loop";
+        case ASTNodeType::DoWhileStatement: return "do-while loop";
+        default: return "for loop";
+    }
+}
+
+// An operation is, unless it only negates a variable or a literal
+bool worthATemporary(const ASTNode* node) {
+    if (node->type == ASTNodeType::BinaryOperation) return true;
+    return node->type == ASTNodeType::UnaryOperation && node->left &&
+           (node->left->type == ASTNodeType::BinaryOperation || node->left->type == ASTNodeType::UnaryOperation);
+}
+
+bool writes(SymbolRange written, Symbol name) {
+    return std::binary_search(written.begin(), written.end(), name,
+                              [](Symbol a, Symbol b) { return a.id() < b.id(); });
+}
+} // namespace
+
+ASTNode* LoopInvariantCodeMotion::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    writeSets = &analyses.get<WrittenVariables>(root);
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    hoisted = 0;
+
+    ASTNode* result = root;
+    size_t next = 0; // graphs are in the order of the program's functions
+    for (const ControlFlowGraph& functionGraph : graphs) {
+        graph = &functionGraph;
+        auto function = const_cast<ASTNode*>(graph->function());
+        auto rewritten = rewriteStatement(function);
+        if (rewritten == function) continue;
+        if (function == root) {
+            result = rewritten;
+            continue;
+        }
+        while (root->children[next] != function) ++next;
+        if (result == root) result = root->shallowCopy(arena);
+        result->children[next] = rewritten;
+    }
+
+    rewrites += hoisted;
+    graph = nullptr;
+    writeSets = nullptr;
+    return result;
+}
+
+// Rewrites the loops under a statement that is not a loop itself
+ASTNode* LoopInvariantCodeMotion::rewriteStatement(ASTNode* node) {
+    if (!node) return nullptr;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Program:
+        case ASTNodeType::Block: {
+            std::vector<ASTNode*> statements;
+            statements.reserve(node->children.size());
+            for (ASTNode* child : node->children) {
+                if (child) {
+                    rewriteInto(child, statements);
+                } else {
+                    statements.push_back(nullptr);
+                }
+            }
+            if (!std::equal(statements.begin(), statements.end(), node->children.begin(), node->children.end())) {
+                own()->children.assign(statements.begin(), statements.end());
+            }
+            break;
+        }
+
+        case ASTNodeType::FunctionDeclaration:
+            if (auto body = rewriteNested(node->left); body != node->left) own()->left = body;
+            break;
+
+        case ASTNodeType::IfStatement:
+            if (auto body = rewriteNested(node->right); body != node->right) own()->right = body;
+            break;
+
+        default:
+            break;
+    }
+    return result;
+}
+
+// A statement in a place that holds just one, such as a loop body without
+// braces; a loop that gains temporaries there is put in a block with them
+ASTNode* LoopInvariantCodeMotion::rewriteNested(ASTNode* node) {
+    if (!node) return nullptr;
+    std::vector<ASTNode*> statements;
+    rewriteInto(node, statements);
+    if (statements.size() == 1) return statements.front();
+
+    auto block = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+    block->children.assign(statements.begin(), statements.end());
+    return block;
+}
+
+// Appends the rewritten statement to `out`, preceded by whatever moved
+// out of it
+void LoopInvariantCodeMotion::rewriteInto(ASTNode* node, std::vector<ASTNode*>& out) {
+    if (!isLoop(node)) {
+        out.push_back(rewriteStatement(node));
+        return;
+    }
+
+    // Inner loops first
+    ASTNode* loop = node;
+    auto own = [&]() {
+        if (loop == node) loop = node->shallowCopy(arena);
+        return loop;
+    };
+    if (node->type == ASTNodeType::ForStatement) {
+        if (node->children.size() > 3) {
+            if (auto body = rewriteNested(node->children[3]); body != node->children[3]) own()->children[3] = body;
+        }
+    } else if (node->type == ASTNodeType::WhileStatement) {
+        if (auto body = rewriteNested(node->right); body != node->right) own()->right = body;
+    } else {
+        if (auto body = rewriteNested(node->left); body != node->left) own()->left = body;
+    }
+    moveOutOfLoop(node, loop, out);
+}
+
+// `original` is the loop as the analyses saw it, `loop` the loop with its
+// inner loops rewritten
+void LoopInvariantCodeMotion::moveOutOfLoop(ASTNode* original, ASTNode* loop, std::vector<ASTNode*>& out) {
+    loopWrites = writeSets->of(original);
+    temporaries.clear();
+
+    ASTNode* result = loop;
+    auto rewritePart = [&](ASTNode* part) {
+        auto rewritten = settle(scan(part));
+        if (rewritten != part && result == loop) result = loop->shallowCopy(arena);
+        return rewritten;
+    };
+
+    ASTNode* guard = nullptr;
+    if (loop->type == ASTNodeType::DoWhileStatement) {
+        // The body runs before the condition is first evaluated
+        guarded = false;
+        auto body = rewritePart(loop->left);
+        auto condition = rewritePart(loop->right);
+        if (result != loop) {
+            result->left = body;
+            result->right = condition;
+        }
+    } else {
+        const bool isFor = loop->type == ASTNodeType::ForStatement;
+        auto child = [&](size_t i) { return i < loop->children.size() ? loop->children[i] : nullptr; };
+        guarded = false;
+        auto condition = rewritePart(isFor ? child(1) : loop->left);
+        bool canGuard = true;
+        guard = guardOf(loop, condition, canGuard);
+        auto increment = isFor ? child(2) : nullptr;
+        auto body = isFor ? child(3) : loop->right;
+        if (canGuard) {
+            guarded = guard != nullptr;
+            increment = rewritePart(increment);
+            body = rewritePart(body);
+        }
+        if (result != loop && isFor) {
+            result->children.resize(std::max<size_t>(result->children.size(), 4));
+            result->children[1] = condition;
+            result->children[2] = increment;
+            result->children[3] = body;
+        } else if (result != loop) {
+            result->left = condition;
+            result->right = body;
+        }
+    }
+
+    if (temporaries.empty()) {
+        out.push_back(loop);
+        return;
+    }
+
+    auto guardedBlock = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+    for (const Temporary& temporary : temporaries) {
+        auto declaration = arena.create<ASTNode>(arena, ASTNodeType::Declaration, temporary.type);
+        declaration->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, temporary.name);
+        if (temporary.guarded) {
+            auto assignment = arena.create<ASTNode>(arena, ASTNodeType::Assignment, kAssign);
+            assignment->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, temporary.name);
+            assignment->right = temporary.value;
+            guardedBlock->children.push_back(assignment);
+        } else {
+            declaration->right = temporary.value;
+        }
+        out.push_back(declaration);
+
+        std::cout << "[Optimizer] Hoisted an invariant expression out of the " << loopName(original)
+                  << " on line " << original->loc.line << " into " << temporary.name
+                  << (temporary.guarded ? ", computed only if the loop is entered" : "") << std::endl;
+    }
+    if (!guardedBlock->children.empty()) {
+        auto ifStatement = arena.create<ASTNode>(arena, ASTNodeType::IfStatement, kIf);
+        ifStatement->left = guard;
+        ifStatement->right = guardedBlock;
+        out.push_back(ifStatement);
+    }
+    out.push_back(result);
+    hoisted += temporaries.size();
+}
+
+// Returns `node` with its largest invariant operations still in place, or
+// with them replaced by temporaries if it is not invariant itself
+LoopInvariantCodeMotion::Scanned LoopInvariantCodeMotion::scan(ASTNode* node) {
+    if (!node) return {nullptr, false, ValueType::Unknown};
+
+    switch (node->type) {
+        case ASTNodeType::Literal:
+            return {node, true, literalType(node->value)};
+
+        // Names declared outside the function, or by this pass, are never
+        // invariant: their writes are not known
+        case ASTNodeType::Identifier: {
+            const uint32_t variable = graph->variableOf(node);
+            if (variable == None) return {node, false, ValueType::Unknown};
+            return {node, !writes(loopWrites, node->value), declaredType(graph->variables()[variable].type)};
+        }
+
+        case ASTNodeType::BinaryOperation: {
+            auto left = scan(node->left);
+            auto right = scan(node->right);
+            const ValueType type = resultType(node->value, left.type, right.type);
+            if (left.invariant && right.invariant && !mayTrap(node)) return {node, true, type};
+
+            ASTNode* result = node;
+            auto leftNode = settle(left);
+            auto rightNode = settle(right);
+            if (leftNode != node->left || rightNode != node->right) {
+                result = node->shallowCopy(arena);
+                result->left = leftNode;
+                result->right = rightNode;
+            }
+            return {result, false, type};
+        }
+
+        case ASTNodeType::UnaryOperation: {
+            auto operand = scan(node->left);
+            const ValueType type = unaryResultType(node->value, operand.type);
+            if (operand.invariant) return {node, true, type};
+            if (operand.node == node->left) return {node, false, type};
+            auto result = node->shallowCopy(arena);
+            result->left = operand.node;
+            return {result, false, type};
+        }
+
+        default: {
+            ASTNode* result = node;
+            auto own = [&]() {
+                if (result == node) result = node->shallowCopy(arena);
+                return result;
+            };
+            if (auto left = settle(scan(node->left)); left != node->left) own()->left = left;
+            if (auto right = settle(scan(node->right)); right != node->right) own()->right = right;
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                auto child = settle(scan(node->children[i]));
+                if (child != node->children[i]) own()->children[i] = child;
+            }
+            return {result, false, ValueType::Unknown};
+        }
+    }
+}
+
+// An invariant operation that a variable can hold is replaced by a
+// temporary; anything else stays
+ASTNode* LoopInvariantCodeMotion::settle(const Scanned& scanned) {
+    if (!scanned.node || !scanned.invariant || !worthATemporary(scanned.node)) return scanned.node;
+    const Symbol type = declarableType(scanned.type);
+    if (type.empty()) return scanned.node;
+
+    // Code that always runs can use what is computed for the condition
+    for (const Temporary& temporary : temporaries) {
+        if ((guarded || !temporary.guarded) && sameExpression(temporary.value, scanned.node)) {
+            return arena.create<ASTNode>(arena, ASTNodeType::Identifier, temporary.name);
+        }
+    }
+    const Symbol name = newTemporaryName();
+    temporaries.push_back(Temporary{name, type, scanned.node, guarded});
+    return arena.create<ASTNode>(arena, ASTNodeType::Identifier, name);
+}
+
+// The condition as it would be evaluated on entry to the loop, or null if
+// the body always runs at least once. A for loop's initializer is folded
+// into it: (int i = 0; i < n; ...) is guarded by 0 < n. The guard is a
+// copy, not the condition's own nodes. `canGuard` is cleared if the
+// condition cannot be evaluated ahead of the loop.
+ASTNode* LoopInvariantCodeMotion::guardOf(ASTNode* loop, ASTNode* condition, bool& canGuard) {
+    if (!condition || (condition->type == ASTNodeType::Literal && condition->value == kTrue)) return nullptr;
+    if (hasSideEffects(condition)) {
+        canGuard = false;
+        return nullptr;
+    }
+
+    const ASTNode* init = loop->type == ASTNodeType::ForStatement && !loop->children.empty()
+                              ? loop->children[0]
+                              : nullptr;
+    if (!init) return condition->deepCopy(arena);
+    if ((init->type == ASTNodeType::Declaration || init->type == ASTNodeType::Assignment) && init->left &&
+        init->left->type == ASTNodeType::Identifier && init->right && !hasSideEffects(init->right)) {
+        return condition->deepCopy(arena, init->left->value, init->right);
+    }
+    canGuard = false;
+    return nullptr;
+}
+
+// Never a name the program already uses
+Symbol LoopInvariantCodeMotion::newTemporaryName() {
+    std::string name;
+    do {
+        name = "licm_" + std::to_string(temporaryCount++);
+    } while (StringInterner::global().contains(name));
+    return Symbol(name);
+}
+
+// Integer division and remainder trap on a zero divisor, and on INT_MIN / -1
+bool LoopInvariantCodeMotion::mayTrap(const ASTNode* operation) {
+    if (operation->value != kDivide && operation->value != kModulo) return false;
+    const ASTNode* divisor = operation->right;
+    if (!divisor || divisor->type != ASTNodeType::Literal) return true;
+    switch (literalType(divisor->value)) {
+        case ValueType::Double:
+            return false;
+        case ValueType::Int:
+            return divisor->value.str().find_first_not_of('0') == std::string_view::npos;
+        default:
+            return true;
+    }
+}
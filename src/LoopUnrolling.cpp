@@ -0,0 +1,255 @@
+#include "../include/LoopUnrolling.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+const Symbol kAssign("=");
+const Symbol kBlock("Block");
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kLess("<");
+const Symbol kGreater(">");
+const Symbol kPlusAssign("+=");
+const Symbol kMinusAssign("-=");
+const Symbol kSimdFor("simd for");
+const Symbol kStripFor("strip for");
+
+// A body declaring variables at its top level needs a scope per copy
+bool declaresVariables(const ASTNode* body) {
+    if (body->type != ASTNodeType::Block) return body->type == ASTNodeType::Declaration;
+    return std::any_of(body->children.begin(), body->children.end(), [](const ASTNode* statement) {
+        return statement && statement->type == ASTNodeType::Declaration;
+    });
+}
+} // namespace
+
+ASTNode* LoopUnrolling::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    writeSets = &analyses.get<WrittenVariables>(root);
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    unrolled = 0;
+
+    ASTNode* result = root;
+    size_t next = 0; // graphs are in the order of the program's functions
+    for (const ControlFlowGraph& functionGraph : graphs) {
+        graph = &functionGraph;
+        auto function = const_cast<ASTNode*>(graph->function());
+        auto rewritten = rewriteStatement(function);
+        if (rewritten == function) continue;
+        if (function == root) {
+            result = rewritten;
+            continue;
+        }
+        while (root->children[next] != function) ++next;
+        if (result == root) result = root->shallowCopy(arena);
+        result->children[next] = rewritten;
+    }
+
+    rewrites += unrolled;
+    graph = nullptr;
+    writeSets = nullptr;
+    return result;
+}
+
+// Rewrites the loops under a statement that is not a for loop itself
+ASTNode* LoopUnrolling::rewriteStatement(ASTNode* node) {
+    if (!node) return nullptr;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Program:
+        case ASTNodeType::Block: {
+            std::vector<ASTNode*> statements;
+            statements.reserve(node->children.size());
+            for (ASTNode* child : node->children) {
+                if (child) {
+                    rewriteInto(child, statements);
+                } else {
+                    statements.push_back(nullptr);
+                }
+            }
+            if (!std::equal(statements.begin(), statements.end(), node->children.begin(), node->children.end())) {
+                own()->children.assign(statements.begin(), statements.end());
+            }
+            break;
+        }
+
+        case ASTNodeType::FunctionDeclaration:
+            if (auto body = rewriteNested(node->left); body != node->left) own()->left = body;
+            break;
+
+        case ASTNodeType::IfStatement:
+        case ASTNodeType::WhileStatement:
+            if (auto body = rewriteNested(node->right); body != node->right) own()->right = body;
+            break;
+
+        case ASTNodeType::DoWhileStatement:
+            if (auto body = rewriteNested(node->left); body != node->left) own()->left = body;
+            break;
+
+        default:
+            break;
+    }
+    return result;
+}
+
+// A statement in a place that holds just one; a loop unrolled there is
+// put in a block
+ASTNode* LoopUnrolling::rewriteNested(ASTNode* node) {
+    if (!node) return nullptr;
+    std::vector<ASTNode*> statements;
+    rewriteInto(node, statements);
+    if (statements.size() == 1) return statements.front();
+
+    auto block = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+    block->children.assign(statements.begin(), statements.end());
+    return block;
+}
+
+// Appends the rewritten statement to `out`, unrolled if it is a for loop
+// that can be
+void LoopUnrolling::rewriteInto(ASTNode* node, std::vector<ASTNode*>& out) {
+    if (node->type != ASTNodeType::ForStatement) {
+        out.push_back(rewriteStatement(node));
+        return;
+    }
+
+    // Inner loops first
+    ASTNode* loop = node;
+    if (node->children.size() > 3) {
+        if (auto body = rewriteNested(node->children[3]); body != node->children[3]) {
+            loop = node->shallowCopy(arena);
+            loop->children[3] = body;
+        }
+    }
+    if (!unroll(node, loop, out)) out.push_back(loop);
+}
+
+// `original` is the loop as the analyses saw it, `loop` the loop with its
+// inner loops rewritten. Returns false, leaving `out` alone, if the loop
+// is kept as it is.
+bool LoopUnrolling::unroll(ASTNode* original, ASTNode* loop, std::vector<ASTNode*>& out) {
+    // Vectorized strips are left for the compiler of the output to map onto lanes
+    if (original->value == kSimdFor || original->value == kStripFor) return false;
+    CountedLoop count;
+    if (!countedLoop(original, *graph, *writeSets, count)) return false;
+    const ASTNode* body = loop->children[3];
+    const size_t bodySize = sizeOf(body);
+    const bool scoped = declaresVariables(body);
+
+    if (count.trips * bodySize <= budget) {
+        for (int64_t k = 0; k < count.trips; ++k) {
+            auto value = literal(count.start + k * count.step);
+            appendBody(body, scoped, count, value, out);
+        }
+        // A variable declared outside the loop is left as the loop leaves it
+        if (!count.declared) {
+            auto assignment = arena.create<ASTNode>(arena, ASTNodeType::Assignment, kAssign);
+            assignment->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, count.variable);
+            assignment->right = literal(count.end());
+            out.push_back(assignment);
+        }
+        std::cout << "[Optimizer] Fully unrolled the for loop on line " << original->loc.line << " ("
+                  << count.trips << " iteration" << (count.trips == 1 ? "" : "s") << ")" << std::endl;
+        ++unrolled;
+        return true;
+    }
+
+    // Stepping by more than one, it may be what an earlier unrolling left
+    const int64_t factor = unrollFactor;
+    if (factor < 2 || (count.step != 1 && count.step != -1) || count.trips < 2 * factor ||
+        factor * (bodySize + 3) > budget) {
+        return false;
+    }
+
+    const int64_t mainTrips = count.trips / factor;
+    const int64_t leftOver = count.trips % factor;
+    const int64_t mainEnd = count.start + mainTrips * factor * count.step;
+
+    // for (i = start; i < mainEnd; i += factor) { body(i); body(i + 1); ... }
+    auto unrolledBody = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+    std::vector<ASTNode*> copies;
+    for (int64_t k = 0; k < factor; ++k) {
+        ASTNode* value = nullptr;
+        if (k > 0) {
+            value = arena.create<ASTNode>(arena, ASTNodeType::BinaryOperation, count.step > 0 ? kPlus : kMinus);
+            value->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, count.variable);
+            value->right = literal(k);
+        }
+        appendBody(body, scoped, count, value, copies);
+    }
+    unrolledBody->children.assign(copies.begin(), copies.end());
+
+    auto main = loop->shallowCopy(arena);
+    main->children[0] = initializer(loop, count, count.start);
+    auto condition = arena.create<ASTNode>(arena, ASTNodeType::BinaryOperation, count.step > 0 ? kLess : kGreater);
+    condition->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, count.variable);
+    condition->right = literal(mainEnd);
+    main->children[1] = condition;
+    auto increment = arena.create<ASTNode>(arena, ASTNodeType::CompoundAssignment,
+                                           count.step > 0 ? kPlusAssign : kMinusAssign);
+    increment->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, count.variable);
+    increment->right = literal(factor);
+    main->children[2] = increment;
+    main->children[3] = unrolledBody;
+    out.push_back(main);
+
+    // The original loop, picking up where the unrolled one stops
+    if (leftOver > 0) {
+        auto remainder = loop->deepCopy(arena);
+        remainder->children[0] = initializer(loop, count, mainEnd);
+        out.push_back(remainder);
+    }
+
+    std::cout << "[Optimizer] Unrolled the for loop on line " << original->loc.line << " by " << factor << " ("
+              << count.trips << " iterations, " << leftOver << " in a remainder loop)" << std::endl;
+    ++unrolled;
+    return true;
+}
+
+// Appends a copy of the body with `value` in place of the loop variable,
+// or the loop variable itself if `value` is null
+void LoopUnrolling::appendBody(const ASTNode* body, bool scoped, const CountedLoop& count, const ASTNode* value,
+                               std::vector<ASTNode*>& out) {
+    auto copy = body->deepCopy(arena, value ? count.variable : Symbol(), value);
+    if (copy->type != ASTNodeType::Block) {
+        if (!scoped) {
+            out.push_back(copy);
+            return;
+        }
+        auto block = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+        block->children.push_back(copy);
+        copy = block;
+    }
+    if (scoped) {
+        out.push_back(copy);
+    } else {
+        out.insert(out.end(), copy->children.begin(), copy->children.end());
+    }
+}
+
+// int i = value, or i = value if the loop does not declare i
+ASTNode* LoopUnrolling::initializer(const ASTNode* loop, const CountedLoop& count, int64_t value) {
+    auto init = loop->children[0]->shallowCopy(arena);
+    init->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, count.variable);
+    init->right = literal(value);
+    return init;
+}
+
+ASTNode* LoopUnrolling::literal(int64_t value) {
+    return arena.create<ASTNode>(arena, ASTNodeType::Literal, std::to_string(value));
+}
+
+size_t LoopUnrolling::sizeOf(const ASTNode* node) {
+    if (!node) return 0;
+    size_t size = 1 + sizeOf(node->left) + sizeOf(node->right);
+    for (const ASTNode* child : node->children) {
+        size += sizeOf(child);
+    }
+    return size;
+}
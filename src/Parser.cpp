@@ -1,556 +1,834 @@
-#include "Parser.h"
-#include <iostream>
-
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens), pos(0) {}
-
-Token Parser::peek() {
-    return pos < tokens.size() ? tokens[pos] : Token{TokenType::Unknown, ""};
-}
-
-Token Parser::advance() {
-    return pos < tokens.size() ? tokens[pos++] : Token{TokenType::Unknown, ""};
-}
-
-bool Parser::match(TokenType type, const std::string& val) {
-    if (pos >= tokens.size()) return false;
-    if (tokens[pos].type != type) return false;
-    if (!val.empty() && tokens[pos].value != val) return false;
-    ++pos;
-    return true;
-}
-
-bool Parser::check(TokenType type, const std::string& val) {
-    if (pos >= tokens.size()) return false;
-    if (tokens[pos].type != type) return false;
-    if (!val.empty() && tokens[pos].value != val) return false;
-    return true;
-}
-
-void Parser::skipTo(const std::string& target) {
-    while (pos < tokens.size() && tokens[pos].value != target) {
-        ++pos;
-    }
-}
-
-std::shared_ptr<ASTNode> Parser::parse() {
-    auto programNode = std::make_shared<ASTNode>(ASTNodeType::Program, "Program");
-    
-    while (pos < tokens.size()) {
-        auto stmt = parseStatement();
-        if (stmt) {
-            programNode->children.push_back(stmt);
-        } else {
-            // Skip unknown tokens
-            if (pos < tokens.size()) {
-                ++pos;
-            }
-        }
-    }
-    return programNode;
-}
-
-std::shared_ptr<ASTNode> Parser::parseStatement() {
-    // Handle preprocessor directives
-    if (check(TokenType::Keyword) && !peek().value.empty() && peek().value[0] == '#') {
-        return parsePreprocessor();
-    }
-    
-    // Handle function declarations
-    if (check(TokenType::Keyword, "int") && pos + 1 < tokens.size() && tokens[pos + 1].value == "main") {
-        return parseFunctionDeclaration();
-    }
-    
-    // Handle return statements
-    if (check(TokenType::Keyword, "return")) {
-        return parseReturnStatement();
-    }
-    
-    // Handle variable declarations
-    if (check(TokenType::Keyword, "int") || check(TokenType::Keyword, "float")) {
-        return parseDeclaration();
-    }
-    
-    // Handle if statements
-    if (check(TokenType::Keyword, "if")) {
-        return parseIfStatement();
-    }
-    
-    // Handle for loops
-    if (check(TokenType::Keyword, "for")) {
-        return parseForStatement();
-    }
-    
-    // Handle while loops
-    if (check(TokenType::Keyword, "while")) {
-        return parseWhileStatement();
-    }
-    
-    // Handle do-while loops
-    if (check(TokenType::Keyword, "do")) {
-        return parseDoWhileStatement();
-    }
-    
-    // Handle input/output statements (std::cout or std::cin) - FIXED
-    if (check(TokenType::Keyword, "std")) {
-        // Look ahead to see if it's cout or cin
-        if (pos + 2 < tokens.size() && tokens[pos + 1].value == "::") {
-            if (tokens[pos + 2].value == "cout") {
-                return parsePrintStatement();
-            } else if (tokens[pos + 2].value == "cin") {
-                return parseInputStatement();
-            }
-        }
-    }
-    
-    // Handle blocks
-    if (check(TokenType::Separator, "{")) {
-        return parseBlock();
-    }
-    
-    // Handle increment/decrement statements (i++, ++i, i--, --i)
-    if (check(TokenType::Identifier)) {
-        // Look ahead to see if this is an increment/decrement statement
-        if (pos + 1 < tokens.size() && 
-            (tokens[pos + 1].value == "++" || tokens[pos + 1].value == "--" || 
-             tokens[pos + 1].value == "+=" || tokens[pos + 1].value == "-=" ||
-             tokens[pos + 1].value == "*=" || tokens[pos + 1].value == "/=")) {
-            auto stmt = parseIncrementExpression();
-            if (stmt && match(TokenType::Separator, ";")) {
-                auto exprStmt = std::make_shared<ASTNode>(ASTNodeType::ExpressionStatement, "ExpressionStatement");
-                exprStmt->left = stmt;
-                return exprStmt;
-            }
-        }
-        // Handle assignments (identifier = expression)
-        else if (pos + 1 < tokens.size() && 
-                 tokens[pos + 1].type == TokenType::Operator && tokens[pos + 1].value == "=") {
-            return parseAssignment();
-        }
-    }
-    
-    // Handle pre-increment/decrement statements (++i, --i)
-    if (check(TokenType::Operator, "++") || check(TokenType::Operator, "--")) {
-        auto stmt = parseIncrementExpression();
-        if (stmt && match(TokenType::Separator, ";")) {
-            auto exprStmt = std::make_shared<ASTNode>(ASTNodeType::ExpressionStatement, "ExpressionStatement");
-            exprStmt->left = stmt;
-            return exprStmt;
-        }
-    }
-    
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseInputStatement() {
-    if (match(TokenType::Keyword, "std") && match(TokenType::Operator, "::") && match(TokenType::Keyword, "cin")) {
-        auto inputNode = std::make_shared<ASTNode>(ASTNodeType::InputStatement, "cin");
-        
-        // Parse each part of the cin statement
-        while (!check(TokenType::Separator, ";") && pos < tokens.size()) {
-            if (check(TokenType::Operator, ">>")) {
-                advance(); // skip >>
-            } else if (check(TokenType::Identifier)) {
-                // Handle variables in cin
-                auto varNode = std::make_shared<ASTNode>(ASTNodeType::Identifier, advance().value);
-                inputNode->children.push_back(varNode);
-            } else {
-                // Skip other tokens we don't handle
-                advance();
-            }
-        }
-        
-        match(TokenType::Separator, ";");
-        return inputNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseForStatement() {
-    if (match(TokenType::Keyword, "for")) {
-        match(TokenType::Separator, "(");
-        
-        auto forNode = std::make_shared<ASTNode>(ASTNodeType::ForStatement, "for");
-        
-        // Parse initialization (e.g., int i = 0)
-        auto init = parseStatement();
-        if (init) {
-            forNode->children.push_back(init);
-        } else {
-            // Handle empty initialization
-            match(TokenType::Separator, ";");
-            forNode->children.push_back(nullptr);
-        }
-        
-        // Parse condition (e.g., i < 10)
-        auto condition = parseExpression();
-        forNode->children.push_back(condition);
-        match(TokenType::Separator, ";");
-        
-        // Parse increment (e.g., i++)
-        auto increment = parseIncrementExpression();
-        forNode->children.push_back(increment);
-        match(TokenType::Separator, ")");
-        
-        // Parse body
-        auto body = parseStatement();
-        if (!body && check(TokenType::Separator, "{")) {
-            body = parseBlock();
-        }
-        forNode->children.push_back(body);
-        
-        return forNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseWhileStatement() {
-    if (match(TokenType::Keyword, "while")) {
-        match(TokenType::Separator, "(");
-        
-        auto whileNode = std::make_shared<ASTNode>(ASTNodeType::WhileStatement, "while");
-        
-        // Parse condition
-        auto condition = parseExpression();
-        whileNode->left = condition;
-        match(TokenType::Separator, ")");
-        
-        // Parse body
-        auto body = parseStatement();
-        if (!body && check(TokenType::Separator, "{")) {
-            body = parseBlock();
-        }
-        whileNode->right = body;
-        
-        return whileNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseDoWhileStatement() {
-    if (match(TokenType::Keyword, "do")) {
-        auto doWhileNode = std::make_shared<ASTNode>(ASTNodeType::DoWhileStatement, "do-while");
-        
-        // Parse body first
-        auto body = parseStatement();
-        if (!body && check(TokenType::Separator, "{")) {
-            body = parseBlock();
-        }
-        doWhileNode->left = body;
-        
-        // Parse while condition
-        match(TokenType::Keyword, "while");
-        match(TokenType::Separator, "(");
-        auto condition = parseExpression();
-        doWhileNode->right = condition;
-        match(TokenType::Separator, ")");
-        match(TokenType::Separator, ";");
-        
-        return doWhileNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseIncrementExpression() {
-    // Handle i++, ++i, i--, --i, i += 1, i -= 1, etc.
-    if (check(TokenType::Identifier)) {
-        auto id = advance();
-        
-        // Post-increment/decrement (i++, i--)
-        if (check(TokenType::Operator, "++") || check(TokenType::Operator, "--")) {
-            auto op = advance();
-            auto incNode = std::make_shared<ASTNode>(ASTNodeType::PostIncrement, op.value);
-            incNode->left = std::make_shared<ASTNode>(ASTNodeType::Identifier, id.value);
-            return incNode;
-        }
-        
-        // Compound assignment (i += 1, i -= 1, etc.)
-        if (check(TokenType::Operator, "+=") || check(TokenType::Operator, "-=") || 
-            check(TokenType::Operator, "*=") || check(TokenType::Operator, "/=")) {
-            auto op = advance();
-            auto expr = parseExpression();
-            auto compoundNode = std::make_shared<ASTNode>(ASTNodeType::CompoundAssignment, op.value);
-            compoundNode->left = std::make_shared<ASTNode>(ASTNodeType::Identifier, id.value);
-            compoundNode->right = expr;
-            return compoundNode;
-        }
-        
-        // Regular assignment (i = i + 1)
-        if (check(TokenType::Operator, "=")) {
-            advance(); // skip =
-            auto expr = parseExpression();
-            auto assignNode = std::make_shared<ASTNode>(ASTNodeType::Assignment, "=");
-            assignNode->left = std::make_shared<ASTNode>(ASTNodeType::Identifier, id.value);
-            assignNode->right = expr;
-            return assignNode;
-        }
-        
-        // Just the identifier (in case of empty increment)
-        return std::make_shared<ASTNode>(ASTNodeType::Identifier, id.value);
-    }
-    
-    // Pre-increment/decrement (++i, --i)
-    if (check(TokenType::Operator, "++") || check(TokenType::Operator, "--")) {
-        auto op = advance();
-        if (check(TokenType::Identifier)) {
-            auto id = advance();
-            auto preIncNode = std::make_shared<ASTNode>(ASTNodeType::PreIncrement, op.value);
-            preIncNode->left = std::make_shared<ASTNode>(ASTNodeType::Identifier, id.value);
-            return preIncNode;
-        }
-    }
-    
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseAssignment() {
-    if (check(TokenType::Identifier)) {
-        auto id = advance();
-        if (match(TokenType::Operator, "=")) {
-            auto assignNode = std::make_shared<ASTNode>(ASTNodeType::Assignment, "=");
-            assignNode->left = std::make_shared<ASTNode>(ASTNodeType::Identifier, id.value);
-            assignNode->right = parseExpression();
-            match(TokenType::Separator, ";");
-            return assignNode;
-        }
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parsePreprocessor() {
-    if (check(TokenType::Keyword) && !peek().value.empty() && peek().value[0] == '#') {
-        auto preprocessor = std::make_shared<ASTNode>(ASTNodeType::Preprocessor, advance().value);
-        return preprocessor;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseFunctionDeclaration() {
-    if (match(TokenType::Keyword, "int") && match(TokenType::Keyword, "main")) {
-        match(TokenType::Separator, "(");
-        match(TokenType::Separator, ")");
-        
-        auto funcNode = std::make_shared<ASTNode>(ASTNodeType::FunctionDeclaration, "main");
-        
-        if (check(TokenType::Separator, "{")) {
-            funcNode->left = parseBlock();
-        }
-        
-        return funcNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseReturnStatement() {
-    if (match(TokenType::Keyword, "return")) {
-        auto returnNode = std::make_shared<ASTNode>(ASTNodeType::ReturnStatement, "return");
-        
-        if (!check(TokenType::Separator, ";")) {
-            returnNode->left = parseExpression();
-        }
-        
-        match(TokenType::Separator, ";");
-        return returnNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseDeclaration() {
-    if (check(TokenType::Keyword, "int") || check(TokenType::Keyword, "float")) {
-        auto typeToken = advance();
-        
-        if (check(TokenType::Identifier)) {
-            auto idToken = advance();
-            auto declNode = std::make_shared<ASTNode>(ASTNodeType::Declaration, typeToken.value);
-            declNode->left = std::make_shared<ASTNode>(ASTNodeType::Identifier, idToken.value);
-            
-            if (match(TokenType::Operator, "=")) {
-                declNode->right = parseExpression();
-            }
-            
-            match(TokenType::Separator, ";");
-            return declNode;
-        }
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseIfStatement() {
-    if (match(TokenType::Keyword, "if")) {
-        match(TokenType::Separator, "(");
-        auto condition = parseLogicalExpression();
-        match(TokenType::Separator, ")");
-        
-        auto ifNode = std::make_shared<ASTNode>(ASTNodeType::IfStatement, "if");
-        ifNode->left = condition;
-        
-        if (check(TokenType::Separator, "{")) {
-            ifNode->right = parseBlock();
-        }
-        
-        return ifNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseBlock() {
-    if (match(TokenType::Separator, "{")) {
-        auto blockNode = std::make_shared<ASTNode>(ASTNodeType::Block, "Block");
-        
-        while (!check(TokenType::Separator, "}") && pos < tokens.size()) {
-            auto stmt = parseStatement();
-            if (stmt) {
-                blockNode->children.push_back(stmt);
-            } else {
-                // Skip single tokens that we can't parse
-                if (pos < tokens.size()) {
-                    ++pos;
-                }
-            }
-        }
-        
-        match(TokenType::Separator, "}");
-        return blockNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parsePrintStatement() {
-    if (match(TokenType::Keyword, "std") && match(TokenType::Operator, "::") && match(TokenType::Keyword, "cout")) {
-        auto printNode = std::make_shared<ASTNode>(ASTNodeType::PrintStatement, "cout");
-        
-        // Parse each part of the cout statement separately
-        while (!check(TokenType::Separator, ";") && pos < tokens.size()) {
-            if (check(TokenType::Operator, "<<")) {
-                advance(); // skip <<
-            } else if (check(TokenType::Literal)) {
-                // Handle string literals
-                auto outputNode = std::make_shared<ASTNode>(ASTNodeType::Literal, advance().value);
-                printNode->children.push_back(outputNode);
-            } else if (check(TokenType::Keyword, "std") && pos + 2 < tokens.size() && 
-                      tokens[pos + 1].value == "::" && tokens[pos + 2].value == "endl") {
-                // Handle std::endl properly
-                advance(); // std
-                advance(); // ::
-                advance(); // endl
-                auto endlNode = std::make_shared<ASTNode>(ASTNodeType::Literal, "std::endl");
-                printNode->children.push_back(endlNode);
-            } else if (check(TokenType::Identifier)) {
-                // Handle variables in cout
-                auto varNode = std::make_shared<ASTNode>(ASTNodeType::Identifier, advance().value);
-                printNode->children.push_back(varNode);
-            } else {
-                // Skip other tokens we don't handle
-                advance();
-            }
-        }
-        
-        match(TokenType::Separator, ";");
-        return printNode;
-    }
-    return nullptr;
-}
-
-std::shared_ptr<ASTNode> Parser::parseExpression() {
-    return parseLogicalExpression();
-}
-
-std::shared_ptr<ASTNode> Parser::parseLogicalExpression() {
-    auto left = parseComparisonExpression();
-    
-    while (check(TokenType::Operator, "||") || check(TokenType::Operator, "&&")) {
-        auto op = advance().value;
-        auto right = parseComparisonExpression();
-        
-        auto opNode = std::make_shared<ASTNode>(ASTNodeType::BinaryOperation, op);
-        opNode->left = left;
-        opNode->right = right;
-        left = opNode;
-    }
-    
-    return left;
-}
-
-std::shared_ptr<ASTNode> Parser::parseComparisonExpression() {
-    auto left = parseArithmeticExpression();
-    
-    while (check(TokenType::Operator, "==") || check(TokenType::Operator, "!=") || 
-           check(TokenType::Operator, "<") || check(TokenType::Operator, ">") ||
-           check(TokenType::Operator, "<=") || check(TokenType::Operator, ">=")) {
-        auto op = advance().value;
-        auto right = parseArithmeticExpression();
-        
-        auto opNode = std::make_shared<ASTNode>(ASTNodeType::BinaryOperation, op);
-        opNode->left = left;
-        opNode->right = right;
-        left = opNode;
-    }
-    
-    return left;
-}
-
-std::shared_ptr<ASTNode> Parser::parseArithmeticExpression() {
-    auto left = parseMultiplicativeExpression();
-    
-    while (check(TokenType::Operator, "+") || check(TokenType::Operator, "-")) {
-        auto op = advance().value;
-        auto right = parseMultiplicativeExpression();
-        
-        auto opNode = std::make_shared<ASTNode>(ASTNodeType::BinaryOperation, op);
-        opNode->left = left;
-        opNode->right = right;
-        left = opNode;
-    }
-    
-    return left;
-}
-
-std::shared_ptr<ASTNode> Parser::parseMultiplicativeExpression() {
-    auto left = parsePrimary();
-    
-    while (check(TokenType::Operator, "*") || check(TokenType::Operator, "/")) {
-        auto op = advance().value;
-        auto right = parsePrimary();
-        
-        auto opNode = std::make_shared<ASTNode>(ASTNodeType::BinaryOperation, op);
-        opNode->left = left;
-        opNode->right = right;
-        left = opNode;
-    }
-    
-    return left;
-}
-
-std::shared_ptr<ASTNode> Parser::parsePrimary() {
-    if (check(TokenType::Number)) {
-        return std::make_shared<ASTNode>(ASTNodeType::Literal, advance().value);
-    }
-    
-    if (check(TokenType::Literal)) {
-        return std::make_shared<ASTNode>(ASTNodeType::Literal, advance().value);
-    }
-    
-    if (check(TokenType::Identifier)) {
-        return std::make_shared<ASTNode>(ASTNodeType::Identifier, advance().value);
-    }
-    
-    if (match(TokenType::Separator, "(")) {
-        auto expr = parseExpression();
-        match(TokenType::Separator, ")");
-        return expr;
-    }
-    
-    return nullptr;
-}
-
-void printAST(const std::shared_ptr<ASTNode>& node, int indent) {
-    if (!node) return;
-    std::string pad(indent, ' ');
-    std::cout << pad << node->value << " (" << static_cast<int>(node->type) << ")\n";
-    
-    if (node->left) printAST(node->left, indent + 2);
-    if (node->right) printAST(node->right, indent + 2);
-    
-    for (const auto& child : node->children) {
-        printAST(child, indent + 2);
-    }
+#include "Parser.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+namespace {
+
+// Labels of the nodes the parser synthesizes, interned once up front so
+// building a node never touches the (shared) interner
+const Symbol kProgram("Program");
+const Symbol kExpressionStatement("ExpressionStatement");
+const Symbol kCin("cin");
+const Symbol kFor("for");
+const Symbol kWhile("while");
+const Symbol kDoWhile("do-while");
+const Symbol kAssign("=");
+const Symbol kSubscript("[]");
+const Symbol kReturn("return");
+const Symbol kIf("if");
+const Symbol kBlock("Block");
+const Symbol kCout("cout");
+const Symbol kEndl("std::endl");
+
+} // namespace
+
+ASTNode* ASTNode::shallowCopy(ASTArena& arena) const {
+    auto copy = arena.create<ASTNode>(arena, type, value);
+    copy->loc = loc;
+    copy->span = span;
+    copy->left = left;
+    copy->right = right;
+    copy->children.assign(children.begin(), children.end());
+    return copy;
+}
+
+ASTNode* ASTNode::deepCopy(ASTArena& arena, Symbol name, const ASTNode* value) const {
+    if (type == ASTNodeType::Identifier && !name.empty() && this->value == name && value) {
+        return value->deepCopy(arena);
+    }
+    auto copy = shallowCopy(arena);
+    if (left) copy->left = left->deepCopy(arena, name, value);
+    if (right) copy->right = right->deepCopy(arena, name, value);
+    for (auto& child : copy->children) {
+        if (child) child = child->deepCopy(arena, name, value);
+    }
+    return copy;
+}
+
+Parser::Parser(const SourceBuffer& source, ASTArena& arena, LexerBackend backend)
+    : tokens(source, backend), arena(arena), source(&source), backend(backend) {}
+
+Parser::Parser(const SourceBuffer& source, const SourceRange& range, ASTArena& arena, LexerBackend backend)
+    : tokens(source, range, backend), arena(arena), source(&source), backend(backend) {}
+
+Parser::Parser(const std::vector<Token>& tokens, ASTArena& arena) : tokens(tokens), arena(arena) {}
+
+const Token& Parser::peek(size_t ahead) {
+    return tokens.peek(ahead);
+}
+
+const Token& Parser::advance() {
+    return tokens.advance();
+}
+
+bool Parser::match(TokenKind kind) {
+    if (!check(kind)) return false;
+    tokens.advance();
+    return true;
+}
+
+// The end-of-input token is Unknown with kind None, so neither check
+// needs a separate atEnd() test
+bool Parser::check(TokenKind kind) {
+    return tokens.peek().kind == kind;
+}
+
+bool Parser::check(TokenType type) {
+    return tokens.peek().type == type;
+}
+
+void Parser::skipTo(std::string_view target) {
+    while (!tokens.atEnd() && tokens.peek().value != target) {
+        tokens.advance();
+    }
+}
+
+size_t Parser::tokensConsumed() const {
+    return tokens.consumed() + workerTokens;
+}
+
+ASTNode* Parser::parse(unsigned threads) {
+    auto programNode = makeNode(ASTNodeType::Program, kProgram);
+    
+    if (threads > 1 && source && parseInParallel(programNode, threads)) {
+        return programNode;
+    }
+    parseTopLevel(programNode);
+    return programNode;
+}
+
+// Returns false if some statement had to look past the last token, i.e.
+// when parsing a range, a statement that may continue in the next range
+bool Parser::parseTopLevel(ASTNode* programNode) {
+    bool selfContained = true;
+    while (!tokens.atEnd()) {
+        auto stmt = parseStatement();
+        if (stmt) {
+            programNode->children.push_back(stmt);
+        } else {
+            // Skip unknown tokens
+            tokens.advance();
+        }
+        selfContained = selfContained && !tokens.reachedEnd();
+    }
+    return selfContained;
+}
+
+namespace {
+
+// Pre-pass for the parallel parse: cuts the source into about `target`
+// ranges of similar size. A range only starts on an int/float or a
+// preprocessor line at brace depth 0 that follows a complete top-level
+// item, which is where the sequential parser starts a new statement.
+std::vector<SourceRange> splitTopLevel(const SourceBuffer& source, LexerBackend backend, size_t target) {
+    std::vector<SourceRange> ranges;
+    const size_t minBytes = std::max<size_t>(source.size() / target, 1);
+
+    Lexer lexer(source, backend);
+    Token token;
+    SourceRange current;
+    size_t depth = 0;
+    bool atItemStart = true;
+    while (lexer.scan(token)) {
+        if (depth == 0 && atItemStart && token.offset - current.begin >= minBytes &&
+            (token.kind == TokenKind::KwInt || token.kind == TokenKind::KwFloat ||
+             token.kind == TokenKind::Preprocessor)) {
+            current.end = token.offset;
+            ranges.push_back(current);
+            current.begin = token.offset;
+            current.loc = token.loc;
+        }
+
+        switch (token.kind) {
+            case TokenKind::LBrace:
+                ++depth;
+                atItemStart = false;
+                break;
+            case TokenKind::RBrace:
+                if (depth > 0) --depth;
+                atItemStart = depth == 0;
+                break;
+            case TokenKind::Semicolon:
+            case TokenKind::Preprocessor:
+                atItemStart = depth == 0;
+                break;
+            default:
+                atItemStart = false;
+                break;
+        }
+    }
+
+    current.end = source.size();
+    ranges.push_back(current);
+    return ranges;
+}
+
+} // namespace
+
+// Parses the top-level ranges on a pool of worker threads, each with its
+// own lexer and arena, and splices the statements into programNode in
+// source order. Returns false, leaving programNode untouched, when the
+// input does not split or a statement crossed a range boundary; the
+// caller then parses sequentially, so the tree is always the same.
+bool Parser::parseInParallel(ASTNode* programNode, unsigned threads) {
+    const std::vector<SourceRange> ranges = splitTopLevel(*source, backend, size_t(threads) * 4);
+    if (ranges.size() < 2) {
+        return false;
+    }
+
+    struct Unit {
+        std::unique_ptr<ASTArena> arena;
+        ASTNode* program = nullptr;
+        size_t tokens = 0;
+        bool selfContained = false;
+    };
+    std::vector<Unit> units(ranges.size());
+    std::atomic<size_t> nextUnit{0};
+
+    auto work = [&] {
+        for (size_t i; (i = nextUnit.fetch_add(1)) < ranges.size();) {
+            Unit& unit = units[i];
+            unit.arena = std::make_unique<ASTArena>();
+            Parser worker(*source, ranges[i], *unit.arena, backend);
+            unit.program = worker.makeNode(ASTNodeType::Program, kProgram);
+            unit.selfContained = worker.parseTopLevel(unit.program);
+            unit.tokens = worker.tokensConsumed();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    const size_t poolSize = std::min<size_t>(threads, ranges.size());
+    for (size_t t = 1; t < poolSize; ++t) {
+        try {
+            pool.emplace_back(work);
+        } catch (const std::system_error&) {
+            break; // the calling thread picks up whatever is left
+        }
+    }
+    work();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    // The last range really ends where the input does
+    for (size_t i = 0; i + 1 < units.size(); ++i) {
+        if (!units[i].selfContained) return false;
+    }
+
+    for (Unit& unit : units) {
+        auto& statements = unit.program->children;
+        programNode->children.insert(programNode->children.end(), statements.begin(), statements.end());
+        workerTokens += unit.tokens;
+        arena.adopt(std::move(unit.arena));
+    }
+    return true;
+}
+
+// Statement rules indexed by the kind of the statement's first token.
+// Identifiers, numbers and literals all have kind None, so its rule
+// checks the token type itself.
+const std::array<Parser::StatementRule, kTokenKindCount> Parser::statementRules = [] {
+    std::array<StatementRule, kTokenKindCount> rules{};
+    auto rule = [&](TokenKind kind, StatementRule parse) { rules[static_cast<size_t>(kind)] = parse; };
+    rule(TokenKind::Preprocessor, &Parser::parsePreprocessor);
+    rule(TokenKind::KwInt, &Parser::parseDeclarationOrFunction);
+    rule(TokenKind::KwFloat, &Parser::parseDeclarationOrFunction);
+    rule(TokenKind::KwReturn, &Parser::parseReturnStatement);
+    rule(TokenKind::KwIf, &Parser::parseIfStatement);
+    rule(TokenKind::KwFor, &Parser::parseForStatement);
+    rule(TokenKind::KwWhile, &Parser::parseWhileStatement);
+    rule(TokenKind::KwDo, &Parser::parseDoWhileStatement);
+    rule(TokenKind::KwStd, &Parser::parseStreamStatement);
+    rule(TokenKind::LBrace, &Parser::parseBlock);
+    rule(TokenKind::None, &Parser::parseIdentifierStatement);
+    rule(TokenKind::PlusPlus, &Parser::parsePrefixIncrementStatement);
+    rule(TokenKind::MinusMinus, &Parser::parsePrefixIncrementStatement);
+    return rules;
+}();
+
+// Every statement records where it starts and ends, which is what
+// IncrementalParser uses to find the statements an edit touches
+ASTNode* Parser::parseStatement() {
+    const Token& first = peek();
+    StatementRule parse = statementRules[static_cast<size_t>(first.kind)];
+    if (!parse) return nullptr;
+
+    const size_t begin = first.offset;
+    const SourceLocation loc = first.loc;
+    ASTNode* stmt = (this->*parse)();
+    if (stmt) {
+        stmt->span = SourceSpan{begin, tokens.consumedEnd()};
+        stmt->loc = loc;
+    }
+    return stmt;
+}
+
+ASTNode* Parser::parseDeclarationOrFunction() {
+    // Handle function declarations: int main, or a type, a name and (
+    if (peek(1).kind == TokenKind::KwMain ||
+        (peek(1).type == TokenType::Identifier && peek(2).kind == TokenKind::LParen)) {
+        return parseFunctionDeclaration();
+    }
+    return parseDeclaration();
+}
+
+ASTNode* Parser::parseStreamStatement() {
+    // Handle input/output statements (std::cout or std::cin)
+    if (peek(1).kind == TokenKind::ColonColon) {
+        if (peek(2).kind == TokenKind::KwCout) {
+            return parsePrintStatement();
+        } else if (peek(2).kind == TokenKind::KwCin) {
+            return parseInputStatement();
+        }
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseIdentifierStatement() {
+    if (!check(TokenType::Identifier)) {
+        return nullptr;
+    }
+
+    // Handle increment/decrement statements (i++, i--, i += 1, ...)
+    switch (peek(1).kind) {
+        case TokenKind::PlusPlus:
+        case TokenKind::MinusMinus:
+        case TokenKind::PlusAssign:
+        case TokenKind::MinusAssign:
+        case TokenKind::StarAssign:
+        case TokenKind::SlashAssign: {
+            auto stmt = parseIncrementExpression();
+            if (stmt && match(TokenKind::Semicolon)) {
+                auto exprStmt = makeNode(ASTNodeType::ExpressionStatement, kExpressionStatement);
+                exprStmt->left = stmt;
+                return exprStmt;
+            }
+            // Whatever follows the broken statement may still be a ++i / --i
+            return parsePrefixIncrementStatement();
+        }
+        // Handle assignments (identifier = expression)
+        case TokenKind::Assign:
+            return parseAssignment();
+        // Handle stores to array elements (a[i] = expression, a[i] += 1, a[i]++)
+        case TokenKind::LBracket: {
+            auto stmt = parseIncrementExpression();
+            match(TokenKind::Semicolon);
+            if (!stmt || stmt->type == ASTNodeType::Assignment) return stmt;
+            auto exprStmt = makeNode(ASTNodeType::ExpressionStatement, kExpressionStatement);
+            exprStmt->left = stmt;
+            return exprStmt;
+        }
+        // Handle calls made for their effects (name(arguments);)
+        case TokenKind::LParen: {
+            auto call = parseCall();
+            match(TokenKind::Semicolon);
+            auto exprStmt = makeNode(ASTNodeType::ExpressionStatement, kExpressionStatement);
+            exprStmt->left = call;
+            return exprStmt;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+ASTNode* Parser::parsePrefixIncrementStatement() {
+    // Handle pre-increment/decrement statements (++i, --i)
+    if (check(TokenKind::PlusPlus) || check(TokenKind::MinusMinus)) {
+        auto stmt = parseIncrementExpression();
+        if (stmt && match(TokenKind::Semicolon)) {
+            auto exprStmt = makeNode(ASTNodeType::ExpressionStatement, kExpressionStatement);
+            exprStmt->left = stmt;
+            return exprStmt;
+        }
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseInputStatement() {
+    if (match(TokenKind::KwStd) && match(TokenKind::ColonColon) && match(TokenKind::KwCin)) {
+        auto inputNode = makeNode(ASTNodeType::InputStatement, kCin);
+        
+        // Parse each part of the cin statement
+        while (!check(TokenKind::Semicolon) && !tokens.atEnd()) {
+            if (check(TokenKind::ShiftRight)) {
+                advance(); // skip >>
+            } else if (check(TokenType::Identifier)) {
+                // Handle variables and array elements in cin
+                inputNode->children.push_back(parseTarget());
+            } else {
+                // Skip other tokens we don't handle
+                advance();
+            }
+        }
+        
+        match(TokenKind::Semicolon);
+        return inputNode;
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseForStatement() {
+    SourceLocation loc = peek().loc;
+    if (match(TokenKind::KwFor)) {
+        match(TokenKind::LParen);
+        
+        auto forNode = makeNode(ASTNodeType::ForStatement, kFor);
+        forNode->loc = loc;
+        
+        // Parse initialization (e.g., int i = 0)
+        auto init = parseStatement();
+        if (init) {
+            forNode->children.push_back(init);
+        } else {
+            // Handle empty initialization
+            match(TokenKind::Semicolon);
+            forNode->children.push_back(nullptr);
+        }
+        
+        // Parse condition (e.g., i < 10)
+        auto condition = parseExpression();
+        forNode->children.push_back(condition);
+        match(TokenKind::Semicolon);
+        
+        // Parse increment (e.g., i++)
+        auto increment = parseIncrementExpression();
+        forNode->children.push_back(increment);
+        match(TokenKind::RParen);
+        
+        // Parse body
+        auto body = parseStatement();
+        if (!body && check(TokenKind::LBrace)) {
+            body = parseBlock();
+        }
+        forNode->children.push_back(body);
+        
+        return forNode;
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseWhileStatement() {
+    SourceLocation loc = peek().loc;
+    if (match(TokenKind::KwWhile)) {
+        match(TokenKind::LParen);
+        
+        auto whileNode = makeNode(ASTNodeType::WhileStatement, kWhile);
+        whileNode->loc = loc;
+        
+        // Parse condition
+        auto condition = parseExpression();
+        whileNode->left = condition;
+        match(TokenKind::RParen);
+        
+        // Parse body
+        auto body = parseStatement();
+        if (!body && check(TokenKind::LBrace)) {
+            body = parseBlock();
+        }
+        whileNode->right = body;
+        
+        return whileNode;
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseDoWhileStatement() {
+    SourceLocation loc = peek().loc;
+    if (match(TokenKind::KwDo)) {
+        auto doWhileNode = makeNode(ASTNodeType::DoWhileStatement, kDoWhile);
+        doWhileNode->loc = loc;
+        
+        // Parse body first
+        auto body = parseStatement();
+        if (!body && check(TokenKind::LBrace)) {
+            body = parseBlock();
+        }
+        doWhileNode->left = body;
+        
+        // Parse while condition
+        match(TokenKind::KwWhile);
+        match(TokenKind::LParen);
+        auto condition = parseExpression();
+        doWhileNode->right = condition;
+        match(TokenKind::RParen);
+        match(TokenKind::Semicolon);
+        
+        return doWhileNode;
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseIncrementExpression() {
+    // Handle i++, ++i, i--, --i, i += 1, i -= 1, etc.
+    if (check(TokenType::Identifier)) {
+        auto target = parseTarget();
+        
+        // Post-increment/decrement (i++, i--)
+        if (check(TokenKind::PlusPlus) || check(TokenKind::MinusMinus)) {
+            auto op = advance();
+            auto incNode = makeNode(ASTNodeType::PostIncrement, op);
+            incNode->left = target;
+            return incNode;
+        }
+        
+        // Compound assignment (i += 1, i -= 1, etc.)
+        if (check(TokenKind::PlusAssign) || check(TokenKind::MinusAssign) || 
+            check(TokenKind::StarAssign) || check(TokenKind::SlashAssign)) {
+            auto op = advance();
+            auto expr = parseExpression();
+            auto compoundNode = makeNode(ASTNodeType::CompoundAssignment, op);
+            compoundNode->left = target;
+            compoundNode->right = expr;
+            return compoundNode;
+        }
+        
+        // Regular assignment (i = i + 1)
+        if (check(TokenKind::Assign)) {
+            advance(); // skip =
+            auto expr = parseExpression();
+            auto assignNode = makeNode(ASTNodeType::Assignment, kAssign);
+            assignNode->left = target;
+            assignNode->right = expr;
+            return assignNode;
+        }
+        
+        // Just the identifier (in case of empty increment)
+        return target;
+    }
+    
+    // Pre-increment/decrement (++i, --i)
+    if (check(TokenKind::PlusPlus) || check(TokenKind::MinusMinus)) {
+        auto op = advance();
+        if (check(TokenType::Identifier)) {
+            auto preIncNode = makeNode(ASTNodeType::PreIncrement, op);
+            preIncNode->left = parseTarget();
+            return preIncNode;
+        }
+    }
+    
+    return nullptr;
+}
+
+ASTNode* Parser::parseAssignment() {
+    if (check(TokenType::Identifier)) {
+        auto target = parseTarget();
+        if (match(TokenKind::Assign)) {
+            auto assignNode = makeNode(ASTNodeType::Assignment, kAssign);
+            assignNode->left = target;
+            assignNode->right = parseExpression();
+            match(TokenKind::Semicolon);
+            return assignNode;
+        }
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parsePreprocessor() {
+    if (check(TokenKind::Preprocessor)) {
+        auto preprocessor = makeNode(ASTNodeType::Preprocessor, advance());
+        return preprocessor;
+    }
+    return nullptr;
+}
+
+// int name(int a, float b) { ... }; a prototype ends in ; instead of a
+// body. The result type is kept as a Declaration with no variable.
+ASTNode* Parser::parseFunctionDeclaration() {
+    if (!check(TokenKind::KwInt) && !check(TokenKind::KwFloat)) {
+        return nullptr;
+    }
+    auto typeToken = advance();
+    if (!check(TokenKind::KwMain) && !check(TokenType::Identifier)) {
+        return nullptr;
+    }
+
+    auto funcNode = makeNode(ASTNodeType::FunctionDeclaration, advance());
+    funcNode->right = makeNode(ASTNodeType::Declaration, typeToken);
+
+    match(TokenKind::LParen);
+    while (check(TokenKind::KwInt) || check(TokenKind::KwFloat)) {
+        auto paramType = advance();
+        if (!check(TokenType::Identifier)) break;
+        auto param = makeNode(ASTNodeType::Declaration, paramType);
+        param->left = makeNode(ASTNodeType::Identifier, advance());
+        funcNode->children.push_back(param);
+        if (!match(TokenKind::Comma)) break;
+    }
+    match(TokenKind::RParen);
+
+    if (check(TokenKind::LBrace)) {
+        funcNode->left = parseBlock();
+    } else {
+        match(TokenKind::Semicolon);
+    }
+    return funcNode;
+}
+
+ASTNode* Parser::parseReturnStatement() {
+    if (match(TokenKind::KwReturn)) {
+        auto returnNode = makeNode(ASTNodeType::ReturnStatement, kReturn);
+        
+        if (!check(TokenKind::Semicolon)) {
+            returnNode->left = parseExpression();
+        }
+        
+        match(TokenKind::Semicolon);
+        return returnNode;
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseDeclaration() {
+    if (check(TokenKind::KwInt) || check(TokenKind::KwFloat)) {
+        auto typeToken = advance();
+        
+        if (check(TokenType::Identifier)) {
+            auto idToken = advance();
+            
+            // int a[size] or int a[size] = {x, y, ...}
+            if (match(TokenKind::LBracket)) {
+                auto arrayNode = makeNode(ASTNodeType::ArrayDeclaration, typeToken);
+                arrayNode->left = makeNode(ASTNodeType::Identifier, idToken);
+                arrayNode->right = parseExpression();
+                match(TokenKind::RBracket);
+                if (match(TokenKind::Assign) && match(TokenKind::LBrace)) {
+                    while (!check(TokenKind::RBrace) && !tokens.atEnd()) {
+                        if (auto element = parseExpression()) {
+                            arrayNode->children.push_back(element);
+                        } else {
+                            advance();
+                        }
+                        match(TokenKind::Comma);
+                    }
+                    match(TokenKind::RBrace);
+                }
+                match(TokenKind::Semicolon);
+                return arrayNode;
+            }
+            
+            auto declNode = makeNode(ASTNodeType::Declaration, typeToken);
+            declNode->left = makeNode(ASTNodeType::Identifier, idToken);
+            
+            if (match(TokenKind::Assign)) {
+                declNode->right = parseExpression();
+            }
+            
+            match(TokenKind::Semicolon);
+            return declNode;
+        }
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseIfStatement() {
+    SourceLocation loc = peek().loc;
+    if (match(TokenKind::KwIf)) {
+        match(TokenKind::LParen);
+        auto condition = parseExpression();
+        match(TokenKind::RParen);
+        
+        auto ifNode = makeNode(ASTNodeType::IfStatement, kIf);
+        ifNode->loc = loc;
+        ifNode->left = condition;
+        
+        if (check(TokenKind::LBrace)) {
+            ifNode->right = parseBlock();
+        }
+        
+        return ifNode;
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parseBlock() {
+    const size_t begin = peek().offset;
+    const SourceLocation loc = peek().loc;
+    if (match(TokenKind::LBrace)) {
+        auto blockNode = makeNode(ASTNodeType::Block, kBlock);
+        blockNode->loc = loc;
+        
+        while (!check(TokenKind::RBrace) && !tokens.atEnd()) {
+            auto stmt = parseStatement();
+            if (stmt) {
+                blockNode->children.push_back(stmt);
+            } else {
+                // Skip single tokens that we can't parse
+                tokens.advance();
+            }
+        }
+        
+        match(TokenKind::RBrace);
+        blockNode->span = SourceSpan{begin, tokens.consumedEnd()};
+        return blockNode;
+    }
+    return nullptr;
+}
+
+ASTNode* Parser::parsePrintStatement() {
+    if (match(TokenKind::KwStd) && match(TokenKind::ColonColon) && match(TokenKind::KwCout)) {
+        auto printNode = makeNode(ASTNodeType::PrintStatement, kCout);
+        
+        // Parse each part of the cout statement separately
+        while (!check(TokenKind::Semicolon) && !tokens.atEnd()) {
+            if (check(TokenKind::ShiftLeft)) {
+                advance(); // skip <<
+            } else if (check(TokenType::Literal)) {
+                // Handle string literals
+                auto outputNode = makeNode(ASTNodeType::Literal, advance());
+                printNode->children.push_back(outputNode);
+            } else if (check(TokenKind::KwStd) &&
+                       peek(1).kind == TokenKind::ColonColon && peek(2).kind == TokenKind::KwEndl) {
+                // Handle std::endl properly
+                advance(); // std
+                advance(); // ::
+                advance(); // endl
+                auto endlNode = makeNode(ASTNodeType::Literal, kEndl);
+                printNode->children.push_back(endlNode);
+            } else if (check(TokenType::Identifier)) {
+                // Handle variables, array elements and calls in cout
+                printNode->children.push_back(peek(1).kind == TokenKind::LParen ? parseCall() : parseTarget());
+            } else {
+                // Skip other tokens we don't handle
+                advance();
+            }
+        }
+        
+        match(TokenKind::Semicolon);
+        return printNode;
+    }
+    return nullptr;
+}
+
+namespace {
+
+// Binding power of each binary operator, as in C++; 0 for tokens that end
+// an expression. Like every level, they associate to the left.
+constexpr std::array<uint8_t, kTokenKindCount> makePrecedenceTable() {
+    std::array<uint8_t, kTokenKindCount> table{};
+    auto level = [&](TokenKind kind, uint8_t precedence) { table[static_cast<size_t>(kind)] = precedence; };
+    level(TokenKind::OrOr, 1);
+    level(TokenKind::AndAnd, 2);
+    level(TokenKind::Ampersand, 3);
+    level(TokenKind::Equal, 4);
+    level(TokenKind::NotEqual, 4);
+    level(TokenKind::Less, 5);
+    level(TokenKind::Greater, 5);
+    level(TokenKind::LessEqual, 5);
+    level(TokenKind::GreaterEqual, 5);
+    level(TokenKind::ShiftLeft, 6);
+    level(TokenKind::ShiftRight, 6);
+    level(TokenKind::Plus, 7);
+    level(TokenKind::Minus, 7);
+    level(TokenKind::Star, 8);
+    level(TokenKind::Slash, 8);
+    level(TokenKind::Percent, 8);
+    return table;
+}
+
+constexpr std::array<uint8_t, kTokenKindCount> kPrecedence = makePrecedenceTable();
+
+} // namespace
+
+ASTNode* Parser::parseExpression() {
+    return parseBinaryExpression(1);
+}
+
+// Precedence climbing: one loop handles every binary level
+ASTNode* Parser::parseBinaryExpression(int minPrecedence) {
+    auto left = parsePrimary();
+
+    for (;;) {
+        const int precedence = kPrecedence[static_cast<size_t>(peek().kind)];
+        if (precedence == 0 || precedence < minPrecedence) break;
+
+        auto opNode = makeNode(ASTNodeType::BinaryOperation, advance());
+        opNode->left = left;
+        opNode->right = parseBinaryExpression(precedence + 1);
+        left = opNode;
+    }
+
+    return left;
+}
+
+ASTNode* Parser::parsePrimary() {
+    if (check(TokenType::Number)) {
+        return makeNode(ASTNodeType::Literal, advance());
+    }
+    
+    if (check(TokenType::Literal)) {
+        return makeNode(ASTNodeType::Literal, advance());
+    }
+    
+    if (check(TokenType::Identifier)) {
+        if (peek(1).kind == TokenKind::LParen) {
+            return parseCall();
+        }
+        return parseTarget();
+    }
+    
+    // Prefix operators bind tighter than any binary one
+    if (check(TokenKind::Not) || check(TokenKind::Minus)) {
+        auto opNode = makeNode(ASTNodeType::UnaryOperation, advance());
+        opNode->left = parsePrimary();
+        return opNode;
+    }
+    
+    if (match(TokenKind::LParen)) {
+        auto expr = parseExpression();
+        match(TokenKind::RParen);
+        return expr;
+    }
+    
+    return nullptr;
+}
+
+// name(argument, ...), starting at the name
+ASTNode* Parser::parseCall() {
+    auto callNode = makeNode(ASTNodeType::CallExpression, advance());
+    match(TokenKind::LParen);
+    if (!check(TokenKind::RParen)) {
+        do {
+            if (auto argument = parseExpression()) {
+                callNode->children.push_back(argument);
+            }
+        } while (match(TokenKind::Comma));
+    }
+    match(TokenKind::RParen);
+    return callNode;
+}
+
+// A variable, or an element of an array: a[index]
+ASTNode* Parser::parseTarget() {
+    if (peek(1).kind == TokenKind::LBracket) {
+        return parseSubscript();
+    }
+    return makeNode(ASTNodeType::Identifier, advance());
+}
+
+ASTNode* Parser::parseSubscript() {
+    auto subscriptNode = makeNode(ASTNodeType::ArraySubscript, kSubscript);
+    subscriptNode->loc = peek().loc;
+    subscriptNode->left = makeNode(ASTNodeType::Identifier, advance());
+    match(TokenKind::LBracket);
+    subscriptNode->right = parseExpression();
+    match(TokenKind::RBracket);
+    return subscriptNode;
+}
+
+void printAST(const ASTNode* node, int indent) {
+    if (!node) return;
+    std::string pad(indent, ' ');
+    std::cout << pad << node->value << " (" << static_cast<int>(node->type) << ")\n";
+    
+    if (node->left) printAST(node->left, indent + 2);
+    if (node->right) printAST(node->right, indent + 2);
+    
+    for (const auto& child : node->children) {
+        printAST(child, indent + 2);
+    }
 }
\ No newline at end of file
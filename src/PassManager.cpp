@@ -0,0 +1,65 @@
+#include "../include/PassManager.h"
+#include <iomanip>
+
+void PassManager::addPass(std::string name, Pass pass) {
+    passes.push_back(std::move(pass));
+    passStatistics.push_back(PassStatistics{std::move(name)});
+}
+
+ASTNode* PassManager::run(ASTNode* root) {
+    cache = AnalysisCache();
+    for (auto& stats : passStatistics) {
+        stats = PassStatistics{std::move(stats.name)};
+    }
+    iterationsRun = 0;
+    fixedPoint = false;
+
+    while (root && iterationsRun < iterationLimit) {
+        ++iterationsRun;
+        bool changed = false;
+        for (size_t i = 0; i < passes.size() && root; ++i) {
+            size_t rewrites = 0;
+            auto start = std::chrono::steady_clock::now();
+            root = passes[i](root, cache, rewrites);
+            passStatistics[i].time += std::chrono::steady_clock::now() - start;
+            ++passStatistics[i].runs;
+
+            if (rewrites > 0) {
+                passStatistics[i].rewrites += rewrites;
+                cache.invalidate();
+                changed = true;
+            }
+        }
+        if (!changed) {
+            fixedPoint = true;
+            break;
+        }
+    }
+    // A tree optimized away entirely cannot change any more
+    if (!root) fixedPoint = true;
+    return root;
+}
+
+void PassManager::report(std::ostream& out, const char* prefix) const {
+    if (fixedPoint) {
+        out << prefix << "Reached a fixed point after " << iterationsRun << " iteration"
+            << (iterationsRun == 1 ? "" : "s") << std::endl;
+    } else {
+        out << prefix << "Stopped at the limit of " << iterationLimit
+            << " iterations before reaching a fixed point" << std::endl;
+    }
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    for (const auto& stats : passStatistics) {
+        out << prefix << "Pass " << stats.name << ": " << stats.runs << " runs, "
+            << stats.rewrites << " rewrites, "
+            << std::chrono::duration<double, std::milli>(stats.time).count() << " ms" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+
+    out << prefix << "Analyses: " << cache.computed() << " computed, "
+        << cache.reused() << " reused from cache" << std::endl;
+}
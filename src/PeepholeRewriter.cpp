@@ -0,0 +1,464 @@
+#include "../include/PeepholeRewriter.h"
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+const Symbol kTrue("true");
+const Symbol kFalse("false");
+
+// Operators patterns are keyed by; a unary - is Negate, a binary one Subtract
+enum class PatternOp : uint8_t {
+    None,
+    Add, Subtract, Multiply, Divide, Modulo, ShiftLeft, ShiftRight, BitAnd,
+    Equal, NotEqual, Less, Greater, LessEqual, GreaterEqual, And, Or,
+    Not, Negate,
+    Count
+};
+
+struct OperatorSpelling {
+    std::string_view text;
+    PatternOp binary;
+    PatternOp unary;
+};
+
+// Two-character operators first, so that patterns read the longest one
+constexpr OperatorSpelling kOperators[] = {
+    {"<<", PatternOp::ShiftLeft, PatternOp::None},  {">>", PatternOp::ShiftRight, PatternOp::None},
+    {"==", PatternOp::Equal, PatternOp::None},      {"!=", PatternOp::NotEqual, PatternOp::None},
+    {"<=", PatternOp::LessEqual, PatternOp::None},  {">=", PatternOp::GreaterEqual, PatternOp::None},
+    {"&&", PatternOp::And, PatternOp::None},        {"||", PatternOp::Or, PatternOp::None},
+    {"+", PatternOp::Add, PatternOp::None},         {"-", PatternOp::Subtract, PatternOp::Negate},
+    {"*", PatternOp::Multiply, PatternOp::None},    {"/", PatternOp::Divide, PatternOp::None},
+    {"%", PatternOp::Modulo, PatternOp::None},      {"&", PatternOp::BitAnd, PatternOp::None},
+    {"<", PatternOp::Less, PatternOp::None},        {">", PatternOp::Greater, PatternOp::None},
+    {"!", PatternOp::None, PatternOp::Not},
+};
+
+// Types a rule allows its variables, as a mask of ValueType bits
+constexpr uint8_t typeBit(ValueType type) { return static_cast<uint8_t>(1u << static_cast<unsigned>(type)); }
+constexpr uint8_t kBools = typeBit(ValueType::Bool);
+constexpr uint8_t kInts = typeBit(ValueType::Int);
+constexpr uint8_t kIntegers = kBools | kInts;
+constexpr uint8_t kNumbers = kInts | typeBit(ValueType::Float) | typeBit(ValueType::Double);
+constexpr uint8_t kKnown = kBools | kNumbers;
+constexpr uint8_t kAnything = kKnown | typeBit(ValueType::Unknown);
+
+struct RuleSource {
+    std::string_view pattern;
+    std::string_view replacement;
+    uint8_t types;
+};
+
+// The rules. A pattern is an operation on operands: the variables x and
+// y, which match any expression (the same one wherever a variable
+// repeats), the literals true, false and integers such as 0 and -1, and
+// operations in parentheses. ! and - are prefix operators. Every
+// replacement is smaller than its pattern, so rewriting always ends.
+constexpr RuleSource kRuleSource[] = {
+    // && and || convert any operand to bool; one they are left with must
+    // be a bool already, or the value would change type
+    {"true || x", "true", kAnything},
+    {"x || true", "true", kAnything},
+    {"false && x", "false", kAnything},
+    {"x && false", "false", kAnything},
+    {"false || x", "x", kBools},
+    {"x || false", "x", kBools},
+    {"true && x", "x", kBools},
+    {"x && true", "x", kBools},
+    {"x || x", "x", kBools},
+    {"x && x", "x", kBools},
+    {"!!x", "x", kBools},
+
+    // Not for floating point: NaN compares unequal to itself, and is
+    // neither less than, equal to nor greater than anything
+    {"!(x == y)", "x != y", kIntegers},
+    {"!(x != y)", "x == y", kIntegers},
+    {"!(x < y)", "x >= y", kIntegers},
+    {"!(x >= y)", "x < y", kIntegers},
+    {"!(x > y)", "x <= y", kIntegers},
+    {"!(x <= y)", "x > y", kIntegers},
+    {"x == x", "true", kIntegers},
+    {"x != x", "false", kIntegers},
+    {"x <= x", "true", kIntegers},
+    {"x >= x", "true", kIntegers},
+    {"x < x", "false", kKnown},
+    {"x > x", "false", kKnown},
+
+    // Exact in floating point as well: x - 0, x * 1 and x / 1 keep -0.0
+    // and NaN as they are, and so does negating twice
+    {"x - 0", "x", kNumbers},
+    {"x * 1", "x", kNumbers},
+    {"1 * x", "x", kNumbers},
+    {"x / 1", "x", kNumbers},
+    {"-(-x)", "x", kNumbers},
+
+    // Ints only: -0.0 + 0 is 0.0, 0 * x is NaN for an infinite x, and
+    // which sign a NaN comes out with depends on the operation
+    {"x + 0", "x", kInts},
+    {"0 + x", "x", kInts},
+    {"x << 0", "x", kInts},
+    {"x >> 0", "x", kInts},
+    {"x & x", "x", kInts},
+    {"x * 0", "0", kInts},
+    {"0 * x", "0", kInts},
+    {"x & 0", "0", kInts},
+    {"0 & x", "0", kInts},
+    {"x % 1", "0", kInts},
+    {"x - x", "0", kInts},
+    {"0 - x", "-x", kInts},
+    {"x * -1", "-x", kInts},
+    {"-1 * x", "-x", kInts},
+    {"-x * -y", "x * y", kInts},
+    {"x + -y", "x - y", kInts},
+    {"x - -y", "x + y", kInts},
+};
+
+// A node of a compiled pattern; operands are indices into the pattern's
+// nodes, which are stored children first
+struct PatternNode {
+    enum class Kind : uint8_t { Variable, Integer, Boolean, Operation };
+    Kind kind = Kind::Variable;
+    PatternOp op = PatternOp::None;
+    uint8_t variable = 0; // 0 for x, 1 for y
+    int8_t value = 0;     // of an Integer or a Boolean
+    int8_t left = -1;
+    int8_t right = -1;    // -1 for a unary operation
+};
+
+constexpr size_t kMaxPatternNodes = 7;
+constexpr size_t kVariables = 2;
+
+struct Pattern {
+    std::array<PatternNode, kMaxPatternNodes> nodes{};
+    uint8_t size = 0;
+    int8_t root = -1;
+    std::array<uint8_t, kVariables> uses{}; // occurrences of each variable
+};
+
+// Parses a pattern, throwing on anything malformed; in a constant
+// expression, that stops the build
+class PatternParser {
+public:
+    explicit constexpr PatternParser(std::string_view text) : text(text) {}
+
+    constexpr Pattern parse() {
+        Pattern pattern;
+        pattern.root = expression(pattern);
+        skipSpaces();
+        if (position != text.size()) throw std::logic_error("unexpected text at the end of a pattern");
+        return pattern;
+    }
+
+private:
+    // An operand, or two joined by a binary operator. Patterns have no
+    // precedence: a nested operation is in parentheses.
+    constexpr int8_t expression(Pattern& pattern) {
+        const int8_t left = operand(pattern);
+        skipSpaces();
+        for (const OperatorSpelling& spelling : kOperators) {
+            if (spelling.binary != PatternOp::None && consume(spelling.text)) {
+                const int8_t right = operand(pattern);
+                return add(pattern, PatternNode{PatternNode::Kind::Operation, spelling.binary, 0, 0, left, right});
+            }
+        }
+        return left;
+    }
+
+    constexpr int8_t operand(Pattern& pattern) {
+        skipSpaces();
+        if (consume("(")) {
+            const int8_t inner = expression(pattern);
+            skipSpaces();
+            if (!consume(")")) throw std::logic_error("missing ) in a pattern");
+            return inner;
+        }
+        const bool negative = text.substr(position, 1) == "-" && position + 1 < text.size() &&
+                              text[position + 1] >= '0' && text[position + 1] <= '9';
+        if (negative) ++position;
+        if (position < text.size() && text[position] >= '0' && text[position] <= '9') {
+            int value = 0;
+            while (position < text.size() && text[position] >= '0' && text[position] <= '9') {
+                value = value * 10 + (text[position++] - '0');
+                if (value > 127) throw std::logic_error("literal too large for a pattern");
+            }
+            const auto literal = static_cast<int8_t>(negative ? -value : value);
+            return add(pattern, PatternNode{PatternNode::Kind::Integer, PatternOp::None, 0, literal});
+        }
+        for (const OperatorSpelling& spelling : kOperators) {
+            if (spelling.unary != PatternOp::None && consume(spelling.text)) {
+                const int8_t inner = operand(pattern);
+                return add(pattern, PatternNode{PatternNode::Kind::Operation, spelling.unary, 0, 0, inner, -1});
+            }
+        }
+        if (consume("true")) return add(pattern, PatternNode{PatternNode::Kind::Boolean, PatternOp::None, 0, 1});
+        if (consume("false")) return add(pattern, PatternNode{PatternNode::Kind::Boolean, PatternOp::None, 0, 0});
+        for (uint8_t variable = 0; variable < kVariables; ++variable) {
+            const char name[] = {static_cast<char>('x' + variable), '\0'};
+            if (consume(std::string_view(name, 1))) {
+                ++pattern.uses[variable];
+                return add(pattern, PatternNode{PatternNode::Kind::Variable, PatternOp::None, variable});
+            }
+        }
+        throw std::logic_error("expected an operand in a pattern");
+    }
+
+    static constexpr int8_t add(Pattern& pattern, const PatternNode& node) {
+        if (pattern.size == kMaxPatternNodes) throw std::logic_error("pattern too large");
+        pattern.nodes[pattern.size] = node;
+        return static_cast<int8_t>(pattern.size++);
+    }
+
+    constexpr bool consume(std::string_view token) {
+        if (text.substr(position, token.size()) != token) return false;
+        position += token.size();
+        return true;
+    }
+
+    constexpr void skipSpaces() {
+        while (position < text.size() && text[position] == ' ') ++position;
+    }
+
+    std::string_view text;
+    size_t position = 0;
+};
+
+struct CompiledRule {
+    Pattern pattern;
+    Pattern replacement;
+    uint8_t types = 0;
+    uint8_t mustBePure = 0; // variables matched more often than they are used, by bit
+    std::string_view text;  // of the pattern and the replacement, for the log
+    std::string_view replacementText;
+};
+
+// Rules ordered by the operator at the root of their pattern, with the
+// range of each operator's rules
+template <size_t Count>
+struct RuleTable {
+    std::array<CompiledRule, Count> rules{};
+    std::array<uint8_t, static_cast<size_t>(PatternOp::Count) + 1> first{};
+};
+
+template <size_t Count>
+constexpr RuleTable<Count> compileRules(const RuleSource (&source)[Count]) {
+    std::array<CompiledRule, Count> compiled{};
+    for (size_t i = 0; i < Count; ++i) {
+        CompiledRule& rule = compiled[i];
+        rule.pattern = PatternParser(source[i].pattern).parse();
+        rule.replacement = PatternParser(source[i].replacement).parse();
+        rule.types = source[i].types;
+        rule.text = source[i].pattern;
+        rule.replacementText = source[i].replacement;
+        if (rule.pattern.nodes[rule.pattern.root].kind != PatternNode::Kind::Operation) {
+            throw std::logic_error("a pattern must be an operation");
+        }
+        if (rule.replacement.size >= rule.pattern.size) throw std::logic_error("a replacement must be smaller");
+        for (uint8_t variable = 0; variable < kVariables; ++variable) {
+            if (rule.replacement.uses[variable] > 0 && rule.pattern.uses[variable] == 0) {
+                throw std::logic_error("a replacement uses a variable its pattern does not match");
+            }
+            if (rule.pattern.uses[variable] > rule.replacement.uses[variable]) rule.mustBePure |= 1u << variable;
+        }
+    }
+
+    RuleTable<Count> table;
+    size_t next = 0;
+    for (size_t op = 0; op < static_cast<size_t>(PatternOp::Count); ++op) {
+        table.first[op] = static_cast<uint8_t>(next);
+        for (const CompiledRule& rule : compiled) {
+            if (static_cast<size_t>(rule.pattern.nodes[rule.pattern.root].op) == op) table.rules[next++] = rule;
+        }
+    }
+    table.first[static_cast<size_t>(PatternOp::Count)] = static_cast<uint8_t>(next);
+    return table;
+}
+
+constexpr auto kRules = compileRules(kRuleSource);
+
+// The key of each operator symbol, by symbol id: operator symbols are
+// interned when the optimizer starts, so the tables are short
+class OperatorKeys {
+public:
+    OperatorKeys() {
+        for (const OperatorSpelling& spelling : kOperators) {
+            const uint32_t id = Symbol(spelling.text).id();
+            if (id >= binary.size()) {
+                binary.resize(id + 1, PatternOp::None);
+                unary.resize(id + 1, PatternOp::None);
+            }
+            binary[id] = spelling.binary;
+            unary[id] = spelling.unary;
+        }
+    }
+
+    PatternOp of(const ASTNode* node) const {
+        const std::vector<PatternOp>* keys;
+        if (node->type == ASTNodeType::BinaryOperation) {
+            keys = &binary;
+        } else if (node->type == ASTNodeType::UnaryOperation) {
+            keys = &unary;
+        } else {
+            return PatternOp::None;
+        }
+        const uint32_t id = node->value.id();
+        return id < keys->size() ? (*keys)[id] : PatternOp::None;
+    }
+
+private:
+    std::vector<PatternOp> binary;
+    std::vector<PatternOp> unary;
+};
+
+const OperatorKeys& operatorKeys() {
+    static const OperatorKeys keys;
+    return keys;
+}
+
+Symbol spellingOf(PatternOp op) {
+    for (const OperatorSpelling& spelling : kOperators) {
+        if (spelling.binary == op || spelling.unary == op) return Symbol(spelling.text);
+    }
+    return Symbol();
+}
+
+using Bindings = std::array<ASTNode*, kVariables>;
+
+bool match(const Pattern& pattern, int8_t index, ASTNode* node, Bindings& bound) {
+    if (!node) return false;
+    const PatternNode& expected = pattern.nodes[index];
+    switch (expected.kind) {
+        case PatternNode::Kind::Variable: {
+            ASTNode*& binding = bound[expected.variable];
+            if (!binding) {
+                binding = node;
+                return true;
+            }
+            return sameExpression(binding, node);
+        }
+        case PatternNode::Kind::Integer: {
+            int64_t value;
+            return node->type == ASTNodeType::Literal && intLiteralValue(node->value, value) &&
+                   value == expected.value;
+        }
+        case PatternNode::Kind::Boolean:
+            return node->type == ASTNodeType::Literal && node->value == (expected.value ? kTrue : kFalse);
+        case PatternNode::Kind::Operation:
+            if (operatorKeys().of(node) != expected.op) return false;
+            return match(pattern, expected.left, node->left, bound) &&
+                   (expected.right < 0 || match(pattern, expected.right, node->right, bound));
+    }
+    return false;
+}
+
+// Builds a replacement. A variable's expression is reused where it is
+// first used, and copied after that.
+ASTNode* instantiate(const Pattern& pattern, int8_t index, const Bindings& bound, std::array<bool, kVariables>& used,
+                     const ASTNode* original, ASTArena& arena) {
+    const PatternNode& node = pattern.nodes[index];
+    ASTNode* result = nullptr;
+    switch (node.kind) {
+        case PatternNode::Kind::Variable: {
+            ASTNode* binding = bound[node.variable];
+            if (!used[node.variable]) {
+                used[node.variable] = true;
+                return binding;
+            }
+            return binding->deepCopy(arena);
+        }
+        case PatternNode::Kind::Integer:
+            result = arena.create<ASTNode>(arena, ASTNodeType::Literal, std::to_string(node.value));
+            break;
+        case PatternNode::Kind::Boolean:
+            result = arena.create<ASTNode>(arena, ASTNodeType::Literal, node.value ? kTrue : kFalse);
+            break;
+        case PatternNode::Kind::Operation:
+            result = arena.create<ASTNode>(
+                arena, node.right < 0 ? ASTNodeType::UnaryOperation : ASTNodeType::BinaryOperation, spellingOf(node.op));
+            result->left = instantiate(pattern, node.left, bound, used, original, arena);
+            if (node.right >= 0) result->right = instantiate(pattern, node.right, bound, used, original, arena);
+            break;
+    }
+    result->loc = original->loc;
+    return result;
+}
+
+} // namespace
+
+ASTNode* PeepholeRewriter::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    simplified = 0;
+
+    ASTNode* result = root;
+    size_t next = 0; // graphs are in the order of the program's functions
+    for (const ControlFlowGraph& functionGraph : graphs) {
+        graph = &functionGraph;
+        auto function = const_cast<ASTNode*>(graph->function());
+        auto rewritten = rewrite(function);
+        if (rewritten == function) continue;
+        if (function == root) {
+            result = rewritten;
+            continue;
+        }
+        while (root->children[next] != function) ++next;
+        if (result == root) result = root->shallowCopy(arena);
+        result->children[next] = rewritten;
+    }
+
+    rewrites += simplified;
+    graph = nullptr;
+    return result;
+}
+
+// Operands before the operations on them, so that x * 1 + 0 goes in two steps
+ASTNode* PeepholeRewriter::rewrite(ASTNode* node) {
+    if (!node) return nullptr;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+    if (auto left = rewrite(node->left); left != node->left) own()->left = left;
+    if (auto right = rewrite(node->right); right != node->right) own()->right = right;
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        auto child = rewrite(node->children[i]);
+        if (child != node->children[i]) own()->children[i] = child;
+    }
+
+    if (node->type != ASTNodeType::BinaryOperation && node->type != ASTNodeType::UnaryOperation) return result;
+    return simplify(result);
+}
+
+// Applies the first rule that matches, and goes on with its replacement
+ASTNode* PeepholeRewriter::simplify(ASTNode* node) {
+    for (;;) {
+        const auto op = static_cast<size_t>(operatorKeys().of(node));
+        const CompiledRule* applied = nullptr;
+        Bindings bound{};
+        for (size_t i = kRules.first[op]; i < kRules.first[op + 1] && !applied; ++i) {
+            const CompiledRule& rule = kRules.rules[i];
+            bound = Bindings{};
+            if (!match(rule.pattern, rule.pattern.root, node, bound)) continue;
+            bool allowed = true;
+            for (uint8_t variable = 0; variable < kVariables && allowed; ++variable) {
+                if (!bound[variable]) continue;
+                allowed = (rule.types & typeBit(expressionType(bound[variable], *graph))) != 0 &&
+                          !((rule.mustBePure >> variable & 1) && hasSideEffects(bound[variable]));
+            }
+            if (allowed) applied = &rule;
+        }
+        if (!applied) return node;
+
+        std::array<bool, kVariables> used{};
+        ASTNode* replacement = instantiate(applied->replacement, applied->replacement.root, bound, used, node, arena);
+        std::cout << "[Optimizer] Rewrote " << applied->text << " to " << applied->replacementText << " on line "
+                  << node->loc.line << std::endl;
+        ++simplified;
+        node = replacement;
+    }
+}
@@ -0,0 +1,107 @@
+#include "../include/SourceBuffer.h"
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SourceBuffer::SourceBuffer(std::string text)
+    : text(std::move(text)), data(this->text.data()), length(this->text.size()) {}
+
+SourceBuffer::SourceBuffer(void* mapping, size_t length)
+    : data(static_cast<const char*>(mapping)), length(length), mapping(mapping) {}
+
+#ifdef _WIN32
+
+SourceBuffer::~SourceBuffer() {}
+
+SourceBuffer SourceBuffer::fromFile(const std::string& path) {
+    std::stringstream buffer;
+    if (path == "-") {
+        buffer << std::cin.rdbuf();
+    } else {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Error opening file: " + path);
+        }
+        buffer << file.rdbuf();
+    }
+    return SourceBuffer(buffer.str());
+}
+
+#else
+
+SourceBuffer::~SourceBuffer() {
+    if (mapping) {
+        munmap(mapping, length);
+    }
+}
+
+namespace {
+
+// Fallback for inputs that cannot be mapped (pipes, terminals, stdin)
+std::string readAll(int fd, const std::string& path) {
+    std::string text;
+    size_t used = 0;
+    text.resize(1 << 16);
+    for (;;) {
+        if (used == text.size()) {
+            text.resize(text.size() * 2);
+        }
+        ssize_t n = ::read(fd, &text[used], text.size() - used);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Error reading file: " + path + ": " + std::strerror(errno));
+        }
+        used += static_cast<size_t>(n);
+    }
+    text.resize(used);
+    return text;
+}
+
+} // namespace
+
+SourceBuffer SourceBuffer::fromFile(const std::string& path) {
+    if (path == "-") {
+        return SourceBuffer(readAll(STDIN_FILENO, "<stdin>"));
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening file: " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        size_t length = static_cast<size_t>(info.st_size);
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            ::close(fd);
+            // The lexer makes a single forward pass over the text
+            madvise(mapping, length, MADV_SEQUENTIAL);
+            return SourceBuffer(mapping, length);
+        }
+    }
+
+    try {
+        std::string text = readAll(fd, path);
+        ::close(fd);
+        return SourceBuffer(std::move(text));
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+#endif
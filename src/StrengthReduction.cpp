@@ -0,0 +1,427 @@
+#include "../include/StrengthReduction.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace {
+const Symbol kInt("int");
+const Symbol kBlock("Block");
+const Symbol kExpressionStatement("ExpressionStatement");
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kTimes("*");
+const Symbol kDivide("/");
+const Symbol kModulo("%");
+const Symbol kShiftLeft("<<");
+const Symbol kShiftRight(">>");
+const Symbol kBitAnd("&");
+const Symbol kPlusAssign("+=");
+const Symbol kMinusAssign("-=");
+
+constexpr uint32_t None = ControlFlowGraph::None;
+
+bool fitsInt(int64_t number) {
+    return number >= std::numeric_limits<int32_t>::min() && number <= std::numeric_limits<int32_t>::max();
+}
+
+// k if number is 2^k with k >= 1, otherwise 0
+int powerOfTwo(int64_t number) {
+    if (number < 2 || (number & (number - 1)) != 0) return 0;
+    int k = 0;
+    while ((int64_t(1) << k) != number) ++k;
+    return k;
+}
+} // namespace
+
+ASTNode* StrengthReduction::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    writeSets = &analyses.get<WrittenVariables>(root);
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    reduced = 0;
+
+    ASTNode* result = root;
+    size_t next = 0; // graphs are in the order of the program's functions
+    for (const ControlFlowGraph& functionGraph : graphs) {
+        graph = &functionGraph;
+        auto function = const_cast<ASTNode*>(graph->function());
+        auto rewritten = rewrite(function);
+        if (rewritten == function) continue;
+        if (function == root) {
+            result = rewritten;
+            continue;
+        }
+        while (root->children[next] != function) ++next;
+        if (result == root) result = root->shallowCopy(arena);
+        result->children[next] = rewritten;
+    }
+
+    rewrites += reduced;
+    graph = nullptr;
+    writeSets = nullptr;
+    return result;
+}
+
+ASTNode* StrengthReduction::rewrite(ASTNode* node) {
+    if (!node) return nullptr;
+
+    switch (node->type) {
+        case ASTNodeType::BinaryOperation:
+        case ASTNodeType::Identifier:
+        case ASTNodeType::Literal:
+            return reduce(node).node;
+
+        case ASTNodeType::ForStatement: {
+            // A loop that gains induction variables is put in a block with them
+            std::vector<ASTNode*> statements;
+            rewriteLoop(node, statements);
+            if (statements.size() == 1) return statements.front();
+            auto block = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+            block->children.assign(statements.begin(), statements.end());
+            return block;
+        }
+
+        default:
+            break;
+    }
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+
+    if (auto left = rewrite(node->left); left != node->left) own()->left = left;
+    if (auto right = rewrite(node->right); right != node->right) own()->right = right;
+
+    if (node->type == ASTNodeType::Program || node->type == ASTNodeType::Block) {
+        std::vector<ASTNode*> statements;
+        statements.reserve(node->children.size());
+        for (ASTNode* child : node->children) {
+            if (child) {
+                rewriteInto(child, statements);
+            } else {
+                statements.push_back(nullptr);
+            }
+        }
+        if (!std::equal(statements.begin(), statements.end(), node->children.begin(), node->children.end())) {
+            own()->children.assign(statements.begin(), statements.end());
+        }
+    } else {
+        for (size_t i = 0; i < node->children.size(); ++i) {
+            if (auto child = rewrite(node->children[i]); child != node->children[i]) own()->children[i] = child;
+        }
+    }
+    return result;
+}
+
+// Appends the rewritten statement to `out`, after the induction variables
+// it needs declared if it is a loop
+void StrengthReduction::rewriteInto(ASTNode* node, std::vector<ASTNode*>& out) {
+    if (node->type == ASTNodeType::ForStatement) {
+        rewriteLoop(node, out);
+    } else {
+        out.push_back(rewrite(node));
+    }
+}
+
+void StrengthReduction::rewriteLoop(ASTNode* loop, std::vector<ASTNode*>& out) {
+    ASTNode* result = loop;
+    auto own = [&]() {
+        if (result == loop) result = loop->shallowCopy(arena);
+        return result;
+    };
+
+    // The initializer, condition and increment are outside the body, where
+    // the loop's induction variables are not kept up to date
+    const size_t header = std::min<size_t>(loop->children.size(), 3);
+    for (size_t i = 0; i < header; ++i) {
+        if (auto child = rewrite(loop->children[i]); child != loop->children[i]) own()->children[i] = child;
+    }
+    if (loop->children.size() < 4) {
+        out.push_back(result);
+        return;
+    }
+
+    ASTNode* body = loop->children[3];
+    CountedLoop count;
+    if (!countedLoop(loop, *graph, *writeSets, count) || count.trips == 0) {
+        if (auto rewritten = rewrite(body); rewritten != body) own()->children[3] = rewritten;
+        out.push_back(result);
+        return;
+    }
+
+    loops.push_back(ActiveLoop{graph->variableOf(loop->children[0]->left), count, {}});
+    ASTNode* rewritten = rewrite(body);
+    const ActiveLoop active = std::move(loops.back());
+    loops.pop_back();
+
+    if (!active.inductions.empty()) {
+        // int iv = start * c; before the loop, iv += step * c; at the end of the body
+        auto block = rewritten->type == ASTNodeType::Block ? rewritten->shallowCopy(arena) : nullptr;
+        if (!block) {
+            block = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+            block->children.push_back(rewritten);
+        }
+        for (const Induction& induction : active.inductions) {
+            auto declaration = arena.create<ASTNode>(arena, ASTNodeType::Declaration, kInt);
+            declaration->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, induction.name);
+            declaration->right = literal(count.start * induction.factor);
+            out.push_back(declaration);
+
+            const int64_t step = count.step * induction.factor;
+            auto increment = arena.create<ASTNode>(arena, ASTNodeType::CompoundAssignment,
+                                                   step > 0 ? kPlusAssign : kMinusAssign);
+            increment->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, induction.name);
+            increment->right = literal(step > 0 ? step : -step);
+            auto statement = arena.create<ASTNode>(arena, ASTNodeType::ExpressionStatement, kExpressionStatement);
+            statement->left = increment;
+            block->children.push_back(statement);
+        }
+        rewritten = block;
+    }
+    if (rewritten != body) own()->children[3] = rewritten;
+    out.push_back(result);
+}
+
+// Rewrites an expression bottom-up, working out the type and range of
+// every operand on the way
+StrengthReduction::Reduced StrengthReduction::reduce(ASTNode* node) {
+    switch (node->type) {
+        case ASTNodeType::Literal: {
+            Range range;
+            int64_t value;
+            if (intLiteralValue(node->value, value)) range = Range{true, value, value};
+            return {node, literalType(node->value), range};
+        }
+
+        case ASTNodeType::Identifier: {
+            const uint32_t variable = graph->variableOf(node);
+            const ValueType type =
+                variable == None ? ValueType::Unknown : declaredType(graph->variables()[variable].type);
+            return {node, type, rangeOf(node)};
+        }
+
+        case ASTNodeType::BinaryOperation: {
+            if (!node->left || !node->right) return {node, ValueType::Unknown, Range()};
+            const Reduced left = reduce(node->left);
+            const Reduced right = reduce(node->right);
+            ASTNode* result = node;
+            if (left.node != node->left || right.node != node->right) {
+                result = node->shallowCopy(arena);
+                result->left = left.node;
+                result->right = right.node;
+            }
+
+            const ValueType type = resultType(node->value, left.type, right.type);
+            const Range range = type == ValueType::Int ? combine(node->value, left.range, right.range) : Range();
+            if (left.type == ValueType::Int && right.type == ValueType::Int) {
+                result = reduceOperation(node, result, left, right);
+            }
+            return {result, type, range};
+        }
+
+        // An element has its array's type, and any value of it
+        case ASTNodeType::ArraySubscript:
+            return {rewrite(node), expressionType(node, *graph), Range()};
+
+        default:
+            return {rewrite(node), ValueType::Unknown, Range()};
+    }
+}
+
+// `node` is `original` with its operands reduced; returns what computes
+// the same int more cheaply, or `node`
+ASTNode* StrengthReduction::reduceOperation(const ASTNode* original, ASTNode* node, const Reduced& left,
+                                            const Reduced& right) {
+    // x op c, or c * x
+    const Symbol op = original->value;
+    int64_t c;
+    const Reduced* operand;
+    if (right.node->type == ASTNodeType::Literal && left.node->type != ASTNodeType::Literal &&
+        intLiteralValue(right.node->value, c)) {
+        operand = &left;
+    } else if (op == kTimes && left.node->type == ASTNodeType::Literal &&
+               right.node->type != ASTNodeType::Literal && intLiteralValue(left.node->value, c)) {
+        operand = &right;
+    } else {
+        return node;
+    }
+    ASTNode* x = operand->node;
+    const Range& range = operand->range;
+    const bool nonNegative = range.known && range.low >= 0;
+    const bool variable = x->type == ASTNodeType::Identifier;
+    const int k = powerOfTwo(c);
+
+    auto report = [&](const char* operation, const std::string& replacement) {
+        std::cout << "[Optimizer] Replaced " << operation << " " << c << " on line " << original->loc.line
+                  << " with " << replacement << std::endl;
+        ++reduced;
+    };
+    // Nodes the pass builds report the line of the operation they replace
+    auto located = [&](ASTNode* replacement) {
+        replacement->loc = original->loc;
+        return replacement;
+    };
+
+    if (op == kTimes) {
+        if (variable && (c < -1 || c > 1)) {
+            if (auto induction = inductionFor(x, c)) {
+                report("a multiplication by", "induction variable " + std::string(induction->value.str()));
+                return induction;
+            }
+        }
+        // Shifting a negative int left is undefined before C++20
+        if (k && nonNegative) {
+            report("a multiplication by", "a shift");
+            return located(operation(kShiftLeft, x, literal(k)));
+        }
+        return node;
+    }
+
+    if ((op != kDivide && op != kModulo) || c < 2) return node;
+
+    // Every value of x is a quotient of 0 and its own remainder
+    if (nonNegative && range.high < c) {
+        report(op == kDivide ? "a division by" : "a remainder by", "its value");
+        return op == kDivide ? located(literal(0)) : x;
+    }
+
+    if (k) {
+        if (nonNegative) {
+            report(op == kDivide ? "a division by" : "a remainder by", op == kDivide ? "a shift" : "a mask");
+            return located(op == kDivide ? operation(kShiftRight, x, literal(k)) : operation(kBitAnd, x, literal(c - 1)));
+        }
+        if (hasSideEffects(x)) return node;
+        // x + (x >> 31 & c - 1) is x + c - 1 for a negative x, which makes
+        // the shift round toward zero
+        auto biased = operation(kPlus, x, operation(kBitAnd, operation(kShiftRight, x->deepCopy(arena), literal(31)),
+                                                   literal(c - 1)));
+        auto replacement = op == kDivide ? operation(kShiftRight, biased, literal(k))
+                                         : operation(kMinus, x->deepCopy(arena), operation(kBitAnd, biased, literal(-c)));
+        // x is computed more than once
+        if (!costs.cheaper(replacement, node)) return node;
+        report(op == kDivide ? "a division by" : "a remainder by", op == kDivide ? "shifts" : "shifts and masks");
+        return located(replacement);
+    }
+
+    int64_t multiplier;
+    int shift;
+    if (!nonNegative || !reciprocal(c, range.high, multiplier, shift)) return node;
+    auto quotient = operation(kShiftRight, located(operation(kTimes, x, literal(multiplier))), literal(shift));
+    const std::string replacement = "a multiplication by " + std::to_string(multiplier) + " and a shift";
+    if (op == kDivide) {
+        report("a division by", replacement);
+        return located(quotient);
+    }
+    if (hasSideEffects(x)) return node;
+    auto remainder = operation(kMinus, x->deepCopy(arena), operation(kTimes, quotient, literal(c)));
+    if (!costs.cheaper(remainder, node)) return node;
+    report("a remainder by", replacement);
+    return located(remainder);
+}
+
+// An identifier for the induction variable that holds `identifier` times
+// `factor`, if `identifier` is the variable of a loop being rewritten and
+// every value the induction variable would take fits in an int
+ASTNode* StrengthReduction::inductionFor(const ASTNode* identifier, int64_t factor) {
+    const uint32_t variable = graph->variableOf(identifier);
+    if (variable == None) return nullptr;
+    for (auto loop = loops.rbegin(); loop != loops.rend(); ++loop) {
+        if (loop->variable != variable) continue;
+        // Values change linearly, so the first and the one the loop ends with are the extremes
+        const CountedLoop& count = loop->count;
+        if (!fitsInt(count.start * factor) || !fitsInt(count.end() * factor) || !fitsInt(count.step * factor)) {
+            return nullptr;
+        }
+        auto existing = std::find_if(loop->inductions.begin(), loop->inductions.end(),
+                                     [&](const Induction& induction) { return induction.factor == factor; });
+        const Symbol name = existing != loop->inductions.end() ? existing->name : newInductionName();
+        if (existing == loop->inductions.end()) loop->inductions.push_back(Induction{factor, name});
+        auto result = arena.create<ASTNode>(arena, ASTNodeType::Identifier, name);
+        result->loc = identifier->loc;
+        return result;
+    }
+    return nullptr;
+}
+
+// Values a counted loop's variable takes in the body
+StrengthReduction::Range StrengthReduction::rangeOf(const ASTNode* identifier) const {
+    const uint32_t variable = graph->variableOf(identifier);
+    if (variable == None) return Range();
+    for (auto loop = loops.rbegin(); loop != loops.rend(); ++loop) {
+        if (loop->variable != variable) continue;
+        const int64_t first = loop->count.start;
+        const int64_t last = loop->count.last();
+        return Range{true, std::min(first, last), std::max(first, last)};
+    }
+    return Range();
+}
+
+// The range of `left op right` on ints; unknown if it may overflow
+StrengthReduction::Range StrengthReduction::combine(Symbol op, const Range& left, const Range& right) {
+    Range result;
+    if (op == kBitAnd) {
+        // Masking with a non-negative number gives at most that number
+        const Range* mask = right.known && right.low >= 0 ? &right : left.known && left.low >= 0 ? &left : nullptr;
+        if (mask) result = Range{true, 0, mask->high};
+        return result;
+    }
+    if (!left.known || !right.known) return result;
+
+    if (op == kPlus) {
+        result = Range{true, left.low + right.low, left.high + right.high};
+    } else if (op == kMinus) {
+        result = Range{true, left.low - right.high, left.high - right.low};
+    } else if (op == kTimes) {
+        const int64_t corners[] = {left.low * right.low, left.low * right.high, left.high * right.low,
+                                   left.high * right.high};
+        result = Range{true, *std::min_element(std::begin(corners), std::end(corners)),
+                       *std::max_element(std::begin(corners), std::end(corners))};
+    } else if (op == kDivide && right.low == right.high && right.low > 0) {
+        result = Range{true, left.low / right.low, left.high / right.low};
+    } else if (op == kModulo && right.low == right.high && right.low > 0 && left.low >= 0) {
+        result = Range{true, 0, std::min(left.high, right.low - 1)};
+    } else if (op == kShiftRight && right.low == right.high && right.low >= 0 && right.low < 32) {
+        result = Range{true, left.low >> right.low, left.high >> right.low};
+    }
+    if (result.known && (!fitsInt(result.low) || !fitsInt(result.high))) result = Range();
+    return result;
+}
+
+// Finds m and s with (x * m) >> s == x / divisor for every x in
+// [0, high] and high * m within int. With m = ceil(2^s / divisor) and
+// e = m * divisor - 2^s, x * m / 2^s exceeds x / divisor by x * e /
+// (divisor * 2^s), which stays below the gap to the next multiple of
+// 1 / divisor as long as high * e < 2^s.
+bool StrengthReduction::reciprocal(int64_t divisor, int64_t high, int64_t& multiplier, int& shift) {
+    for (int s = 0; s < 32; ++s) {
+        const int64_t power = int64_t(1) << s;
+        const int64_t m = (power + divisor - 1) / divisor;
+        if (high * m > std::numeric_limits<int32_t>::max()) return false;
+        if (high * (m * divisor - power) < power) {
+            multiplier = m;
+            shift = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+ASTNode* StrengthReduction::operation(Symbol op, ASTNode* left, ASTNode* right) {
+    auto node = arena.create<ASTNode>(arena, ASTNodeType::BinaryOperation, op);
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+ASTNode* StrengthReduction::literal(int64_t value) {
+    return arena.create<ASTNode>(arena, ASTNodeType::Literal, std::to_string(value));
+}
+
+Symbol StrengthReduction::newInductionName() {
+    std::string name;
+    do {
+        name = "iv_" + std::to_string(inductionCount++);
+    } while (StringInterner::global().contains(name));
+    return Symbol(name);
+}
@@ -0,0 +1,65 @@
+#include "../include/StringInterner.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+StringInterner& StringInterner::global() {
+    static StringInterner interner;
+    return interner;
+}
+
+StringInterner::StringInterner() {
+    ids.emplace(std::string_view(), append(std::string_view()));
+}
+
+// Copies text into chunked storage that is never reallocated
+const char* StringInterner::store(std::string_view text) {
+    if (chunkUsed + text.size() > chunkSize) {
+        chunkSize = std::max<size_t>(64 * 1024, text.size());
+        chunks.push_back(std::make_unique<char[]>(chunkSize));
+        chunkUsed = 0;
+    }
+    char* dest = chunks.back().get() + chunkUsed;
+    std::memcpy(dest, text.data(), text.size());
+    chunkUsed += text.size();
+    return dest;
+}
+
+// Adds the next id; the caller holds the exclusive lock
+uint32_t StringInterner::append(std::string_view stored) {
+    const uint32_t id = count.load(std::memory_order_relaxed);
+    const uint64_t index = uint64_t(id) + FirstBucketSize;
+    const unsigned bucket = floorLog2(index) - FirstBucketBits;
+    if (!buckets[bucket]) {
+        buckets[bucket] = std::make_unique<std::string_view[]>(size_t(FirstBucketSize) << bucket);
+    }
+    buckets[bucket][index - (uint64_t(FirstBucketSize) << bucket)] = stored;
+    count.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+uint32_t StringInterner::intern(std::string_view text) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto found = ids.find(text);
+        if (found != ids.end()) {
+            return found->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto found = ids.find(text); // another thread may have added it meanwhile
+    if (found != ids.end()) {
+        return found->second;
+    }
+
+    std::string_view stored(store(text), text.size());
+    uint32_t id = append(stored);
+    ids.emplace(stored, id);
+    return id;
+}
+
+bool StringInterner::contains(std::string_view text) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return ids.find(text) != ids.end();
+}
@@ -0,0 +1,56 @@
+#include "../include/TokenStream.h"
+
+TokenStream::TokenStream(const SourceBuffer& source, LexerBackend backend)
+    : lexer(std::in_place, source, backend) {}
+
+TokenStream::TokenStream(const SourceBuffer& source, const SourceRange& range, LexerBackend backend)
+    : lexer(std::in_place, source, range, backend) {}
+
+TokenStream::TokenStream(const std::vector<Token>& tokens)
+    : vectorCursor(tokens.data()), vectorEnd(tokens.data() + tokens.size()) {}
+
+bool TokenStream::pull(Token& token) {
+    if (lexer) {
+        return lexer->next(token);
+    }
+    if (vectorCursor == vectorEnd) {
+        return false;
+    }
+    token = *vectorCursor++;
+    return true;
+}
+
+// Makes sure the window holds at least ahead + 1 tokens, if there are any
+bool TokenStream::fill(size_t ahead) {
+    while (buffered <= ahead) {
+        if (!pull(window[(head + buffered) % Lookahead])) {
+            exhausted = true;
+            return false;
+        }
+        ++buffered;
+    }
+    return true;
+}
+
+const Token& TokenStream::peek(size_t ahead) {
+    if (ahead >= Lookahead - 1 || !fill(ahead)) {
+        return endToken;
+    }
+    return window[(head + ahead) % Lookahead];
+}
+
+const Token& TokenStream::advance() {
+    if (!fill(0)) {
+        return endToken;
+    }
+    const Token& token = window[head];
+    head = (head + 1) % Lookahead;
+    --buffered;
+    ++consumedCount;
+    lastEnd = token.offset + token.value.size();
+    return token;
+}
+
+bool TokenStream::atEnd() {
+    return !fill(0);
+}
@@ -1,108 +1,595 @@
-#include "../include/Tokenizer.h"
-#include <cctype>
-#include <unordered_set>
-#include <cstring>
-
-std::vector<Token> Tokenizer::tokenize(const std::string& code) {
-    std::vector<Token> tokens;
-    std::unordered_set<std::string> keywords = {
-        "int", "float", "if", "else", "while", "for", "do", "return", 
-        "include", "iostream", "std", "cout", "cin", "endl", "main", "true", "false"
-    };
-    
-    size_t i = 0;
-    while (i < code.length()) {
-        if (isspace(code[i])) {
-            ++i;
-            continue;
-        }
-
-        // Skip comments
-        if (i < code.length() - 1 && code[i] == '/' && code[i+1] == '/') {
-            while (i < code.length() && code[i] != '\n') {
-                ++i;
-            }
-            continue;
-        }
-
-        // Handle preprocessor directives - capture the full line
-        if (code[i] == '#') {
-            std::string directive;
-            while (i < code.length() && code[i] != '\n') {
-                directive += code[i++];
-            }
-            tokens.push_back({TokenType::Keyword, directive});
-            continue;
-        }
-
-        // Handle string literals
-        if (code[i] == '"') {
-            std::string str = "\"";
-            ++i;
-            while (i < code.length() && code[i] != '"') {
-                if (code[i] == '\\' && i + 1 < code.length()) {
-                    str += code[i++]; // escape character
-                }
-                str += code[i++];
-            }
-            if (i < code.length()) str += code[i++]; // closing quote
-            tokens.push_back({TokenType::Literal, str});
-            continue;
-        }
-
-        // Handle identifiers and keywords
-        if (isalpha(code[i]) || code[i] == '_') {
-            std::string id;
-            while (i < code.length() && (isalnum(code[i]) || code[i] == '_')) {
-                id += code[i++];
-            }
-            TokenType type = keywords.count(id) ? TokenType::Keyword : TokenType::Identifier;
-            // Special handling for boolean literals
-            if (id == "true" || id == "false") {
-                type = TokenType::Literal;
-            }
-            tokens.push_back({type, id});
-            continue;
-        }
-
-        // Handle numbers (including floating point)
-        if (isdigit(code[i])) {
-            std::string num;
-            while (i < code.length() && (isdigit(code[i]) || code[i] == '.')) {
-                num += code[i++];
-            }
-            tokens.push_back({TokenType::Number, num});
-            continue;
-        }
-
-        // Handle multi-character operators (check longer ones first)
-        if (i < code.length() - 1) {
-            std::string twoChar = code.substr(i, 2);
-            if (twoChar == "==" || twoChar == "!=" || twoChar == "<=" || twoChar == ">=" ||
-                twoChar == "||" || twoChar == "&&" || twoChar == "::" || twoChar == "<<" ||
-                twoChar == ">>" || twoChar == "++" || twoChar == "--" || twoChar == "+=" || 
-                twoChar == "-=" || twoChar == "*=" || twoChar == "/=") {
-                tokens.push_back({TokenType::Operator, twoChar});
-                i += 2;
-                continue;
-            }
-        }
-
-        // Single character operators
-        if (strchr("+-*/=<>!", code[i])) {
-            tokens.push_back({TokenType::Operator, std::string(1, code[i++])});
-            continue;
-        }
-
-        // Separators
-        if (strchr(";,(){}[]", code[i])) {
-            tokens.push_back({TokenType::Separator, std::string(1, code[i++])});
-            continue;
-        }
-
-        // Unknown character
-        tokens.push_back({TokenType::Unknown, std::string(1, code[i++])});
-    }
-
-    return tokens;
-}
\ No newline at end of file
+#include "../include/Tokenizer.h"
+#include <array>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOKENIZER_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+using LineState = Lexer::LineState;
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Character classes: one table lookup replaces isspace/isalpha/strchr
+// ---------------------------------------------------------------------------
+
+enum CharClass : uint8_t {
+    CC_SPACE       = 1 << 0,
+    CC_IDENT_START = 1 << 1,
+    CC_IDENT       = 1 << 2,
+    CC_DIGIT       = 1 << 3,
+    CC_OPERATOR    = 1 << 4,
+    CC_SEPARATOR   = 1 << 5
+};
+
+constexpr std::array<uint8_t, 256> makeCharClassTable() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        uint8_t cls = 0;
+        if (c == ' ' || (c >= '\t' && c <= '\r')) cls |= CC_SPACE;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') cls |= CC_IDENT_START | CC_IDENT;
+        if (c >= '0' && c <= '9') cls |= CC_DIGIT | CC_IDENT;
+        table[c] = cls;
+    }
+    for (char c : std::string_view("+-*/%&=<>!")) table[static_cast<unsigned char>(c)] |= CC_OPERATOR;
+    for (char c : std::string_view(";,(){}[]")) table[static_cast<unsigned char>(c)] |= CC_SEPARATOR;
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> kCharClass = makeCharClassTable();
+
+inline uint8_t charClass(char c) {
+    return kCharClass[static_cast<unsigned char>(c)];
+}
+
+// ---------------------------------------------------------------------------
+// Compile-time perfect hashes for keywords and two-character operators.
+// The hash parameters are searched for by the compiler, so extending either
+// list only needs the new entry; a static_assert fires if no hash exists.
+// ---------------------------------------------------------------------------
+
+struct FixedSpelling {
+    std::string_view text;
+    TokenKind kind;
+};
+
+constexpr FixedSpelling kKeywords[] = {
+    {"int", TokenKind::KwInt}, {"float", TokenKind::KwFloat}, {"if", TokenKind::KwIf},
+    {"else", TokenKind::KwElse}, {"while", TokenKind::KwWhile}, {"for", TokenKind::KwFor},
+    {"do", TokenKind::KwDo}, {"return", TokenKind::KwReturn}, {"include", TokenKind::KwInclude},
+    {"iostream", TokenKind::KwIostream}, {"std", TokenKind::KwStd}, {"cout", TokenKind::KwCout},
+    {"cin", TokenKind::KwCin}, {"endl", TokenKind::KwEndl}, {"main", TokenKind::KwMain},
+    {"true", TokenKind::KwTrue}, {"false", TokenKind::KwFalse}
+};
+constexpr size_t kKeywordCount = sizeof(kKeywords) / sizeof(kKeywords[0]);
+constexpr uint32_t kKeywordSlots = 32;
+
+struct KeywordHash {
+    uint32_t lengthFactor;
+    uint32_t firstFactor;
+};
+
+constexpr uint32_t keywordSlot(std::string_view word, KeywordHash h) {
+    return (static_cast<uint32_t>(word.size()) * h.lengthFactor +
+            static_cast<unsigned char>(word.front()) * h.firstFactor +
+            static_cast<unsigned char>(word.back())) & (kKeywordSlots - 1);
+}
+
+constexpr KeywordHash findKeywordHash() {
+    for (uint32_t a = 1; a < 64; ++a) {
+        for (uint32_t b = 1; b < 64; ++b) {
+            bool used[kKeywordSlots] = {};
+            bool perfect = true;
+            for (size_t k = 0; k < kKeywordCount && perfect; ++k) {
+                uint32_t slot = keywordSlot(kKeywords[k].text, {a, b});
+                perfect = !used[slot];
+                used[slot] = true;
+            }
+            if (perfect) return {a, b};
+        }
+    }
+    return {0, 0};
+}
+
+constexpr KeywordHash kKeywordHash = findKeywordHash();
+static_assert(kKeywordHash.lengthFactor != 0, "no perfect hash for the keyword table");
+
+constexpr std::array<int8_t, kKeywordSlots> makeKeywordTable() {
+    std::array<int8_t, kKeywordSlots> table{};
+    for (auto& slot : table) slot = -1;
+    for (size_t k = 0; k < kKeywordCount; ++k) {
+        table[keywordSlot(kKeywords[k].text, kKeywordHash)] = static_cast<int8_t>(k);
+    }
+    return table;
+}
+
+constexpr std::array<int8_t, kKeywordSlots> kKeywordTable = makeKeywordTable();
+
+// Index of `word` in kKeywords, or -1
+inline int keywordIndex(std::string_view word) {
+    int8_t k = kKeywordTable[keywordSlot(word, kKeywordHash)];
+    return k >= 0 && kKeywords[k].text == word ? k : -1;
+}
+
+constexpr FixedSpelling kTwoCharOperators[] = {
+    {"==", TokenKind::Equal}, {"!=", TokenKind::NotEqual}, {"<=", TokenKind::LessEqual},
+    {">=", TokenKind::GreaterEqual}, {"||", TokenKind::OrOr}, {"&&", TokenKind::AndAnd},
+    {"::", TokenKind::ColonColon}, {"<<", TokenKind::ShiftLeft}, {">>", TokenKind::ShiftRight},
+    {"++", TokenKind::PlusPlus}, {"--", TokenKind::MinusMinus}, {"+=", TokenKind::PlusAssign},
+    {"-=", TokenKind::MinusAssign}, {"*=", TokenKind::StarAssign}, {"/=", TokenKind::SlashAssign}
+};
+constexpr size_t kTwoCharOperatorCount = sizeof(kTwoCharOperators) / sizeof(kTwoCharOperators[0]);
+constexpr uint32_t kOperatorSlotBits = 5;
+
+constexpr uint32_t operatorSlot(char first, char second, uint32_t multiplier) {
+    uint32_t pair = (static_cast<uint32_t>(static_cast<unsigned char>(first)) << 8) |
+                    static_cast<unsigned char>(second);
+    return ((pair * multiplier) & 0xFFFF) >> (16 - kOperatorSlotBits);
+}
+
+constexpr uint32_t findOperatorMultiplier() {
+    for (uint32_t m = 1; m < 0x10000; ++m) {
+        bool used[1u << kOperatorSlotBits] = {};
+        bool perfect = true;
+        for (size_t k = 0; k < kTwoCharOperatorCount && perfect; ++k) {
+            uint32_t slot = operatorSlot(kTwoCharOperators[k].text[0], kTwoCharOperators[k].text[1], m);
+            perfect = !used[slot];
+            used[slot] = true;
+        }
+        if (perfect) return m;
+    }
+    return 0;
+}
+
+constexpr uint32_t kOperatorMultiplier = findOperatorMultiplier();
+static_assert(kOperatorMultiplier != 0, "no perfect hash for the operator table");
+
+constexpr std::array<uint16_t, 1u << kOperatorSlotBits> makeOperatorTable() {
+    std::array<uint16_t, 1u << kOperatorSlotBits> table{};
+    for (size_t k = 0; k < kTwoCharOperatorCount; ++k) {
+        std::string_view op = kTwoCharOperators[k].text;
+        table[operatorSlot(op[0], op[1], kOperatorMultiplier)] =
+            static_cast<uint16_t>((static_cast<unsigned char>(op[0]) << 8) | static_cast<unsigned char>(op[1]));
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 1u << kOperatorSlotBits> kOperatorTable = makeOperatorTable();
+
+constexpr std::array<TokenKind, 1u << kOperatorSlotBits> makeOperatorKindTable() {
+    std::array<TokenKind, 1u << kOperatorSlotBits> table{};
+    for (size_t k = 0; k < kTwoCharOperatorCount; ++k) {
+        std::string_view op = kTwoCharOperators[k].text;
+        table[operatorSlot(op[0], op[1], kOperatorMultiplier)] = kTwoCharOperators[k].kind;
+    }
+    return table;
+}
+
+constexpr std::array<TokenKind, 1u << kOperatorSlotBits> kOperatorKinds = makeOperatorKindTable();
+
+constexpr FixedSpelling kSingleChars[] = {
+    {"+", TokenKind::Plus}, {"-", TokenKind::Minus}, {"*", TokenKind::Star}, {"/", TokenKind::Slash},
+    {"%", TokenKind::Percent}, {"&", TokenKind::Ampersand}, {"=", TokenKind::Assign}, {"<", TokenKind::Less}, {">", TokenKind::Greater}, {"!", TokenKind::Not},
+    {";", TokenKind::Semicolon}, {",", TokenKind::Comma}, {"(", TokenKind::LParen}, {")", TokenKind::RParen},
+    {"{", TokenKind::LBrace}, {"}", TokenKind::RBrace}, {"[", TokenKind::LBracket}, {"]", TokenKind::RBracket}
+};
+
+constexpr std::array<TokenKind, 256> makeSingleCharKindTable() {
+    std::array<TokenKind, 256> table{};
+    for (const FixedSpelling& single : kSingleChars) {
+        table[static_cast<unsigned char>(single.text[0])] = single.kind;
+    }
+    return table;
+}
+
+constexpr std::array<TokenKind, 256> kSingleCharKinds = makeSingleCharKindTable();
+
+// Slot of the operator spelled first+second in kOperatorTable, or -1
+inline int twoCharOperatorSlot(char first, char second) {
+    uint16_t pair = static_cast<uint16_t>((static_cast<unsigned char>(first) << 8) | static_cast<unsigned char>(second));
+    uint32_t slot = operatorSlot(first, second, kOperatorMultiplier);
+    return kOperatorTable[slot] == pair ? static_cast<int>(slot) : -1;
+}
+
+// ---------------------------------------------------------------------------
+// Scanning kernels. Each one returns the first position that no longer
+// belongs to the run; skipWhitespace also keeps the line bookkeeping.
+// ---------------------------------------------------------------------------
+
+const char* skipWhitespaceScalar(const char* p, const char* end, LineState& lines) {
+    while (p < end && (charClass(*p) & CC_SPACE)) {
+        if (*p == '\n') {
+            ++lines.line;
+            lines.lineStart = p + 1;
+        }
+        ++p;
+    }
+    return p;
+}
+
+const char* scanIdentifierScalar(const char* p, const char* end) {
+    while (p < end && (charClass(*p) & CC_IDENT)) ++p;
+    return p;
+}
+
+const char* scanLineScalar(const char* p, const char* end) {
+    while (p < end && *p != '\n') ++p;
+    return p;
+}
+
+#ifdef TOKENIZER_X86_SIMD
+
+// Bookkeeping for one vector of whitespace: `spaces` marks the whitespace
+// bytes, `newlines` the '\n' bytes. Returns the length of the leading run.
+inline unsigned consumeSpaceMask(const char* p, uint32_t spaces, uint32_t newlines,
+                                 unsigned width, LineState& lines) {
+    uint32_t full = width == 32 ? 0xFFFFFFFFu : ((1u << width) - 1);
+    uint32_t stop = ~spaces & full;
+    unsigned run = stop ? static_cast<unsigned>(__builtin_ctz(stop)) : width;
+    uint32_t prefix = run == 32 ? 0xFFFFFFFFu : ((1u << run) - 1);
+    uint32_t nl = newlines & prefix;
+    if (nl) {
+        lines.line += static_cast<uint32_t>(__builtin_popcount(nl));
+        lines.lineStart = p + (31 - __builtin_clz(nl)) + 1;
+    }
+    return run;
+}
+
+__attribute__((target("sse2")))
+const char* skipWhitespaceSSE2(const char* p, const char* end, LineState& lines) {
+    // Most runs are a single space between tokens; don't pay for a vector load
+    if (p + 1 < end && !(charClass(p[1]) & CC_SPACE) && *p != '\n') return p + 1;
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i below = _mm_set1_epi8('\t' - 1);
+    const __m128i above = _mm_set1_epi8('\r' + 1);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i ctrl = _mm_and_si128(_mm_cmpgt_epi8(v, below), _mm_cmplt_epi8(v, above));
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space), ctrl);
+        uint32_t spaces = static_cast<uint32_t>(_mm_movemask_epi8(ws));
+        uint32_t newlines = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+        unsigned run = consumeSpaceMask(p, spaces, newlines, 16, lines);
+        p += run;
+        if (run < 16) return p;
+    }
+    return skipWhitespaceScalar(p, end, lines);
+}
+
+__attribute__((target("sse2")))
+const char* scanIdentifierSSE2(const char* p, const char* end) {
+    // Identifiers are usually short: finish them without touching vectors
+    for (int k = 0; k < 8 && p < end; ++k, ++p) {
+        if (!(charClass(*p) & CC_IDENT)) return p;
+    }
+    const __m128i lowerBit = _mm_set1_epi8(0x20);
+    const __m128i beforeA = _mm_set1_epi8('a' - 1);
+    const __m128i afterZ = _mm_set1_epi8('z' + 1);
+    const __m128i before0 = _mm_set1_epi8('0' - 1);
+    const __m128i after9 = _mm_set1_epi8('9' + 1);
+    const __m128i underscore = _mm_set1_epi8('_');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i lower = _mm_or_si128(v, lowerBit);
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, beforeA), _mm_cmplt_epi8(lower, afterZ));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, before0), _mm_cmplt_epi8(v, after9));
+        __m128i ident = _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(v, underscore));
+        uint32_t stop = ~static_cast<uint32_t>(_mm_movemask_epi8(ident)) & 0xFFFFu;
+        if (stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scanIdentifierScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+const char* scanLineSSE2(const char* p, const char* end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t hit = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+        if (hit) return p + __builtin_ctz(hit);
+        p += 16;
+    }
+    return scanLineScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* skipWhitespaceAVX2(const char* p, const char* end, LineState& lines) {
+    if (p + 1 < end && !(charClass(p[1]) & CC_SPACE) && *p != '\n') return p + 1;
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i below = _mm256_set1_epi8('\t' - 1);
+    const __m256i above = _mm256_set1_epi8('\r' + 1);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i ctrl = _mm256_and_si256(_mm256_cmpgt_epi8(v, below), _mm256_cmpgt_epi8(above, v));
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), ctrl);
+        uint32_t spaces = static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+        uint32_t newlines = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+        unsigned run = consumeSpaceMask(p, spaces, newlines, 32, lines);
+        p += run;
+        if (run < 32) return p;
+    }
+    return skipWhitespaceSSE2(p, end, lines);
+}
+
+__attribute__((target("avx2")))
+const char* scanIdentifierAVX2(const char* p, const char* end) {
+    for (int k = 0; k < 8 && p < end; ++k, ++p) {
+        if (!(charClass(*p) & CC_IDENT)) return p;
+    }
+    const __m256i lowerBit = _mm256_set1_epi8(0x20);
+    const __m256i beforeA = _mm256_set1_epi8('a' - 1);
+    const __m256i afterZ = _mm256_set1_epi8('z' + 1);
+    const __m256i before0 = _mm256_set1_epi8('0' - 1);
+    const __m256i after9 = _mm256_set1_epi8('9' + 1);
+    const __m256i underscore = _mm256_set1_epi8('_');
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i lower = _mm256_or_si256(v, lowerBit);
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, beforeA), _mm256_cmpgt_epi8(afterZ, lower));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, before0), _mm256_cmpgt_epi8(after9, v));
+        __m256i ident = _mm256_or_si256(_mm256_or_si256(alpha, digit), _mm256_cmpeq_epi8(v, underscore));
+        uint32_t stop = ~static_cast<uint32_t>(_mm256_movemask_epi8(ident));
+        if (stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return scanIdentifierSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* scanLineAVX2(const char* p, const char* end) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t hit = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+        if (hit) return p + __builtin_ctz(hit);
+        p += 32;
+    }
+    return scanLineSSE2(p, end);
+}
+
+#endif // TOKENIZER_X86_SIMD
+
+} // namespace
+
+// Symbols for every fixed spelling, indexed the same way as the perfect
+// hash tables, so keywords, operators and separators are interned
+// without a hash-map lookup
+struct FixedSymbols {
+    Symbol keywords[kKeywordCount];
+    Symbol twoCharOperators[1u << kOperatorSlotBits];
+    Symbol singleChars[256];
+};
+
+namespace {
+
+const FixedSymbols& fixedSymbols() {
+    static const FixedSymbols symbols = [] {
+        FixedSymbols table;
+        for (size_t k = 0; k < kKeywordCount; ++k) {
+            table.keywords[k] = Symbol(kKeywords[k].text);
+        }
+        for (uint32_t slot = 0; slot < (1u << kOperatorSlotBits); ++slot) {
+            if (kOperatorTable[slot]) {
+                const char op[2] = {static_cast<char>(kOperatorTable[slot] >> 8),
+                                    static_cast<char>(kOperatorTable[slot] & 0xFF)};
+                table.twoCharOperators[slot] = Symbol(std::string_view(op, 2));
+            }
+        }
+        for (int c = 0; c < 256; ++c) {
+            const char ch = static_cast<char>(c);
+            table.singleChars[c] = Symbol(std::string_view(&ch, 1));
+        }
+        return table;
+    }();
+    return symbols;
+}
+
+} // namespace
+
+struct ScanKernels {
+    const char* name;
+    const char* (*skipWhitespace)(const char* p, const char* end, LineState& lines);
+    const char* (*scanIdentifier)(const char* p, const char* end);
+    const char* (*scanLine)(const char* p, const char* end);
+};
+
+namespace {
+
+const ScanKernels kScalarKernels = {"scalar", skipWhitespaceScalar, scanIdentifierScalar, scanLineScalar};
+#ifdef TOKENIZER_X86_SIMD
+const ScanKernels kSSE2Kernels = {"sse2", skipWhitespaceSSE2, scanIdentifierSSE2, scanLineSSE2};
+const ScanKernels kAVX2Kernels = {"avx2", skipWhitespaceAVX2, scanIdentifierAVX2, scanLineAVX2};
+#endif
+
+const ScanKernels* kernelsFor(LexerBackend backend) {
+#ifdef TOKENIZER_X86_SIMD
+    switch (backend) {
+        case LexerBackend::AVX2:
+            return __builtin_cpu_supports("avx2") ? &kAVX2Kernels : nullptr;
+        case LexerBackend::SSE2:
+            return __builtin_cpu_supports("sse2") ? &kSSE2Kernels : nullptr;
+        case LexerBackend::Scalar:
+            return &kScalarKernels;
+        case LexerBackend::Auto:
+            if (__builtin_cpu_supports("avx2")) return &kAVX2Kernels;
+            if (__builtin_cpu_supports("sse2")) return &kSSE2Kernels;
+            return &kScalarKernels;
+    }
+    return nullptr;
+#else
+    return (backend == LexerBackend::Scalar || backend == LexerBackend::Auto) ? &kScalarKernels : nullptr;
+#endif
+}
+
+} // namespace
+
+bool Lexer::isSupported(LexerBackend backend) {
+    return kernelsFor(backend) != nullptr;
+}
+
+Lexer::Lexer(const SourceBuffer& source, LexerBackend backend)
+    : kernels(kernelsFor(backend)),
+      symbols(&fixedSymbols()),
+      begin(source.view().data()),
+      cursor(begin),
+      end(begin + source.size()),
+      lines{1, begin} {
+    // Fall back to the best available kernels if the requested ones are missing
+    if (!kernels) kernels = kernelsFor(LexerBackend::Auto);
+}
+
+Lexer::Lexer(const SourceBuffer& source, const SourceRange& range, LexerBackend backend)
+    : Lexer(source, backend) {
+    cursor = begin + range.begin;
+    end = begin + range.end;
+    lines = LineState{range.loc.line, cursor - (range.loc.column - 1)};
+}
+
+const char* Lexer::backendName() const {
+    return kernels->name;
+}
+
+bool Lexer::next(Token& token) {
+    return lex<true>(token);
+}
+
+bool Lexer::scan(Token& token) {
+    return lex<false>(token);
+}
+
+template <bool Intern>
+bool Lexer::lex(Token& token) {
+    const char* p = cursor;
+
+    auto intern = [](const char* start, const char* stop) {
+        return Intern ? Symbol(std::string_view(start, static_cast<size_t>(stop - start))) : Symbol();
+    };
+
+    auto emit = [&](TokenType type, TokenKind kind, const char* start, const char* stop, Symbol symbol) {
+        token.type = type;
+        token.kind = kind;
+        token.symbol = symbol;
+        token.value = std::string_view(start, static_cast<size_t>(stop - start));
+        token.offset = static_cast<size_t>(start - begin);
+        token.loc = SourceLocation{lines.line, static_cast<uint32_t>(start - lines.lineStart + 1)};
+        cursor = stop;
+        return true;
+    };
+
+    while (p < end) {
+        const uint8_t cls = charClass(*p);
+
+        if (cls & CC_SPACE) {
+            p = kernels->skipWhitespace(p, end, lines);
+            continue;
+        }
+
+        // Skip comments
+        if (*p == '/' && p + 1 < end && p[1] == '/') {
+            p = kernels->scanLine(p + 2, end);
+            continue;
+        }
+
+        const char* start = p;
+
+        // Handle preprocessor directives - capture the full line
+        if (*p == '#') {
+            p = kernels->scanLine(p + 1, end);
+            return emit(TokenType::Keyword, TokenKind::Preprocessor, start, p, intern(start, p));
+        }
+
+        // Handle string literals
+        if (*p == '"') {
+            ++p;
+            while (p < end && *p != '"') {
+                if (*p == '\\' && p + 1 < end) {
+                    ++p; // escape character
+                }
+                ++p;
+            }
+            if (p < end) ++p; // closing quote
+            emit(TokenType::Literal, TokenKind::None, start, p, intern(start, p));
+            // An unterminated literal runs over line ends; keep the count right
+            for (const char* q = start; q < p; ++q) {
+                if (*q == '\n') {
+                    ++lines.line;
+                    lines.lineStart = q + 1;
+                }
+            }
+            return true;
+        }
+
+        // Handle identifiers and keywords
+        if (cls & CC_IDENT_START) {
+            p = kernels->scanIdentifier(p + 1, end);
+            std::string_view id(start, static_cast<size_t>(p - start));
+            int keyword = keywordIndex(id);
+            if (keyword < 0) {
+                return emit(TokenType::Identifier, TokenKind::None, start, p, intern(start, p));
+            }
+            // Special handling for boolean literals
+            const TokenKind kind = kKeywords[keyword].kind;
+            TokenType type = (kind == TokenKind::KwTrue || kind == TokenKind::KwFalse) ? TokenType::Literal : TokenType::Keyword;
+            return emit(type, kind, start, p, symbols->keywords[keyword]);
+        }
+
+        // Handle numbers (including floating point)
+        if (cls & CC_DIGIT) {
+            while (p < end && ((charClass(*p) & CC_DIGIT) || *p == '.')) {
+                ++p;
+            }
+            return emit(TokenType::Number, TokenKind::None, start, p, intern(start, p));
+        }
+
+        // Handle multi-character operators (check longer ones first)
+        if (p + 1 < end) {
+            int slot = twoCharOperatorSlot(p[0], p[1]);
+            if (slot >= 0) {
+                return emit(TokenType::Operator, kOperatorKinds[slot], start, p + 2, symbols->twoCharOperators[slot]);
+            }
+        }
+
+        const Symbol single = symbols->singleChars[static_cast<unsigned char>(*p)];
+        const TokenKind singleKind = kSingleCharKinds[static_cast<unsigned char>(*p)];
+
+        // Single character operators
+        if (cls & CC_OPERATOR) {
+            return emit(TokenType::Operator, singleKind, start, p + 1, single);
+        }
+
+        // Separators
+        if (cls & CC_SEPARATOR) {
+            return emit(TokenType::Separator, singleKind, start, p + 1, single);
+        }
+
+        // Unknown character
+        return emit(TokenType::Unknown, TokenKind::None, start, p + 1, single);
+    }
+
+    cursor = p;
+    return false;
+}
+
+bool Tokenizer::isSupported(LexerBackend backend) {
+    return Lexer::isSupported(backend);
+}
+
+const char* Tokenizer::backendName() const {
+    return kernelsFor(backend) ? kernelsFor(backend)->name : kernelsFor(LexerBackend::Auto)->name;
+}
+
+std::vector<Token> Tokenizer::tokenize(const SourceBuffer& source) {
+    std::vector<Token> tokens;
+    tokens.reserve(source.size() / 4); // typical code averages 4-5 bytes per token
+
+    Lexer lexer(source, backend);
+    Token token;
+    while (lexer.next(token)) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
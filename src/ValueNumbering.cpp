@@ -0,0 +1,465 @@
+#include "../include/ValueNumbering.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kTimes("*");
+const Symbol kDivide("/");
+const Symbol kEqual("==");
+const Symbol kNotEqual("!=");
+const Symbol kAnd("&&");
+const Symbol kOr("||");
+
+bool isCommutative(Symbol op) {
+    return op == kPlus || op == kTimes || op == kEqual || op == kNotEqual;
+}
+
+// The right operand of && and || is only evaluated sometimes, so nothing
+// in it may be computed ahead of the statement
+bool isShortCircuit(Symbol op) {
+    return op == kAnd || op == kOr;
+}
+
+bool isIntLiteral(const ASTNode* node, int64_t value) {
+    int64_t literal;
+    return node->type == ASTNodeType::Literal && intLiteralValue(node->value, literal) && literal == value;
+}
+
+// Which operand `left op right` is the same value as, where one is a
+// literal that changes nothing: x - 0, x * 1, 1 * x and x / 1, and on ints
+// x + 0 and 0 + x too (-0.0 + 0 is 0.0). 1 for the left, 2 for the right,
+// 0 for an operation that computes something.
+int identityOperand(Symbol op, const ASTNode* left, const ASTNode* right, bool ints) {
+    if (!left || !right) return 0;
+    if ((op == kMinus && isIntLiteral(right, 0)) || ((op == kTimes || op == kDivide) && isIntLiteral(right, 1)) ||
+        (op == kPlus && ints && isIntLiteral(right, 0))) {
+        return 1;
+    }
+    if ((op == kTimes && isIntLiteral(left, 1)) || (op == kPlus && ints && isIntLiteral(left, 0))) return 2;
+    return 0;
+}
+} // namespace
+
+ASTNode* ValueNumbering::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    writeSets = &analyses.get<WrittenVariables>(root);
+    numberCount = 0;
+    expressionNumbers.clear();
+    literalNumbers.clear();
+    variableNumbers.clear();
+    variableTypes.clear();
+    declaredTypes.clear();
+    holders.assign(1, Symbol());
+    eliminated = 0;
+
+    auto result = numberNested(root);
+
+    if (eliminated > 0) {
+        std::cout << "[Optimizer] Eliminated " << eliminated << " common subexpression"
+                  << (eliminated == 1 ? "" : "s") << std::endl;
+    }
+    rewrites += eliminated;
+    writeSets = nullptr;
+    return result;
+}
+
+// Numbers the statements of a list in order, then gives values the list
+// computes more than once a temporary
+ASTNode* ValueNumbering::numberList(ASTNode* list) {
+    const size_t scope = declaredTypes.size();
+    Occurrences occurrences;
+    ASTNode* result = list;
+    for (size_t i = 0; i < list->children.size(); ++i) {
+        auto child = list->children[i];
+        if (!child) continue;
+        auto numbered = numberStatement(child, i, &occurrences);
+        if (numbered != child) {
+            if (result == list) result = list->shallowCopy(arena);
+            result->children[i] = numbered;
+        }
+    }
+    leaveScope(scope);
+    return introduceTemporaries(result, occurrences);
+}
+
+// A statement inside another one. A lone statement (a loop body without
+// braces) has nowhere to declare temporaries, but can still reuse values.
+ASTNode* ValueNumbering::numberNested(ASTNode* node) {
+    if (!node) return nullptr;
+    if (node->type == ASTNodeType::Program || node->type == ASTNodeType::Block) {
+        return numberList(node);
+    }
+    return numberStatement(node, 0, nullptr);
+}
+
+ASTNode* ValueNumbering::numberStatement(ASTNode* node, size_t index, Occurrences* occurrences) {
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+    auto numberOperand = [&](ASTNode* operand) {
+        return numberExpression(operand, Symbol(), occurrences, index).node;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Program:
+        case ASTNodeType::Block:
+            result = numberList(node);
+            break;
+
+        case ASTNodeType::FunctionDeclaration:
+            // Locals of one function say nothing about another's
+            variableNumbers.clear();
+            variableTypes.clear();
+            if (auto body = numberNested(node->left); body != node->left) own()->left = body;
+            return result;
+
+        case ASTNodeType::Declaration:
+        case ASTNodeType::Assignment: {
+            if (!node->left || node->left->type != ASTNodeType::Identifier) break;
+            const Symbol target = node->left->value;
+
+            // The variable itself cannot stand in for the value it is about to receive
+            auto value = numberExpression(node->right, target, occurrences, index);
+            if (value.node != node->right) own()->right = value.node;
+
+            if (node->type == ASTNodeType::Declaration) {
+                declare(target, node->value);
+            }
+            if (node->right) {
+                assign(target, value);
+            } else {
+                variableNumbers[target] = freshNumber();
+            }
+            return result;
+        }
+
+        case ASTNodeType::IfStatement:
+            if (auto condition = numberOperand(node->left); condition != node->left) own()->left = condition;
+            if (auto body = numberNested(node->right); body != node->right) own()->right = body;
+            break;
+
+        // A loop body runs again after its own writes, and loop conditions
+        // are evaluated on every iteration: only the body is numbered, with
+        // everything the loop writes unknown on entry
+        case ASTNodeType::WhileStatement:
+            forgetWrites(node);
+            if (auto body = numberNested(node->right); body != node->right) own()->right = body;
+            break;
+
+        case ASTNodeType::DoWhileStatement:
+            forgetWrites(node);
+            if (auto body = numberNested(node->left); body != node->left) own()->left = body;
+            break;
+
+        case ASTNodeType::ForStatement: {
+            // The initializer only declares the loop variable's type here
+            const size_t scope = declaredTypes.size();
+            forgetWrites(node);
+            if (!node->children.empty() && node->children[0]) {
+                numberStatement(node->children[0], index, nullptr);
+            }
+            forgetWrites(node);
+            if (node->children.size() > 3) {
+                if (auto body = numberNested(node->children[3]); body != node->children[3]) own()->children[3] = body;
+            }
+            leaveScope(scope);
+            break;
+        }
+
+        case ASTNodeType::ExpressionStatement:
+        case ASTNodeType::ReturnStatement:
+        case ASTNodeType::PrintStatement:
+            if (auto left = numberOperand(node->left); left != node->left) own()->left = left;
+            for (size_t i = 0; i < node->children.size(); ++i) {
+                auto child = numberOperand(node->children[i]);
+                if (child != node->children[i]) own()->children[i] = child;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    forgetWrites(node);
+    return result;
+}
+
+// Numbers `node` from the operands up. An operation some variable other
+// than `target` still holds the value of is replaced by that variable.
+// Operations that remain are recorded in `occurrences`, if given.
+ValueNumbering::Numbered ValueNumbering::numberExpression(ASTNode* node, Symbol target,
+                                                          Occurrences* occurrences, size_t statement) {
+    if (!node) return {nullptr, 0, ValueType::Unknown, -1};
+
+    switch (node->type) {
+        case ASTNodeType::Literal:
+            return {node, literalNumber(node->value), literalType(node->value), -1};
+
+        case ASTNodeType::Identifier: {
+            const bool typed = variableTypes.contains(node->value);
+            return {node, variableNumber(node->value),
+                    typed ? variableTypes.at(node->value) : ValueType::Unknown, -1};
+        }
+
+        case ASTNodeType::BinaryOperation:
+        case ASTNodeType::UnaryOperation:
+            break;
+
+        default: {
+            // Assignments and increments used as expressions: only the
+            // value they store is numbered; they are no value themselves
+            auto right = numberExpression(node->right, target, occurrences, statement);
+            ASTNode* result = node;
+            if (right.node != node->right) {
+                result = node->shallowCopy(arena);
+                result->right = right.node;
+            }
+            return {result, 0, ValueType::Unknown, -1};
+        }
+    }
+
+    const size_t mark = occurrences ? occurrences->size() : 0;
+    const size_t eliminatedBefore = eliminated;
+
+    // A unary operation is numbered as if its missing operand had number 0,
+    // which no value has
+    const bool unary = node->type == ASTNodeType::UnaryOperation;
+    auto left = numberExpression(node->left, target, occurrences, statement);
+    auto right = unary ? Numbered{nullptr, 0, ValueType::Unknown, -1}
+                       : numberExpression(node->right, target,
+                                          isShortCircuit(node->value) ? nullptr : occurrences, statement);
+
+    ASTNode* result = node;
+    if (left.node != node->left || right.node != node->right) {
+        result = node->shallowCopy(arena);
+        result->left = left.node;
+        result->right = right.node;
+    }
+    if (!left.number || (!unary && !right.number)) {
+        return {result, 0, ValueType::Unknown, -1};
+    }
+
+    // x * 1 and the like are x: no value of their own, so never worth a
+    // temporary that would only copy a variable
+    if (!unary) {
+        const ValueType type = resultType(node->value, left.type, right.type);
+        const bool number = type == ValueType::Int || type == ValueType::Float || type == ValueType::Double;
+        const int same = number ? identityOperand(node->value, node->left, node->right, type == ValueType::Int) : 0;
+        const Numbered& operand = same == 1 ? left : right;
+        if (same && operand.type == type) return {result, operand.number, type, operand.occurrence};
+    }
+
+    uint32_t a = left.number;
+    uint32_t b = right.number;
+    if (isCommutative(node->value) && a > b) std::swap(a, b);
+    auto inserted = expressionNumbers.emplace(ExpressionKey{node->value.id(), a, b}, 0);
+    if (inserted.second) inserted.first->second = freshNumber();
+    const uint32_t number = inserted.first->second;
+    const ValueType type = unary ? unaryResultType(node->value, left.type)
+                                 : resultType(node->value, left.type, right.type);
+
+    // The whole operation goes, along with whatever was found in its operands
+    if (Symbol holder = holderOf(number, type, target); !holder.empty()) {
+        if (occurrences) occurrences->resize(mark);
+        eliminated = eliminatedBefore + 1;
+        return {arena.create<ASTNode>(arena, ASTNodeType::Identifier, holder), number, type, -1};
+    }
+
+    if (!occurrences) {
+        return {result, number, type, -1};
+    }
+    const int index = static_cast<int>(occurrences->size());
+    occurrences->push_back(Occurrence{result, number, type, statement, -1});
+    for (int operand : {left.occurrence, right.occurrence}) {
+        if (operand >= static_cast<int>(mark)) (*occurrences)[operand].parent = index;
+    }
+    return {result, number, type, index};
+}
+
+// Values computed by more than one live occurrence in the list are
+// computed once into a temporary. Larger values go first (an operation's
+// number is always above its operands'), so an operand repeated only
+// inside copies of a bigger repeated value needs no temporary of its own.
+ASTNode* ValueNumbering::introduceTemporaries(ASTNode* list, Occurrences& occurrences) {
+    std::unordered_map<uint32_t, std::vector<int>> byNumber;
+    for (size_t i = 0; i < occurrences.size(); ++i) {
+        byNumber[occurrences[i].number].push_back(static_cast<int>(i));
+    }
+    std::vector<uint32_t> repeated;
+    for (const auto& entry : byNumber) {
+        if (entry.second.size() > 1) repeated.push_back(entry.first);
+    }
+    if (repeated.empty()) return list;
+    std::sort(repeated.begin(), repeated.end(), [](uint32_t a, uint32_t b) { return a > b; });
+
+    // An occurrence inside a replaced one is no longer computed
+    auto live = [&](int index) {
+        for (int p = occurrences[index].parent; p >= 0; p = occurrences[p].parent) {
+            if (occurrences[p].replaced) return false;
+        }
+        return true;
+    };
+
+    struct Temporary {
+        size_t statement;
+        uint32_t number;
+        Symbol type;
+        ASTNode* value;
+        std::vector<ASTNode*> uses; // named once the order of declarations is known
+    };
+    std::vector<Temporary> temporaries;
+    std::unordered_map<const ASTNode*, ASTNode*> replacements;
+
+    for (uint32_t number : repeated) {
+        std::vector<int> uses;
+        for (int index : byNumber[number]) {
+            if (live(index)) uses.push_back(index);
+        }
+        if (uses.size() < 2) continue;
+
+        const Occurrence& first = occurrences[uses.front()];
+        const Symbol type = declarableType(first.type);
+        if (type.empty()) continue; // no declarable type that keeps the value exact
+
+        // The first occurrence moves into the temporary, so operations
+        // inside it stay live; the others are gone
+        Temporary temporary{first.statement, number, type, first.node, {}};
+        for (int index : uses) {
+            auto use = arena.create<ASTNode>(arena, ASTNodeType::Identifier, Symbol());
+            replacements[occurrences[index].node] = use;
+            temporary.uses.push_back(use);
+            if (index != uses.front()) occurrences[index].replaced = true;
+        }
+        temporaries.push_back(std::move(temporary));
+        eliminated += uses.size() - 1;
+    }
+    if (temporaries.empty()) return list;
+
+    // Temporaries go before the statement of their first use; one made
+    // from another's operand is declared first
+    std::sort(temporaries.begin(), temporaries.end(), [](const Temporary& a, const Temporary& b) {
+        return a.statement != b.statement ? a.statement < b.statement : a.number < b.number;
+    });
+    for (auto& temporary : temporaries) {
+        const Symbol name = newTemporaryName();
+        for (ASTNode* use : temporary.uses) use->value = name;
+        std::cout << "[Optimizer] Computed a common subexpression once into " << name
+                  << " (" << temporary.uses.size() << " uses)" << std::endl;
+    }
+
+    auto result = list->shallowCopy(arena);
+    result->children.clear();
+    result->children.reserve(list->children.size() + temporaries.size());
+    size_t next = 0;
+    for (size_t i = 0; i < list->children.size(); ++i) {
+        for (; next < temporaries.size() && temporaries[next].statement == i; ++next) {
+            const Temporary& temporary = temporaries[next];
+            auto value = temporary.value->shallowCopy(arena);
+            value->left = substitute(value->left, replacements);
+            value->right = substitute(value->right, replacements);
+
+            auto declaration = arena.create<ASTNode>(arena, ASTNodeType::Declaration, temporary.type);
+            declaration->left = arena.create<ASTNode>(arena, ASTNodeType::Identifier, temporary.uses.front()->value);
+            declaration->right = value;
+            result->children.push_back(declaration);
+        }
+        result->children.push_back(substitute(list->children[i], replacements));
+    }
+    return result;
+}
+
+ASTNode* ValueNumbering::substitute(ASTNode* node, const std::unordered_map<const ASTNode*, ASTNode*>& replacements) {
+    if (!node) return nullptr;
+    auto found = replacements.find(node);
+    if (found != replacements.end()) return found->second;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+    if (auto left = substitute(node->left, replacements); left != node->left) own()->left = left;
+    if (auto right = substitute(node->right, replacements); right != node->right) own()->right = right;
+    for (size_t i = 0; i < node->children.size(); ++i) {
+        auto child = substitute(node->children[i], replacements);
+        if (child != node->children[i]) own()->children[i] = child;
+    }
+    return result;
+}
+
+uint32_t ValueNumbering::freshNumber() {
+    holders.push_back(Symbol());
+    return ++numberCount;
+}
+
+// A variable read before any write seen here holds some unknown value,
+// the same one at every read until it is written
+uint32_t ValueNumbering::variableNumber(Symbol name) {
+    if (!variableNumbers.contains(name)) {
+        variableNumbers[name] = freshNumber();
+    }
+    return variableNumbers.at(name);
+}
+
+uint32_t ValueNumbering::literalNumber(Symbol text) {
+    if (!literalNumbers.contains(text)) {
+        literalNumbers[text] = freshNumber();
+    }
+    return literalNumbers.at(text);
+}
+
+// A variable stores the value unchanged only if its type can hold it
+void ValueNumbering::assign(Symbol name, const Numbered& value) {
+    const ValueType type = variableTypes.contains(name) ? variableTypes.at(name) : ValueType::Unknown;
+    if (value.number && canHold(type, value.type)) {
+        variableNumbers[name] = value.number;
+        holders[value.number] = name;
+    } else {
+        variableNumbers[name] = freshNumber();
+    }
+}
+
+// The type a declaration gives a variable lasts until the end of its scope
+void ValueNumbering::declare(Symbol name, Symbol type) {
+    declaredTypes.emplace_back(name, variableTypes.contains(name) ? variableTypes.at(name) : ValueType::Unknown);
+    variableTypes[name] = declaredType(type);
+}
+
+void ValueNumbering::leaveScope(size_t scope) {
+    while (declaredTypes.size() > scope) {
+        variableTypes[declaredTypes.back().first] = declaredTypes.back().second;
+        declaredTypes.pop_back();
+    }
+}
+
+void ValueNumbering::forgetWrites(const ASTNode* node) {
+    for (Symbol written : writeSets->of(node)) {
+        variableNumbers[written] = freshNumber();
+    }
+}
+
+Symbol ValueNumbering::holderOf(uint32_t number, ValueType type, Symbol target) {
+    const Symbol holder = holders[number];
+    if (holder.empty() || holder == target) return Symbol();
+    if (!variableNumbers.contains(holder) || variableNumbers.at(holder) != number) return Symbol();
+    if (!variableTypes.contains(holder) || !canHold(variableTypes.at(holder), type)) return Symbol();
+    return holder;
+}
+
+// Never a name the program already uses
+Symbol ValueNumbering::newTemporaryName() {
+    std::string name;
+    do {
+        name = "cse_" + std::to_string(temporaryCount++);
+    } while (StringInterner::global().contains(name));
+    return Symbol(name);
+}
+
+bool ValueNumbering::canHold(ValueType variable, ValueType value) {
+    if (variable == ValueType::Unknown) return false;
+    return variable == value || (variable == ValueType::Int && value == ValueType::Bool);
+}
@@ -0,0 +1,519 @@
+#include "../include/Vectorizer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+const Symbol kInt("int");
+const Symbol kFor("for");
+const Symbol kSimdFor("simd for");
+const Symbol kStripFor("strip for");
+const Symbol kEpilogueFor("epilogue for");
+const Symbol kBlock("Block");
+const Symbol kPlus("+");
+const Symbol kMinus("-");
+const Symbol kTimes("*");
+const Symbol kDivide("/");
+const Symbol kLess("<");
+const Symbol kIncrement("++");
+const Symbol kPlusAssign("+=");
+
+bool contains(const ASTNode* node, ASTNodeType type) {
+    if (!node) return false;
+    if (node->type == type || contains(node->left, type) || contains(node->right, type)) return true;
+    return std::any_of(node->children.begin(), node->children.end(),
+                       [&](const ASTNode* child) { return contains(child, type); });
+}
+
+bool isIdentifier(const ASTNode* node, Symbol name) {
+    return node && node->type == ASTNodeType::Identifier && node->value == name;
+}
+
+bool writes(SymbolRange written, Symbol name) {
+    return std::binary_search(written.begin(), written.end(), name,
+                              [](Symbol a, Symbol b) { return a.id() < b.id(); });
+}
+
+// Why an expression with side effects keeps the loop as it is
+std::string sideEffectReason(const ASTNode* node) {
+    return contains(node, ASTNodeType::CallExpression) ? "it calls a function"
+                                                       : "an expression in it has side effects";
+}
+
+std::string indexText(Symbol variable, int64_t offset) {
+    std::string text(variable.str());
+    if (offset > 0) text += " + " + std::to_string(offset);
+    if (offset < 0) text += " - " + std::to_string(-offset);
+    return text;
+}
+} // namespace
+
+ASTNode* Vectorizer::run(ASTNode* root, AnalysisCache& analyses, size_t& rewrites) {
+    if (width < 2) return root;
+    writeSets = &analyses.get<WrittenVariables>(root);
+    const auto& graphs = analyses.get<ControlFlow>(root);
+    vectorized = 0;
+
+    ASTNode* result = root;
+    size_t next = 0; // graphs are in the order of the program's functions
+    for (const ControlFlowGraph& functionGraph : graphs) {
+        graph = &functionGraph;
+        auto function = const_cast<ASTNode*>(graph->function());
+        auto rewritten = rewriteStatement(function);
+        if (rewritten == function) continue;
+        if (function == root) {
+            result = rewritten;
+            continue;
+        }
+        while (root->children[next] != function) ++next;
+        if (result == root) result = root->shallowCopy(arena);
+        result->children[next] = rewritten;
+    }
+
+    rewrites += vectorized;
+    graph = nullptr;
+    writeSets = nullptr;
+    return result;
+}
+
+// Rewrites the loops under a statement that is not a for loop itself
+ASTNode* Vectorizer::rewriteStatement(ASTNode* node) {
+    if (!node) return nullptr;
+
+    ASTNode* result = node;
+    auto own = [&]() {
+        if (result == node) result = node->shallowCopy(arena);
+        return result;
+    };
+
+    switch (node->type) {
+        case ASTNodeType::Program:
+        case ASTNodeType::Block: {
+            std::vector<ASTNode*> statements;
+            statements.reserve(node->children.size());
+            for (ASTNode* child : node->children) {
+                if (child) {
+                    rewriteInto(child, statements);
+                } else {
+                    statements.push_back(nullptr);
+                }
+            }
+            if (!std::equal(statements.begin(), statements.end(), node->children.begin(), node->children.end())) {
+                own()->children.assign(statements.begin(), statements.end());
+            }
+            break;
+        }
+
+        case ASTNodeType::FunctionDeclaration:
+            if (auto body = rewriteNested(node->left); body != node->left) own()->left = body;
+            break;
+
+        case ASTNodeType::IfStatement:
+        case ASTNodeType::WhileStatement:
+            if (auto body = rewriteNested(node->right); body != node->right) own()->right = body;
+            break;
+
+        case ASTNodeType::DoWhileStatement:
+            if (auto body = rewriteNested(node->left); body != node->left) own()->left = body;
+            break;
+
+        default:
+            break;
+    }
+    return result;
+}
+
+// A statement in a place that holds just one; a loop vectorized there is
+// put in a block
+ASTNode* Vectorizer::rewriteNested(ASTNode* node) {
+    if (!node) return nullptr;
+    std::vector<ASTNode*> statements;
+    rewriteInto(node, statements);
+    if (statements.size() == 1) return statements.front();
+
+    auto block = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+    block->children.assign(statements.begin(), statements.end());
+    return block;
+}
+
+// Appends the rewritten statement to `out`, strip-mined if it is a for
+// loop that can be
+void Vectorizer::rewriteInto(ASTNode* node, std::vector<ASTNode*>& out) {
+    if (node->type != ASTNodeType::ForStatement) {
+        out.push_back(rewriteStatement(node));
+        return;
+    }
+
+    // Inner loops first
+    ASTNode* loop = node;
+    if (node->children.size() > 3) {
+        if (auto body = rewriteNested(node->children[3]); body != node->children[3]) {
+            loop = node->shallowCopy(arena);
+            loop->children[3] = body;
+        }
+    }
+    if (!vectorize(node, loop, out)) out.push_back(loop);
+}
+
+// `original` is the loop as the analyses saw it, `loop` the loop with its
+// inner loops rewritten. Returns false, leaving `out` alone, if the loop
+// is kept as it is.
+bool Vectorizer::vectorize(ASTNode* original, ASTNode* loop, std::vector<ASTNode*>& out) {
+    // Loops this pass built are done; loops without arrays have nothing to vectorize
+    if (original->value != kFor || !contains(original, ASTNodeType::ArraySubscript)) return false;
+
+    Candidate candidate;
+    std::string reason;
+    int64_t start = 0;
+    int64_t bound = 0;
+    bool ok = examine(original, candidate, reason);
+    const bool literalBounds = ok && candidate.start->type == ASTNodeType::Literal &&
+                               intLiteralValue(candidate.start->value, start) &&
+                               candidate.bound->type == ASTNodeType::Literal &&
+                               intLiteralValue(candidate.bound->value, bound);
+    if (literalBounds && bound - start < static_cast<int64_t>(width)) {
+        ok = false;
+        reason = "it runs fewer than " + std::to_string(width) + " iterations";
+    }
+    if (!ok) {
+        const uint64_t key = uint64_t(original->loc.line) << 32 | original->loc.column;
+        if (reported.insert(key).second) {
+            std::cout << "[Optimizer] Did not vectorize the for loop on line " << original->loc.line << ": "
+                      << reason << std::endl;
+        }
+        return false;
+    }
+
+    const Symbol variable = candidate.variable;
+    const int64_t lanes = width;
+    auto operation = [&](Symbol op, ASTNode* left, ASTNode* right) {
+        auto node = arena.create<ASTNode>(arena, ASTNodeType::BinaryOperation, op);
+        node->left = left;
+        node->right = right;
+        return node;
+    };
+
+    // Where the strips end: a literal, or a variable set before the loop
+    const int64_t stripEnd = literalBounds ? start + (bound - start) / lanes * lanes : 0;
+    Symbol endName;
+    if (!literalBounds) {
+        endName = freshName("vec_end");
+        auto span = operation(kMinus, candidate.bound->deepCopy(arena), candidate.start->deepCopy(arena));
+        auto declaration = arena.create<ASTNode>(arena, ASTNodeType::Declaration, kInt);
+        declaration->left = identifier(endName);
+        declaration->right = operation(kPlus, candidate.start->deepCopy(arena),
+                                       operation(kTimes, operation(kDivide, span, literal(lanes)), literal(lanes)));
+        out.push_back(declaration);
+    }
+    auto end = [&]() { return literalBounds ? literal(stripEnd) : identifier(endName); };
+
+    // for (int vec_lane = 0; vec_lane < W; vec_lane++) { body(i + vec_lane) }
+    const Symbol lane = freshName("vec_lane");
+    auto laneInit = arena.create<ASTNode>(arena, ASTNodeType::Declaration, kInt);
+    laneInit->left = identifier(lane);
+    laneInit->right = literal(0);
+    auto laneIncrement = arena.create<ASTNode>(arena, ASTNodeType::PostIncrement, kIncrement);
+    laneIncrement->left = identifier(lane);
+    auto element = operation(kPlus, identifier(variable), identifier(lane));
+    auto laneBody = loop->children[3]->deepCopy(arena, variable, element);
+    if (laneBody->type != ASTNodeType::Block) {
+        auto block = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+        block->children.push_back(laneBody);
+        laneBody = block;
+    }
+    auto lanesLoop = arena.create<ASTNode>(arena, ASTNodeType::ForStatement, kSimdFor);
+    lanesLoop->loc = original->loc;
+    lanesLoop->children.push_back(laneInit);
+    lanesLoop->children.push_back(operation(kLess, identifier(lane), literal(lanes)));
+    lanesLoop->children.push_back(laneIncrement);
+    lanesLoop->children.push_back(laneBody);
+
+    // for (int i = start; i < end; i += W) { lanes }
+    auto strips = loop->shallowCopy(arena);
+    strips->value = kStripFor;
+    strips->children[0] = loop->children[0]->shallowCopy(arena);
+    strips->children[0]->left = identifier(variable);
+    strips->children[0]->right = candidate.start->deepCopy(arena);
+    strips->children[1] = operation(kLess, identifier(variable), end());
+    auto step = arena.create<ASTNode>(arena, ASTNodeType::CompoundAssignment, kPlusAssign);
+    step->left = identifier(variable);
+    step->right = literal(lanes);
+    strips->children[2] = step;
+    auto stripBody = arena.create<ASTNode>(arena, ASTNodeType::Block, kBlock);
+    stripBody->children.push_back(lanesLoop);
+    strips->children[3] = stripBody;
+    out.push_back(strips);
+
+    // The original loop, picking up where the strips stop
+    const bool epilogue = !literalBounds || stripEnd < bound;
+    if (epilogue) {
+        auto remainder = loop->deepCopy(arena);
+        remainder->value = kEpilogueFor;
+        remainder->children[0]->right = end();
+        out.push_back(remainder);
+    }
+
+    std::cout << "[Optimizer] Vectorized the for loop on line " << original->loc.line << " in strips of " << lanes
+              << " lanes";
+    if (literalBounds) {
+        std::cout << " (" << (stripEnd - start) << " iterations, " << (bound - stripEnd) << " in a scalar epilogue)";
+    } else {
+        std::cout << ", with a scalar epilogue";
+    }
+    std::cout << std::endl;
+    ++vectorized;
+    return true;
+}
+
+// Whether the loop has the shape the pass handles and a body whose
+// iterations are independent; `reason` says why not
+bool Vectorizer::examine(const ASTNode* loop, Candidate& candidate, std::string& reason) {
+    if (loop->children.size() < 4 || !loop->children[3]) {
+        reason = "it has no body";
+        return false;
+    }
+    const ASTNode* init = loop->children[0];
+    const ASTNode* condition = loop->children[1];
+    const ASTNode* increment = loop->children[2];
+
+    // for (int i = start; ...), with start a literal or a variable
+    if (!init || init->type != ASTNodeType::Declaration || init->value != kInt || !init->left ||
+        init->left->type != ASTNodeType::Identifier) {
+        reason = "it does not declare an int loop variable";
+        return false;
+    }
+    candidate.variable = init->left->value;
+    const std::string name(candidate.variable.str());
+    candidate.start = init->right;
+    int64_t value;
+    const bool startsAtLiteral = candidate.start && candidate.start->type == ASTNodeType::Literal &&
+                                 intLiteralValue(candidate.start->value, value);
+    if (!startsAtLiteral && !(candidate.start && candidate.start->type == ASTNodeType::Identifier &&
+                              candidate.start->value != candidate.variable)) {
+        reason = name + " does not start at a literal or a variable";
+        return false;
+    }
+
+    // i < bound
+    if (!condition || condition->type != ASTNodeType::BinaryOperation || condition->value != kLess ||
+        !isIdentifier(condition->left, candidate.variable) || !invariant(condition->right, loop)) {
+        reason = "its condition is not " + name + " < a bound the loop does not change";
+        return false;
+    }
+    candidate.bound = condition->right;
+
+    // i++, ++i or i += 1
+    int64_t step = 0;
+    if (increment && isIdentifier(increment->left, candidate.variable)) {
+        if (increment->type == ASTNodeType::PostIncrement || increment->type == ASTNodeType::PreIncrement) {
+            step = increment->value == kIncrement ? 1 : 0;
+        } else if (increment->type == ASTNodeType::CompoundAssignment && increment->value == kPlusAssign &&
+                   increment->right && increment->right->type == ASTNodeType::Literal) {
+            intLiteralValue(increment->right->value, step);
+        }
+    }
+    if (step != 1) {
+        reason = "it does not step by 1";
+        return false;
+    }
+
+    const ASTNode* body = loop->children[3];
+    if (writes(writeSets->of(body), candidate.variable)) {
+        reason = "its body writes " + name;
+        return false;
+    }
+    return examineStatement(body, candidate, reason) && independent(candidate, reason);
+}
+
+// Checks one statement of the body and collects the elements it uses
+bool Vectorizer::examineStatement(const ASTNode* node, Candidate& candidate, std::string& reason) {
+    if (!node) return true;
+    switch (node->type) {
+        case ASTNodeType::Block:
+            for (const ASTNode* child : node->children) {
+                if (!examineStatement(child, candidate, reason)) return false;
+            }
+            return true;
+
+        // Every iteration has a variable of its own
+        case ASTNodeType::Declaration:
+            if (!node->left || node->left->type != ASTNodeType::Identifier) break;
+            if (node->left->value == candidate.variable) {
+                reason = "its body declares another " + std::string(candidate.variable.str());
+                return false;
+            }
+            if (hasSideEffects(node->right)) {
+                reason = sideEffectReason(node->right);
+                return false;
+            }
+            collectAccesses(node->right, candidate);
+            candidate.locals.push_back(graph->variableOf(node->left));
+            return true;
+
+        case ASTNodeType::Assignment:
+        case ASTNodeType::CompoundAssignment:
+            if (hasSideEffects(node->right)) {
+                reason = sideEffectReason(node->right);
+                return false;
+            }
+            collectAccesses(node->right, candidate);
+            return examineStore(node->left, candidate, reason);
+
+        case ASTNodeType::ExpressionStatement: {
+            const ASTNode* expression = node->left;
+            if (expression && (expression->type == ASTNodeType::Assignment ||
+                               expression->type == ASTNodeType::CompoundAssignment)) {
+                return examineStatement(expression, candidate, reason);
+            }
+            if (expression && (expression->type == ASTNodeType::PreIncrement ||
+                               expression->type == ASTNodeType::PostIncrement)) {
+                return examineStore(expression->left, candidate, reason);
+            }
+            if (hasSideEffects(expression)) {
+                reason = sideEffectReason(expression);
+                return false;
+            }
+            collectAccesses(expression, candidate);
+            return true;
+        }
+
+        case ASTNodeType::IfStatement:
+            if (hasSideEffects(node->left)) {
+                reason = sideEffectReason(node->left);
+                return false;
+            }
+            collectAccesses(node->left, candidate);
+            return examineStatement(node->right, candidate, reason);
+
+        case ASTNodeType::ForStatement:
+        case ASTNodeType::WhileStatement:
+        case ASTNodeType::DoWhileStatement:
+            reason = "it contains another loop";
+            return false;
+
+        case ASTNodeType::PrintStatement:
+        case ASTNodeType::InputStatement:
+            reason = "it does input or output";
+            return false;
+
+        case ASTNodeType::ReturnStatement:
+            reason = "it may return from the function";
+            return false;
+
+        case ASTNodeType::ArrayDeclaration:
+            reason = "its body declares an array";
+            return false;
+
+        default:
+            break;
+    }
+    reason = "its body holds a statement the pass does not handle";
+    return false;
+}
+
+// A store must go to an array element or to a variable of the iteration
+bool Vectorizer::examineStore(const ASTNode* target, Candidate& candidate, std::string& reason) {
+    if (target && target->type == ASTNodeType::ArraySubscript &&
+        target->left && target->left->type == ASTNodeType::Identifier) {
+        if (hasSideEffects(target->right)) {
+            reason = sideEffectReason(target->right);
+            return false;
+        }
+        collectAccesses(target->right, candidate);
+        candidate.accesses.push_back(accessOf(target, true, candidate.variable));
+        return true;
+    }
+    if (target && target->type == ASTNodeType::Identifier) {
+        const uint32_t variable = graph->variableOf(target);
+        if (variable != ControlFlowGraph::None &&
+            std::find(candidate.locals.begin(), candidate.locals.end(), variable) != candidate.locals.end()) {
+            return true;
+        }
+        reason = "it carries " + std::string(target->value.str()) + " from one iteration to the next";
+        return false;
+    }
+    reason = "its body stores to something other than a variable or an array element";
+    return false;
+}
+
+void Vectorizer::collectAccesses(const ASTNode* node, Candidate& candidate) {
+    if (!node) return;
+    if (node->type == ASTNodeType::ArraySubscript) {
+        if (node->left && node->left->type == ASTNodeType::Identifier) {
+            candidate.accesses.push_back(accessOf(node, false, candidate.variable));
+        }
+        collectAccesses(node->right, candidate);
+        return;
+    }
+    collectAccesses(node->left, candidate);
+    collectAccesses(node->right, candidate);
+    for (const ASTNode* child : node->children) {
+        collectAccesses(child, candidate);
+    }
+}
+
+Vectorizer::Access Vectorizer::accessOf(const ASTNode* subscript, bool write, Symbol variable) {
+    Access access{subscript->left->value, write, false, 0};
+    access.affine = affineIndex(subscript->right, variable, access.offset);
+    return access;
+}
+
+// Iterations i and i + d, with 0 < d < W, run in the same strip: no
+// element one of them stores may be used by the other
+bool Vectorizer::independent(const Candidate& candidate, std::string& reason) {
+    const std::string name(candidate.variable.str());
+    for (const Access& store : candidate.accesses) {
+        if (!store.write) continue;
+        const std::string array(store.array.str());
+        for (const Access& other : candidate.accesses) {
+            if (other.array != store.array) continue;
+            if (!store.affine || !other.affine) {
+                reason = array + " is stored to, and indexed by something other than " + name + " plus a literal";
+                return false;
+            }
+            const int64_t distance = std::abs(store.offset - other.offset);
+            if (distance != 0 && distance < static_cast<int64_t>(width)) {
+                reason = "dependence distance " + std::to_string(distance) + " between " + array + "[" +
+                         indexText(candidate.variable, store.offset) + "], stored, and " + array + "[" +
+                         indexText(candidate.variable, other.offset) + "], " + (other.write ? "stored" : "read") +
+                         "; a strip has " + std::to_string(width) + " lanes";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Literals and variables the loop does not write, and arithmetic on them
+bool Vectorizer::invariant(const ASTNode* node, const ASTNode* loop) {
+    if (!node) return false;
+    switch (node->type) {
+        case ASTNodeType::Literal:
+            return true;
+        case ASTNodeType::Identifier:
+            return !writes(writeSets->of(loop), node->value);
+        case ASTNodeType::BinaryOperation:
+            return invariant(node->left, loop) && invariant(node->right, loop);
+        case ASTNodeType::UnaryOperation:
+            return invariant(node->left, loop);
+        default:
+            return false;
+    }
+}
+
+ASTNode* Vectorizer::literal(int64_t value) {
+    return arena.create<ASTNode>(arena, ASTNodeType::Literal, std::to_string(value));
+}
+
+ASTNode* Vectorizer::identifier(Symbol name) {
+    return arena.create<ASTNode>(arena, ASTNodeType::Identifier, name);
+}
+
+// Never a name the program already uses
+Symbol Vectorizer::freshName(const char* prefix) {
+    std::string name;
+    do {
+        name = std::string(prefix) + "_" + std::to_string(names++);
+    } while (StringInterner::global().contains(name));
+    return Symbol(name);
+}
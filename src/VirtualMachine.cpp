@@ -0,0 +1,344 @@
+#include "../include/VirtualMachine.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+namespace {
+// An int result, wrapped to 32 bits and sign-extended
+inline int64_t wrap(int64_t value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+// The int a double converts to, or INT_MIN where the hardware gives that
+// for a value outside the range
+inline int64_t truncate(double value) {
+    if (!(value > -2147483649.0 && value < 2147483648.0)) return INT_MIN;
+    return static_cast<int64_t>(value);
+}
+
+// Stops the program at the instruction `pc` of `function`
+[[noreturn]] void stop(const BytecodeFunction* function, const Instruction* pc, const std::string& message) {
+    throw std::runtime_error("line " + std::to_string(function->lines[pc - function->code.data()]) + ": " + message);
+}
+
+// An element of an array of the frame at `r`
+inline Value& element(const BytecodeFunction* function, Value* r, const Instruction* pc, uint16_t array,
+                      int64_t index) {
+    const BytecodeFunction::Array& layout = function->arrays[array];
+    if (index < 0 || index >= static_cast<int64_t>(layout.size)) {
+        stop(function, pc,
+             "index " + std::to_string(index) + " is outside an array of " + std::to_string(layout.size));
+    }
+    return r[layout.offset + index];
+}
+
+// A call that has not returned
+struct Frame {
+    const BytecodeFunction* function;
+    size_t base;                   // of its registers on the stack
+    const Instruction* resume;     // where it goes on
+    uint16_t dest;                 // of the result
+};
+} // namespace
+
+VirtualMachine::Statistics VirtualMachine::run(const BytecodeProgram& program, std::istream& in,
+                                               std::ostream& out) const {
+    Statistics statistics;
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<Value> stack;
+    std::vector<Frame> frames;
+    std::vector<Value> globals(program.globals, Value{0});
+    const BytecodeFunction* function = &program.functions[program.entry];
+    const Instruction* code = function->code.data();
+    const Instruction* pc = code;
+    size_t base = 0;
+    stack.resize(function->frameSize);
+    Value* r = stack.data();
+    std::copy(function->constants.begin(), function->constants.end(), r + function->parameters);
+
+    uint64_t executed = 0;
+    auto& counts = statistics.executed;
+    const uint64_t limit = instructionLimit;
+
+    // Every instruction is counted as it is dispatched; the limit is
+    // checked where control goes back
+#ifdef VM_COMPUTED_GOTO
+    static const void* const labels[] = {
+#define VM_LABEL(name) &&op_##name,
+        BYTECODE_OPCODES(VM_LABEL)
+#undef VM_LABEL
+    };
+#define VM_CASE(name) op_##name
+#define VM_DISPATCH()                              \
+    {                                              \
+        ++executed;                                \
+        ++counts[static_cast<size_t>(pc->op)];     \
+        goto *labels[static_cast<size_t>(pc->op)]; \
+    }
+#else
+#define VM_CASE(name) case Opcode::name
+#define VM_DISPATCH() continue;
+#endif
+#define VM_NEXT()     \
+    {                 \
+        ++pc;         \
+        VM_DISPATCH() \
+    }
+#define VM_JUMP(to)                                                                                \
+    {                                                                                              \
+        pc = (to);                                                                                 \
+        if (executed > limit) {                                                                    \
+            stop(function, pc, "the program ran over " + std::to_string(limit) + " instructions"); \
+        }                                                                                          \
+        VM_DISPATCH()                                                                              \
+    }
+
+#ifdef VM_COMPUTED_GOTO
+    VM_DISPATCH()
+#else
+    for (;;) {
+        ++executed;
+        ++counts[static_cast<size_t>(pc->op)];
+        switch (pc->op) {
+#endif
+
+    VM_CASE(Move):
+        r[pc->a] = r[pc->b];
+        VM_NEXT()
+    VM_CASE(Clear):
+        std::fill(r + pc->a, r + pc->a + pc->b, Value{0});
+        VM_NEXT()
+    VM_CASE(IntToReal):
+        r[pc->a].r = static_cast<double>(r[pc->b].i);
+        VM_NEXT()
+    VM_CASE(RealToInt):
+        r[pc->a].i = truncate(r[pc->b].r);
+        VM_NEXT()
+    VM_CASE(RoundFloat):
+        r[pc->a].r = static_cast<float>(r[pc->b].r);
+        VM_NEXT()
+    VM_CASE(ToBool):
+        r[pc->a].i = r[pc->b].i != 0;
+        VM_NEXT()
+    VM_CASE(RealToBool):
+        r[pc->a].i = r[pc->b].r != 0;
+        VM_NEXT()
+
+    VM_CASE(AddInt):
+        r[pc->a].i = wrap(r[pc->b].i + r[pc->c].i);
+        VM_NEXT()
+    VM_CASE(AddIntImm):
+        r[pc->a].i = wrap(r[pc->b].i + pc->immediate());
+        VM_NEXT()
+    VM_CASE(SubInt):
+        r[pc->a].i = wrap(r[pc->b].i - r[pc->c].i);
+        VM_NEXT()
+    VM_CASE(MulInt):
+        r[pc->a].i = wrap(r[pc->b].i * r[pc->c].i);
+        VM_NEXT()
+    VM_CASE(DivInt): {
+        const int64_t divisor = r[pc->c].i;
+        if (divisor == 0) stop(function, pc, "division by zero");
+        if (divisor == -1 && r[pc->b].i == INT_MIN) stop(function, pc, "the quotient of a division overflows");
+        r[pc->a].i = r[pc->b].i / divisor;
+        VM_NEXT()
+    }
+    VM_CASE(ModInt): {
+        const int64_t divisor = r[pc->c].i;
+        if (divisor == 0) stop(function, pc, "division by zero");
+        if (divisor == -1 && r[pc->b].i == INT_MIN) stop(function, pc, "the quotient of a division overflows");
+        r[pc->a].i = r[pc->b].i % divisor;
+        VM_NEXT()
+    }
+    VM_CASE(ShlInt):
+        r[pc->a].i = wrap(static_cast<int64_t>(static_cast<uint32_t>(r[pc->b].i) << (r[pc->c].i & 31)));
+        VM_NEXT()
+    VM_CASE(ShrInt):
+        r[pc->a].i = static_cast<int32_t>(r[pc->b].i) >> (r[pc->c].i & 31);
+        VM_NEXT()
+    VM_CASE(AndInt):
+        r[pc->a].i = r[pc->b].i & r[pc->c].i;
+        VM_NEXT()
+    VM_CASE(OrInt):
+        r[pc->a].i = r[pc->b].i | r[pc->c].i;
+        VM_NEXT()
+    VM_CASE(XorInt):
+        r[pc->a].i = r[pc->b].i ^ r[pc->c].i;
+        VM_NEXT()
+    VM_CASE(NegInt):
+        r[pc->a].i = wrap(-r[pc->b].i);
+        VM_NEXT()
+    VM_CASE(Not):
+        r[pc->a].i = r[pc->b].i == 0;
+        VM_NEXT()
+
+    VM_CASE(AddReal):
+        r[pc->a].r = r[pc->b].r + r[pc->c].r;
+        VM_NEXT()
+    VM_CASE(SubReal):
+        r[pc->a].r = r[pc->b].r - r[pc->c].r;
+        VM_NEXT()
+    VM_CASE(MulReal):
+        r[pc->a].r = r[pc->b].r * r[pc->c].r;
+        VM_NEXT()
+    VM_CASE(DivReal):
+        r[pc->a].r = r[pc->b].r / r[pc->c].r;
+        VM_NEXT()
+    VM_CASE(NegReal):
+        r[pc->a].r = -r[pc->b].r;
+        VM_NEXT()
+
+    VM_CASE(EqInt):
+        r[pc->a].i = r[pc->b].i == r[pc->c].i;
+        VM_NEXT()
+    VM_CASE(NeInt):
+        r[pc->a].i = r[pc->b].i != r[pc->c].i;
+        VM_NEXT()
+    VM_CASE(LtInt):
+        r[pc->a].i = r[pc->b].i < r[pc->c].i;
+        VM_NEXT()
+    VM_CASE(LeInt):
+        r[pc->a].i = r[pc->b].i <= r[pc->c].i;
+        VM_NEXT()
+    VM_CASE(EqReal):
+        r[pc->a].i = r[pc->b].r == r[pc->c].r;
+        VM_NEXT()
+    VM_CASE(NeReal):
+        r[pc->a].i = r[pc->b].r != r[pc->c].r;
+        VM_NEXT()
+    VM_CASE(LtReal):
+        r[pc->a].i = r[pc->b].r < r[pc->c].r;
+        VM_NEXT()
+    VM_CASE(LeReal):
+        r[pc->a].i = r[pc->b].r <= r[pc->c].r;
+        VM_NEXT()
+
+    VM_CASE(LoadElement):
+        r[pc->a] = element(function, r, pc, pc->b, r[pc->c].i);
+        VM_NEXT()
+    VM_CASE(StoreElement):
+        element(function, r, pc, pc->a, r[pc->b].i) = r[pc->c];
+        VM_NEXT()
+    VM_CASE(SetElement):
+        element(function, r, pc, pc->a, pc->b) = r[pc->c];
+        VM_NEXT()
+    VM_CASE(ClearArray): {
+        const BytecodeFunction::Array& layout = function->arrays[pc->a];
+        std::fill(r + layout.offset, r + layout.offset + layout.size, Value{0});
+        VM_NEXT()
+    }
+    VM_CASE(LoadGlobal):
+        r[pc->a] = globals[pc->b];
+        VM_NEXT()
+    VM_CASE(StoreGlobal):
+        globals[pc->a] = r[pc->b];
+        VM_NEXT()
+
+    VM_CASE(Jump):
+        VM_JUMP(code + pc->target())
+    VM_CASE(JumpIfZero):
+        if (r[pc->a].i == 0) VM_JUMP(code + pc->target());
+        VM_NEXT()
+    VM_CASE(JumpIfNotZero):
+        if (r[pc->a].i != 0) VM_JUMP(code + pc->target());
+        VM_NEXT()
+    VM_CASE(BranchEqInt):
+        if (r[pc->a].i == r[pc->b].i) VM_JUMP(pc + 1 + pc->immediate());
+        VM_NEXT()
+    VM_CASE(BranchNeInt):
+        if (r[pc->a].i != r[pc->b].i) VM_JUMP(pc + 1 + pc->immediate());
+        VM_NEXT()
+    VM_CASE(BranchLtInt):
+        if (r[pc->a].i < r[pc->b].i) VM_JUMP(pc + 1 + pc->immediate());
+        VM_NEXT()
+    VM_CASE(BranchLeInt):
+        if (r[pc->a].i <= r[pc->b].i) VM_JUMP(pc + 1 + pc->immediate());
+        VM_NEXT()
+
+    VM_CASE(Call): {
+        if (frames.size() >= MaxCallDepth) {
+            stop(function, pc, "calls nest more than " + std::to_string(MaxCallDepth) + " deep");
+        }
+        frames.push_back(Frame{function, base, pc + 1, pc->a});
+        const size_t arguments = base + pc->c;
+        base += function->frameSize;
+        function = &program.functions[pc->b];
+        if (stack.size() < base + function->frameSize) {
+            stack.resize(std::max(base + function->frameSize, 2 * stack.size()));
+        }
+        r = stack.data() + base;
+        std::copy(stack.data() + arguments, stack.data() + arguments + function->parameters, r);
+        std::copy(function->constants.begin(), function->constants.end(), r + function->parameters);
+        code = function->code.data();
+        VM_JUMP(code)
+    }
+    VM_CASE(Return):
+    VM_CASE(ReturnVoid): {
+        const Value result = pc->op == Opcode::Return ? r[pc->a] : Value{0};
+        if (frames.empty()) {
+            statistics.exitCode = static_cast<int>(result.i);
+            goto halt;
+        }
+        const Frame& caller = frames.back();
+        function = caller.function;
+        base = caller.base;
+        code = function->code.data();
+        pc = caller.resume;
+        r = stack.data() + base;
+        r[caller.dest] = result;
+        frames.pop_back();
+        VM_DISPATCH()
+    }
+
+    VM_CASE(PrintInt):
+        out << r[pc->a].i;
+        VM_NEXT()
+    VM_CASE(PrintReal):
+        out << r[pc->a].r;
+        VM_NEXT()
+    VM_CASE(PrintChar):
+        out.put(static_cast<char>(pc->b));
+        VM_NEXT()
+    VM_CASE(PrintString):
+        out << program.strings[pc->target()];
+        VM_NEXT()
+    VM_CASE(PrintEndl):
+        out << std::endl;
+        VM_NEXT()
+    VM_CASE(ReadInt): {
+        // As std::cin reads an int: unchanged if the stream has failed
+        // before, zero if this read fails
+        auto value = static_cast<int>(r[pc->a].i);
+        in >> value;
+        r[pc->a].i = value;
+        VM_NEXT()
+    }
+    VM_CASE(ReadFloat): {
+        auto value = static_cast<float>(r[pc->a].r);
+        in >> value;
+        r[pc->a].r = value;
+        VM_NEXT()
+    }
+
+#ifndef VM_COMPUTED_GOTO
+        }
+    }
+#endif
+#undef VM_CASE
+#undef VM_DISPATCH
+#undef VM_NEXT
+#undef VM_JUMP
+
+halt:
+    statistics.instructions = executed;
+    statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return statistics;
+}
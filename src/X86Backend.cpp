@@ -0,0 +1,1006 @@
+#include "../include/X86Backend.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+// The registers linear scan hands out
+struct MachineRegister {
+    const char* name32;
+    const char* name64;
+    bool calleeSaved;
+};
+
+const MachineRegister kRegisters[] = {
+    {"%ebx", "%rbx", true},   {"%r12d", "%r12", true},  {"%r13d", "%r13", true}, {"%r14d", "%r14", true},
+    {"%r15d", "%r15", true},  {"%r10d", "%r10", false}, {"%r11d", "%r11", false},
+};
+constexpr int kRegisterCount = sizeof(kRegisters) / sizeof(kRegisters[0]);
+
+const char* const kArguments[] = {"%edi", "%esi", "%edx", "%ecx", "%r8d", "%r9d"};
+constexpr size_t kArgumentCount = sizeof(kArguments) / sizeof(kArguments[0]);
+
+constexpr uint32_t None = UINT32_MAX;
+
+// Arrays smaller than this are cleared one store per element
+constexpr uint32_t kInlineClear = 16;
+
+bool isBranch(Opcode op) {
+    return op == Opcode::BranchEqInt || op == Opcode::BranchNeInt || op == Opcode::BranchLtInt ||
+           op == Opcode::BranchLeInt;
+}
+
+bool isJump(Opcode op) {
+    return op == Opcode::Jump || op == Opcode::JumpIfZero || op == Opcode::JumpIfNotZero || isBranch(op);
+}
+
+bool isOutput(Opcode op) {
+    return op == Opcode::PrintInt || op == Opcode::PrintChar || op == Opcode::PrintString || op == Opcode::PrintEndl;
+}
+
+// Whether an instruction calls out, so that what is live across it must
+// be in a register the callee saves
+bool isCall(Opcode op) {
+    return op == Opcode::Call || op == Opcode::ReadInt || isOutput(op);
+}
+
+// Whether the instruction after an instruction may run next
+bool fallsThrough(Opcode op) {
+    return op != Opcode::Jump && op != Opcode::Return && op != Opcode::ReturnVoid;
+}
+
+size_t jumpTarget(const Instruction& instruction, size_t pc) {
+    return isBranch(instruction.op) ? pc + 1 + instruction.immediate() : instruction.target();
+}
+
+// The condition code of a comparison or a branch, or of its negation;
+// `swapped` when its operands are compared the other way round
+const char* condition(Opcode op, bool negate, bool swapped) {
+    static const char* const codes[][4] = {
+        // as is, negated, swapped, swapped and negated
+        {"e", "ne", "e", "ne"},
+        {"ne", "e", "ne", "e"},
+        {"l", "ge", "g", "le"},
+        {"le", "g", "ge", "l"},
+    };
+    size_t row = 3;
+    if (op == Opcode::EqInt || op == Opcode::BranchEqInt) row = 0;
+    if (op == Opcode::NeInt || op == Opcode::BranchNeInt) row = 1;
+    if (op == Opcode::LtInt || op == Opcode::BranchLtInt) row = 2;
+    return codes[row][(negate ? 1 : 0) + (swapped ? 2 : 0)];
+}
+
+// Calls `use` for every register an instruction reads and `define` for
+// every one it writes
+template <typename Use, typename Define>
+void forEachOperand(const Instruction& instruction, const BytecodeProgram& program, Use use, Define define) {
+    switch (instruction.op) {
+        case Opcode::Move:
+        case Opcode::ToBool:
+        case Opcode::NegInt:
+        case Opcode::Not:
+        case Opcode::AddIntImm:
+            use(instruction.b);
+            define(instruction.a);
+            break;
+        case Opcode::Clear:
+            for (uint32_t i = 0; i < instruction.b; ++i) define(static_cast<uint16_t>(instruction.a + i));
+            break;
+        case Opcode::AddInt:
+        case Opcode::SubInt:
+        case Opcode::MulInt:
+        case Opcode::DivInt:
+        case Opcode::ModInt:
+        case Opcode::ShlInt:
+        case Opcode::ShrInt:
+        case Opcode::AndInt:
+        case Opcode::OrInt:
+        case Opcode::XorInt:
+        case Opcode::EqInt:
+        case Opcode::NeInt:
+        case Opcode::LtInt:
+        case Opcode::LeInt:
+            use(instruction.b);
+            use(instruction.c);
+            define(instruction.a);
+            break;
+        case Opcode::LoadElement:
+            use(instruction.c);
+            define(instruction.a);
+            break;
+        case Opcode::StoreElement:
+            use(instruction.b);
+            use(instruction.c);
+            break;
+        case Opcode::SetElement:
+        case Opcode::StoreGlobal:
+            use(instruction.op == Opcode::SetElement ? instruction.c : instruction.b);
+            break;
+        case Opcode::LoadGlobal:
+            define(instruction.a);
+            break;
+        case Opcode::JumpIfZero:
+        case Opcode::JumpIfNotZero:
+        case Opcode::Return:
+        case Opcode::PrintInt:
+            use(instruction.a);
+            break;
+        case Opcode::BranchEqInt:
+        case Opcode::BranchNeInt:
+        case Opcode::BranchLtInt:
+        case Opcode::BranchLeInt:
+            use(instruction.a);
+            use(instruction.b);
+            break;
+        case Opcode::Call:
+            for (uint32_t i = 0; i < program.functions[instruction.b].parameters; ++i) {
+                use(static_cast<uint16_t>(instruction.c + i));
+            }
+            define(instruction.a);
+            break;
+        case Opcode::ReadInt:
+            use(instruction.a);
+            define(instruction.a);
+            break;
+        default:
+            break;
+    }
+}
+
+// Text for the format of printf, or for a .string directive
+void appendFormat(std::string& format, char c) {
+    if (c == '%') format += '%';
+    format += c;
+}
+
+std::string quoted(const std::string& text) {
+    static const char digits[] = "01234567";
+    std::string result = "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (c < 32 || c >= 127) {
+                    result += '\\';
+                    result += digits[c >> 6];
+                    result += digits[(c >> 3) & 7];
+                    result += digits[c & 7];
+                } else {
+                    result += static_cast<char>(c);
+                }
+                break;
+        }
+    }
+    return result + "\"";
+}
+} // namespace
+
+std::string X86Backend::compile(const BytecodeProgram& bytecode) {
+    program = &bytecode;
+    out.clear();
+    strings.clear();
+    reads = false;
+    stats = Statistics();
+
+    out += "\t.text\n";
+    for (uint32_t index = 0; index < program->functions.size(); ++index) emitFunction(index);
+
+    if (reads) {
+        // Reads an int the way std::cin does: once a read has failed, no
+        // more are made and values are left as they are; a read that finds
+        // no number leaves zero, one at the end of the input the value as
+        // it was. The value before is in edi, the value after is returned.
+        out += "\n.Lread_int:\n";
+        line("subq $24, %rsp");
+        line("movl %edi, (%rsp)");
+        line("cmpb $0, .Lcin_failed(%rip)");
+        line("jne .Lread_done");
+        line("movq %rsp, %rsi");
+        line("leaq .Lformat_int(%rip), %rdi");
+        line("xorl %eax, %eax");
+        line("call scanf@PLT");
+        line("cmpl $1, %eax");
+        line("je .Lread_done");
+        line("movb $1, .Lcin_failed(%rip)");
+        line("testl %eax, %eax");
+        line("jne .Lread_done");
+        line("movl $0, (%rsp)");
+        out += ".Lread_done:\n";
+        line("movl (%rsp), %eax");
+        line("addq $24, %rsp");
+        line("ret");
+    }
+
+    out += "\n\t.section .rodata\n";
+    for (size_t i = 0; i < strings.size(); ++i) {
+        out += ".LC" + std::to_string(i) + ":\n";
+        line(".string " + quoted(strings[i]));
+    }
+    if (reads) {
+        out += ".Lformat_int:\n";
+        line(".string \"%d\"");
+    }
+    if (program->globals > 0 || reads) {
+        out += "\n\t.bss\n";
+        line(".align 4");
+        for (uint32_t global = 0; global < program->globals; ++global) {
+            out += ".Lglobal" + std::to_string(global) + ":\n";
+            line(".zero 4");
+        }
+        if (reads) {
+            out += ".Lcin_failed:\n";
+            line(".zero 1");
+        }
+    }
+    out += "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+
+    program = nullptr;
+    function = nullptr;
+    return std::move(out);
+}
+
+void X86Backend::emitFunction(uint32_t index) {
+    // Nothing of the function before carries over
+    function = &program->functions[index];
+    functionIndex = index;
+    at = 0;
+    targets.clear();
+    words = 0;
+    live.clear();
+    runs.clear();
+    ranges.clear();
+    locations.clear();
+    saved.clear();
+    frameBytes = 0;
+    arrayBase = 0;
+
+    const std::string name(function->name.str());
+    if (function->reals) fail("float values are not supported; only the virtual machine runs them");
+    if (function->parameters > kArgumentCount) fail("functions with more than six parameters are not supported");
+    if (name == "printf" || name == "scanf") fail("the name is taken by the C library");
+
+    analyze();
+    allocate();
+    ++stats.functions;
+
+    out += "\n";
+    if (index == program->entry) line(".globl " + name);
+    line(".type " + name + ", @function");
+    out += name + ":\n";
+    line("pushq %rbp");
+    line("movq %rsp, %rbp");
+    for (int8_t reg : saved) line(std::string("pushq ") + kRegisters[reg].name64);
+    if (frameBytes > 0) line("subq $" + std::to_string(frameBytes) + ", %rsp");
+    for (uint16_t parameter = 0; parameter < function->parameters; ++parameter) {
+        if (runs[parameter].empty() || runs[parameter].front().start != 0) continue; // not read
+        line(std::string("movl ") + kArguments[parameter] + ", " + operand(parameter));
+    }
+
+    const size_t size = function->code.size();
+    bool reachable = true;
+    for (size_t pc = 0; pc < size;) {
+        if (targets[pc]) {
+            out += label(pc) + ":\n";
+            reachable = true;
+        }
+        if (!reachable) {
+            ++pc;
+            continue;
+        }
+        pc = emitInstruction(pc);
+        reachable = fallsThrough(function->code[pc - 1].op);
+    }
+
+    out += ".Lreturn" + std::to_string(index) + ":\n";
+    if (saved.empty()) {
+        line("leave");
+    } else {
+        line("leaq -" + std::to_string(8 * saved.size()) + "(%rbp), %rsp");
+        for (auto reg = saved.rbegin(); reg != saved.rend(); ++reg) {
+            line(std::string("popq ") + kRegisters[*reg].name64);
+        }
+        line("popq %rbp");
+    }
+    line("ret");
+    line(".size " + name + ", .-" + name);
+    function = nullptr;
+}
+
+// Finds the basic blocks, the registers live after every instruction, and
+// the live ranges: the runs of instructions a register is live over,
+// joined where control passes from one run to another. A register the
+// compiler reuses for several temporaries gets a range for each.
+void X86Backend::analyze() {
+    const auto& code = function->code;
+    const size_t size = code.size();
+    targets.assign(size + 1, 0);
+    std::vector<char> leaders(size + 1, 0);
+    leaders[0] = 1;
+    for (size_t pc = 0; pc < size; ++pc) {
+        const Opcode op = code[pc].op;
+        if (isJump(op)) leaders[jumpTarget(code[pc], pc)] = targets[jumpTarget(code[pc], pc)] = 1;
+        if (isJump(op) || op == Opcode::Return || op == Opcode::ReturnVoid) leaders[pc + 1] = 1;
+    }
+
+    std::vector<uint32_t> blockStarts;
+    for (size_t pc = 0; pc < size; ++pc) {
+        if (leaders[pc]) blockStarts.push_back(static_cast<uint32_t>(pc));
+    }
+    const size_t blocks = blockStarts.size();
+    blockStarts.push_back(static_cast<uint32_t>(size));
+    auto blockOf = [&](size_t pc) {
+        return static_cast<size_t>(std::upper_bound(blockStarts.begin(), blockStarts.end() - 1, pc) -
+                                   blockStarts.begin() - 1);
+    };
+
+    // Literals are never written, and need no range
+    words = (function->registers + 63u) / 64u;
+    auto set = [&](std::vector<uint64_t>& bits, size_t row, uint16_t reg) {
+        if (!isConstant(reg)) bits[row * words + reg / 64] |= uint64_t(1) << (reg % 64);
+    };
+    auto clear = [&](std::vector<uint64_t>& bits, size_t row, uint16_t reg) {
+        bits[row * words + reg / 64] &= ~(uint64_t(1) << (reg % 64));
+    };
+    auto test = [&](const std::vector<uint64_t>& bits, size_t row, uint16_t reg) {
+        return ((bits[row * words + reg / 64] >> (reg % 64)) & 1) != 0;
+    };
+
+    // Registers each block reads before writing, and writes
+    std::vector<uint64_t> used(blocks * words), defined(blocks * words), liveIn(blocks * words), liveOut(blocks * words);
+    for (size_t block = 0; block < blocks; ++block) {
+        for (size_t pc = blockStarts[block]; pc < blockStarts[block + 1]; ++pc) {
+            forEachOperand(
+                code[pc], *program,
+                [&](uint16_t reg) {
+                    if (!test(defined, block, reg)) set(used, block, reg);
+                },
+                [&](uint16_t reg) { set(defined, block, reg); });
+        }
+    }
+
+    std::vector<std::vector<size_t>> successors(blocks);
+    for (size_t block = 0; block < blocks; ++block) {
+        const size_t last = blockStarts[block + 1] - 1;
+        if (isJump(code[last].op)) successors[block].push_back(blockOf(jumpTarget(code[last], last)));
+        if (fallsThrough(code[last].op) && block + 1 < blocks) successors[block].push_back(block + 1);
+    }
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t block = blocks; block-- > 0;) {
+            for (size_t word = 0; word < words; ++word) {
+                uint64_t exits = 0;
+                for (size_t successor : successors[block]) exits |= liveIn[successor * words + word];
+                const size_t slot = block * words + word;
+                const uint64_t entries = used[slot] | (exits & ~defined[slot]);
+                if (entries != liveIn[slot] || exits != liveOut[slot]) changed = true;
+                liveIn[slot] = entries;
+                liveOut[slot] = exits;
+            }
+        }
+    }
+
+    live.assign(size * words, 0);
+    for (size_t block = 0; block < blocks; ++block) {
+        std::vector<uint64_t> after(liveOut.begin() + block * words, liveOut.begin() + (block + 1) * words);
+        for (size_t pc = blockStarts[block + 1]; pc-- > blockStarts[block];) {
+            std::copy(after.begin(), after.end(), live.begin() + pc * words);
+            forEachOperand(code[pc], *program, [](uint16_t) {}, [&](uint16_t reg) { clear(after, 0, reg); });
+            forEachOperand(code[pc], *program, [&](uint16_t reg) { set(after, 0, reg); }, [](uint16_t) {});
+        }
+    }
+
+    // The runs: instructions a register is live after, read at or written
+    // at, in a row that control falls through
+    runs.assign(function->registers, {});
+    std::vector<uint32_t> parent; // of each run, to join them
+    std::vector<uint64_t> occupied(words);
+    for (uint32_t pc = 0; pc < size; ++pc) {
+        std::copy(live.begin() + pc * words, live.begin() + (pc + 1) * words, occupied.begin());
+        auto occupy = [&](uint16_t reg) { set(occupied, 0, reg); };
+        forEachOperand(code[pc], *program, occupy, occupy);
+        const bool fallsInto = pc > 0 && fallsThrough(code[pc - 1].op);
+        for (size_t word = 0; word < words; ++word) {
+            for (uint64_t bits = occupied[word]; bits != 0; bits &= bits - 1) {
+                const auto reg = static_cast<uint16_t>(word * 64 + __builtin_ctzll(bits));
+                auto& list = runs[reg];
+                if (fallsInto && !list.empty() && list.back().end + 1 == pc && test(live, pc - 1, reg)) {
+                    list.back().end = pc;
+                } else {
+                    list.push_back(Run{pc, pc, static_cast<uint32_t>(parent.size())});
+                    parent.push_back(static_cast<uint32_t>(parent.size()));
+                }
+            }
+        }
+    }
+
+    // Joined along jumps, for the registers live where they go
+    auto root = [&](uint32_t run) {
+        while (parent[run] != run) run = parent[run] = parent[parent[run]];
+        return run;
+    };
+    for (size_t pc = 0; pc < size; ++pc) {
+        if (!isJump(code[pc].op)) continue;
+        const size_t target = jumpTarget(code[pc], pc);
+        const size_t block = blockOf(target);
+        for (uint16_t reg = 0; reg < function->registers; ++reg) {
+            if (!test(liveIn, block, reg)) continue;
+            parent[root(runs[reg][runAt(reg, pc)].range)] = root(runs[reg][runAt(reg, target)].range);
+        }
+    }
+
+    // A range for each set of joined runs, from the first to the last
+    // instruction of any; runs are renumbered by range
+    ranges.clear();
+    std::vector<uint32_t> rangeOf(parent.size(), None);
+    for (uint32_t reg = 0; reg < function->registers; ++reg) {
+        for (Run& run : runs[reg]) {
+            uint32_t& range = rangeOf[root(run.range)];
+            if (range == None) {
+                range = static_cast<uint32_t>(ranges.size());
+                ranges.push_back(Interval{run.start, run.end, false});
+            }
+            ranges[range].start = std::min(ranges[range].start, run.start);
+            ranges[range].end = std::max(ranges[range].end, run.end);
+            run.range = range;
+        }
+    }
+
+    // What is live across a call, not written by it, must be where the
+    // callee saves it
+    for (uint32_t pc = 0; pc < size; ++pc) {
+        if (!isCall(code[pc].op)) continue;
+        std::copy(live.begin() + pc * words, live.begin() + (pc + 1) * words, occupied.begin());
+        forEachOperand(code[pc], *program, [](uint16_t) {}, [&](uint16_t reg) { clear(occupied, 0, reg); });
+        for (size_t word = 0; word < words; ++word) {
+            for (uint64_t bits = occupied[word]; bits != 0; bits &= bits - 1) {
+                const auto reg = static_cast<uint16_t>(word * 64 + __builtin_ctzll(bits));
+                ranges[runs[reg][runAt(reg, pc)].range].crossesCall = true;
+            }
+        }
+    }
+}
+
+// Linear scan: ranges take the registers in the order they start, and
+// give them back when they end
+void X86Backend::allocate() {
+    locations.assign(ranges.size(), Location());
+    std::vector<uint32_t> order(ranges.size());
+    for (uint32_t range = 0; range < order.size(); ++range) order[range] = range;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return ranges[a].start < ranges[b].start; });
+
+    std::vector<uint32_t> active; // by end
+    bool taken[kRegisterCount] = {};
+    std::vector<uint32_t> spills;
+    for (uint32_t range : order) {
+        const Interval& interval = ranges[range];
+        while (!active.empty() && ranges[active.front()].end < interval.start) {
+            taken[locations[active.front()].reg] = false;
+            active.erase(active.begin());
+        }
+
+        // Registers the caller saves are for ranges that cross no call
+        int8_t chosen = -1;
+        for (int8_t reg = kRegisterCount - 1; reg >= 0 && chosen < 0; --reg) {
+            if (!taken[reg] && (kRegisters[reg].calleeSaved || !interval.crossesCall)) chosen = reg;
+        }
+        if (chosen < 0) {
+            // Spill whichever ends last, of this range and those holding a
+            // register it can have
+            auto victim = active.end();
+            for (auto other = active.begin(); other != active.end(); ++other) {
+                if (kRegisters[locations[*other].reg].calleeSaved || !interval.crossesCall) victim = other;
+            }
+            if (victim == active.end() || ranges[*victim].end <= interval.end) {
+                locations[range].reg = Spilled;
+                spills.push_back(range);
+                continue;
+            }
+            chosen = locations[*victim].reg;
+            locations[*victim].reg = Spilled;
+            spills.push_back(*victim);
+            active.erase(victim);
+        }
+        locations[range].reg = chosen;
+        taken[chosen] = true;
+        active.insert(std::upper_bound(active.begin(), active.end(), range,
+                                       [&](uint32_t a, uint32_t b) { return ranges[a].end < ranges[b].end; }),
+                      range);
+    }
+    stats.ranges += ranges.size();
+    stats.spilled += spills.size();
+
+    // The frame: rbp, the callee-saved registers, the spilled ranges, then
+    // the arrays
+    saved.clear();
+    for (const Location& location : locations) {
+        if (location.reg >= 0 && kRegisters[location.reg].calleeSaved &&
+            std::find(saved.begin(), saved.end(), location.reg) == saved.end()) {
+            saved.push_back(location.reg);
+        }
+    }
+    std::sort(saved.begin(), saved.end());
+    const auto savedBytes = static_cast<int32_t>(8 * saved.size());
+    int32_t offset = savedBytes;
+    for (uint32_t range : spills) {
+        offset += 4;
+        locations[range].value = -offset;
+    }
+    const auto memory = static_cast<int32_t>(function->frameSize - function->registers);
+    offset += 4 * memory;
+    arrayBase = -offset;
+    frameBytes = ((offset + 15) & ~15) - savedBytes;
+}
+
+// Emits the instruction at `pc`, with the ones after it that it combines
+// with; returns the next one to emit
+size_t X86Backend::emitInstruction(size_t pc) {
+    const auto& code = function->code;
+    const Instruction& instruction = code[pc];
+    const uint16_t a = instruction.a;
+    const uint16_t b = instruction.b;
+    const uint16_t c = instruction.c;
+    at = pc;
+
+    switch (instruction.op) {
+        case Opcode::Move:
+            copy(a, b);
+            break;
+
+        case Opcode::Clear:
+            for (uint32_t i = 0; i < b; ++i) {
+                const auto reg = static_cast<uint16_t>(a + i);
+                if (!liveAfter(reg, pc)) continue;
+                line(inRegister(reg) ? "xorl " + operand(reg) + ", " + operand(reg) : "movl $0, " + operand(reg));
+            }
+            break;
+
+        case Opcode::AddIntImm: {
+            const int16_t amount = instruction.immediate();
+            if (immediate(b)) {
+                line("movl $" + std::to_string(static_cast<int32_t>(static_cast<uint32_t>(place(b).value) + amount)) +
+                     ", " + operand(a));
+            } else if (sameLocation(a, b)) {
+                line("addl $" + std::to_string(amount) + ", " + operand(a));
+            } else if (inRegister(a) && inRegister(b)) {
+                line("leal " + std::to_string(amount) + "(" + kRegisters[place(b).reg].name64 + "), " + operand(a));
+            } else {
+                load("%eax", b);
+                line("addl $" + std::to_string(amount) + ", %eax");
+                assign(a, "%eax");
+            }
+            break;
+        }
+
+        case Opcode::AddInt: binary("addl", a, b, c, true); break;
+        case Opcode::SubInt: binary("subl", a, b, c, false); break;
+        case Opcode::MulInt: binary("imull", a, b, c, true); break;
+        case Opcode::AndInt: binary("andl", a, b, c, true); break;
+        case Opcode::OrInt: binary("orl", a, b, c, true); break;
+        case Opcode::XorInt: binary("xorl", a, b, c, true); break;
+
+        case Opcode::DivInt:
+        case Opcode::ModInt:
+            load("%eax", b);
+            line("cltd");
+            if (immediate(c)) {
+                load("%ecx", c);
+                line("idivl %ecx");
+            } else {
+                line("idivl " + operand(c));
+            }
+            assign(a, instruction.op == Opcode::DivInt ? "%eax" : "%edx");
+            break;
+
+        case Opcode::ShlInt:
+        case Opcode::ShrInt: {
+            const char* mnemonic = instruction.op == Opcode::ShlInt ? "sall " : "sarl ";
+            std::string count = "%cl";
+            if (immediate(c)) {
+                count = "$" + std::to_string(place(c).value & 31);
+            } else {
+                load("%ecx", c);
+            }
+            if (inRegister(a)) {
+                copy(a, b);
+                line(mnemonic + count + ", " + operand(a));
+            } else {
+                load("%eax", b);
+                line(mnemonic + count + ", %eax");
+                assign(a, "%eax");
+            }
+            break;
+        }
+
+        case Opcode::NegInt:
+            if (inRegister(a)) {
+                copy(a, b);
+                line("negl " + operand(a));
+            } else {
+                load("%eax", b);
+                line("negl %eax");
+                assign(a, "%eax");
+            }
+            break;
+
+        case Opcode::Not:
+        case Opcode::ToBool:
+            test(b);
+            line(instruction.op == Opcode::Not ? "sete %al" : "setne %al");
+            setFromFlags(a);
+            break;
+
+        case Opcode::EqInt:
+        case Opcode::NeInt:
+        case Opcode::LtInt:
+        case Opcode::LeInt: {
+            // Into a branch or a conditional move where the result is used
+            // by nothing else
+            const Instruction& next = code[pc + 1];
+            const bool fuses = !targets[pc + 1] && !liveAfter(a, pc + 1) &&
+                               (next.op == Opcode::JumpIfZero || next.op == Opcode::JumpIfNotZero) && next.a == a;
+            if (fuses && emitConditionalMove(pc)) return pc + 3;
+            at = pc;
+            if (fuses) {
+                const char* taken = compare(instruction.op, b, c, next.op == Opcode::JumpIfZero);
+                line(std::string("j") + taken + " " + label(next.target()));
+                ++stats.fusedBranches;
+                return pc + 2;
+            }
+            line(std::string("set") + compare(instruction.op, b, c, false) + " %al");
+            setFromFlags(a);
+            break;
+        }
+
+        case Opcode::LoadElement:
+            if (immediate(c)) {
+                moveFrom(a, element(b, place(c).value, false));
+            } else {
+                index(c);
+                moveFrom(a, element(b, 0, true));
+            }
+            break;
+
+        case Opcode::StoreElement:
+        case Opcode::SetElement: {
+            const std::string value = source(c, "%ecx");
+            if (instruction.op == Opcode::SetElement) {
+                line("movl " + value + ", " + element(a, b, false));
+            } else if (immediate(b)) {
+                line("movl " + value + ", " + element(a, place(b).value, false));
+            } else {
+                index(b);
+                line("movl " + value + ", " + element(a, 0, true));
+            }
+            break;
+        }
+
+        case Opcode::ClearArray: {
+            const BytecodeFunction::Array& layout = function->arrays[a];
+            if (layout.size < kInlineClear) {
+                for (uint32_t i = 0; i < layout.size; ++i) line("movl $0, " + element(a, i, false));
+            } else {
+                line("leaq " + element(a, 0, false) + ", %rdi");
+                line("movl $" + std::to_string(layout.size) + ", %ecx");
+                line("xorl %eax, %eax");
+                line("rep stosl");
+            }
+            break;
+        }
+
+        case Opcode::LoadGlobal:
+            moveFrom(a, ".Lglobal" + std::to_string(b) + "(%rip)");
+            break;
+
+        case Opcode::StoreGlobal:
+            line("movl " + source(b, "%ecx") + ", .Lglobal" + std::to_string(a) + "(%rip)");
+            break;
+
+        case Opcode::Jump:
+            line("jmp " + label(instruction.target()));
+            break;
+
+        case Opcode::JumpIfZero:
+        case Opcode::JumpIfNotZero: {
+            const bool onZero = instruction.op == Opcode::JumpIfZero;
+            if (immediate(a)) {
+                if ((place(a).value == 0) == onZero) line("jmp " + label(instruction.target()));
+                break;
+            }
+            test(a);
+            line(std::string(onZero ? "je " : "jne ") + label(instruction.target()));
+            break;
+        }
+
+        case Opcode::BranchEqInt:
+        case Opcode::BranchNeInt:
+        case Opcode::BranchLtInt:
+        case Opcode::BranchLeInt:
+            line(std::string("j") + compare(instruction.op, a, b, false) + " " + label(jumpTarget(instruction, pc)));
+            break;
+
+        case Opcode::Call: {
+            const BytecodeFunction& callee = program->functions[b];
+            for (uint16_t i = 0; i < callee.parameters; ++i) {
+                line("movl " + operand(static_cast<uint16_t>(c + i)) + ", " + kArguments[i]);
+            }
+            line("call " + std::string(callee.name.str()));
+            if (liveAfter(a, pc)) assign(a, "%eax");
+            break;
+        }
+
+        case Opcode::Return:
+        case Opcode::ReturnVoid:
+            if (instruction.op == Opcode::Return) {
+                load("%eax", a);
+            } else {
+                line("xorl %eax, %eax");
+            }
+            // Straight into the epilogue when no jump reaches what follows
+            if (std::find(targets.begin() + pc + 1, targets.end(), 1) != targets.end()) {
+                line("jmp .Lreturn" + std::to_string(functionIndex));
+            }
+            break;
+
+        case Opcode::PrintInt:
+        case Opcode::PrintChar:
+        case Opcode::PrintString:
+        case Opcode::PrintEndl:
+            return emitOutput(pc);
+
+        case Opcode::ReadInt:
+            load("%edi", a);
+            line("call .Lread_int");
+            assign(a, "%eax");
+            reads = true;
+            break;
+
+        default:
+            fail(std::string("instruction ") + opcodeName(instruction.op) + " is not supported");
+    }
+    return pc + 1;
+}
+
+// A run of outputs as one call of printf, with up to five ints, and a
+// flush if it has a std::endl; returns the instruction after the run
+size_t X86Backend::emitOutput(size_t pc) {
+    const auto& code = function->code;
+    std::string format;
+    std::vector<std::pair<uint16_t, size_t>> values; // registers, and where they are read
+    bool flush = false;
+    size_t end = pc;
+    for (; end < code.size() && isOutput(code[end].op) && (end == pc || !targets[end]); ++end) {
+        const Instruction& instruction = code[end];
+        if (instruction.op == Opcode::PrintInt) {
+            if (values.size() + 1 == kArgumentCount) break;
+            format += "%d";
+            values.emplace_back(instruction.a, end);
+        } else if (instruction.op == Opcode::PrintChar) {
+            appendFormat(format, static_cast<char>(instruction.b));
+        } else if (instruction.op == Opcode::PrintString) {
+            for (char c : program->strings[instruction.target()]) appendFormat(format, c);
+        } else {
+            format += '\n';
+            flush = true;
+        }
+    }
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        at = values[i].second;
+        line("movl " + operand(values[i].first) + ", " + kArguments[i + 1]);
+    }
+    line("leaq " + stringLabel(format) + "(%rip), %rdi");
+    line("xorl %eax, %eax");
+    line("call printf@PLT");
+    if (flush) {
+        line("xorl %edi, %edi");
+        line("call fflush@PLT");
+    }
+    return end;
+}
+
+// `if (x op y) a = b;` as a cmp and a cmov, where a is in a register: the
+// comparison at `pc` is followed by a jump over one move
+bool X86Backend::emitConditionalMove(size_t pc) {
+    const auto& code = function->code;
+    if (pc + 3 > code.size() || targets[pc + 2]) return false;
+    const Instruction& comparison = code[pc];
+    const Instruction& jump = code[pc + 1];
+    const Instruction& move = code[pc + 2];
+    at = pc + 2;
+    if (move.op != Opcode::Move || jump.target() != pc + 3 || !inRegister(move.a)) return false;
+
+    std::string value = operand(move.b);
+    const std::string destination = operand(move.a);
+    if (immediate(move.b)) {
+        load("%ecx", move.b);
+        value = "%ecx";
+    }
+    at = pc;
+    // The move is made when the jump over it is not taken
+    const char* moves = compare(comparison.op, comparison.b, comparison.c, jump.op == Opcode::JumpIfNotZero);
+    line(std::string("cmov") + moves + " " + value + ", " + destination);
+    ++stats.conditionalMoves;
+    return true;
+}
+
+// a = b op c, for an instruction that takes its destination as its left
+// operand
+void X86Backend::binary(const char* mnemonic, uint16_t a, uint16_t b, uint16_t c, bool commutative) {
+    const std::string op(mnemonic);
+    if (op == "imull" && inRegister(a) && (immediate(b) || immediate(c))) {
+        if (immediate(b)) std::swap(b, c);
+        if (!immediate(b)) {
+            line("imull " + operand(c) + ", " + operand(b) + ", " + operand(a));
+            return;
+        }
+    }
+    if (inRegister(a)) {
+        if (!sameLocation(a, c) || sameLocation(a, b)) {
+            copy(a, b);
+            line(op + " " + operand(c) + ", " + operand(a));
+            return;
+        }
+        if (commutative) {
+            line(op + " " + operand(b) + ", " + operand(a));
+            return;
+        }
+    }
+    load("%eax", b);
+    line(op + " " + operand(c) + ", %eax");
+    assign(a, "%eax");
+}
+
+// Compares `left` with `right` for the comparison or branch `op`;
+// returns the condition code that holds when it is true, or, `negate`,
+// when it is false
+const char* X86Backend::compare(Opcode op, uint16_t left, uint16_t right, bool negate) {
+    // A literal goes on the right, where cmp takes an immediate
+    const bool swapped = immediate(left) && !immediate(right);
+    if (swapped) std::swap(left, right);
+    if (immediate(right) && place(right).value == 0 && inRegister(left)) {
+        line("testl " + operand(left) + ", " + operand(left));
+    } else if (immediate(left) || (!inRegister(left) && !inRegister(right) && !immediate(right))) {
+        load("%eax", left);
+        line("cmpl " + operand(right) + ", %eax");
+    } else {
+        line("cmpl " + operand(right) + ", " + operand(left));
+    }
+    return condition(op, negate, swapped);
+}
+
+// Sets the flags for `reg` compared with zero
+void X86Backend::test(uint16_t reg) {
+    if (inRegister(reg)) {
+        line("testl " + operand(reg) + ", " + operand(reg));
+    } else if (immediate(reg)) {
+        load("%eax", reg);
+        line("testl %eax, %eax");
+    } else {
+        line("cmpl $0, " + operand(reg));
+    }
+}
+
+// a = the flag setcc left in al
+void X86Backend::setFromFlags(uint16_t a) {
+    if (inRegister(a)) {
+        line("movzbl %al, " + operand(a));
+    } else {
+        line("movzbl %al, %eax");
+        assign(a, "%eax");
+    }
+}
+
+void X86Backend::copy(uint16_t to, uint16_t from) {
+    if (sameLocation(to, from)) return;
+    if (!inRegister(to) && !inRegister(from) && !immediate(from)) {
+        load("%eax", from);
+        assign(to, "%eax");
+        return;
+    }
+    if (inRegister(to) && immediate(from) && place(from).value == 0) {
+        line("xorl " + operand(to) + ", " + operand(to));
+        return;
+    }
+    line("movl " + operand(from) + ", " + operand(to));
+}
+
+// A register of the bytecode from memory, through eax if it is spilled
+void X86Backend::moveFrom(uint16_t to, const std::string& memory) {
+    if (inRegister(to)) {
+        line("movl " + memory + ", " + operand(to));
+    } else {
+        line("movl " + memory + ", %eax");
+        assign(to, "%eax");
+    }
+}
+
+void X86Backend::load(const std::string& scratch, uint16_t reg) {
+    line("movl " + operand(reg) + ", " + scratch);
+}
+
+void X86Backend::assign(uint16_t reg, const std::string& scratch) {
+    line("movl " + scratch + ", " + operand(reg));
+}
+
+// The operand of a store to memory: `scratch`, loaded, if `reg` is spilled
+std::string X86Backend::source(uint16_t reg, const std::string& scratch) {
+    if (inRegister(reg) || immediate(reg)) return operand(reg);
+    load(scratch, reg);
+    return scratch;
+}
+
+// Puts the index a register holds in rax
+void X86Backend::index(uint16_t reg) {
+    line("movslq " + operand(reg) + ", %rax");
+}
+
+// The address of an element of an array of the frame: `offset` on from
+// the start, and rax more if `indexed`
+std::string X86Backend::element(uint16_t array, int64_t offset, bool indexed) const {
+    const int64_t start = arrayBase + 4 * (static_cast<int64_t>(function->arrays[array].offset) - function->registers);
+    return std::to_string(start + 4 * offset) + (indexed ? "(%rbp,%rax,4)" : "(%rbp)");
+}
+
+// Where a register is at the instruction being lowered
+X86Backend::Location X86Backend::place(uint16_t reg) const {
+    if (isConstant(reg)) {
+        return Location{Immediate, static_cast<int32_t>(function->constants[reg - function->parameters].i)};
+    }
+    return locations[runs[reg][runAt(reg, at)].range];
+}
+
+bool X86Backend::isConstant(uint16_t reg) const {
+    return reg >= function->parameters && reg - function->parameters < static_cast<int>(function->constants.size());
+}
+
+// The run of a register an instruction is in
+size_t X86Backend::runAt(uint16_t reg, size_t pc) const {
+    const auto& list = runs[reg];
+    const auto next = std::upper_bound(list.begin(), list.end(), pc,
+                                       [](size_t instruction, const Run& run) { return instruction < run.start; });
+    if (next == list.begin() || (next - 1)->end < pc) fail("register " + std::to_string(reg) + " is not live");
+    return static_cast<size_t>(next - list.begin() - 1);
+}
+
+bool X86Backend::liveAfter(uint16_t reg, size_t pc) const {
+    return ((live[pc * words + reg / 64] >> (reg % 64)) & 1) != 0;
+}
+
+std::string X86Backend::operand(uint16_t reg) const {
+    const Location location = place(reg);
+    if (location.reg >= 0) return kRegisters[location.reg].name32;
+    if (location.reg == Immediate) return "$" + std::to_string(location.value);
+    return std::to_string(location.value) + "(%rbp)";
+}
+
+bool X86Backend::sameLocation(uint16_t a, uint16_t b) const {
+    const Location first = place(a);
+    const Location second = place(b);
+    return first.reg == second.reg && (first.reg >= 0 || first.value == second.value);
+}
+
+std::string X86Backend::label(size_t pc) const {
+    return ".L" + std::to_string(functionIndex) + "_" + std::to_string(pc);
+}
+
+// The label of a string of the data section, shared by equal strings
+std::string X86Backend::stringLabel(const std::string& text) {
+    auto found = std::find(strings.begin(), strings.end(), text);
+    if (found == strings.end()) found = strings.insert(strings.end(), text);
+    return ".LC" + std::to_string(found - strings.begin());
+}
+
+void X86Backend::line(const std::string& instruction) {
+    out += '\t';
+    out += instruction;
+    out += '\n';
+}
+
+void X86Backend::fail(const std::string& message) const {
+    throw std::runtime_error("function " + std::string(function->name.str()) + ": " + message);
+}
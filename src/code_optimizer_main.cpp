@@ -1,101 +1,408 @@
-#include "../include/Tokenizer.h"
-#include "../include/Parser.h"
-#include "../include/CodeAnalyzer.h"
-#include "../include/CodeOptimizer.h"
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <stdexcept>
-#include <string>
-
-// Function to read content from file
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file: " + filename);
-    }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
-
-// Function to write content to file
-void writeFile(const std::string& filename, const std::string& content) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Error opening file for writing: " + filename);
-    }
-    
-    file << content;
-    file.close();
-}
-
-void printTokens(const std::vector<Token>& tokens) {
-    for (const auto& token : tokens) {
-        std::cout << "Type: ";
-        switch (token.type) {
-            case TokenType::Identifier: std::cout << "Identifier"; break;
-            case TokenType::Keyword:    std::cout << "Keyword"; break;
-            case TokenType::Operator:   std::cout << "Operator"; break;
-            case TokenType::Number:     std::cout << "Number"; break;
-            case TokenType::Separator:  std::cout << "Separator"; break;
-            case TokenType::Literal:    std::cout << "Literal"; break;
-            default:                   std::cout << "Unknown"; break;
-        }
-        std::cout << ", Value: '" << token.value << "'\n";
-    }
-}
-
-int main(int argc, char* argv[]) {
-    // Check if input and output file paths are provided
-    if (argc < 3) {
-        std::cout << "Usage: " << argv[0] << " <input_file> <output_file>" << std::endl;
-        return 1;
-    }
-    
-    std::string inputFile = argv[1];
-    std::string outputFile = argv[2];
-    
-    try {
-        // Read input code
-        std::string code = readFile(inputFile);
-        std::cout << "Processing file: " << inputFile << std::endl;
-        
-        // Tokenize
-        Tokenizer tokenizer;
-        auto tokens = tokenizer.tokenize(code);
-        
-        std::cout << "Tokenization complete. Found " << tokens.size() << " tokens." << std::endl;
-        
-        // Parse
-        Parser parser(tokens);
-        auto ast = parser.parse();
-        
-        std::cout << "Parsing complete. AST created." << std::endl;
-        
-        // Analyze
-        std::cout << "\nRunning code analysis..." << std::endl;
-        CodeAnalyzer analyzer;
-        analyzer.analyze(ast);
-        
-        // Optimize
-        std::cout << "\nOptimizing code..." << std::endl;
-        CodeOptimizer optimizer;
-        auto optimizedAst = optimizer.optimize(ast);
-        
-        // Generate optimized code
-        std::string optimizedCode = optimizer.generateCode(optimizedAst);
-        
-        // Write output
-        writeFile(outputFile, optimizedCode);
-        
-        std::cout << "Optimization complete. Optimized code written to: " << outputFile << std::endl;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
-        return 1;
-    }
-    
-    return 0;
+#include "../include/Tokenizer.h"
+#include "../include/Parser.h"
+#include "../include/CodeAnalyzer.h"
+#include "../include/CodeOptimizer.h"
+#include "../include/IncrementalParser.h"
+#include "../include/VirtualMachine.h"
+#include "../include/X86Backend.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Function to write content to file. The content is handed to the OS in
+// large unbuffered writes straight from the emitter's buffer.
+void writeFile(const std::string& filename, std::string_view content) {
+#ifdef _WIN32
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Error opening file for writing: " + filename);
+    }
+    file.write(content.data(), static_cast<std::streamsize>(content.size()));
+#else
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Error opening file for writing: " + filename);
+    }
+
+    const size_t chunk = size_t(1) << 30;
+    while (!content.empty()) {
+        ssize_t n = ::write(fd, content.data(), std::min(content.size(), chunk));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ::close(fd);
+            throw std::runtime_error("Error writing file: " + filename + ": " + std::strerror(errno));
+        }
+        content.remove_prefix(static_cast<size_t>(n));
+    }
+    if (::close(fd) != 0) {
+        throw std::runtime_error("Error writing file: " + filename + ": " + std::strerror(errno));
+    }
+#endif
+}
+
+void printTokens(const std::vector<Token>& tokens) {
+    for (const auto& token : tokens) {
+        std::cout << "Type: ";
+        switch (token.type) {
+            case TokenType::Identifier: std::cout << "Identifier"; break;
+            case TokenType::Keyword:    std::cout << "Keyword"; break;
+            case TokenType::Operator:   std::cout << "Operator"; break;
+            case TokenType::Number:     std::cout << "Number"; break;
+            case TokenType::Separator:  std::cout << "Separator"; break;
+            case TokenType::Literal:    std::cout << "Literal"; break;
+            default:                   std::cout << "Unknown"; break;
+        }
+        std::cout << ", Value: '" << token.value << "'\n";
+    }
+}
+
+// Brings `ast`, the tree of `source`, up to date with `edited`, a changed
+// copy of it. The edit is taken to be everything between the longest
+// common prefix and suffix of the two, and only the statements it touches
+// are parsed again.
+ASTNode* reparseEdited(ASTNode* ast, const SourceBuffer& source, const SourceBuffer& edited, ASTArena& arena) {
+    const std::string_view before = source.view();
+    const std::string_view after = edited.view();
+    const size_t prefix = std::mismatch(before.begin(), before.end(), after.begin(), after.end()).first -
+                          before.begin();
+    size_t suffix = 0;
+    while (suffix < std::min(before.size(), after.size()) - prefix &&
+           before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    IncrementalParser incremental(arena);
+    const TextEdit edit{prefix, before.size() - prefix - suffix, after.size() - prefix - suffix};
+    ast = incremental.reparse(ast, source, edited, edit);
+    const ReparseStats& stats = incremental.stats();
+    std::cout << "Reparse complete. Replaced " << edit.removed << " bytes at offset " << edit.offset << " by "
+              << edit.inserted << " bytes; relexed " << stats.bytesRelexed << " bytes, " << stats.statementsReparsed
+              << " statements parsed in place of " << stats.statementsReplaced << "." << std::endl;
+    return ast;
+}
+
+// Cycles of the function `region` is in another version of the program,
+// which defines the functions of each name in the same order; false if
+// that version has no such function
+bool functionCycles(const std::vector<CostModel::Region>& regions, const std::vector<CostModel::Region>& others,
+                    const CostModel::Region& region, double& cycles) {
+    size_t earlier = 0;
+    for (const auto& other : regions) {
+        if (&other == &region) break;
+        if (other.kind == "function" && other.function == region.function) ++earlier;
+    }
+    for (const auto& other : others) {
+        if (other.kind != "function" || other.function != region.function) continue;
+        if (earlier-- == 0) {
+            cycles = other.cycles;
+            return true;
+        }
+    }
+    return false;
+}
+
+void printLoops(const std::vector<CostModel::Region>& regions) {
+    for (const auto& region : regions) {
+        if (region.kind == "function") continue;
+        std::cout << "    " << region.function << ": " << std::string(region.depth * 2, ' ') << region.kind
+                  << " on line " << region.line << ", " << region.trips << (region.assumed ? " assumed" : "")
+                  << " trips, " << region.cycles << " cycles x " << region.executions << std::endl;
+    }
+}
+
+// Estimated cost of each function before and after optimization; with
+// `loops`, of each loop as well
+void printCostReport(const std::vector<CostModel::Region>& before, const std::vector<CostModel::Region>& after,
+                     bool loops) {
+    std::cout << "\nEstimated cost in cycles, for one call of each function:" << std::endl;
+    const auto precision = std::cout.precision(0);
+    const auto flags = std::cout.setf(std::ios::fixed, std::ios::floatfield);
+    for (const auto& region : before) {
+        if (region.kind != "function") continue;
+        double optimized = 0;
+        const bool kept = functionCycles(before, after, region, optimized);
+        std::cout << "  " << region.function << " (line " << region.line << "): " << region.cycles << " before, ";
+        if (!kept) {
+            std::cout << "removed by optimization" << std::endl;
+            continue;
+        }
+        std::cout << optimized << " after";
+        if (region.cycles > 0) {
+            std::cout.precision(1);
+            const double change = 100 * (optimized - region.cycles) / region.cycles;
+            std::cout << " (" << std::abs(change) << (change > 0 ? "% more)" : "% less)");
+            std::cout.precision(0);
+        }
+        std::cout << std::endl;
+    }
+    if (loops) {
+        std::cout << "  Loops before optimization:" << std::endl;
+        printLoops(before);
+        std::cout << "  Loops after optimization:" << std::endl;
+        printLoops(after);
+    }
+    std::cout.precision(precision);
+    std::cout.flags(flags);
+}
+
+void writeRegionsJson(std::ostream& json, const std::vector<CostModel::Region>& regions) {
+    json << "[";
+    for (size_t i = 0; i < regions.size(); ++i) {
+        const auto& region = regions[i];
+        json << (i ? ",\n    " : "\n    ") << "{\"kind\": \"" << region.kind << "\", \"function\": \""
+             << region.function << "\", \"line\": " << region.line;
+        if (region.kind != "function") {
+            json << ", \"depth\": " << region.depth << ", \"trips\": " << region.trips
+                 << ", \"assumedTrips\": " << (region.assumed ? "true" : "false")
+                 << ", \"executions\": " << region.executions;
+        }
+        json << ", \"cycles\": " << region.cycles << "}";
+    }
+    json << (regions.empty() ? "]" : "\n  ]");
+}
+
+std::string costReportJson(const std::vector<CostModel::Region>& before, const std::vector<CostModel::Region>& after) {
+    std::ostringstream json;
+    json << "{\n  \"before\": ";
+    writeRegionsJson(json, before);
+    json << ",\n  \"after\": ";
+    writeRegionsJson(json, after);
+    json << "\n}\n";
+    return json.str();
+}
+
+void printRunStatistics(const std::string& version, const VirtualMachine::Statistics& statistics) {
+    std::cout << "[VM] " << version << ": " << statistics.instructions << " instructions in "
+              << statistics.seconds * 1000 << " ms, exit code " << statistics.exitCode << std::endl;
+
+    // The opcodes that ran most
+    std::vector<size_t> opcodes(OpcodeCount);
+    std::iota(opcodes.begin(), opcodes.end(), 0);
+    std::sort(opcodes.begin(), opcodes.end(),
+              [&](size_t a, size_t b) { return statistics.executed[a] > statistics.executed[b]; });
+    std::cout << "[VM]   most executed:";
+    for (size_t i = 0; i < 5 && statistics.executed[opcodes[i]] > 0; ++i) {
+        std::cout << (i ? ", " : " ") << opcodeName(static_cast<Opcode>(opcodes[i])) << " "
+                  << statistics.executed[opcodes[i]];
+    }
+    std::cout << std::endl;
+}
+
+// Runs the optimized program on the virtual machine, with std::cin and
+// std::cout as its own; or, `differential`, runs both versions on the same
+// input from std::cin and checks they write the same output. Returns the
+// exit status for the tool.
+int runOnVirtualMachine(const ASTNode* original, const ASTNode* optimized, bool differential) {
+    try {
+        BytecodeCompiler compiler;
+        VirtualMachine machine;
+        const BytecodeProgram after = compiler.compile(optimized);
+        if (!differential) {
+            std::cout << "\n[VM] Running the optimized program, " << after.size() << " instructions" << std::endl;
+            printRunStatistics("optimized", machine.run(after, std::cin, std::cout));
+            return 0;
+        }
+
+        const BytecodeProgram before = compiler.compile(original);
+        std::cout << "\n[VM] Running both versions, " << before.size() << " and " << after.size()
+                  << " instructions" << std::endl;
+        const std::string input((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        std::istringstream originalInput(input);
+        std::istringstream optimizedInput(input);
+        std::ostringstream originalOutput;
+        std::ostringstream optimizedOutput;
+        const auto originalRun = machine.run(before, originalInput, originalOutput);
+        const auto optimizedRun = machine.run(after, optimizedInput, optimizedOutput);
+        printRunStatistics("original", originalRun);
+        printRunStatistics("optimized", optimizedRun);
+        if (originalRun.instructions > 0) {
+            std::cout << "[VM] The optimized program runs "
+                      << 100.0 * optimizedRun.instructions / originalRun.instructions
+                      << "% of the instructions of the original" << std::endl;
+        }
+
+        const std::string expected = originalOutput.str();
+        const std::string actual = optimizedOutput.str();
+        if (expected == actual && originalRun.exitCode == optimizedRun.exitCode) {
+            std::cout << "[VM] Same output: " << expected.size() << " bytes" << std::endl;
+            return 0;
+        }
+        if (expected == actual) {
+            std::cout << "[VM] MISMATCH: exit code " << originalRun.exitCode << " before, " << optimizedRun.exitCode
+                      << " after" << std::endl;
+            return 1;
+        }
+        const size_t at = std::mismatch(expected.begin(), expected.end(), actual.begin(), actual.end()).first -
+                          expected.begin();
+        auto lineAt = [&](const std::string& output) {
+            const size_t begin = output.rfind('\n', at ? at - 1 : 0);
+            const size_t start = begin == std::string::npos || at == 0 ? 0 : begin + 1;
+            return output.substr(start, output.find('\n', start) - start);
+        };
+        std::cout << "[VM] MISMATCH on output line " << std::count(expected.begin(), expected.begin() + at, '\n') + 1
+                  << ":\n[VM]   original:  " << lineAt(expected) << "\n[VM]   optimized: " << lineAt(actual)
+                  << std::endl;
+        return 1;
+    } catch (const std::exception& e) {
+        std::cout << "[VM] Cannot run: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// Lowers the optimized program to x86-64 assembly in `assemblyFile`.
+// Returns whether it could.
+bool writeAssembly(const ASTNode* optimized, const std::string& assemblyFile) {
+    try {
+        BytecodeCompiler compiler;
+        X86Backend backend;
+        writeFile(assemblyFile, backend.compile(compiler.compile(optimized)));
+        const auto& statistics = backend.statistics();
+        std::cout << "\n[x86] Assembly written to: " << assemblyFile << " (build it with: gcc " << assemblyFile
+                  << " -o program)" << std::endl;
+        std::cout << "[x86] " << statistics.functions << " functions, " << statistics.ranges
+                  << " live ranges, " << statistics.spilled << " spilled, " << statistics.conditionalMoves
+                  << " cmov, " << statistics.fusedBranches << " compare-and-branch" << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        std::cout << "\n[x86] Cannot lower: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Options may come anywhere; the other arguments are positional
+    std::vector<std::string> arguments;
+    bool costReport = false;
+    bool run = false;
+    bool differential = false;
+    std::string costJsonFile;
+    std::string assemblyFile;
+    std::string editedFile;
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if (argument == "--cost") {
+            costReport = true;
+        } else if (argument == "--run") {
+            run = true;
+        } else if (argument == "--diff") {
+            differential = true;
+        } else if (argument.rfind("--cost-json=", 0) == 0) {
+            costJsonFile = argument.substr(12);
+        } else if (argument.rfind("--asm=", 0) == 0) {
+            assemblyFile = argument.substr(6);
+        } else if (argument.rfind("--edit=", 0) == 0) {
+            editedFile = argument.substr(7);
+        } else {
+            arguments.push_back(argument);
+        }
+    }
+
+    // Check if input and output file paths are provided
+    if (arguments.size() < 2) {
+        std::cout << "Usage: " << argv[0] << " [--cost] [--cost-json=<file>] [--asm=<file>] [--edit=<file>] [--run | --diff] <input_file> <output_file> [parser_threads] [unroll_factor]" << std::endl;
+        std::cout << "Use - as the input file to read from stdin." << std::endl;
+        std::cout << "parser_threads defaults to the number of hardware threads." << std::endl;
+        std::cout << "unroll_factor defaults to " << LoopUnrolling::DefaultFactor << "; 1 turns partial unrolling off." << std::endl;
+        std::cout << "--cost lists the estimated cost of every loop besides every function;" << std::endl;
+        std::cout << "--cost-json writes both to a JSON file." << std::endl;
+        std::cout << "--edit parses the input, then reparses only what changed to get the tree of <file>, an edited" << std::endl;
+        std::cout << "copy of it, which is then optimized in place of the input;" << std::endl;
+        std::cout << "--asm writes the optimized program as x86-64 assembly, for programs with only int values;" << std::endl;
+        std::cout << "--run runs the optimized program on the bytecode VM, with this program's stdin and stdout;" << std::endl;
+        std::cout << "--diff runs both versions on the same stdin and checks their output is the same." << std::endl;
+        return 1;
+    }
+    
+    std::string inputFile = arguments[0];
+    std::string outputFile = arguments[1];
+    unsigned parserThreads = arguments.size() > 2 ? static_cast<unsigned>(std::max(1, std::atoi(arguments[2].c_str())))
+                                                  : std::max(1u, std::thread::hardware_concurrency());
+    unsigned unrollFactor = arguments.size() > 3 ? static_cast<unsigned>(std::max(1, std::atoi(arguments[3].c_str())))
+                                                 : LoopUnrolling::DefaultFactor;
+    
+    try {
+        // Map the input; the buffer outlives every token and AST node below
+        SourceBuffer source = SourceBuffer::fromFile(inputFile);
+        std::cout << "Processing file: " << inputFile << std::endl;
+        
+        // Every AST node of this unit, original and optimized, lives in one
+        // arena that releases the whole tree at once when main returns
+        ASTArena arena;
+        
+        // Tokenize and parse in one pass; tokens are lexed as the parser asks
+        // for them, with top-level functions spread over parserThreads workers
+        Parser parser(source, arena);
+        auto ast = parser.parse(parserThreads);
+        
+        std::cout << "Tokenization complete. Found " << parser.tokensConsumed() << " tokens." << std::endl;
+        std::cout << "Parsing complete. AST created." << std::endl;
+
+        // Like the input, the edited copy outlives the tree
+        std::unique_ptr<SourceBuffer> edited;
+        if (!editedFile.empty()) {
+            edited.reset(new SourceBuffer(SourceBuffer::fromFile(editedFile)));
+            std::cout << "Processing edit: " << editedFile << std::endl;
+            ast = reparseEdited(ast, source, *edited, arena);
+        }
+        
+        // Analyze
+        std::cout << "\nRunning code analysis..." << std::endl;
+        CodeAnalyzer analyzer;
+        analyzer.analyze(ast);
+        
+        // Optimize
+        std::cout << "\nOptimizing code..." << std::endl;
+        CodeOptimizer optimizer(arena);
+        optimizer.setUnrollFactor(unrollFactor);
+        auto optimizedAst = optimizer.optimize(ast);
+        
+        // Generate optimized code
+        std::string optimizedCode = optimizer.generateCode(optimizedAst);
+        
+        // Write output
+        writeFile(outputFile, optimizedCode);
+        
+        std::cout << "Optimization complete. Optimized code written to: " << outputFile << std::endl;
+
+        // Estimate; the original tree is intact after optimizing
+        const CostModel& costs = optimizer.costModel();
+        const auto before = costs.regions(ast);
+        const auto after = costs.regions(optimizedAst);
+        printCostReport(before, after, costReport);
+        if (!costJsonFile.empty()) {
+            writeFile(costJsonFile, costReportJson(before, after));
+            std::cout << "Cost estimates written to: " << costJsonFile << std::endl;
+        }
+
+        std::cout << "AST arena: " << arena.allocationCount() << " allocations, "
+                  << arena.bytesReserved() / 1024 << " KB in " << arena.blockCount() << " blocks" << std::endl;
+
+        if (!assemblyFile.empty() && !writeAssembly(optimizedAst, assemblyFile)) return 1;
+        if (run || differential) return runOnVirtualMachine(ast, optimizedAst, differential);
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
 }
\ No newline at end of file
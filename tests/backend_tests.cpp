@@ -0,0 +1,136 @@
+// Regression tests for the backends. Programs are parsed, optimized and
+// compiled to bytecode, then run on the VM, with the output compared with
+// what the program prints when built with g++, or lowered to x86-64.
+//
+// Usage: backend_tests
+#include "../include/ASTArena.h"
+#include "../include/Bytecode.h"
+#include "../include/CodeOptimizer.h"
+#include "../include/Parser.h"
+#include "../include/SourceBuffer.h"
+#include "../include/VirtualMachine.h"
+#include "../include/X86Backend.h"
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+BytecodeProgram compileSource(const std::string& source) {
+    SourceBuffer buffer(source);
+    ASTArena arena;
+    Parser parser(buffer, arena);
+    CodeOptimizer optimizer(arena);
+    BytecodeCompiler compiler;
+    return compiler.compile(optimizer.optimize(parser.parse()));
+}
+
+void report(const char* name, const std::string& expected, const std::string& actual) {
+    if (actual == expected) {
+        std::cout << "PASS " << name << std::endl;
+        return;
+    }
+    ++failures;
+    std::cout << "FAIL " << name << "\n  expected: " << expected << "\n  actual:   " << actual << std::endl;
+}
+
+// Runs `source` on the VM with `input`
+void expectRun(const char* name, const std::string& source, const std::string& input, const std::string& expected) {
+    std::string actual;
+    try {
+        std::istringstream in(input);
+        std::ostringstream out;
+        VirtualMachine().run(compileSource(source), in, out);
+        actual = out.str();
+    } catch (const std::exception& e) {
+        actual = std::string("error: ") + e.what();
+    }
+    report(name, expected, actual);
+}
+
+// Lowers `source` to x86-64 assembly; the result is "defines `function`"
+// if the assembly has a label for it, else the error
+void expectAssembly(const char* name, const std::string& source, const std::string& function,
+                    const std::string& expected) {
+    std::string actual;
+    try {
+        const std::string assembly = X86Backend().compile(compileSource(source));
+        actual = assembly.find(function + ":") != std::string::npos ? "defines " + function : assembly;
+    } catch (const std::exception& e) {
+        actual = std::string("error: ") + e.what();
+    }
+    report(name, expected, actual);
+}
+
+} // namespace
+
+int main() {
+    // A function after one with a branch, and a global between them
+    const std::string globalAfterBranch = "#include <iostream>\n"
+                                          "int fib(int n) {\n"
+                                          "    if (n < 2) {\n"
+                                          "        return n;\n"
+                                          "    }\n"
+                                          "    return n + 1;\n"
+                                          "}\n"
+                                          "int g = 5;\n"
+                                          "int bump(int a) {\n"
+                                          "    g = g + a;\n"
+                                          "    return g;\n"
+                                          "}\n"
+                                          "int main() {\n"
+                                          "    int n;\n"
+                                          "    std::cin >> n;\n"
+                                          "    int x = bump(n);\n"
+                                          "    int y = fib(n);\n"
+                                          "    std::cout << x << \" \" << y << \" \" << g << std::endl;\n"
+                                          "    return 0;\n"
+                                          "}\n";
+    expectRun("vm: global after a function with a branch", globalAfterBranch, "3", "8 4 8\n");
+    expectAssembly("x86: global after a function with a branch", globalAfterBranch, "bump", "defines bump");
+
+    // Conditions left out are reported, not followed
+    const std::string whileWithoutCondition = "#include <iostream>\n"
+                                              "int main() {\n"
+                                              "    int x = 1;\n"
+                                              "    while () {\n"
+                                              "    }\n"
+                                              "    return 0;\n"
+                                              "}\n";
+    const std::string ifWithoutCondition = "#include <iostream>\n"
+                                           "int main() {\n"
+                                           "    int x = 1;\n"
+                                           "    if () {\n"
+                                           "        x = 2;\n"
+                                           "    }\n"
+                                           "    std::cout << x << std::endl;\n"
+                                           "    return 0;\n"
+                                           "}\n";
+    expectRun("vm: while without a condition", whileWithoutCondition, "",
+              "error: line 4: an expression is missing");
+    expectRun("vm: if without a condition", ifWithoutCondition, "", "error: line 4: an expression is missing");
+    expectAssembly("x86: while without a condition", whileWithoutCondition, "main",
+                   "error: line 4: an expression is missing");
+
+    // Arrays are in the frames of functions only
+    expectRun("vm: array outside functions",
+              "#include <iostream>\n"
+              "int a[100];\n"
+              "int main() {\n"
+              "    a[0] = 1;\n"
+              "    return 0;\n"
+              "}\n",
+              "",
+              "error: line 2: arrays declared outside functions are not supported; declare a in the functions that "
+              "use it");
+
+    if (failures > 0) {
+        std::cout << failures << " tests failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}
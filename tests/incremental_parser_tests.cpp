@@ -0,0 +1,172 @@
+// Equivalence tests for the incremental parser. After each edit the tree
+// brought up to date by IncrementalParser::reparse must be the tree a full
+// parse of the new source builds, down to every position and span. Besides
+// a few fixed edits, random edits are made to a program, several in a row
+// on one tree.
+//
+// Usage: incremental_parser_tests [seeds]
+#include "../include/ASTArena.h"
+#include "../include/IncrementalParser.h"
+#include "../include/Parser.h"
+#include "../include/SourceBuffer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+const std::string kProgram = "#include <iostream>\n"
+                             "int g = 5;\n"
+                             "int fib(int n) {\n"
+                             "    if (n < 2) {\n"
+                             "        return n;\n"
+                             "    }\n"
+                             "    return fib(n - 1) + fib(n - 2);\n"
+                             "}\n"
+                             "int main() {\n"
+                             "    int a[4] = {1, 2, 3, 4};\n"
+                             "    int total = 0;\n"
+                             "    for (int i = 0; i < 4; i++) {\n"
+                             "        total += a[i] * g;\n"
+                             "    }\n"
+                             "    while (total > 10) {\n"
+                             "        total = total - 3;\n"
+                             "    }\n"
+                             "    std::cout << \"first\n"
+                             "second\" << total << std::endl;\n"
+                             "    std::cout << fib(total) << std::endl;\n"
+                             "    return 0;\n"
+                             "}\n";
+
+// Everything about a tree a reparse must get right, one node per line
+void dump(const ASTNode* node, int depth, std::ostringstream& out) {
+    out << std::string(depth * 2, ' ');
+    if (!node) {
+        out << "null\n";
+        return;
+    }
+    out << static_cast<int>(node->type) << " '" << node->value.str() << "' " << node->loc.line << ':'
+        << node->loc.column << " [" << node->span.begin << ", " << node->span.end << ")\n";
+    dump(node->left, depth + 1, out);
+    dump(node->right, depth + 1, out);
+    for (const ASTNode* child : node->children) dump(child, depth + 1, out);
+}
+
+std::string dump(const ASTNode* node) {
+    std::ostringstream out;
+    dump(node, 0, out);
+    return out.str();
+}
+
+// A source and the tree kept up to date with it
+struct Document {
+    ASTArena arena;
+    std::unique_ptr<SourceBuffer> source;
+    ASTNode* tree;
+
+    explicit Document(const std::string& text) : source(std::make_unique<SourceBuffer>(text)) {
+        tree = Parser(*source, arena).parse();
+    }
+
+    // Replaces `removed` bytes at `offset` by `text`. Returns whether the
+    // reparsed tree is the one a full parse builds; reports it if not.
+    bool edit(const char* name, size_t offset, size_t removed, const std::string& text) {
+        std::string newText(source->view());
+        newText.replace(offset, removed, text);
+        auto newSource = std::make_unique<SourceBuffer>(newText);
+
+        ASTArena fullArena;
+        const std::string expected = dump(Parser(*newSource, fullArena).parse());
+        IncrementalParser incremental(arena);
+        tree = incremental.reparse(tree, *source, *newSource, TextEdit{offset, removed, text.size()});
+        source = std::move(newSource);
+        const std::string actual = dump(tree);
+        if (actual == expected) return true;
+
+        const size_t at = std::mismatch(expected.begin(), expected.end(), actual.begin(), actual.end()).first -
+                          expected.begin();
+        auto lineAt = [&](const std::string& text) {
+            const size_t begin = text.rfind('\n', at ? at - 1 : 0);
+            const size_t start = begin == std::string::npos || at == 0 ? 0 : begin + 1;
+            return text.substr(start, text.find('\n', start) - start);
+        };
+        ++failures;
+        std::cout << "FAIL " << name << ": replaced " << removed << " bytes at " << offset << " by \"" << text
+                  << "\"\n  full parse: " << lineAt(expected) << "\n  reparse:    " << lineAt(actual)
+                  << std::endl;
+        return false;
+    }
+};
+
+void expectSameTree(const char* name, const std::string& before, const std::string& find, size_t removed,
+                    const std::string& text) {
+    Document document(before);
+    if (document.edit(name, before.find(find), removed, text)) {
+        std::cout << "PASS " << name << std::endl;
+    }
+}
+
+// Text a random edit inserts: tokens, whitespace and whole statements
+const char* const kInsertions[] = {"\n", " ", "    ", "x", "1", "7", ";", "{", "}", "(", ")", "\"", "+ 1",
+                                   "\n\n", "int y = 2;\n", "total = total + 1;", "// note\n", "/* a\nb */",
+                                   "\"text\nmore\"", "if (g) { g = 1; }\n"};
+
+void randomEdits(unsigned seeds) {
+    unsigned failed = 0;
+    for (unsigned seed = 1; seed <= seeds; ++seed) {
+        std::mt19937 random(seed);
+        Document document(kProgram);
+        const std::string name = "random edits, seed " + std::to_string(seed);
+        for (int step = 0; step < 4; ++step) {
+            const size_t size = document.source->size();
+            const size_t offset = random() % (size + 1);
+            const size_t removed = random() % 3 == 0 ? random() % (std::min<size_t>(size - offset, 12) + 1) : 0;
+            const std::string text = random() % 4 == 0 ? "" : kInsertions[random() % std::size(kInsertions)];
+            if (removed == 0 && text.empty()) continue;
+            if (!document.edit(name.c_str(), offset, removed, text)) {
+                ++failed;
+                break;
+            }
+        }
+    }
+    if (failed == 0) std::cout << "PASS random edits, " << seeds << " seeds" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // Inside a body: the function's result type and parameters come before it
+    expectSameTree("newline in a function body", kProgram, "    int total", 0, "\n");
+    expectSameTree("line in a function with parameters", kProgram, "        return n;", 0, "    n = n;\n");
+
+    // Tokens after a string spanning lines, on the line the edit is on
+    expectSameTree("edit before a string spanning lines", kProgram, "std::cout << \"first", 0, "  ");
+    expectSameTree("edit before a string spanning lines, in a new line", kProgram, "std::cout << \"first", 0,
+                   "x = 1;\nx = 2; ");
+    // An operation is placed at its operator, past such a string, but its
+    // left operand is still on the line
+    const std::string operandBeforeString = "int main() {\n"
+                                            "    int x = 1;\n"
+                                            "    x = x - \"a\n"
+                                            "b\" + 1;\n"
+                                            "    return x;\n"
+                                            "}\n";
+    expectSameTree("edit before an operation across a string", operandBeforeString, "x = x", 0, ";");
+
+    const unsigned seeds = argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10)) : 300;
+    randomEdits(seeds);
+
+    if (failures > 0) {
+        std::cout << failures << " tests failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Regression tests for the optimizer. Each program is parsed and
+// optimized, then either run on the bytecode VM, with its output compared
+// with what the program prints when built with g++, or looked for a piece
+// of the code the optimizer should write.
+//
+// Usage: optimizer_tests
+#include "../include/ASTArena.h"
+#include "../include/Bytecode.h"
+#include "../include/CodeOptimizer.h"
+#include "../include/Parser.h"
+#include "../include/SourceBuffer.h"
+#include "../include/VirtualMachine.h"
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+int failures = 0;
+
+// The optimized code of `source`, whether or not the VM can run it
+std::string optimize(const std::string& source) {
+    SourceBuffer buffer(source);
+    ASTArena arena;
+    Parser parser(buffer, arena);
+    CodeOptimizer optimizer(arena);
+    return optimizer.generateCode(optimizer.optimize(parser.parse()));
+}
+
+// Optimizes `source`, then runs it on `input`; `code` is the optimized
+// source
+std::string optimizeAndRun(const std::string& source, const std::string& input, std::string& code) {
+    SourceBuffer buffer(source);
+    ASTArena arena;
+    Parser parser(buffer, arena);
+    CodeOptimizer optimizer(arena);
+    ASTNode* optimized = optimizer.optimize(parser.parse());
+    code = optimizer.generateCode(optimized);
+
+    BytecodeCompiler compiler;
+    std::istringstream in(input);
+    std::ostringstream out;
+    VirtualMachine().run(compiler.compile(optimized), in, out);
+    return out.str();
+}
+
+void expectOutput(const char* name, const std::string& source, const std::string& input,
+                  const std::string& expected) {
+    std::string code;
+    std::string actual;
+    try {
+        actual = optimizeAndRun(source, input, code);
+    } catch (const std::exception& e) {
+        actual = std::string("error: ") + e.what();
+    }
+    if (actual == expected) {
+        std::cout << "PASS " << name << std::endl;
+        return;
+    }
+    ++failures;
+    std::cout << "FAIL " << name << "\n  expected: " << expected << "\n  actual:   " << actual
+              << "\n  optimized code:\n" << code << std::endl;
+}
+
+// The optimized code of `source` must contain `text`, or not if `present`
+// is false
+void expectCode(const char* name, const std::string& source, const std::string& text, bool present = true) {
+    std::string code;
+    try {
+        code = optimize(source);
+    } catch (const std::exception& e) {
+        code = std::string("error: ") + e.what();
+    }
+    if ((code.find(text) != std::string::npos) == present) {
+        std::cout << "PASS " << name << std::endl;
+        return;
+    }
+    ++failures;
+    std::cout << "FAIL " << name << "\n  expected code " << (present ? "with: " : "without: ") << text << "\n  optimized code:\n" << code << std::endl;
+}
+
+} // namespace
+
+int main() {
+    // || binds less tightly than &&, and == less tightly than <, both
+    // when folded and when evaluated at run time
+    expectOutput("fold mixed || and &&",
+                 "#include <iostream>\n"
+                 "int main() {\n"
+                 "    if (1 || 0 && 0) {\n"
+                 "        std::cout << \"or\";\n"
+                 "    }\n"
+                 "    if (0 && 1 || 1) {\n"
+                 "        std::cout << \" and\";\n"
+                 "    }\n"
+                 "    std::cout << std::endl;\n"
+                 "    return 0;\n"
+                 "}\n",
+                 "", "or and\n");
+    expectOutput("fold mixed == and <",
+                 "#include <iostream>\n"
+                 "int main() {\n"
+                 "    int x = 0 == 1 < 2;\n"
+                 "    int y = 1 < 2 == 1;\n"
+                 "    if (0 == 1 < 2) {\n"
+                 "        std::cout << \"wrong \";\n"
+                 "    }\n"
+                 "    std::cout << x << y << std::endl;\n"
+                 "    return 0;\n"
+                 "}\n",
+                 "", "01\n");
+    expectOutput("mixed || and && at run time",
+                 "#include <iostream>\n"
+                 "int main() {\n"
+                 "    int a;\n"
+                 "    int b;\n"
+                 "    int c;\n"
+                 "    std::cin >> a >> b >> c;\n"
+                 "    if (a || b && c) {\n"
+                 "        std::cout << \"yes\";\n"
+                 "    }\n"
+                 "    int d = a == b < c;\n"
+                 "    std::cout << d << std::endl;\n"
+                 "    return 0;\n"
+                 "}\n",
+                 "1 0 0", "yes0\n");
+
+    // A call printed by cout is a call, not a shift of its name
+    expectOutput("print a call result",
+                 "#include <iostream>\n"
+                 "int fib(int n) {\n"
+                 "    if (n < 2) {\n"
+                 "        return n;\n"
+                 "    }\n"
+                 "    return fib(n - 1) + fib(n - 2);\n"
+                 "}\n"
+                 "int main() {\n"
+                 "    int n;\n"
+                 "    std::cin >> n;\n"
+                 "    std::cout << fib(n) << \" \" << fib(n - 1) << std::endl;\n"
+                 "    return 0;\n"
+                 "}\n",
+                 "10", "55 34\n");
+
+    // Shifting a negative int left is undefined, so only a multiplication
+    // known not to be negative becomes one
+    expectCode("no shift of a maybe negative int",
+               "#include <iostream>\n"
+               "int main() {\n"
+               "    int n;\n"
+               "    std::cin >> n;\n"
+               "    int m = n * 4;\n"
+               "    std::cout << m << std::endl;\n"
+               "    return 0;\n"
+               "}\n",
+               "n * 4");
+    expectCode("shift of a loop variable",
+               "#include <iostream>\n"
+               "int main() {\n"
+               "    int total = 0;\n"
+               "    for (int i = 0; i < 1000; i++) {\n"
+               "        total = total + (i + 1) * 8;\n"
+               "    }\n"
+               "    std::cout << total << std::endl;\n"
+               "    return 0;\n"
+               "}\n",
+               "<< 3");
+
+    // Globals are variables like any other to the dependences between loops
+    expectCode("fuse loops over global arrays",
+               "#include <iostream>\n"
+               "int a[100];\n"
+               "int b[100];\n"
+               "int main() {\n"
+               "    int n;\n"
+               "    std::cin >> n;\n"
+               "    for (int i = 0; i < n; i++) {\n"
+               "        a[i] = i * n;\n"
+               "    }\n"
+               "    for (int i = 0; i < n; i++) {\n"
+               "        b[i] = a[i] + 1;\n"
+               "    }\n"
+               "    std::cout << b[7] << std::endl;\n"
+               "    return 0;\n"
+               "}\n",
+               "        a[i] = i * n;\n"
+               "        b[i] = a[i] + 1;\n");
+
+    // A value numbered like a variable is that variable, not a temporary
+    // copy of it, even when it is spelled n - 0
+    expectCode("no temporary for a copy of a variable",
+               "#include <iostream>\n"
+               "int main() {\n"
+               "    int n;\n"
+               "    std::cin >> n;\n"
+               "    int a = (n - 0) * 3 + 1;\n"
+               "    int b = (n - 0) * 5 + 2;\n"
+               "    std::cout << a << \" \" << b << std::endl;\n"
+               "    return 0;\n"
+               "}\n",
+               " = n;", false);
+
+    if (failures > 0) {
+        std::cout << failures << " tests failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed" << std::endl;
+    return 0;
+}